@@ -1,4 +1,5 @@
 #include <stddef.h>
+#include <stdlib.h>
 #include "tpm_error.h"
 #include "tpm_library_intern.h"
 
@@ -54,6 +55,19 @@ Disabled_SetBufferSize(uint32_t wanted_size LIBTPMS_ATTR_UNUSED,
     return 0;
 }
 
+static uint32_t
+Disabled_SetKeyHandles(uint32_t wanted LIBTPMS_ATTR_UNUSED,
+                       uint32_t *min,
+                       uint32_t *max)
+{
+    if (min)
+        *min = 0;
+    if (max)
+        *max = 0;
+
+    return 0;
+}
+
 static TPM_RESULT
 Disabled_ValidateState(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
                        unsigned int flags LIBTPMS_ATTR_UNUSED)
@@ -61,6 +75,15 @@ Disabled_ValidateState(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
     return TPM_FAIL;
 }
 
+static TPM_RESULT
+Disabled_ValidateStateBlob(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
+                           const unsigned char *buffer LIBTPMS_ATTR_UNUSED,
+                           uint32_t buflen LIBTPMS_ATTR_UNUSED,
+                           unsigned int flags LIBTPMS_ATTR_UNUSED)
+{
+    return TPM_FAIL;
+}
+
 static TPM_RESULT
 Disabled_GetState(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
                   unsigned char **buffer LIBTPMS_ATTR_UNUSED,
@@ -77,6 +100,39 @@ Disabled_SetState(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
     return TPM_FAIL;
 }
 
+static TPM_RESULT
+Disabled_SetStateBuffer(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
+                        unsigned char *buffer,
+                        uint32_t buflen LIBTPMS_ATTR_UNUSED)
+{
+    free(buffer);
+    return TPM_FAIL;
+}
+
+static TPM_RESULT
+Disabled_GetStateStream(enum TPMLIB_StateType st LIBTPMS_ATTR_UNUSED,
+                        TPMLIB_StateWriter writer LIBTPMS_ATTR_UNUSED,
+                        void *opaque LIBTPMS_ATTR_UNUSED)
+{
+    return TPM_FAIL;
+}
+
+static TPM_RESULT
+Disabled_ReseedInstance(unsigned int flags LIBTPMS_ATTR_UNUSED)
+{
+    return TPM_FAIL;
+}
+
+static TPM_RESULT Disabled_TakeSnapshot(void)
+{
+    return TPM_FAIL;
+}
+
+static TPM_RESULT Disabled_ResetToSnapshot(void)
+{
+    return TPM_FAIL;
+}
+
 static TPM_RESULT Disabled_IO_Hash_Start(void)
 {
     return TPM_FAIL;
@@ -126,6 +182,13 @@ const struct tpm_interface DisabledInterface = {
     .SetBufferSize = Disabled_SetBufferSize,
     .ValidateState = Disabled_ValidateState,
     .SetState = Disabled_SetState,
+    .SetStateBuffer = Disabled_SetStateBuffer,
     .GetState = Disabled_GetState,
     .WasManufactured = Disabled_WasManufactured,
+    .SetKeyHandles = Disabled_SetKeyHandles,
+    .GetStateStream = Disabled_GetStateStream,
+    .ValidateStateBlob = Disabled_ValidateStateBlob,
+    .ReseedInstance = Disabled_ReseedInstance,
+    .TakeSnapshot = Disabled_TakeSnapshot,
+    .ResetToSnapshot = Disabled_ResetToSnapshot,
 };
@@ -1754,7 +1754,7 @@ TPM_RESULT TPM_Process_ChangeAuthAsymStart(tpm_state_t *tpm_state,
     if (returnCode == TPM_SUCCESS) {
 	ephHandle = 0;	/* no preferred value */
 	returnCode = TPM_KeyHandleEntries_AddKeyEntry(&ephHandle,			/* output */
-						      tpm_state->tpm_key_handle_entries, /* input */
+						      &(tpm_state->tpm_key_handle_entries), /* input */
 						      tempKey,				/* input */
 						      0,	/* parentPCRStatus not used */
 						      0);	/* keyControl not used */
@@ -1874,7 +1874,7 @@ TPM_RESULT TPM_Process_ChangeAuthAsymStart(tpm_state_t *tpm_state,
 	if (key_added) {
 	    /* if there was a failure and tempKey was stored in the handle list, free the handle.
 	       Ignore errors, since only one error code can be returned. */
-	    TPM_KeyHandleEntries_DeleteHandle(tpm_state->tpm_key_handle_entries, ephHandle);
+	    TPM_KeyHandleEntries_DeleteHandle(&(tpm_state->tpm_key_handle_entries), ephHandle);
 	}	
     }
     return rcf;
@@ -2219,7 +2219,7 @@ TPM_RESULT TPM_Process_ChangeAuthAsymFinish(tpm_state_t *tpm_state,
 	TPM_Key_Delete(ephKey);		/* free the key resources */
 	free(ephKey);			/* free the key itself */
 	/* remove entry from the key handle entries list */
-	returnCode = TPM_KeyHandleEntries_DeleteHandle(tpm_state->tpm_key_handle_entries,
+	returnCode = TPM_KeyHandleEntries_DeleteHandle(&(tpm_state->tpm_key_handle_entries),
 						       ephHandle);
     }
     /*
@@ -151,6 +151,15 @@
 
 #define TPM_STORE_BUFFER_INCREMENT (TPM_ALLOC_MAX / 64)
 
+/* TPM_Sbuffer_Delete() keeps up to TPM_STORE_BUFFER_POOL_SIZE buffers of at most
+   TPM_STORE_BUFFER_POOL_MAX bytes for reuse by the next TPM_STORE_BUFFER's, so that the short lived
+   buffers used while processing a command do not go through the heap.  The value 0 disables the
+   pool.
+*/
+
+#define TPM_STORE_BUFFER_POOL_SIZE 8
+#define TPM_STORE_BUFFER_POOL_MAX  (4 * TPM_STORE_BUFFER_INCREMENT)
+
 /* This is the maximum value of the TPM input and output packet buffer.  It should be large enough
    to accommodate the largest TPM command or response, currently about 1200 bytes.  It should be
    small enough to accommodate whatever software is driving the TPM.
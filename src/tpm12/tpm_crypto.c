@@ -550,6 +550,195 @@ static TPM_RESULT TPM_RSAGeneratePrivateToken(RSA **rsa_pri_key,	/* freed by cal
     return rc;
 }
 
+/* TPM_RSA_KEY_CACHE holds the OpenSSL private key objects built from the n,e,d of one TPM_KEY.
+
+   The objects are created on first use and reused afterwards, which avoids converting n,e,d to
+   bignums and lets OpenSSL keep its Montgomery and blinding state between operations.  A digest
+   of the n,e,d the objects were built from is recorded so that the objects are rebuilt if the key
+   material is replaced, even if the new material is stored at the same addresses.
+*/
+
+typedef struct tdTPM_RSA_KEY_CACHE {
+    TPM_DIGEST keyDigest;	/* digest of the n,e,d the objects were built from */
+    RSA *rsa_pri_key;		/* private key token */
+#if USE_OPENSSL_FUNCTIONS_RSA
+    EVP_PKEY *pkey;		/* private key for the EVP functions */
+#endif
+} TPM_RSA_KEY_CACHE;
+
+/* TPM_RSAKeyCache_Clear() frees the cached OpenSSL objects
+ */
+
+static void TPM_RSAKeyCache_Clear(TPM_RSA_KEY_CACHE *rsa_key_cache)
+{
+    RSA_free(rsa_key_cache->rsa_pri_key);
+    rsa_key_cache->rsa_pri_key = NULL;
+#if USE_OPENSSL_FUNCTIONS_RSA
+    EVP_PKEY_free(rsa_key_cache->pkey);
+    rsa_key_cache->pkey = NULL;
+#endif
+    memset(rsa_key_cache->keyDigest, 0, TPM_DIGEST_SIZE);
+    return;
+}
+
+/* TPM_RSAKeyCache_Get() returns the cache for the key n,e,d.  The cache is allocated on first use.
+   If it was built from different key material, the cached objects are freed.
+*/
+
+static TPM_RESULT TPM_RSAKeyCache_Get(TPM_RSA_KEY_CACHE **cache,	/* output */
+				      void **rsa_key_cache,		/* input/output */
+				      unsigned char *narr,		/* public modulus */
+				      uint32_t nbytes,
+				      unsigned char *earr,		/* public exponent */
+				      uint32_t ebytes,
+				      unsigned char *darr,		/* private exponent */
+				      uint32_t dbytes)
+{
+    TPM_RESULT  rc = 0;
+    TPM_DIGEST	keyDigest;
+
+    /* the sizes are included so that the digest covers an unambiguous encoding */
+    if (rc == 0) {
+	rc = TPM_SHA1(keyDigest,
+		      (uint32_t)sizeof(uint32_t), (unsigned char *)&nbytes,
+		      nbytes, narr,
+		      (uint32_t)sizeof(uint32_t), (unsigned char *)&ebytes,
+		      ebytes, earr,
+		      (uint32_t)sizeof(uint32_t), (unsigned char *)&dbytes,
+		      dbytes, darr,
+		      0, NULL);
+    }
+    if (rc == 0) {
+	if (*rsa_key_cache == NULL) {
+	    rc = TPM_Malloc((unsigned char **)rsa_key_cache, sizeof(TPM_RSA_KEY_CACHE));
+	    if (rc == 0) {
+		memset(*rsa_key_cache, 0, sizeof(TPM_RSA_KEY_CACHE));
+	    }
+	}
+    }
+    if (rc == 0) {
+	*cache = *rsa_key_cache;
+	if (memcmp((*cache)->keyDigest, keyDigest, TPM_DIGEST_SIZE) != 0) {
+	    TPM_RSAKeyCache_Clear(*cache);
+	    memcpy((*cache)->keyDigest, keyDigest, TPM_DIGEST_SIZE);
+	}
+    }
+    return rc;
+}
+
+/* TPM_RSAKeyCache_Delete() frees a key cache created by TPM_RSAPrivateDecrypt() or TPM_RSASign()
+ */
+
+void TPM_RSAKeyCache_Delete(void **rsa_key_cache)
+{
+    if (*rsa_key_cache != NULL) {
+	TPM_RSAKeyCache_Clear(*rsa_key_cache);
+	free(*rsa_key_cache);
+	*rsa_key_cache = NULL;
+    }
+    return;
+}
+
+/* TPM_RSAGetPrivateToken() returns in 'rsa_pri_key' a private key token for n,e,d.
+
+   If 'rsa_key_cache' is NULL, a new token is generated and also returned in 'rsa_pri_key_free',
+   which the caller must free.  Otherwise the token is taken from or added to the cache, and
+   'rsa_pri_key_free' is NULL.
+*/
+
+static TPM_RESULT TPM_RSAGetPrivateToken(RSA **rsa_pri_key,
+					 RSA **rsa_pri_key_free,	/* freed by caller */
+					 unsigned char *narr,		/* public modulus */
+					 uint32_t nbytes,
+					 unsigned char *earr,		/* public exponent */
+					 uint32_t ebytes,
+					 unsigned char *darr,		/* private exponent */
+					 uint32_t dbytes,
+					 void **rsa_key_cache)
+{
+    TPM_RESULT		rc = 0;
+    TPM_RSA_KEY_CACHE	*cache = NULL;
+    RSA			**token = rsa_pri_key_free;
+
+    *rsa_pri_key = NULL;
+    *rsa_pri_key_free = NULL;
+    if (rc == 0) {
+	if (rsa_key_cache != NULL) {
+	    rc = TPM_RSAKeyCache_Get(&cache, rsa_key_cache,
+				     narr, nbytes, earr, ebytes, darr, dbytes);
+	    if (rc == 0) {
+		token = &(cache->rsa_pri_key);
+	    }
+	}
+    }
+    if ((rc == 0) && (*token == NULL)) {
+	rc = TPM_RSAGeneratePrivateToken(token,
+					 narr,      	/* public modulus */
+					 nbytes,
+					 earr,      	/* public exponent */
+					 ebytes,
+					 darr,		/* private exponent */
+					 dbytes);
+	/* do not keep a partially constructed token in the cache */
+	if ((rc != 0) && (cache != NULL)) {
+	    TPM_RSAKeyCache_Clear(cache);
+	}
+    }
+    if (rc == 0) {
+	*rsa_pri_key = *token;
+    }
+    return rc;
+}
+
+#if USE_OPENSSL_FUNCTIONS_RSA
+/* TPM_RSAGetEVP_PKEY() returns in 'pkey' an EVP_PKEY for n,e,d.  It handles 'pkey_free' and
+   'rsa_key_cache' like TPM_RSAGetPrivateToken().
+*/
+
+static TPM_RESULT TPM_RSAGetEVP_PKEY(EVP_PKEY **pkey,
+				     EVP_PKEY **pkey_free,	/* freed by caller */
+				     unsigned char *narr,	/* public modulus */
+				     uint32_t nbytes,
+				     unsigned char *earr,	/* public exponent */
+				     uint32_t ebytes,
+				     unsigned char *darr,	/* private exponent */
+				     uint32_t dbytes,
+				     void **rsa_key_cache)
+{
+    TPM_RESULT		rc = 0;
+    TPM_RSA_KEY_CACHE	*cache = NULL;
+    EVP_PKEY		**key = pkey_free;
+
+    *pkey = NULL;
+    *pkey_free = NULL;
+    if (rc == 0) {
+	if (rsa_key_cache != NULL) {
+	    rc = TPM_RSAKeyCache_Get(&cache, rsa_key_cache,
+				     narr, nbytes, earr, ebytes, darr, dbytes);
+	    if (rc == 0) {
+		key = &(cache->pkey);
+	    }
+	}
+    }
+    if ((rc == 0) && (*key == NULL)) {
+	rc = TPM_RSAGenerateEVP_PKEY(key,
+				     narr,      	/* public modulus */
+				     nbytes,
+				     earr,      	/* public exponent */
+				     ebytes,
+				     darr,		/* private exponent */
+				     dbytes);
+	if ((rc != 0) && (cache != NULL)) {
+	    TPM_RSAKeyCache_Clear(cache);
+	}
+    }
+    if (rc == 0) {
+	*pkey = *key;
+    }
+    return rc;
+}
+#endif
+
 #if !USE_OPENSSL_FUNCTIONS_RSA // libtpms added
 /* TPM_RSAPrivateDecrypt() decrypts 'encrypt_data' using the private key 'n, e, d'.  The OAEP
    padding is removed and 'decrypt_data_length' bytes are moved to 'decrypt_data'.
@@ -569,25 +758,30 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,   /* decrypted dat
                                  unsigned char *earr,           /* public exponent */
                                  uint32_t ebytes,
                                  unsigned char *darr,           /* private exponent */
-                                 uint32_t dbytes)
+                                 uint32_t dbytes,
+                                 void **rsa_key_cache)          /* cached key objects, may be
+                                                                   NULL */
 {
     TPM_RESULT  rc = 0;
     int         irc;
-    RSA *       rsa_pri_key = NULL;	/* freed @1 */
+    RSA *       rsa_pri_key = NULL;
+    RSA *       rsa_pri_key_free = NULL;	/* freed @1 */
 
     unsigned char       *padded_data = NULL;
     int                 padded_data_size = 0;
     
     printf(" TPM_RSAPrivateDecrypt:\n");
-    /* construct the OpenSSL private key object */
-    if (rc == 0) {
-	rc = TPM_RSAGeneratePrivateToken(&rsa_pri_key,	/* freed @1 */
-					 narr,      	/* public modulus */
-					 nbytes,
-					 earr,      	/* public exponent */
-					 ebytes,
-					 darr,		/* private exponent */
-					 dbytes);
+    /* get the OpenSSL private key object */
+    if (rc == 0) {
+	rc = TPM_RSAGetPrivateToken(&rsa_pri_key,
+				    &rsa_pri_key_free,	/* freed @1 */
+				    narr,      		/* public modulus */
+				    nbytes,
+				    earr,      		/* public exponent */
+				    ebytes,
+				    darr,		/* private exponent */
+				    dbytes,
+				    rsa_key_cache);
     }
     /* intermediate buffer for the decrypted but still padded data */
     if (rc == 0) {
@@ -652,8 +846,8 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,   /* decrypted dat
         printf("  TPM_RSAPrivateDecrypt: RSA_padding_check_PKCS1_OAEP() recovered %d bytes\n", irc);
         TPM_PrintFourLimit("  TPM_RSAPrivateDecrypt: Decrypt data", decrypt_data, *decrypt_data_length);
     }
-    if (rsa_pri_key != NULL) {
-        RSA_free(rsa_pri_key);          /* @1 */
+    if (rsa_pri_key_free != NULL) {
+        RSA_free(rsa_pri_key_free);     /* @1 */
     }
     free(padded_data);                  /* @2 */
     return rc;
@@ -673,10 +867,13 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,   /* decrypted dat
                                  unsigned char *earr,           /* public exponent */
                                  uint32_t ebytes,
                                  unsigned char *darr,           /* private exponent */
-                                 uint32_t dbytes)
+                                 uint32_t dbytes,
+                                 void **rsa_key_cache)          /* cached key objects, may be
+                                                                   NULL */
 {
     TPM_RESULT             rc = 0;
     EVP_PKEY              *pkey = NULL;
+    EVP_PKEY              *pkey_free = NULL;
     EVP_PKEY_CTX          *ctx = NULL;
     const EVP_MD          *md = NULL;
     unsigned char         *label = NULL;
@@ -684,15 +881,17 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,   /* decrypted dat
     unsigned char          buffer[(TPM_RSA_KEY_LENGTH_MAX + 7) / 8];
 
     printf(" TPM_RSAPrivateDecrypt:\n");
-    /* construct the OpenSSL private key object */
+    /* get the OpenSSL private key object */
     if (rc == 0) {
-	rc = TPM_RSAGenerateEVP_PKEY(&pkey,	/* freed @1 */
-				     narr,      	/* public modulus */
-				     nbytes,
-				     earr,      	/* public exponent */
-				     ebytes,
-				     darr,		/* private exponent */
-				     dbytes);
+	rc = TPM_RSAGetEVP_PKEY(&pkey,
+				&pkey_free,	/* freed @1 */
+				narr,      	/* public modulus */
+				nbytes,
+				earr,      	/* public exponent */
+				ebytes,
+				darr,		/* private exponent */
+				dbytes,
+				rsa_key_cache);
     }
 
     if (rc == 0) {
@@ -775,7 +974,7 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,   /* decrypted dat
         }
     }
 
-    EVP_PKEY_free(pkey);
+    EVP_PKEY_free(pkey_free);     /* @1 */
     EVP_PKEY_CTX_free(ctx);
     TPM_Free(label);
 
@@ -1088,22 +1287,26 @@ TPM_RESULT TPM_RSASign(unsigned char *signature,        /* output */
                        unsigned char *earr,             /* public exponent */
                        uint32_t ebytes,
                        unsigned char *darr,             /* private exponent */
-                       uint32_t dbytes)
+                       uint32_t dbytes,
+                       void **rsa_key_cache)            /* cached key objects, may be NULL */
 {
     TPM_RESULT          rc = 0;
-    RSA *               rsa_pri_key = NULL;	/* freed @1 */
+    RSA *               rsa_pri_key = NULL;
+    RSA *               rsa_pri_key_free = NULL;	/* freed @1 */
     unsigned int        key_size;
 
     printf(" TPM_RSASign:\n");
-    /* construct the OpenSSL private key object */
-    if (rc == 0) {
-	rc = TPM_RSAGeneratePrivateToken(&rsa_pri_key,	/* freed @1 */
-					 narr,      	/* public modulus */
-					 nbytes,
-					 earr,      	/* public exponent */
-					 ebytes,
-					 darr,		/* private exponent */
-					 dbytes);
+    /* get the OpenSSL private key object */
+    if (rc == 0) {
+	rc = TPM_RSAGetPrivateToken(&rsa_pri_key,
+				    &rsa_pri_key_free,	/* freed @1 */
+				    narr,      		/* public modulus */
+				    nbytes,
+				    earr,      		/* public exponent */
+				    ebytes,
+				    darr,		/* private exponent */
+				    dbytes,
+				    rsa_key_cache);
     }
     /* check the size of the output signature buffer */
     if (rc == 0) {
@@ -1143,8 +1346,8 @@ TPM_RESULT TPM_RSASign(unsigned char *signature,        /* output */
             break;
         }
     }
-    if (rsa_pri_key != NULL) {
-        RSA_free(rsa_pri_key);          /* @1 */
+    if (rsa_pri_key_free != NULL) {
+        RSA_free(rsa_pri_key_free);     /* @1 */
     }
     return rc;
 }
@@ -120,7 +120,8 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,
                                  unsigned char *e,
                                  uint32_t ebytes,
                                  unsigned char *d,
-                                 uint32_t dbytes);
+                                 uint32_t dbytes,
+                                 void **rsa_key_cache);
 
 TPM_RESULT TPM_RSAPublicEncrypt(unsigned char* encrypt_data,
                                 size_t encrypt_data_size,
@@ -158,7 +159,9 @@ TPM_RESULT TPM_RSASign(unsigned char *signature,
                        unsigned char *earr,
                        uint32_t ebytes,
                        unsigned char *darr,
-                       uint32_t dbytes);
+                       uint32_t dbytes,
+                       void **rsa_key_cache);
+void       TPM_RSAKeyCache_Delete(void **rsa_key_cache);
 TPM_RESULT TPM_RSAVerifySHA1(unsigned char *signature,
 			     unsigned int signature_size,
 			     const unsigned char *message,
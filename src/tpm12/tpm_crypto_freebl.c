@@ -573,7 +573,8 @@ TPM_RESULT TPM_RSAPrivateDecrypt(unsigned char *decrypt_data,   /* decrypted dat
                                  unsigned char *earr,           /* public exponent */
                                  uint32_t ebytes,
                                  unsigned char *darr,           /* private exponent */
-                                 uint32_t dbytes)
+                                 uint32_t dbytes,
+                                 void **rsa_key_cache)          /* not used */
 {
     TPM_RESULT  	rc = 0;
     SECStatus 		rv = SECSuccess;
@@ -810,7 +811,8 @@ TPM_RESULT TPM_RSASign(unsigned char *signature,        /* output */
                        unsigned char *earr,             /* public exponent */
                        uint32_t ebytes,
                        unsigned char *darr,             /* private exponent */
-                       uint32_t dbytes)
+                       uint32_t dbytes,
+                       void **rsa_key_cache)            /* not used */
 {
     TPM_RESULT          rc = 0;
     RSAPrivateKey 	rsa_pri_key;
@@ -1041,6 +1043,17 @@ TPM_RESULT TPM_RSAVerifySHA1(unsigned char *signature,          /* input */
     return rc;
 }
 
+/* TPM_RSAKeyCache_Delete() frees a key cache created by TPM_RSAPrivateDecrypt() or TPM_RSASign().
+
+   freebl keys are not cached, so the cache is always NULL.
+*/
+
+void TPM_RSAKeyCache_Delete(void **rsa_key_cache)
+{
+    *rsa_key_cache = NULL;
+    return;
+}
+
 /* TPM_RSAGetPrivateKey calculates q (2nd prime factor) and d (private key) from n (public key), e
    (public exponent), and p (1st prime factor)
 
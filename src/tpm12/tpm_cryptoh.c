@@ -1643,7 +1643,8 @@ TPM_RESULT TPM_RSAPrivateDecryptH(unsigned char *decrypt_data,	/* decrypted data
 				   earr,		/* public exponent */
 				   ebytes,
 				   darr,		/* private exponent */
-				   dbytes);
+				   dbytes,
+				   &(tpm_key->rsa_key_cache));
     }
     if (rc == 0) {
 	TPM_PrintFourLimit(" TPM_RSAPrivateDecryptH: Decrypt data", decrypt_data, *decrypt_data_length);
@@ -1931,7 +1932,8 @@ TPM_RESULT TPM_RSASignH(unsigned char *signature,		/* output */
 			 earr,		/* public exponent */
 			 ebytes,
 			 darr,		/* private exponent */
-			 dbytes);
+			 dbytes,
+			 &(tpm_key->rsa_key_cache));
     }
     if (rc == 0) {
 	TPM_PrintFour("  TPM_RSASignH: Signature", signature);
@@ -2669,7 +2671,8 @@ TPM_RESULT TPM_CryptoTest(void)
 				   tpm_default_rsa_exponent,	/* public exponent */
 				   3,
 				   d,				/* private exponent */
-				   2048/8);
+				   2048/8,
+				   NULL);			/* no key cache */
     }
     if (rc == 0) {
 	if (actual_size != TPM_DIGEST_SIZE) {
@@ -2715,7 +2718,8 @@ TPM_RESULT TPM_CryptoTest(void)
 				   tpm_default_rsa_exponent,	/* public exponent */
 				   3,
 				   d,				/* private exponent */
-				   2048/8);
+				   2048/8,
+				   NULL);			/* no key cache */
     }
     /* check length after padding removed */
     if (rc == 0) {
@@ -2751,7 +2755,8 @@ TPM_RESULT TPM_CryptoTest(void)
 			 tpm_default_rsa_exponent,	/* public exponent */
 			 3,
 			 d,				/* private exponent */
-			 2048/8);
+			 2048/8,
+			 NULL);				/* no key cache */
     }
     if (rc == 0) {
 	rc = TPM_RSAVerify(signature,		/* input signature buffer */
@@ -2780,7 +2785,8 @@ TPM_RESULT TPM_CryptoTest(void)
 			 tpm_default_rsa_exponent,	/* public exponent */
 			 3,
 			 d,				/* private exponent */
-			 2048/8);
+			 2048/8,
+			 NULL);				/* no key cache */
     }
     if (rc == 0) {
 	rc = TPM_RSAVerify(signature,		/* input signature buffer */
@@ -104,7 +104,9 @@ TPM_RESULT TPM_Global_Init(tpm_state_t *tpm_state)
     /* initialize the TPM_KEY_HANDLE_LIST structure */
     if (rc == 0) {
         printf("TPM_Global_Init: Initializing TPM_KEY_HANDLE_LIST\n");
-        TPM_KeyHandleEntries_Init(tpm_state->tpm_key_handle_entries);
+        rc = TPM_KeyHandleEntries_Init(&(tpm_state->tpm_key_handle_entries));
+    }
+    if (rc == 0) {
 	/* initialize the SHA1 thread context */
 	tpm_state->sha1_context = NULL;
 	/* initialize the TIS SHA1 thread context */
@@ -197,7 +199,7 @@ void TPM_Global_Delete(tpm_state_t *tpm_state)
 	printf("  TPM_Global_Delete: Deleting TPM_STANY_DATA\n");
 	TPM_StanyData_Delete(&(tpm_state->tpm_stany_data));
 	printf("  TPM_Global_Delete: Deleting key handle entries\n");
-	TPM_KeyHandleEntries_Delete(tpm_state->tpm_key_handle_entries);
+	TPM_KeyHandleEntries_Delete(&(tpm_state->tpm_key_handle_entries));
 	printf("  TPM_Global_Delete: Deleting SHA1 contexts\n");
 	TPM_SHA1Delete(&(tpm_state->sha1_context));
 	TPM_SHA1Delete(&(tpm_state->sha1_context_tis));
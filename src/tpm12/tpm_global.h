@@ -65,7 +65,7 @@ typedef struct tdTPM_STATE
     /* 7.6 TPM_STANY_DATA  */
     TPM_STANY_DATA tpm_stany_data;
     /* 5.6 TPM_KEY_HANDLE_ENTRY */
-    TPM_KEY_HANDLE_ENTRY tpm_key_handle_entries[TPM_KEY_HANDLES];
+    TPM_KEY_HANDLE_ENTRIES tpm_key_handle_entries;
     /* Context for SHA1 functions */
     void *sha1_context;
     void *sha1_context_tis;
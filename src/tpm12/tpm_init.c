@@ -83,6 +83,7 @@ static TPM_RESULT TPM_CheckTypes(void);
 
    main()
         TPM_MainInit()
+                TPM_OrdinalTable_Init() - builds the ordinal table index
                 TPM_IO_Init() - initializes the TPM I/O interface
                 TPM_Crypto_Init() - initializes cryptographic libraries
                 TPM_NVRAM_Init() - get NVRAM path once
@@ -111,6 +112,10 @@ TPM_RESULT TPM_MainInit(void)
     if (rc == 0) {
         rc = TPM_CheckTypes();
     }
+    /* build the ordinal table index used for command dispatch */
+    if (rc == 0) {
+        rc = TPM_OrdinalTable_Init();
+    }
     /* initialize the TPM to host interface */
     if (rc == 0) {
         printf("TPM_MainInit: Initialize the TPM to host interface\n");
@@ -101,6 +101,7 @@ void TPM_Key_Init(TPM_KEY *tpm_key)
     tpm_key->tpm_pcr_info_long = NULL;
     tpm_key->tpm_store_asymkey = NULL;
     tpm_key->tpm_migrate_asymkey = NULL;
+    tpm_key->rsa_key_cache = NULL;
     return;
 }
 
@@ -665,6 +666,7 @@ void TPM_Key_Delete(TPM_KEY *tpm_key)
 	free(tpm_key->tpm_store_asymkey);
 	TPM_MigrateAsymkey_Delete(tpm_key->tpm_migrate_asymkey);
 	free(tpm_key->tpm_migrate_asymkey);
+	TPM_RSAKeyCache_Delete(&(tpm_key->rsa_key_cache));
 	TPM_Key_Init(tpm_key);
     }
     return;
@@ -3134,33 +3136,114 @@ TPM_RESULT TPM_KeyHandleEntry_FlushSpecific(tpm_state_t *tpm_state,
   Key Handle Entries
 */
 
-/* TPM_KeyHandleEntries_Init() initializes the fixed TPM_KEY_HANDLE_ENTRY array.  All entries are
-   emptied.  The keys are not deleted.
+/* TPM_KeyHandleEntries_HashIndex() returns the first index bucket to probe for a key handle.
+   'indexSize' must be a power of 2.
 */
 
-void TPM_KeyHandleEntries_Init(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+static uint32_t TPM_KeyHandleEntries_HashIndex(TPM_KEY_HANDLE tpm_key_handle,
+					       uint32_t indexSize)
 {
-    size_t i;
-    
-    printf(" TPM_KeyHandleEntries_Init:\n");
-    for (i = 0 ; i < TPM_KEY_HANDLES ; i++) {
-	TPM_KeyHandleEntry_Init(&(tpm_key_handle_entries[i]));
+    return (uint32_t)(tpm_key_handle * 0x9e3779b1U) & (indexSize - 1);
+}
+
+/* TPM_KeyHandleEntries_IndexInsert() adds the slot 'slot' to the index under its handle.  The
+   caller guarantees that the index has at least one empty bucket.
+*/
+
+static void TPM_KeyHandleEntries_IndexInsert(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
+					     uint32_t slot)
+{
+    uint32_t bucket;
+
+    bucket = TPM_KeyHandleEntries_HashIndex(tpm_key_handle_entries->tpm_key_handle_entry[slot].handle,
+					    tpm_key_handle_entries->indexSize);
+    while (tpm_key_handle_entries->index[bucket] != 0) {
+	bucket = (bucket + 1) & (tpm_key_handle_entries->indexSize - 1);
     }
+    tpm_key_handle_entries->index[bucket] = slot + 1;
+    tpm_key_handle_entries->indexUsed++;
     return;
 }
 
-/* TPM_KeyHandleEntries_Delete() deletes and freed all TPM_KEY's stored in entries, and the entry
+/* TPM_KeyHandleEntries_IndexRebuild() clears the index and re-adds all occupied slots.  This drops
+   the stale buckets left behind by deleted entries.
+*/
 
+static void TPM_KeyHandleEntries_IndexRebuild(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
+{
+    uint32_t i;
+
+    printf(" TPM_KeyHandleEntries_IndexRebuild: %u buckets used\n",
+	   tpm_key_handle_entries->indexUsed);
+    memset(tpm_key_handle_entries->index, 0,
+	   tpm_key_handle_entries->indexSize * sizeof(uint16_t));
+    tpm_key_handle_entries->indexUsed = 0;
+    for (i = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[i].key != NULL) {
+	    TPM_KeyHandleEntries_IndexInsert(tpm_key_handle_entries, i);
+	}
+    }
+    return;
+}
+
+/* TPM_KeyHandleEntries_Init() allocates and initializes the TPM_KEY_HANDLE_ENTRY array and its
+   handle index.  The number of entries is the one set through TPMLIB_SetKeyHandles().  All entries
+   are emptied.
 */
 
-void TPM_KeyHandleEntries_Delete(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+TPM_RESULT TPM_KeyHandleEntries_Init(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
+{
+    TPM_RESULT	rc = 0;
+    size_t	i;
+    uint32_t	keyHandleCount = TPM12_GetKeyHandles();
+    uint32_t	indexSize;
+
+    printf(" TPM_KeyHandleEntries_Init: %u slots\n", keyHandleCount);
+    tpm_key_handle_entries->keyHandleCount = 0;
+    tpm_key_handle_entries->tpm_key_handle_entry = NULL;
+    tpm_key_handle_entries->indexSize = 0;
+    tpm_key_handle_entries->indexUsed = 0;
+    tpm_key_handle_entries->index = NULL;
+    /* the index is kept at most half full, so it needs at least twice the slots */
+    for (indexSize = 8 ; indexSize < (2 * keyHandleCount) ; indexSize <<= 1);
+    if (rc == 0) {
+	rc = TPM_Malloc((unsigned char **)&(tpm_key_handle_entries->tpm_key_handle_entry),
+			keyHandleCount * sizeof(TPM_KEY_HANDLE_ENTRY));
+    }
+    if (rc == 0) {
+	rc = TPM_Malloc((unsigned char **)&(tpm_key_handle_entries->index),
+			indexSize * sizeof(uint16_t));
+    }
+    if (rc == 0) {
+	tpm_key_handle_entries->keyHandleCount = keyHandleCount;
+	for (i = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
+	    TPM_KeyHandleEntry_Init(&(tpm_key_handle_entries->tpm_key_handle_entry[i]));
+	}
+	tpm_key_handle_entries->indexSize = indexSize;
+	memset(tpm_key_handle_entries->index, 0, indexSize * sizeof(uint16_t));
+    }
+    return rc;
+}
+
+/* TPM_KeyHandleEntries_Delete() deletes and freed all TPM_KEY's stored in entries, and the entry
+   array and index.
+*/
+
+void TPM_KeyHandleEntries_Delete(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     size_t i;
     
     printf(" TPM_KeyHandleEntries_Delete:\n");
-    for (i = 0 ; i < TPM_KEY_HANDLES ; i++) {
-	TPM_KeyHandleEntry_Delete(&(tpm_key_handle_entries[i]));
-    }
+    for (i = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
+	TPM_KeyHandleEntry_Delete(&(tpm_key_handle_entries->tpm_key_handle_entry[i]));
+    }
+    free(tpm_key_handle_entries->tpm_key_handle_entry);
+    free(tpm_key_handle_entries->index);
+    tpm_key_handle_entries->keyHandleCount = 0;
+    tpm_key_handle_entries->tpm_key_handle_entry = NULL;
+    tpm_key_handle_entries->indexSize = 0;
+    tpm_key_handle_entries->indexUsed = 0;
+    tpm_key_handle_entries->index = NULL;
     return;
 }
 
@@ -3192,10 +3275,10 @@ TPM_RESULT TPM_KeyHandleEntries_Load(tpm_state_t *tpm_state,
     }
     /* sanity check that keyCount not greater than key slots */
     if (rc == 0) {
-	if (keyCount > TPM_KEY_HANDLES) {
+	if (keyCount > tpm_state->tpm_key_handle_entries.keyHandleCount) {
 	    printf("TPM_KeyHandleEntries_Load: Error (fatal)"
-		   " key handles in stream %u greater than %d\n",
-		   keyCount, TPM_KEY_HANDLES);
+		   " key handles in stream %u greater than %u\n",
+		   keyCount, tpm_state->tpm_key_handle_entries.keyHandleCount);
 	    rc = TPM_FAIL;
 	}
     }    
@@ -3214,7 +3297,7 @@ TPM_RESULT TPM_KeyHandleEntries_Load(tpm_state_t *tpm_state,
 	       handle was saved twice.	*/
 	    rc = TPM_KeyHandleEntries_AddEntry(&(tpm_key_handle_entry.handle), 	/* suggested */
 					       TRUE,				/* keep handle */
-					       tpm_state->tpm_key_handle_entries,
+					       &(tpm_state->tpm_key_handle_entries),
 					       &tpm_key_handle_entry);
 	}
 	/* if there was an error copying the entry to the array, the entry must be delete'd to
@@ -3255,7 +3338,7 @@ TPM_RESULT TPM_KeyHandleEntries_Store(TPM_STORE_BUFFER *sbuffer,
 	   /* returns TPM_RETRY when at the end of the table, terminates loop */
 	   (TPM_KeyHandleEntries_GetNextEntry(&tpm_key_handle_entry,
 					      &current,
-					      tpm_state->tpm_key_handle_entries,
+					      &(tpm_state->tpm_key_handle_entries),
 					      start)) == 0) {
 	TPM_SaveState_IsSaveKey(&save, tpm_key_handle_entry);
 	if (save) {
@@ -3277,7 +3360,7 @@ TPM_RESULT TPM_KeyHandleEntries_Store(TPM_STORE_BUFFER *sbuffer,
 	   /* returns TPM_RETRY when at the end of the table, terminates loop */
 	   (TPM_KeyHandleEntries_GetNextEntry(&tpm_key_handle_entry,
 					      &current,
-					      tpm_state->tpm_key_handle_entries,
+					      &(tpm_state->tpm_key_handle_entries),
 					      start)) == 0) {
 	TPM_SaveState_IsSaveKey(&save, tpm_key_handle_entry);
 	if (save) {
@@ -3304,7 +3387,7 @@ TPM_RESULT TPM_KeyHandleEntries_Store(TPM_STORE_BUFFER *sbuffer,
 */
 
 TPM_RESULT TPM_KeyHandleEntries_StoreHandles(TPM_STORE_BUFFER *sbuffer,
-					     const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+					     const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     TPM_RESULT	rc = 0;
     uint16_t	i, loadedCount;
@@ -3313,17 +3396,18 @@ TPM_RESULT TPM_KeyHandleEntries_StoreHandles(TPM_STORE_BUFFER *sbuffer,
     if (rc == 0) {
 	loadedCount = 0;
 	/* count the number of loaded handles */
-	for (i = 0 ; i < TPM_KEY_HANDLES ; i++) {
-	    if (tpm_key_handle_entries[i].key != NULL) {
+	for (i = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
+	    if (tpm_key_handle_entries->tpm_key_handle_entry[i].key != NULL) {
 		loadedCount++;
 	    }
 	}
 	/* store 'loaded' handle count */
 	rc = TPM_Sbuffer_Append16(sbuffer, loadedCount); 
     }
-    for (i = 0 ; (rc == 0) && (i < TPM_KEY_HANDLES) ; i++) {
-	if (tpm_key_handle_entries[i].key != NULL) {	/* if the index is loaded */
-	    rc = TPM_Sbuffer_Append32(sbuffer, tpm_key_handle_entries[i].handle); /* store it */
+    for (i = 0 ; (rc == 0) && (i < tpm_key_handle_entries->keyHandleCount) ; i++) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[i].key != NULL) {	/* if the index is loaded */
+	    rc = TPM_Sbuffer_Append32(sbuffer,	/* store it */
+				      tpm_key_handle_entries->tpm_key_handle_entry[i].handle);
 	}
     }
     return rc;
@@ -3335,7 +3419,7 @@ TPM_RESULT TPM_KeyHandleEntries_StoreHandles(TPM_STORE_BUFFER *sbuffer,
    the table.
 */
 
-TPM_RESULT TPM_KeyHandleEntries_DeleteHandle(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+TPM_RESULT TPM_KeyHandleEntries_DeleteHandle(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 					     TPM_KEY_HANDLE tpm_key_handle)
 {
     TPM_RESULT	rc = 0;
@@ -3366,11 +3450,11 @@ TPM_RESULT TPM_KeyHandleEntries_DeleteHandle(TPM_KEY_HANDLE_ENTRY *tpm_key_handl
 
 void TPM_KeyHandleEntries_IsSpace(TPM_BOOL *isSpace,
 				  uint32_t *index,
-				  const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+				  const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     printf(" TPM_KeyHandleEntries_IsSpace:\n");
-    for (*index = 0, *isSpace = FALSE ; *index < TPM_KEY_HANDLES ; (*index)++) {
-	if (tpm_key_handle_entries[*index].key == NULL) {	/* if the index is empty */
+    for (*index = 0, *isSpace = FALSE ; *index < tpm_key_handle_entries->keyHandleCount ; (*index)++) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[*index].key == NULL) {	/* if the index is empty */
 	    printf("  TPM_KeyHandleEntries_IsSpace: Found space at %u\n", *index);
 	    *isSpace = TRUE;
 	    break;
@@ -3384,13 +3468,13 @@ void TPM_KeyHandleEntries_IsSpace(TPM_BOOL *isSpace,
 */
 
 void TPM_KeyHandleEntries_GetSpace(uint32_t *space,
-				   const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+				   const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     uint32_t i;
 
     printf(" TPM_KeyHandleEntries_GetSpace:\n");
-    for (*space = 0 , i = 0 ; i < TPM_KEY_HANDLES ; i++) {
-	if (tpm_key_handle_entries[i].key == NULL) {	/* if the index is empty */
+    for (*space = 0 , i = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[i].key == NULL) {	/* if the index is empty */
 	    (*space)++;
 	}	    
     }
@@ -3402,18 +3486,18 @@ void TPM_KeyHandleEntries_GetSpace(uint32_t *space,
 */
 
 void TPM_KeyHandleEntries_IsEvictSpace(TPM_BOOL *isSpace,
-				       const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+				       const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 				       uint32_t minSpace)
 {
     uint32_t evictSpace;
     uint32_t i;
 
-    for (i = 0,	 evictSpace = 0 ; i < TPM_KEY_HANDLES ; i++) {
-	if (tpm_key_handle_entries[i].key == NULL) {	/* if the index is empty */
+    for (i = 0,	 evictSpace = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[i].key == NULL) {	/* if the index is empty */
 	    evictSpace++;
 	}
 	else {							/* is index is used */
-	    if (!(tpm_key_handle_entries[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
+	    if (!(tpm_key_handle_entries->tpm_key_handle_entry[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
 		evictSpace++;	/* space that can be evicted */
 	    }
 	}
@@ -3438,7 +3522,7 @@ void TPM_KeyHandleEntries_IsEvictSpace(TPM_BOOL *isSpace,
 */
 
 TPM_RESULT TPM_KeyHandleEntries_AddKeyEntry(TPM_KEY_HANDLE *tpm_key_handle,		/* i/o */
-					    TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries, /* in */
+					    TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries, /* in */
 					    TPM_KEY *tpm_key,
 					    TPM_BOOL parentPCRStatus,
 					    TPM_KEY_CONTROL keyControl)
@@ -3474,13 +3558,14 @@ TPM_RESULT TPM_KeyHandleEntries_AddKeyEntry(TPM_KEY_HANDLE *tpm_key_handle,		/*
 
 TPM_RESULT TPM_KeyHandleEntries_AddEntry(TPM_KEY_HANDLE *tpm_key_handle,		/* i/o */
 					 TPM_BOOL keepHandle,				/* input */
-					 TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,	/* input */
+					 TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,	/* input */
 					 TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entry)	/* input */
 					 
 {
     TPM_RESULT			rc = 0;
     uint32_t			index;
     TPM_BOOL			isSpace;
+    TPM_KEY_HANDLE_ENTRY	*entry;
     
     printf(" TPM_KeyHandleEntries_AddEntry: handle %08x, keepHandle %u\n",
 	   *tpm_key_handle, keepHandle);
@@ -3507,34 +3592,54 @@ TPM_RESULT TPM_KeyHandleEntries_AddEntry(TPM_KEY_HANDLE *tpm_key_handle,		/* i/o
 				       (TPM_GETENTRY_FUNCTION_T)TPM_KeyHandleEntries_GetEntry);
     }
     if (rc == 0) {
-	tpm_key_handle_entries[index].handle = *tpm_key_handle;
-	tpm_key_handle_entries[index].key = tpm_key_handle_entry->key;
-	tpm_key_handle_entries[index].keyControl = tpm_key_handle_entry->keyControl;
-	tpm_key_handle_entries[index].parentPCRStatus = tpm_key_handle_entry->parentPCRStatus;
+	entry = &(tpm_key_handle_entries->tpm_key_handle_entry[index]);
+	entry->handle = *tpm_key_handle;
+	entry->key = tpm_key_handle_entry->key;
+	entry->keyControl = tpm_key_handle_entry->keyControl;
+	entry->parentPCRStatus = tpm_key_handle_entry->parentPCRStatus;
+	/* buckets of deleted entries are only dropped when the index is rebuilt */
+	if ((tpm_key_handle_entries->indexUsed + 1) > (tpm_key_handle_entries->indexSize / 2)) {
+	    TPM_KeyHandleEntries_IndexRebuild(tpm_key_handle_entries);
+	}
+	else {
+	    TPM_KeyHandleEntries_IndexInsert(tpm_key_handle_entries, index);
+	}
 	printf("  TPM_KeyHandleEntries_AddEntry: Index %u key handle %08x key pointer %p\n",
-	       index, tpm_key_handle_entries[index].handle, tpm_key_handle_entries[index].key);
+	       index, entry->handle, entry->key);
     }
     return rc;
 }
 
-/* TPM_KeyHandleEntries_GetEntry() searches all entries for the entry matching the handle, and
-   returns that entry */
+/* TPM_KeyHandleEntries_GetEntry() looks up the entry matching the handle through the handle
+   index, and returns that entry.
+
+   Buckets may refer to slots that were deleted or reused for another handle, so the slot is
+   verified and the probe continues until an empty bucket.
+*/
 
 TPM_RESULT TPM_KeyHandleEntries_GetEntry(TPM_KEY_HANDLE_ENTRY **tpm_key_handle_entry,
-					 TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+					 TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 					 TPM_KEY_HANDLE tpm_key_handle)
 {
     TPM_RESULT	rc = 0;
-    size_t	i;
+    uint32_t	bucket;
+    uint32_t	slot;
     TPM_BOOL	found;
 
     printf(" TPM_KeyHandleEntries_GetEntry: Get entry for handle %08x\n", tpm_key_handle);
-    for (i = 0, found = FALSE ; (i < TPM_KEY_HANDLES) && !found ; i++) {
-	/* first test for matching handle.  Then check for non-NULL to insure that entry is valid */
-	if ((tpm_key_handle_entries[i].handle == tpm_key_handle) &&
-	    tpm_key_handle_entries[i].key != NULL) {	/* found */
-	    found = TRUE;
-	    *tpm_key_handle_entry = &(tpm_key_handle_entries[i]);
+    found = FALSE;
+    if (tpm_key_handle_entries->indexSize != 0) {
+	bucket = TPM_KeyHandleEntries_HashIndex(tpm_key_handle, tpm_key_handle_entries->indexSize);
+	while (!found && ((slot = tpm_key_handle_entries->index[bucket]) != 0)) {
+	    slot--;
+	    /* first test for matching handle.  Then check for non-NULL to insure that entry is
+	       valid */
+	    if ((tpm_key_handle_entries->tpm_key_handle_entry[slot].handle == tpm_key_handle) &&
+		tpm_key_handle_entries->tpm_key_handle_entry[slot].key != NULL) {	/* found */
+		found = TRUE;
+		*tpm_key_handle_entry = &(tpm_key_handle_entries->tpm_key_handle_entry[slot]);
+	    }
+	    bucket = (bucket + 1) & (tpm_key_handle_entries->indexSize - 1);
 	}
     }
     if (!found) {
@@ -3561,15 +3666,15 @@ TPM_RESULT TPM_KeyHandleEntries_GetEntry(TPM_KEY_HANDLE_ENTRY **tpm_key_handle_e
 
 TPM_RESULT TPM_KeyHandleEntries_GetNextEntry(TPM_KEY_HANDLE_ENTRY **tpm_key_handle_entry,
 					     size_t *current,
-					     TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+					     TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 					     size_t start)
 {
     TPM_RESULT	rc = TPM_RETRY;
 
     printf(" TPM_KeyHandleEntries_GetNextEntry: Start %lu\n", (unsigned long)start);
-    for (*current = start ; *current < TPM_KEY_HANDLES ; (*current)++) {
-	if (tpm_key_handle_entries[*current].key != NULL) {
-	    *tpm_key_handle_entry = &(tpm_key_handle_entries[*current]);
+    for (*current = start ; *current < tpm_key_handle_entries->keyHandleCount ; (*current)++) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[*current].key != NULL) {
+	    *tpm_key_handle_entry = &(tpm_key_handle_entries->tpm_key_handle_entry[*current]);
 	    rc = 0;	/* found an entry */
 	    break;
 	}
@@ -3657,7 +3762,7 @@ TPM_RESULT TPM_KeyHandleEntries_GetKey(TPM_KEY **tpm_key,
     /* If not one of the special key handles, search for the handle in the list */
     if ((rc == 0) && !found) {
 	rc = TPM_KeyHandleEntries_GetEntry(&tpm_key_handle_entry,
-					   tpm_state->tpm_key_handle_entries,
+					   &(tpm_state->tpm_key_handle_entries),
 					   tpm_key_handle);
 	if (rc != 0) {
 	    printf("TPM_KeyHandleEntries_GetKey: Error, key handle %08x not found\n",
@@ -3693,7 +3798,7 @@ TPM_RESULT TPM_KeyHandleEntries_GetKey(TPM_KEY **tpm_key,
 /* TPM_KeyHandleEntries_SetParentPCRStatus() updates the parentPCRStatus member of the
    TPM_KEY_HANDLE_ENTRY */
 
-TPM_RESULT TPM_KeyHandleEntries_SetParentPCRStatus(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+TPM_RESULT TPM_KeyHandleEntries_SetParentPCRStatus(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 						   TPM_KEY_HANDLE tpm_key_handle,
 						   TPM_BOOL parentPCRStatus)
 {
@@ -3721,7 +3826,7 @@ TPM_RESULT TPM_KeyHandleEntries_SetParentPCRStatus(TPM_KEY_HANDLE_ENTRY *tpm_key
    handle entries table.
 */
 
-TPM_RESULT TPM_KeyHandleEntries_OwnerEvictLoad(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+TPM_RESULT TPM_KeyHandleEntries_OwnerEvictLoad(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 					       unsigned char **stream,
 					       uint32_t *stream_size)
 {
@@ -3792,7 +3897,7 @@ TPM_RESULT TPM_KeyHandleEntries_OwnerEvictLoad(TPM_KEY_HANDLE_ENTRY *tpm_key_han
 */
 
 TPM_RESULT TPM_KeyHandleEntries_OwnerEvictStore(TPM_STORE_BUFFER *sbuffer,
-						const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+						const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     TPM_RESULT	rc = 0;
     uint16_t 	count;
@@ -3811,13 +3916,13 @@ TPM_RESULT TPM_KeyHandleEntries_OwnerEvictStore(TPM_STORE_BUFFER *sbuffer,
     if (rc == 0) {
 	rc = TPM_Sbuffer_Append16(sbuffer, count); 
     }
-    for (i = 0 ; (rc == 0) && (i < TPM_KEY_HANDLES) ; i++) {
+    for (i = 0 ; (rc == 0) && (i < tpm_key_handle_entries->keyHandleCount) ; i++) {
 	/* if the slot is occupied */
-	if (tpm_key_handle_entries[i].key != NULL) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[i].key != NULL) {
 	    /* if the key is owner evict */
-	    if ((tpm_key_handle_entries[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
+	    if ((tpm_key_handle_entries->tpm_key_handle_entry[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
 		/* store it */
-		rc = TPM_KeyHandleEntry_Store(sbuffer, &(tpm_key_handle_entries[i]));
+		rc = TPM_KeyHandleEntry_Store(sbuffer, &(tpm_key_handle_entries->tpm_key_handle_entry[i]));
 	    }
 	}
     }
@@ -3829,7 +3934,7 @@ TPM_RESULT TPM_KeyHandleEntries_OwnerEvictStore(TPM_STORE_BUFFER *sbuffer,
 
 TPM_RESULT
 TPM_KeyHandleEntries_OwnerEvictGetCount(uint16_t *count,
-					const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+					const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     TPM_RESULT	rc = 0;
     uint16_t	i;		/* the uint16_t corresponds to the standard getcap */
@@ -3837,11 +3942,11 @@ TPM_KeyHandleEntries_OwnerEvictGetCount(uint16_t *count,
     printf(" TPM_KeyHandleEntries_OwnerEvictGetCount:\n");
     /* count the number of loaded owner evict handles */
     if (rc == 0) {
-	for (i = 0 , *count = 0 ; i < TPM_KEY_HANDLES ; i++) {
+	for (i = 0 , *count = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
 	    /* if the slot is occupied */
-	    if (tpm_key_handle_entries[i].key != NULL) {
+	    if (tpm_key_handle_entries->tpm_key_handle_entry[i].key != NULL) {
 		/* if the key is owner evict */
-		if ((tpm_key_handle_entries[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
+		if ((tpm_key_handle_entries->tpm_key_handle_entry[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
 		    (*count)++;		/* count it */
 		}
 	    }
@@ -3863,16 +3968,16 @@ TPM_KeyHandleEntries_OwnerEvictGetCount(uint16_t *count,
 
 */
 
-void TPM_KeyHandleEntries_OwnerEvictDelete(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+void TPM_KeyHandleEntries_OwnerEvictDelete(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     uint16_t	i;		/* the uint16_t corresponds to the standard getcap */
 
-    for (i = 0 ; i < TPM_KEY_HANDLES ; i++) {
+    for (i = 0 ; i < tpm_key_handle_entries->keyHandleCount ; i++) {
 	/* if the slot is occupied */
-	if (tpm_key_handle_entries[i].key != NULL) {
+	if (tpm_key_handle_entries->tpm_key_handle_entry[i].key != NULL) {
 	    /* if the key is owner evict */
-	    if ((tpm_key_handle_entries[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
-		TPM_KeyHandleEntry_Delete(&(tpm_key_handle_entries[i]));
+	    if ((tpm_key_handle_entries->tpm_key_handle_entry[i].keyControl & TPM_KEY_CONTROL_OWNER_EVICT)) {
+		TPM_KeyHandleEntry_Delete(&(tpm_key_handle_entries->tpm_key_handle_entry[i]));
 	    }
 	}
     }
@@ -5247,7 +5352,7 @@ TPM_RESULT TPM_Process_EvictKey(tpm_state_t *tpm_state,
     if (returnCode == TPM_SUCCESS) {
 	printf("TPM_Process_EvictKey: Evicting handle %08x\n", evictHandle);
 	returnCode = TPM_KeyHandleEntries_GetEntry(&tpm_key_handle_entry,
-						   tpm_state->tpm_key_handle_entries,
+						   &(tpm_state->tpm_key_handle_entries),
 						   evictHandle);
 	if (returnCode != TPM_SUCCESS) {
 	    printf("TPM_Process_EvictKey: Error, key handle %08x not found\n",
@@ -247,8 +247,8 @@ TPM_RESULT TPM_KeyHandleEntry_FlushSpecific(tpm_state_t *tpm_state,
   TPM_KEY_HANDLE_ENTRY entries list
 */
 
-void       TPM_KeyHandleEntries_Init(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
-void       TPM_KeyHandleEntries_Delete(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
+TPM_RESULT TPM_KeyHandleEntries_Init(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
+void       TPM_KeyHandleEntries_Delete(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
 
 TPM_RESULT TPM_KeyHandleEntries_Load(tpm_state_t *tpm_state,
 				     unsigned char **stream,
@@ -257,28 +257,28 @@ TPM_RESULT TPM_KeyHandleEntries_Store(TPM_STORE_BUFFER *sbuffer,
 				      tpm_state_t *tpm_state);
 
 TPM_RESULT TPM_KeyHandleEntries_StoreHandles(TPM_STORE_BUFFER *sbuffer,
-                                             const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
-TPM_RESULT TPM_KeyHandleEntries_DeleteHandle(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+                                             const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
+TPM_RESULT TPM_KeyHandleEntries_DeleteHandle(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                              TPM_KEY_HANDLE tpm_key_handle);
 
 void       TPM_KeyHandleEntries_IsSpace(TPM_BOOL *isSpace, uint32_t *index,
-                                        const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
+                                        const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
 void       TPM_KeyHandleEntries_GetSpace(uint32_t *space,
-                                         const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
+                                         const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
 void       TPM_KeyHandleEntries_IsEvictSpace(TPM_BOOL *isSpace,
-                                             const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+                                             const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                              uint32_t minSpace);
 TPM_RESULT TPM_KeyHandleEntries_AddKeyEntry(TPM_KEY_HANDLE *tpm_key_handle,
-                                            TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+                                            TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                             TPM_KEY *tpm_key,
                                             TPM_BOOL parentPCRStatus,
                                             TPM_KEY_CONTROL keyControl);
 TPM_RESULT TPM_KeyHandleEntries_AddEntry(TPM_KEY_HANDLE *tpm_key_handle,
                                          TPM_BOOL keepHandle,
-                                         TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+                                         TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                          TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entry);
 TPM_RESULT TPM_KeyHandleEntries_GetEntry(TPM_KEY_HANDLE_ENTRY **tpm_key_handle_entry,
-                                         TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+                                         TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                          TPM_KEY_HANDLE tpm_key_handle);
 TPM_RESULT TPM_KeyHandleEntries_GetKey(TPM_KEY **tpm_key,
                                        TPM_BOOL *parentPCRStatus,
@@ -287,22 +287,22 @@ TPM_RESULT TPM_KeyHandleEntries_GetKey(TPM_KEY **tpm_key,
                                        TPM_BOOL readOnly,
                                        TPM_BOOL ignorePCRs,
                                        TPM_BOOL allowEK);
-TPM_RESULT TPM_KeyHandleEntries_SetParentPCRStatus(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+TPM_RESULT TPM_KeyHandleEntries_SetParentPCRStatus(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                                    TPM_KEY_HANDLE tpm_key_handle,
                                                    TPM_BOOL parentPCRStatus);
 TPM_RESULT TPM_KeyHandleEntries_GetNextEntry(TPM_KEY_HANDLE_ENTRY **tpm_key_handle_entry,
                                              size_t *current,
-                                             TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+                                             TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
                                              size_t start);
 
-TPM_RESULT TPM_KeyHandleEntries_OwnerEvictLoad(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+TPM_RESULT TPM_KeyHandleEntries_OwnerEvictLoad(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 					       unsigned char **stream, uint32_t *stream_size);
 TPM_RESULT TPM_KeyHandleEntries_OwnerEvictStore(TPM_STORE_BUFFER *sbuffer,
-						const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
+						const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
 TPM_RESULT TPM_KeyHandleEntries_OwnerEvictGetCount(uint16_t *count,
-						   const TPM_KEY_HANDLE_ENTRY
+						   const TPM_KEY_HANDLE_ENTRIES
 						   *tpm_key_handle_entries);
-void       TPM_KeyHandleEntries_OwnerEvictDelete(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
+void       TPM_KeyHandleEntries_OwnerEvictDelete(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
 
 /* TPM_RSA_KEY_PARMS */
 
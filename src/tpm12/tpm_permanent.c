@@ -993,7 +993,7 @@ TPM_RESULT TPM_PermanentAll_Load(tpm_state_t *tpm_state,
     }
     /* owner evict keys deserialize from stream */
     if (rc == 0) {
-	rc = TPM_KeyHandleEntries_OwnerEvictLoad(tpm_state->tpm_key_handle_entries,
+	rc = TPM_KeyHandleEntries_OwnerEvictLoad(&(tpm_state->tpm_key_handle_entries),
 						 stream, stream_size);
     }
     /* NV defined space deserialize from stream */
@@ -1064,7 +1064,7 @@ TPM_RESULT TPM_PermanentAll_Store(TPM_STORE_BUFFER *sbuffer,	/* freed by caller
     /* serialize owner evict keys */
     if (rc == 0) {
 	rc = TPM_KeyHandleEntries_OwnerEvictStore(sbuffer,
-						  tpm_state->tpm_key_handle_entries);
+						  &(tpm_state->tpm_key_handle_entries));
     }
     /* serialize NV defined space */
     if (rc == 0) {
@@ -1205,7 +1205,7 @@ TPM_RESULT TPM_PermanentAll_NVStore(tpm_state_t *tpm_state,
 		printf(" TPM_PermanentAllNVStore: Deleting TPM_PERMANENT_DATA structure\n");
 		TPM_PermanentData_Delete(&(tpm_state->tpm_permanent_data), TRUE);
 		printf(" TPM_PermanentAllNVStore: Deleting owner evict keys\n");
-		TPM_KeyHandleEntries_OwnerEvictDelete(tpm_state->tpm_key_handle_entries);
+		TPM_KeyHandleEntries_OwnerEvictDelete(&(tpm_state->tpm_key_handle_entries));
 		printf(" TPM_PermanentAllNVStore: Deleting NV defined space \n");
 		TPM_NVIndexEntries_Delete(&(tpm_state->tpm_nv_index_entries));
 		printf(" TPM_PermanentAllNVStore: "
@@ -99,12 +99,12 @@ static TPM_RESULT TPM_GetCapability_CapProperty(TPM_STORE_BUFFER *capabilityResp
 						uint32_t capProperty);
 static TPM_RESULT TPM_GetCapability_CapVersion(TPM_STORE_BUFFER *capabilityResponse);
 static TPM_RESULT TPM_GetCapability_CapCheckLoaded(TPM_STORE_BUFFER *capabilityResponse,
-						   const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entry,
+						   const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 						   TPM_SIZED_BUFFER *subCap);
 static TPM_RESULT TPM_GetCapability_CapSymMode(TPM_STORE_BUFFER *capabilityResponse,
 					       TPM_SYM_MODE symMode);
 static TPM_RESULT TPM_GetCapability_CapKeyStatus(TPM_STORE_BUFFER *capabilityResponse,
-						 TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+						 TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 						 uint32_t tpm_key_handle);
 static TPM_RESULT TPM_GetCapability_CapMfr(TPM_STORE_BUFFER *capabilityResponse,
 					   tpm_state_t *tpm_state,
@@ -2048,25 +2048,102 @@ static TPM_ORDINAL_TABLE tpm_ordinal_table[] =
    Ordinal Table Utilities
 */
 
+/* Direct index into tpm_ordinal_table.
+
+   Main specification ordinals are below TPM_ORDINALS_MAX and index tpm_ordinal_index directly.
+   TSC ordinals are TPM_CONNECTION_ORDINAL plus a small offset and index tsc_ordinal_index by
+   that offset.  A NULL slot is an ordinal that is not in the table.
+*/
+
+#define TSC_ORDINALS_MAX	16
+
+static TPM_ORDINAL_TABLE *tpm_ordinal_index[TPM_ORDINALS_MAX];
+static TPM_ORDINAL_TABLE *tsc_ordinal_index[TSC_ORDINALS_MAX];
+static TPM_BOOL tpm_ordinal_index_valid = FALSE;
+
+/* TPM_OrdinalTable_GetSlot() returns the index slot for the ordinal, or NULL if the ordinal is
+   outside both index ranges.
+*/
+
+static TPM_ORDINAL_TABLE **TPM_OrdinalTable_GetSlot(TPM_COMMAND_CODE ordinal)
+{
+    if (ordinal < TPM_ORDINALS_MAX) {
+	return &tpm_ordinal_index[ordinal];
+    }
+    if ((ordinal >= TPM_CONNECTION_ORDINAL) &&
+	(ordinal - TPM_CONNECTION_ORDINAL < TSC_ORDINALS_MAX)) {
+	return &tsc_ordinal_index[ordinal - TPM_CONNECTION_ORDINAL];
+    }
+    return NULL;
+}
+
+/* TPM_OrdinalTable_Init() builds the direct index into tpm_ordinal_table.
+
+   Since the table is constant, this can be called any number of times.
+
+   Returns TPM_FAIL if a table entry cannot be indexed or is a duplicate.  This can only happen
+   if an ordinal is added to the table that is outside the index ranges.
+*/
+
+TPM_RESULT TPM_OrdinalTable_Init(void)
+{
+    TPM_RESULT		rc = 0;
+    TPM_ORDINAL_TABLE	**slot;
+    size_t		i;
+
+    printf(" TPM_OrdinalTable_Init:\n");
+    memset(tpm_ordinal_index, 0, sizeof(tpm_ordinal_index));
+    memset(tsc_ordinal_index, 0, sizeof(tsc_ordinal_index));
+    tpm_ordinal_index_valid = FALSE;
+    for (i = 0 ; (rc == 0) && (i < (sizeof(tpm_ordinal_table)/sizeof(TPM_ORDINAL_TABLE))) ; i++) {
+	slot = TPM_OrdinalTable_GetSlot(tpm_ordinal_table[i].ordinal);
+	if ((slot == NULL) || (*slot != NULL)) {
+	    printf("TPM_OrdinalTable_Init: Error (fatal), cannot index ordinal %08x\n",
+		   tpm_ordinal_table[i].ordinal);
+	    rc = TPM_FAIL;	/* should never occur */
+	}
+	else {
+	    *slot = &(tpm_ordinal_table[i]);
+	}
+    }
+    if (rc == 0) {
+	tpm_ordinal_index_valid = TRUE;
+    }
+    return rc;
+}
+
 /* TPM_OrdinalTable_GetEntry() gets the table entry for the ordinal.
 
    If the ordinal is not in the table, TPM_BAD_ORDINAL is returned
+
+   The ordinalTable must be tpm_ordinal_table, which is looked up through its direct index.
 */
 
 TPM_RESULT TPM_OrdinalTable_GetEntry(TPM_ORDINAL_TABLE **entry,
 				     TPM_ORDINAL_TABLE *ordinalTable,
 				     TPM_COMMAND_CODE ordinal)
 {
-    TPM_RESULT	rc = TPM_BAD_ORDINAL;
-    size_t	i;
+    TPM_RESULT	rc = 0;
+    TPM_ORDINAL_TABLE **slot;
 
     /* printf(" TPM_OrdinalTable_GetEntry: Ordinal %08x\n", ordinal); */
     *entry = NULL;
-    for (i = 0 ; i < (sizeof(tpm_ordinal_table)/sizeof(TPM_ORDINAL_TABLE)) ; i++) {
-	if (ordinalTable[i].ordinal == ordinal) {	/* if found */
-	    *entry = &(ordinalTable[i]);		/* return the entry */
-	    rc = 0;					/* return found */
-	    break;
+    if (ordinalTable != tpm_ordinal_table) {
+	printf("TPM_OrdinalTable_GetEntry: Error (fatal), unknown ordinal table\n");
+	rc = TPM_FAIL;	/* should never occur */
+    }
+    /* the index is normally built by TPM_MainInit(), but state handling functions may be
+       called before that */
+    if ((rc == 0) && !tpm_ordinal_index_valid) {
+	rc = TPM_OrdinalTable_Init();
+    }
+    if (rc == 0) {
+	slot = TPM_OrdinalTable_GetSlot(ordinal);
+	if ((slot != NULL) && (*slot != NULL)) {	/* if found */
+	    *entry = *slot;				/* return the entry */
+	}
+	else {
+	    rc = TPM_BAD_ORDINAL;
 	}
     }
     return rc;
@@ -2420,14 +2497,15 @@ TPM_RESULT TPM_OrdinalTable_ParseWrappedRsp(uint32_t *datawStart,
     return rc;
 }
 
-void TPM_KeyHandleEntries_Trace(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries);
+void TPM_KeyHandleEntries_Trace(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries);
 
-void TPM_KeyHandleEntries_Trace(TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries)
+void TPM_KeyHandleEntries_Trace(TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries)
 {
     size_t i;
-    for (i = 0 ; (i < 4) && (i < TPM_KEY_HANDLES) ; i++) {
+    for (i = 0 ; (i < 4) && (i < tpm_key_handle_entries->keyHandleCount) ; i++) {
 	printf("TPM_KeyHandleEntries_Trace: %lu handle %08x tpm_key %p\n",
-	       (unsigned long)i, tpm_key_handle_entries[i].handle, tpm_key_handle_entries[i].key);
+	       (unsigned long)i, tpm_key_handle_entries->tpm_key_handle_entry[i].handle,
+	       tpm_key_handle_entries->tpm_key_handle_entry[i].key);
     }
     return;
 }
@@ -2552,7 +2630,7 @@ TPM_RESULT TPM_Process(TPM_STORE_BUFFER *response,
     }
     /* NOTE Only for debugging */
     if ((rc == 0) && (returnCode == TPM_SUCCESS)) {
-	TPM_KeyHandleEntries_Trace(targetInstance->tpm_key_handle_entries);
+	TPM_KeyHandleEntries_Trace(&(targetInstance->tpm_key_handle_entries));
     }
     /* process the ordinal */
     if ((rc == 0) && (returnCode == TPM_SUCCESS)) {
@@ -2566,7 +2644,7 @@ TPM_RESULT TPM_Process(TPM_STORE_BUFFER *response,
     }
     /* NOTE Only for debugging */
     if ((rc == 0) && (returnCode == TPM_SUCCESS)) {
-	TPM_KeyHandleEntries_Trace(targetInstance->tpm_key_handle_entries);
+	TPM_KeyHandleEntries_Trace(&(targetInstance->tpm_key_handle_entries));
     }
     /* NOTE Only for debugging */
     if ((rc == 0) && (returnCode == TPM_SUCCESS)) {
@@ -3632,11 +3710,11 @@ TPM_RESULT TPM_GetCapabilityCommon(TPM_STORE_BUFFER *capabilityResponse,
 	/* This is command is available for backwards compatibility. It is the same as
 	   TPM_CAP_HANDLE with a resource type of keys. */
 	rc = TPM_KeyHandleEntries_StoreHandles(capabilityResponse,
-					       tpm_state->tpm_key_handle_entries);
+					       &(tpm_state->tpm_key_handle_entries));
 	break;
       case TPM_CAP_CHECK_LOADED: 
 	rc = TPM_GetCapability_CapCheckLoaded(capabilityResponse,
-					      tpm_state->tpm_key_handle_entries,
+					      &(tpm_state->tpm_key_handle_entries),
 					      subCap);
 	break;
       case TPM_CAP_SYM_MODE:
@@ -3651,7 +3729,7 @@ TPM_RESULT TPM_GetCapabilityCommon(TPM_STORE_BUFFER *capabilityResponse,
       case TPM_CAP_KEY_STATUS: 
 	if (subCap->size == sizeof(uint32_t)) {
 	    rc = TPM_GetCapability_CapKeyStatus(capabilityResponse,
-						tpm_state->tpm_key_handle_entries,
+						&(tpm_state->tpm_key_handle_entries),
 						subCap32);
 	}
 	else {
@@ -3882,7 +3960,7 @@ static TPM_RESULT TPM_GetCapability_CapProperty(TPM_STORE_BUFFER *capabilityResp
 	break;
       case TPM_CAP_PROP_KEYS:	/* Returns the number of 2048-bit RSA keys that can be loaded. This
 				   MAY vary with time and circumstances. */
-	TPM_KeyHandleEntries_GetSpace(&uint32, tpm_state->tpm_key_handle_entries);
+	TPM_KeyHandleEntries_GetSpace(&uint32, &(tpm_state->tpm_key_handle_entries));
 	printf(" TPM_GetCapability_CapProperty: TPM_CAP_PROP_KEYS %u\n", uint32);
 	rc = TPM_Sbuffer_Append32(capabilityResponse, uint32);
 	break;
@@ -3930,8 +4008,10 @@ static TPM_RESULT TPM_GetCapability_CapProperty(TPM_STORE_BUFFER *capabilityResp
 	break;
       case TPM_CAP_PROP_MAX_KEYS:	/* The maximum number of 2048 RSA keys that the TPM can
 					   support. The number does not include the EK or SRK. */
-	printf(" TPM_GetCapability_CapProperty: TPM_CAP_PROP_MAX_KEYS %u\n", TPM_KEY_HANDLES);
-	rc = TPM_Sbuffer_Append32(capabilityResponse, TPM_KEY_HANDLES);
+	printf(" TPM_GetCapability_CapProperty: TPM_CAP_PROP_MAX_KEYS %u\n",
+	       tpm_state->tpm_key_handle_entries.keyHandleCount);
+	rc = TPM_Sbuffer_Append32(capabilityResponse,
+				  tpm_state->tpm_key_handle_entries.keyHandleCount);
 	break;
       case TPM_CAP_PROP_OWNER:	/* A value of TRUE indicates that the TPM has successfully installed
 				   an owner. */
@@ -4098,7 +4178,7 @@ static TPM_RESULT TPM_GetCapability_CapVersion(TPM_STORE_BUFFER *capabilityRespo
 */
 
 static TPM_RESULT TPM_GetCapability_CapCheckLoaded(TPM_STORE_BUFFER *capabilityResponse,
-						   const TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entry,
+						   const TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 						   TPM_SIZED_BUFFER *subCap)
 {
     TPM_RESULT		rc = 0;
@@ -4117,7 +4197,7 @@ static TPM_RESULT TPM_GetCapability_CapCheckLoaded(TPM_STORE_BUFFER *capabilityR
     }
     if (rc == 0) {
 	if (keyParms.algorithmID == TPM_ALG_RSA) {
-	    TPM_KeyHandleEntries_IsSpace(&isSpace, &index, tpm_key_handle_entry);
+	    TPM_KeyHandleEntries_IsSpace(&isSpace, &index, tpm_key_handle_entries);
 	}
 	else {
 	    printf(" TPM_GetCapability_CapCheckLoaded: algorithmID %08x is not TPM_ALG_RSA %08x\n",
@@ -4152,7 +4232,7 @@ static TPM_RESULT TPM_GetCapability_CapSymMode(TPM_STORE_BUFFER *capabilityRespo
  */
 
 static TPM_RESULT TPM_GetCapability_CapKeyStatus(TPM_STORE_BUFFER *capabilityResponse,
-						 TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entries,
+						 TPM_KEY_HANDLE_ENTRIES *tpm_key_handle_entries,
 						 uint32_t tpm_key_handle)
 {
     TPM_RESULT			rc = 0;
@@ -4301,7 +4381,7 @@ static TPM_RESULT TPM_GetCapability_CapHandle(TPM_STORE_BUFFER *capabilityRespon
       case TPM_RT_KEY:
 	printf("  TPM_GetCapability_CapHandle: TPM_RT_KEY\n");
 	rc = TPM_KeyHandleEntries_StoreHandles(capabilityResponse,
-					       tpm_state->tpm_key_handle_entries);
+					       &(tpm_state->tpm_key_handle_entries));
 	break;
       case TPM_RT_AUTH:
 	printf("  TPM_GetCapability_CapHandle: TPM_RT_AUTH\n");
@@ -225,6 +225,7 @@ typedef struct tdTPM_ORDINAL_TABLE {
                                                            hardware TPM instance  */
 } TPM_ORDINAL_TABLE;
 
+TPM_RESULT TPM_OrdinalTable_Init(void);
 TPM_RESULT TPM_OrdinalTable_GetEntry(TPM_ORDINAL_TABLE **entry,
                                      TPM_ORDINAL_TABLE *ordinalTable,
                                      TPM_COMMAND_CODE ordinal);
@@ -2909,7 +2909,7 @@ TPM_RESULT TPM_Process_FlushSpecific(tpm_state_t *tpm_state,
 	    if (returnCode == TPM_SUCCESS) {
 		printf("TPM_Process_FlushSpecific: Flushing key handle %08x\n", handle);
 		returnCode = TPM_KeyHandleEntries_GetEntry(&tpm_key_handle_entry,
-							   tpm_state->tpm_key_handle_entries,
+							   &(tpm_state->tpm_key_handle_entries),
 							   handle);
 		/* 7. Validate that R1 determined by resourceType and handle points to a valid
 		   allocated resource.	Return TPM_BAD_PARAMETER on error. */
@@ -3146,7 +3146,7 @@ TPM_RESULT TPM_Process_SaveContext(tpm_state_t *tpm_state,
 	    printf("TPM_Process_SaveContext: Resource is key handle %08x\n", handle);
 	    /* check if the key handle is valid */
 	    returnCode = TPM_KeyHandleEntries_GetEntry(&tpm_key_handle_entry,
-						       tpm_state->tpm_key_handle_entries,
+						       &(tpm_state->tpm_key_handle_entries),
 						       handle);
 	    break;
 	  case TPM_RT_AUTH:
@@ -3759,7 +3759,7 @@ TPM_RESULT TPM_Process_LoadContext(tpm_state_t *tpm_state,
 	  case TPM_RT_KEY:
 	    returnCode = TPM_KeyHandleEntries_AddEntry(&(b1ContextBlob.handle),
 						       keepHandle,
-						       tpm_state->tpm_key_handle_entries,
+						       &(tpm_state->tpm_key_handle_entries),
 						       &tpm_key_handle_entry);
 	    key_added = TRUE;
 	    break;
@@ -3842,7 +3842,7 @@ TPM_RESULT TPM_Process_LoadContext(tpm_state_t *tpm_state,
 	if (key_added) {
 	    /* if there was a failure and inKey was stored in the handle list, free the handle.
 	       Ignore errors, since only one error code can be returned. */
-	    TPM_KeyHandleEntries_DeleteHandle(tpm_state->tpm_key_handle_entries,
+	    TPM_KeyHandleEntries_DeleteHandle(&(tpm_state->tpm_key_handle_entries),
 					      b1ContextBlob.handle);
 	}
 	if (auth_session_added) {
@@ -3895,7 +3895,7 @@ static TPM_RESULT TPM_LoadContext_CheckKeyLoaded(tpm_state_t *tpm_state,
     /* normal case, key is in the key handle list */
     else {
 	rc = TPM_KeyHandleEntries_GetEntry(&key_handle_entry,
-					   tpm_state->tpm_key_handle_entries,
+					   &(tpm_state->tpm_key_handle_entries),
 					   entityHandle);
 	if (rc == 0) {
 	    TPM_Digest_Copy(entityDigest, key_handle_entry->key->tpm_store_asymkey->pubDataDigest);
@@ -3931,7 +3931,7 @@ static TPM_RESULT TPM_LoadContext_CheckKeyLoadedByDigest(tpm_state_t *tpm_state,
 	   /* returns TPM_RETRY when at the end of the table, terminates loop */
 	   (TPM_KeyHandleEntries_GetNextEntry(&key_handle_entry,
 					      &current,
-					      tpm_state->tpm_key_handle_entries,
+					      &(tpm_state->tpm_key_handle_entries),
 					      start)) == 0) {
 	
 
@@ -4225,7 +4225,7 @@ TPM_RESULT TPM_Process_KeyControlOwner(tpm_state_t *tpm_state,
     /* get the key corresponding to the keyHandle parameter */
     if (returnCode == TPM_SUCCESS) {
 	returnCode = TPM_KeyHandleEntries_GetEntry(&tpm_key_handle_entry,
-						   tpm_state->tpm_key_handle_entries,
+						   &(tpm_state->tpm_key_handle_entries),
 						   keyHandle);
 	if (returnCode != TPM_SUCCESS) {
 	    printf("TPM_Process_KeyControlOwner: Error, key handle not loaded\n");
@@ -4274,7 +4274,7 @@ TPM_RESULT TPM_Process_KeyControlOwner(tpm_state_t *tpm_state,
 		       OwnerEvict bit set, on error return TPM_NOSPACE */
 		    if (returnCode == TPM_SUCCESS) {
 			TPM_KeyHandleEntries_IsEvictSpace(&isSpace,
-							  tpm_state->tpm_key_handle_entries,
+							  &(tpm_state->tpm_key_handle_entries),
 							  2);	/* minSpace */
 			if (!isSpace) {
 			    printf("TPM_Process_KeyControlOwner: Error, "
@@ -4296,7 +4296,7 @@ TPM_RESULT TPM_Process_KeyControlOwner(tpm_state_t *tpm_state,
 		    if (returnCode == TPM_SUCCESS) {
 			returnCode = TPM_KeyHandleEntries_OwnerEvictGetCount
 				     (&ownerEvictCount,
-				      tpm_state->tpm_key_handle_entries);
+				      &(tpm_state->tpm_key_handle_entries));
 		    }
 		    /* check that the number of owner evict key slots will not be exceeded */
 		    if (returnCode == TPM_SUCCESS) {
@@ -4524,7 +4524,7 @@ TPM_RESULT TPM_Process_SaveKeyContext(tpm_state_t *tpm_state,
     if (returnCode == TPM_SUCCESS) {
 	printf("TPM_Process_SaveKeyContext: Handle %08x\n", keyHandle);
 	returnCode = TPM_KeyHandleEntries_GetEntry(&tpm_key_handle_entry,
-						   tpm_state->tpm_key_handle_entries,
+						   &(tpm_state->tpm_key_handle_entries),
 						   keyHandle);
     }
     /* use the contextNonceKey to invalidate a blob at power up */
@@ -4823,7 +4823,7 @@ TPM_RESULT TPM_Process_LoadKeyContext(tpm_state_t *tpm_state,
 	       keyContextBlob.handle);
 	/* check if the key handle is free */
 	getRc = TPM_KeyHandleEntries_GetEntry(&used_key_handle_entry,
-					      tpm_state->tpm_key_handle_entries,
+					      &(tpm_state->tpm_key_handle_entries),
 					      keyContextBlob.handle);
 	/* GetEntry TPM_SUCCESS means the handle is already used */
 	if (getRc == TPM_SUCCESS) {
@@ -4838,7 +4838,7 @@ TPM_RESULT TPM_Process_LoadKeyContext(tpm_state_t *tpm_state,
     if (returnCode == TPM_SUCCESS) {
 	printf("TPM_Process_LoadKeyContext: Checking for table space\n");
 	TPM_KeyHandleEntries_IsSpace(&isSpace, &index,
-				     tpm_state->tpm_key_handle_entries);
+				     &(tpm_state->tpm_key_handle_entries));
 	/* if there is no space, return error */
 	if (!isSpace) {
 	    printf("TPM_Process_LoadKeyContext: Error, no room in table\n");
@@ -4850,7 +4850,7 @@ TPM_RESULT TPM_Process_LoadKeyContext(tpm_state_t *tpm_state,
 	printf("TPM_Process_LoadKeyContext: Adding entry to table\n");
 	returnCode = TPM_KeyHandleEntries_AddEntry(&keyHandle,
 						   FALSE,		/* keep handle */
-						   tpm_state->tpm_key_handle_entries,
+						   &(tpm_state->tpm_key_handle_entries),
 						   &tpm_key_handle_entry);
 	key_added = TRUE;
     }
@@ -4908,7 +4908,7 @@ TPM_RESULT TPM_Process_LoadKeyContext(tpm_state_t *tpm_state,
 	if (key_added) {
 	    /* if there was a failure and a key was stored in the handle list, free the handle.
 	       Ignore errors, since only one error code can be returned. */
-	    TPM_KeyHandleEntries_DeleteHandle(tpm_state->tpm_key_handle_entries, keyHandle);
+	    TPM_KeyHandleEntries_DeleteHandle(&(tpm_state->tpm_key_handle_entries), keyHandle);
 	}
     }
     return rcf;
@@ -294,9 +294,10 @@ TPM_RESULT TPM_SaveState_NVStore(tpm_state_t *tpm_state)
     /* validate the length of the stream */
     if (rc == 0) {
 	printf("   TPM_SaveState_NVStore: Require %u bytes\n", length);
-	if (length > TPM_MAX_SAVESTATE_SPACE) {
+	if (length > TPM_MAX_SAVESTATE_SPACE_KEYS(tpm_state->tpm_key_handle_entries.keyHandleCount)) {
 	    printf("TPM_SaveState_NVStore: Error, No space, need %u max %u\n",
-		   length, TPM_MAX_SAVESTATE_SPACE);
+		   length,
+		   TPM_MAX_SAVESTATE_SPACE_KEYS(tpm_state->tpm_key_handle_entries.keyHandleCount));
 	    rc = TPM_NOSPACE;
 	}
     }
@@ -607,9 +608,10 @@ TPM_RESULT TPM_VolatileAll_NVStore(tpm_state_t *tpm_state)
     /* validate the length of the stream */
     if (rc == 0) {
 	printf("   TPM_VolatileAll_NVStore: Require %u bytes\n", length);
-	if (length > TPM_MAX_VOLATILESTATE_SPACE) {
+	if (length > TPM_MAX_VOLATILESTATE_SPACE_KEYS(tpm_state->tpm_key_handle_entries.keyHandleCount)) {
 	    printf("TPM_VolatileAll_NVStore: Error, No space, need %u max %u\n",
-		   length, TPM_MAX_VOLATILESTATE_SPACE);
+		   length,
+		   TPM_MAX_VOLATILESTATE_SPACE_KEYS(tpm_state->tpm_key_handle_entries.keyHandleCount));
 	    rc = TPM_NOSPACE;
 	}
     }
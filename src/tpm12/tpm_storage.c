@@ -2887,7 +2887,7 @@ TPM_RESULT TPM_Process_LoadKey(tpm_state_t *tpm_state,
 	if (key_added) {
 	    /* if there was a failure and inKey was stored in the handle list, free the handle.
 	       Ignore errors, since only one error code can be returned. */
-	    TPM_KeyHandleEntries_DeleteHandle(tpm_state->tpm_key_handle_entries, inKeyHandle);
+	    TPM_KeyHandleEntries_DeleteHandle(&(tpm_state->tpm_key_handle_entries), inKeyHandle);
 	}	
     }
     return rcf;
@@ -3123,7 +3123,7 @@ TPM_RESULT TPM_Process_LoadKey2(tpm_state_t *tpm_state,
 	if (key_added) {
 	    /* if there was a failure and inKey was stored in the handle list, free the handle.
 	       Ignore errors, since only one error code can be returned. */
-	    TPM_KeyHandleEntries_DeleteHandle(tpm_state->tpm_key_handle_entries, inKeyHandle);
+	    TPM_KeyHandleEntries_DeleteHandle(&(tpm_state->tpm_key_handle_entries), inKeyHandle);
 	}	
     }
     return rcf;
@@ -3315,7 +3315,7 @@ static TPM_RESULT TPM_LoadKeyCommon(TPM_KEY_HANDLE	*inKeyHandle,	/* output */
     if (rc == TPM_SUCCESS) {
 	*inKeyHandle = 0;	/* no preferred value */
 	rc = TPM_KeyHandleEntries_AddKeyEntry(inKeyHandle,			/* output */
-					      tpm_state->tpm_key_handle_entries, /* input */
+					      &(tpm_state->tpm_key_handle_entries), /* input */
 					      inKey,				/* input */
 					      parentPCRStatus,
 					      0);			/* keyControl */
@@ -3333,7 +3333,7 @@ static TPM_RESULT TPM_LoadKeyCommon(TPM_KEY_HANDLE	*inKeyHandle,	/* output */
     }
     if (rc == TPM_SUCCESS) {
 	if (parentPCRUsage) {
-	    rc = TPM_KeyHandleEntries_SetParentPCRStatus(tpm_state->tpm_key_handle_entries,
+	    rc = TPM_KeyHandleEntries_SetParentPCRStatus(&(tpm_state->tpm_key_handle_entries),
 							 *inKeyHandle, TRUE);
 	}
     }	
@@ -64,6 +64,71 @@
 static void       TPM_Sbuffer_AdjustParamSize(TPM_STORE_BUFFER *sbuffer);
 static TPM_RESULT TPM_Sbuffer_AdjustReturnCode(TPM_STORE_BUFFER *sbuffer, TPM_RESULT returnCode);
 
+#if TPM_STORE_BUFFER_POOL_SIZE > 0
+/* Buffers released by TPM_Sbuffer_Delete() for reuse by TPM_Sbuffer_Append().  The buffers are
+   zeroed when they are released, since they may have held secrets. */
+
+static struct {
+    unsigned char *buffer;
+    size_t size;
+} tpm_sbuffer_pool[TPM_STORE_BUFFER_POOL_SIZE];
+static size_t tpm_sbuffer_pool_count;
+
+/* TPM_Sbuffer_PoolGet() moves a pooled buffer of at least 'size' bytes to 'sbuffer', which must
+   not have a buffer yet.  Returns FALSE if there is none. */
+
+static TPM_BOOL TPM_Sbuffer_PoolGet(TPM_STORE_BUFFER *sbuffer, size_t size)
+{
+    size_t i;
+
+    for (i = tpm_sbuffer_pool_count ; i > 0 ; i--) {
+	if (tpm_sbuffer_pool[i - 1].size >= size) {
+	    sbuffer->buffer = tpm_sbuffer_pool[i - 1].buffer;
+	    sbuffer->buffer_current = sbuffer->buffer;
+	    sbuffer->buffer_end = sbuffer->buffer + tpm_sbuffer_pool[i - 1].size;
+	    tpm_sbuffer_pool_count--;
+	    tpm_sbuffer_pool[i - 1] = tpm_sbuffer_pool[tpm_sbuffer_pool_count];
+	    return TRUE;
+	}
+    }
+    return FALSE;
+}
+
+/* TPM_Sbuffer_PoolPut() zeroes and keeps the buffer of 'sbuffer' if it fits into the pool.
+   Returns FALSE if the caller must free the buffer. */
+
+static TPM_BOOL TPM_Sbuffer_PoolPut(TPM_STORE_BUFFER *sbuffer)
+{
+    size_t size = (size_t)(sbuffer->buffer_end - sbuffer->buffer);
+
+    if ((sbuffer->buffer == NULL) ||
+	(size > TPM_STORE_BUFFER_POOL_MAX) ||
+	(tpm_sbuffer_pool_count >= TPM_STORE_BUFFER_POOL_SIZE)) {
+	return FALSE;
+    }
+    memset(sbuffer->buffer, 0, size);
+    tpm_sbuffer_pool[tpm_sbuffer_pool_count].buffer = sbuffer->buffer;
+    tpm_sbuffer_pool[tpm_sbuffer_pool_count].size = size;
+    tpm_sbuffer_pool_count++;
+    return TRUE;
+}
+#endif
+
+/* TPM_Sbuffer_PoolDelete() frees the buffers kept for reuse.  It is called when the TPM is
+   terminated. */
+
+void TPM_Sbuffer_PoolDelete(void)
+{
+#if TPM_STORE_BUFFER_POOL_SIZE > 0
+    while (tpm_sbuffer_pool_count > 0) {
+	tpm_sbuffer_pool_count--;
+	free(tpm_sbuffer_pool[tpm_sbuffer_pool_count].buffer);
+	tpm_sbuffer_pool[tpm_sbuffer_pool_count].buffer = NULL;
+    }
+#endif
+    return;
+}
+
 
 /* TPM_Sbuffer_Init() sets up a new serialize buffer.  It should be called before the first use. */
 
@@ -111,11 +176,17 @@ TPM_RESULT TPM_Sbuffer_Load(TPM_STORE_BUFFER *sbuffer,
 
 /* TPM_Sbuffer_Delete() frees an existing buffer and reinitializes it.  It must be called when a
    TPM_STORE_BUFFER is no longer required, to avoid a memory leak.  The buffer can be reused, but in
-   that case TPM_Sbuffer_Clear would be a better choice. */
+   that case TPM_Sbuffer_Clear would be a better choice.
+
+   Small buffers are zeroed and kept for reuse rather than freed.
+*/
 
 void TPM_Sbuffer_Delete(TPM_STORE_BUFFER *sbuffer)
 {
-    free(sbuffer->buffer);
+#if TPM_STORE_BUFFER_POOL_SIZE > 0
+    if (!TPM_Sbuffer_PoolPut(sbuffer))
+#endif
+	free(sbuffer->buffer);
     TPM_Sbuffer_Init(sbuffer);
 }
 
@@ -214,6 +285,7 @@ TPM_RESULT TPM_Sbuffer_Append(TPM_STORE_BUFFER *sbuffer,
     size_t current_size;        /* size of current buffer */
     size_t current_length;      /* bytes in current buffer */
     size_t new_size;            /* size of new buffer */
+    TPM_BOOL pooled = FALSE;    /* new buffer taken from the pool */
     
     /* can data fit? */
     if (rc == 0) {
@@ -235,10 +307,14 @@ TPM_RESULT TPM_Sbuffer_Append(TPM_STORE_BUFFER *sbuffer,
             if (rc == 0) {
                 /* cast safe as end is always greater than start */
                 current_size = (size_t)(sbuffer->buffer_end - sbuffer->buffer);
-                /* optimize realloc's by rounding up data_length to the next increment */
-                new_size = current_size +       /* currently used */
-                           ((((data_length - 1)/TPM_STORE_BUFFER_INCREMENT) + 1) *
+                /* optimize realloc's by rounding up the needed size to the next increment */
+                new_size = ((((current_length + data_length - 1)/TPM_STORE_BUFFER_INCREMENT) + 1) *
                             TPM_STORE_BUFFER_INCREMENT);
+                /* and by at least doubling the buffer, so that a large serialization does not
+                   realloc for every increment */
+                if (new_size < (2 * current_size)) {
+                    new_size = 2 * current_size;
+                }
                 /* but not greater than maximum buffer size */
                 if (new_size > TPM_ALLOC_MAX) {
                     new_size = TPM_ALLOC_MAX;
@@ -247,7 +323,16 @@ TPM_RESULT TPM_Sbuffer_Append(TPM_STORE_BUFFER *sbuffer,
                        (unsigned long)data_length,
                        (unsigned long)current_size,
                        (unsigned long)new_size);
-                rc = TPM_Realloc(&(sbuffer->buffer), new_size);
+#if TPM_STORE_BUFFER_POOL_SIZE > 0
+                /* a new buffer can come from the pool */
+                if ((sbuffer->buffer == NULL) && TPM_Sbuffer_PoolGet(sbuffer, new_size)) {
+                    new_size = (size_t)(sbuffer->buffer_end - sbuffer->buffer);
+                    pooled = TRUE;
+                }
+#endif
+                if (!pooled) {
+                    rc = TPM_Realloc(&(sbuffer->buffer), new_size);
+                }
             }
             if (rc == 0) {
                 sbuffer->buffer_end = sbuffer->buffer + new_size;       /* end */
@@ -50,6 +50,7 @@ TPM_RESULT TPM_Sbuffer_Load(TPM_STORE_BUFFER *sbuffer,
                             uint32_t *stream_size);
 /* TPM_Sbuffer_Store(): See TPM_Sbuffer_AppendAsSizedBuffer() */
 void       TPM_Sbuffer_Delete(TPM_STORE_BUFFER *sbuffer);
+void       TPM_Sbuffer_PoolDelete(void);
 
 void       TPM_Sbuffer_Clear(TPM_STORE_BUFFER *sbuffer);
 void       TPM_Sbuffer_Get(TPM_STORE_BUFFER *sbuffer,
@@ -830,6 +830,10 @@ typedef struct tdTPM_KEY {
        these structures are always non-NULL. */
     TPM_STORE_ASYMKEY *tpm_store_asymkey;
     TPM_MIGRATE_ASYMKEY *tpm_migrate_asymkey;
+    /* libtpms added: A cache of the crypto library private key objects built from the key, so
+       that repeated signing and decryption with a loaded key does not rebuild them.  Created on
+       first use, freed by TPM_Key_Delete(). */
+    void *rsa_key_cache;
 } TPM_KEY; 
 
 /* 10.3 TPM_KEY12 rev 87
@@ -898,10 +902,21 @@ typedef struct tdTPM_PUBKEY {
 #define TPM_KEY_HANDLES 3     /* entries in global TPM_KEY_HANDLE_ENTRY array */
 #endif
 
+/* TPM_KEY_HANDLES is the default and minimum number of key slots.  TPMLIB_SetKeyHandles() can
+   raise the number of key slots at runtime up to TPM_KEY_HANDLES_MAX. */
+
+#ifndef TPM_KEY_HANDLES_MAX
+#define TPM_KEY_HANDLES_MAX TPM_KEY_HANDLES
+#endif
+
+#if (TPM_KEY_HANDLES_MAX < TPM_KEY_HANDLES)
+#error "TPM_KEY_HANDLES_MAX must not be less than TPM_KEY_HANDLES"
+#endif
+
 /* TPM_GetCapability uses a uint_16 for the number of key slots */
 
-#if (TPM_KEY_HANDLES > 0xffff)
-#error "TPM_KEY_HANDLES must be less than 0x10000"
+#if (TPM_KEY_HANDLES_MAX > 0xffff)
+#error "TPM_KEY_HANDLES_MAX must be less than 0x10000"
 #endif
 
 /* The TPM does not have to support any minimum number of owner evict keys.  Adjust this value to
@@ -932,6 +947,22 @@ typedef struct tdTPM_KEY_HANDLE_ENTRY {
                                    manipulation. */
 } TPM_KEY_HANDLE_ENTRY; 
 
+/* The key slots and an index from key handle to key slot.
+
+   The index is an open addressing hash table.  A bucket holds a slot number + 1, 0 marks an empty
+   bucket.  Since entries are removed by emptying the slot, a bucket can refer to a slot that is
+   empty or has been reused for a different handle.  Lookups therefore always verify the slot, and
+   the index is rebuilt from the slots when half of the buckets are in use.
+*/
+
+typedef struct tdTPM_KEY_HANDLE_ENTRIES {
+    uint32_t keyHandleCount;			/* number of key slots */
+    TPM_KEY_HANDLE_ENTRY *tpm_key_handle_entry;	/* array of key slots */
+    uint32_t indexSize;				/* number of buckets, a power of 2 */
+    uint32_t indexUsed;				/* non-empty buckets */
+    uint16_t *index;				/* array of buckets */
+} TPM_KEY_HANDLE_ENTRIES;
+
 /* 5.12 TPM_MIGRATIONKEYAUTH rev 87
 
    This structure provides the proof that the associated public key has TPM Owner authorization to
@@ -2622,7 +2653,7 @@ typedef struct tdTPM_DA_INFO_LIMITED {
 
 #if (TPM_ALLOC_MAX <					\
 	(4000 +						\
-	 TPM_KEY_HANDLES * 2000 +			\
+	 TPM_KEY_HANDLES_MAX * 2000 +			\
 	 TPM_MIN_TRANS_SESSIONS * 500 +			\
 	 TPM_MIN_DAA_SESSIONS * 2000 +			\
 	 TPM_MIN_AUTH_SESSIONS * 500))
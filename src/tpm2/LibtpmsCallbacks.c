@@ -13,6 +13,7 @@
 #include "tpm_library_intern.h"
 #include "tpm_error.h"
 #include "tpm_nvfilename.h"
+#include "tpm_probes.h"
 
 int libtpms_plat__NVEnable(void)
 {
@@ -36,7 +37,11 @@ int libtpms_plat__NVEnable(void)
         const char* name       = TPM_PERMANENT_ALL_NAME;
         TPM_RESULT  ret;
 
+        /* the application may have changed the stored state */
+        SetStoredStateDigest(TPMLIB_STATE_PERMANENT, NULL);
+        TPM_PROBE1(nvram_load_entry, name);
         ret = cbs->tpm_nvram_loaddata(&data, &length, tpm_number, name);
+        TPM_PROBE3(nvram_load_return, name, length, ret);
         switch(ret)
         {
             case TPM_RETRY:
@@ -102,13 +107,29 @@ int libtpms_plat__NvCommit(void)
         TPM_RESULT  ret;
         BYTE*       buf;
         uint32_t    buflen;
+        unsigned char digest[STORED_STATE_DIGEST_SIZE];
+        bool          have_digest;
 
         ret = TPM2_PersistentAllStore(&buf, &buflen);
         if(ret != TPM_SUCCESS)
             return ret;
 
+        /* skip storing the same state again */
+        have_digest = ComputeStoredStateDigest(buf, buflen, digest);
+        if(have_digest
+           && StoredStateDigestMatches(TPMLIB_STATE_PERMANENT, digest))
+        {
+            TPM_PROBE1(nv_commit_skipped, buflen);
+            free(buf);
+            return 0;
+        }
+
+        TPM_PROBE2(nvram_store_entry, name, buflen);
         ret = cbs->tpm_nvram_storedata(buf, buflen, tpm_number, name);
+        TPM_PROBE2(nvram_store_return, name, ret);
         free(buf);
+        SetStoredStateDigest(TPMLIB_STATE_PERMANENT,
+                             (ret == TPM_SUCCESS && have_digest) ? digest : NULL);
         if(ret == TPM_SUCCESS)
             return 0;
 
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+/*
+ * Report the memory held by the subsystems of the TPM 2 for
+ * TPMLIB_GetInfo(TPMLIB_INFO_MEMORY_USAGE). The ExpDCache and the
+ * snapshot report their memory usage when it changes.
+ */
+
+#include <string.h>
+
+#define OBJECT_C
+#define SESSION_C
+#define NV_C
+#include "Tpm.h"
+#include "Platform.h"
+#include "RuntimeProfile_fp.h"
+#include "MemoryUsage.h"
+#if USE_OPENSSL_FUNCTIONS_SYMMETRIC
+# include "Helpers_fp.h"
+#endif
+#include "tpm_memusage.h"
+
+/*
+ * Update the memory usage of the object and session slots. This is
+ * cheap enough to be done after every command so that their peaks
+ * are known.
+ */
+void MemoryUsageUpdateSlots(void)
+{
+    size_t objects = 0, sequences = 0, sessions = 0;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(s_objects); i++) {
+        if (!s_objects[i].attributes.occupied)
+            continue;
+        objects++;
+        if (s_objects[i].attributes.hashSeq ||
+            s_objects[i].attributes.hmacSeq ||
+            s_objects[i].attributes.eventSeq)
+            sequences++;
+    }
+    for (i = 0; i < ARRAY_SIZE(s_sessions); i++) {
+        if (s_sessions[i].occupied)
+            sessions++;
+    }
+
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_OBJECTS, sizeof(s_objects),
+                          objects * sizeof(s_objects[0]));
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_HASH_SEQUENCES, sizeof(s_objects),
+                          sequences * sizeof(s_objects[0]));
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_SESSIONS, sizeof(s_sessions),
+                          sessions * sizeof(s_sessions[0]));
+}
+
+static size_t StringSize(const char *str)
+{
+    return str ? strlen(str) + 1 : 0;
+}
+
+/*
+ * Update the memory usage of all subsystems that do not report changes
+ * of their memory usage themselves.
+ */
+void MemoryUsageUpdate(void)
+{
+    size_t size, in_use;
+
+    MemoryUsageUpdateSlots();
+
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_NV, NV_MEMORY_SIZE,
+                          NvGetUsedBytes());
+
+    size = StringSize(g_RuntimeProfile.profileName) +
+           StringSize(g_RuntimeProfile.runtimeProfileJSON) +
+           StringSize(g_RuntimeProfile.profileDescription) +
+           RuntimeProfileCacheGetMemoryUsage();
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_RUNTIME_PROFILE, size, size);
+
+#if USE_OPENSSL_FUNCTIONS_SYMMETRIC
+    GetEVPCipherCacheMemoryUsage(&size, &in_use);
+#else
+    size = in_use = 0;
+#endif
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_CIPHER_CACHE, size, in_use);
+}
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+void MemoryUsageUpdateSlots(void);
+void MemoryUsageUpdate(void);
+
+#endif /* MEMORY_USAGE_H */
@@ -86,8 +86,9 @@ block_skip_write_push(block_skip_t *bs, BOOL has_block,
     UINT16 written , w;
     UINT16 zero = 0;
     written = BOOL_Marshal(&has_block, buffer, size);
-    bs->pos[bs->idx].buffer = *buffer;
-    bs->pos[bs->idx].size = *size;
+    /* buffer == NULL: only computing the size of the byte stream */
+    bs->pos[bs->idx].buffer = buffer ? *buffer : NULL;
+    bs->pos[bs->idx].size = size ? *size : 0;
     w = UINT16_Marshal(&zero, buffer, size);
     if (w) {
         bs->idx++;
@@ -110,6 +111,8 @@ block_skip_write_pop(block_skip_t *bs, INT32 *size) {
     UINT16 skip;
     unsigned i = --bs->idx;
     pAssert_VOID_OK((int)bs->idx >= 0);
+    if (bs->pos[i].buffer == NULL || size == NULL)
+        return;
     skip = bs->pos[i].size - *size - sizeof(UINT16);
     UINT16_Marshal(&skip, &bs->pos[i].buffer, &bs->pos[i].size);
 }
@@ -178,6 +181,67 @@ block_skip_read(BOOL needs_block, BYTE **buffer, INT32 *size,
             goto SKIP_MARK;						\
     }
 
+/*
+ * When the PERSISTENT_ALL blob is streamed it is marshalled into a bounded
+ * buffer that is handed to a writer function whenever the next item would
+ * not fit into the remaining space anymore. The size of the next item is
+ * determined by marshalling it without a buffer. Items are only reserved
+ * where no block_skip position is outstanding since those point into the
+ * buffer.
+ */
+static struct nv_stream {
+    NV_STREAM_WRITER    writer;
+    void               *opaque;
+    BYTE               *start;
+    INT32               bufsize;
+    TPM_RC              rc;
+} nv_stream;
+
+static void
+nv_stream_reserve(BYTE **buffer, INT32 *size, UINT32 needed)
+{
+    if (*size >= (INT32)needed)
+        return;
+
+    if (nv_stream.rc == TPM_RC_SUCCESS && *buffer > nv_stream.start)
+        nv_stream.rc = nv_stream.writer(nv_stream.opaque, nv_stream.start,
+                                        *buffer - nv_stream.start);
+    *buffer = nv_stream.start;
+    *size = nv_stream.bufsize;
+
+    if (nv_stream.rc == TPM_RC_SUCCESS && *size < (INT32)needed) {
+        TPMLIB_LogTPM2Error("Stream buffer of %d bytes is too small for %u bytes\n",
+                            *size, needed);
+        nv_stream.rc = TPM_RC_SIZE;
+    }
+}
+
+#define NV_STREAM_RESERVE(NEEDED)                       \
+    do {                                                \
+        if (nv_stream.writer && buffer)                 \
+            nv_stream_reserve(buffer, size, NEEDED);    \
+    } while (0)
+
+/*
+ * Fail the stream if an item did not marshal into exactly the number of
+ * bytes reserved for it; more bytes would have overflowed the buffer.
+ */
+static void
+nv_stream_check(const char *name, UINT32 needed, UINT32 written)
+{
+    if (nv_stream.rc == TPM_RC_SUCCESS && written != needed) {
+        TPMLIB_LogTPM2Error("%s: Marshalled %u bytes but reserved %u bytes\n",
+                            name, written, needed);
+        nv_stream.rc = TPM_RC_SIZE;
+    }
+}
+
+#define NV_STREAM_CHECK(NAME, NEEDED, WRITTEN)          \
+    do {                                                \
+        if (nv_stream.writer && buffer)                 \
+            nv_stream_check(NAME, NEEDED, WRITTEN);     \
+    } while (0)
+
 static unsigned int _ffsll(long long bits)
 {
     size_t i = 0;
@@ -280,13 +344,8 @@ String_Marshal(const char *source, BYTE **buffer, INT32 *size)
         len = (UINT16)strlen(source) + 1;
     written += UINT16_Marshal(&len, buffer, size);
 
-    if (len > 0 && *size >= len) {
-        memcpy(*buffer, source, len);
-        *buffer += len;
-        *size -= len;
-
-        written += len;
-    }
+    if (len > 0)
+        written += Array_Marshal((BYTE *)source, len, buffer, size);
 
     return written;
 }
@@ -470,7 +529,6 @@ static UINT16
 DRBG_STATE_Marshal(DRBG_STATE *data, BYTE **buffer, INT32 *size)
 {
     UINT16 written;
-    size_t i;
     UINT16 array_size;
     BLOCK_SKIP_INIT;
 
@@ -485,9 +543,7 @@ DRBG_STATE_Marshal(DRBG_STATE *data, BYTE **buffer, INT32 *size)
 
     array_size = ARRAY_SIZE(data->lastValue);
     written += UINT16_Marshal(&array_size, buffer, size);
-    for (i = 0; i < array_size; i++) {
-        written += UINT32_Marshal(&data->lastValue[i], buffer, size);
-    }
+    written += UINT32_Array_Marshal(&data->lastValue[0], buffer, size, array_size);
 
     written += BLOCK_SKIP_WRITE_PUSH(TRUE, buffer, size);
     /* future versions append below this line */
@@ -503,7 +559,6 @@ static TPM_RC
 DRBG_STATE_Unmarshal(DRBG_STATE *data, BYTE **buffer, INT32 *size)
 {
     TPM_RC rc= TPM_RC_SUCCESS;
-    size_t i;
     NV_HEADER hdr;
     UINT16 array_size = 0;
 
@@ -546,9 +601,8 @@ DRBG_STATE_Unmarshal(DRBG_STATE *data, BYTE **buffer, INT32 *size)
         }
     }
     if (rc == TPM_RC_SUCCESS) {
-        for (i = 0; i < ARRAY_SIZE(data->lastValue) && rc == TPM_RC_SUCCESS; i++) {
-            rc = UINT32_Unmarshal(&data->lastValue[i], buffer, size);
-        }
+        rc = UINT32_Array_Unmarshal(&data->lastValue[0], buffer, size,
+                                    ARRAY_SIZE(data->lastValue));
     }
 
     /* version 2 starts having indicator for next versions that we can skip;
@@ -1153,7 +1207,6 @@ static UINT16
 PCR_AUTHVALUE_Marshal(PCR_AUTHVALUE *data, BYTE **buffer, INT32 *size)
 {
     UINT16 written;
-    size_t i;
     UINT16 array_size;
     BLOCK_SKIP_INIT;
 
@@ -1162,9 +1215,7 @@ PCR_AUTHVALUE_Marshal(PCR_AUTHVALUE *data, BYTE **buffer, INT32 *size)
 
     array_size = ARRAY_SIZE(data->auth);
     written += UINT16_Marshal(&array_size, buffer, size);
-    for (i = 0; i < array_size; i++) {
-        written += TPM2B_DIGEST_Marshal(&data->auth[i], buffer, size);
-    }
+    written += TPM2B_DIGEST_Array_Marshal(&data->auth[0], buffer, size, array_size);
 
     written += BLOCK_SKIP_WRITE_PUSH(TRUE, buffer, size);
     /* future versions append below this line */
@@ -1351,9 +1402,8 @@ STATE_RESET_DATA_Unmarshal(STATE_RESET_DATA *data, BYTE **buffer, INT32 *size)
             s_ContextSlotMask = 0xff;
         } else {
             /* version 4 and later an array of UINT16 */
-            for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
-                rc = UINT16_Unmarshal(&data->contextArray[i], buffer, size);
-            }
+            rc = UINT16_Array_Unmarshal(&data->contextArray[0], buffer, size,
+                                        array_size);
             if (rc == TPM_RC_SUCCESS) {
                 rc = UINT16_Unmarshal(&s_ContextSlotMask, buffer, size);
             }
@@ -1446,7 +1496,6 @@ STATE_RESET_DATA_Marshal(STATE_RESET_DATA *data, BYTE **buffer, INT32 *size)
     BOOL has_block;
     UINT16 array_size;
     BLOCK_SKIP_INIT;
-    size_t i;
 
     written = NV_HEADER_Marshal(buffer, size,
                                 STATE_RESET_DATA_VERSION,
@@ -1458,8 +1507,7 @@ STATE_RESET_DATA_Marshal(STATE_RESET_DATA *data, BYTE **buffer, INT32 *size)
 
     array_size = ARRAY_SIZE(data->contextArray);
     written += UINT16_Marshal(&array_size, buffer, size);
-    for (i = 0; i < array_size; i++)
-        written += UINT16_Marshal(&data->contextArray[i], buffer, size);
+    written += UINT16_Array_Marshal(&data->contextArray[0], buffer, size, array_size);
 
     if (s_ContextSlotMask != 0x00ff && s_ContextSlotMask != 0xffff) {
         /* TPM wasn't initialized, so s_ContextSlotMask wasn't set */
@@ -2877,7 +2925,351 @@ skip_future_versions:
     return rc;
 }
 
-#define VOLATILE_STATE_VERSION 4
+/*
+ * Since StateFormatLevel 9 the volatile state uses a compact encoding for
+ * the object slots, session slots, PCRs and s_indexOrderlyRam. Slots are
+ * preceded by an occupancy bitmap and only occupied slots are written.
+ * PCRs are written per bank with a bitmap of the PCRs that hold a non-zero
+ * digest followed by only those digests. Only the used part of
+ * s_indexOrderlyRam, up to its last non-zero byte, is written.
+ */
+MUST_BE(MAX_LOADED_OBJECTS <= 32);
+MUST_BE(MAX_LOADED_SESSIONS <= 32);
+MUST_BE(IMPLEMENTATION_PCR <= 32);
+
+#if defined PCR_C || defined GLOBAL_C
+static const struct {
+    TPM_ALG_ID algid;
+    size_t offset;
+    UINT16 digestSize;
+} pcr_banks[] = {
+#define PCR_BANK(ALGID, FIELD) \
+    { .algid = ALGID, .offset = offsetof(PCR, FIELD), .digestSize = sizeof(((PCR *)0)->FIELD) }
+#if ALG_SHA1
+    PCR_BANK(TPM_ALG_SHA1, Sha1Pcr),
+#endif
+#if ALG_SHA256
+    PCR_BANK(TPM_ALG_SHA256, Sha256Pcr),
+#endif
+#if ALG_SHA384
+    PCR_BANK(TPM_ALG_SHA384, Sha384Pcr),
+#endif
+#if ALG_SHA512
+    PCR_BANK(TPM_ALG_SHA512, Sha512Pcr),
+#endif
+#if ALG_SM3_256
+    PCR_BANK(TPM_ALG_SM3_256, Sm3_256),
+#endif
+#if ALG_SHA3_256
+    PCR_BANK(TPM_ALG_SHA3_256, Sha3_256),
+#endif
+#if ALG_SHA3_384
+    PCR_BANK(TPM_ALG_SHA3_384, Sha3_384),
+#endif
+#if ALG_SHA3_512
+    PCR_BANK(TPM_ALG_SHA3_512, Sha3_512),
+#endif
+#undef PCR_BANK
+};
+
+static BOOL
+IsZeroBuffer(const BYTE *buffer, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (buffer[i])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static UINT16
+PCRS_Compact_Marshal(PCR *pcrs, UINT16 array_size, BYTE **buffer, INT32 *size)
+{
+    UINT16 written;
+    UINT32 bitmap;
+    TPM_ALG_ID algid;
+    BYTE *digest;
+    size_t b, i;
+
+    written = UINT16_Marshal(&array_size, buffer, size);
+
+    for (b = 0; b < ARRAY_SIZE(pcr_banks); b++) {
+        bitmap = 0;
+        for (i = 0; i < array_size; i++) {
+            digest = (BYTE *)&pcrs[i] + pcr_banks[b].offset;
+            if (!IsZeroBuffer(digest, pcr_banks[b].digestSize))
+                bitmap |= (UINT32)1 << i;
+        }
+        written += TPM_ALG_ID_Marshal((TPM_ALG_ID *)&pcr_banks[b].algid, buffer, size);
+        written += UINT16_Marshal((UINT16 *)&pcr_banks[b].digestSize, buffer, size);
+        written += UINT32_Marshal(&bitmap, buffer, size);
+        for (i = 0; i < array_size; i++) {
+            if (!(bitmap & ((UINT32)1 << i)))
+                continue;
+            digest = (BYTE *)&pcrs[i] + pcr_banks[b].offset;
+            written += Array_Marshal(digest, pcr_banks[b].digestSize, buffer, size);
+        }
+    }
+
+    /* end marker */
+    algid = TPM_ALG_NULL;
+    written += TPM_ALG_ID_Marshal(&algid, buffer, size);
+
+    return written;
+}
+
+static TPM_RC
+PCRS_Compact_Unmarshal(PCR *pcrs, UINT16 exp_array_size, BYTE **buffer, INT32 *size,
+                       const TPML_PCR_SELECTION *pcrAllocated)
+{
+    TPM_RC rc = TPM_RC_SUCCESS;
+    UINT64 algs_needed = pcrbanks_algs_active(pcrAllocated);
+    UINT16 array_size = 0, digestSize;
+    UINT32 bitmap;
+    TPM_ALG_ID algid = TPM_ALG_ERROR;
+    size_t b = 0, i;
+
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT16_Unmarshal(&array_size, buffer, size);
+    }
+    if (rc == TPM_RC_SUCCESS && array_size != exp_array_size) {
+        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_pcrs; "
+                            "expected %u, got %u\n",
+                            exp_array_size, array_size);
+        rc = TPM_RC_BAD_PARAMETER;
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        memset(pcrs, 0, array_size * sizeof(*pcrs));
+    }
+
+    while (rc == TPM_RC_SUCCESS) {
+        rc = TPM_ALG_ID_Unmarshal(&algid, buffer, size);
+        if (rc != TPM_RC_SUCCESS || algid == TPM_ALG_NULL)
+            break;
+
+        for (b = 0; b < ARRAY_SIZE(pcr_banks); b++) {
+            if (pcr_banks[b].algid == algid)
+                break;
+        }
+        if (b == ARRAY_SIZE(pcr_banks)) {
+            TPMLIB_LogTPM2Error("PCR: Unsupported algid %d.", algid);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        if (rc == TPM_RC_SUCCESS) {
+            algs_needed &= ~((UINT64)1 << algid);
+            rc = UINT16_Unmarshal(&digestSize, buffer, size);
+        }
+        if (rc == TPM_RC_SUCCESS && digestSize != pcr_banks[b].digestSize) {
+            TPMLIB_LogTPM2Error("PCR: Bad size for PCR for hash 0x%x; "
+                                "Expected %u, got %u\n",
+                                algid, pcr_banks[b].digestSize, digestSize);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        if (rc == TPM_RC_SUCCESS) {
+            rc = UINT32_Unmarshal(&bitmap, buffer, size);
+        }
+        if (rc == TPM_RC_SUCCESS && array_size < 32 && (bitmap >> array_size)) {
+            TPMLIB_LogTPM2Error("PCR: Bad PCR bitmap 0x%08x for hash 0x%x\n",
+                                bitmap, algid);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
+            if (bitmap & ((UINT32)1 << i))
+                rc = Array_Unmarshal((BYTE *)&pcrs[i] + pcr_banks[b].offset,
+                                     digestSize, buffer, size);
+        }
+    }
+
+    if (rc == TPM_RC_SUCCESS && algs_needed) {
+        TPMLIB_LogTPM2Error("PCR: Missing data for hash algorithm %d.\n",
+                            _ffsll(algs_needed) - 1);
+        rc = TPM_RC_BAD_PARAMETER;
+    }
+
+    return rc;
+}
+#endif
+
+#if defined OBJECT_C || defined GLOBAL_C
+static UINT16
+OBJECTS_Compact_Marshal(OBJECT *objects, UINT16 array_size, BYTE **buffer, INT32 *size,
+                        struct RuntimeProfile *RuntimeProfile)
+{
+    UINT16 written;
+    UINT32 bitmap = 0;
+    size_t i;
+
+    for (i = 0; i < array_size; i++) {
+        if (objects[i].attributes.occupied)
+            bitmap |= (UINT32)1 << i;
+    }
+
+    written = UINT16_Marshal(&array_size, buffer, size);
+    written += UINT32_Marshal(&bitmap, buffer, size);
+
+    for (i = 0; i < array_size; i++) {
+        if (bitmap & ((UINT32)1 << i))
+            written += ANY_OBJECT_Marshal(&objects[i], buffer, size, RuntimeProfile);
+    }
+
+    return written;
+}
+
+static TPM_RC
+OBJECTS_Compact_Unmarshal(OBJECT *objects, UINT16 exp_array_size,
+                          BYTE **buffer, INT32 *size)
+{
+    TPM_RC rc = TPM_RC_SUCCESS;
+    UINT16 array_size = 0;
+    UINT32 bitmap = 0;
+    size_t i;
+
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT16_Unmarshal(&array_size, buffer, size);
+    }
+    if (rc == TPM_RC_SUCCESS && array_size != exp_array_size) {
+        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_objects; "
+                            "expected %u, got %u\n",
+                            exp_array_size, array_size);
+        rc = TPM_RC_BAD_PARAMETER;
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT32_Unmarshal(&bitmap, buffer, size);
+    }
+    for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
+        if (!(bitmap & ((UINT32)1 << i))) {
+            memset(&objects[i], 0, sizeof(objects[i]));
+            continue;
+        }
+        rc = ANY_OBJECT_Unmarshal(&objects[i], buffer, size, true);
+        if (rc == TPM_RC_SUCCESS && !objects[i].attributes.occupied) {
+            TPMLIB_LogTPM2Error("Volatile state: Object slot %zu is not occupied\n",
+                                i);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+    }
+
+    return rc;
+}
+#endif
+
+#if defined SESSION_C || defined GLOBAL_C
+static UINT16
+SESSION_SLOTS_Compact_Marshal(SESSION_SLOT *sessions, UINT16 array_size,
+                              BYTE **buffer, INT32 *size)
+{
+    UINT16 written;
+    UINT32 bitmap = 0;
+    size_t i;
+
+    for (i = 0; i < array_size; i++) {
+        if (sessions[i].occupied)
+            bitmap |= (UINT32)1 << i;
+    }
+
+    written = UINT16_Marshal(&array_size, buffer, size);
+    written += UINT32_Marshal(&bitmap, buffer, size);
+
+    for (i = 0; i < array_size; i++) {
+        if (bitmap & ((UINT32)1 << i))
+            written += SESSION_SLOT_Marshal(&sessions[i], buffer, size);
+    }
+
+    return written;
+}
+
+static TPM_RC
+SESSION_SLOTS_Compact_Unmarshal(SESSION_SLOT *sessions, UINT16 exp_array_size,
+                                BYTE **buffer, INT32 *size)
+{
+    TPM_RC rc = TPM_RC_SUCCESS;
+    UINT16 array_size = 0;
+    UINT32 bitmap = 0;
+    size_t i;
+
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT16_Unmarshal(&array_size, buffer, size);
+    }
+    if (rc == TPM_RC_SUCCESS && array_size != exp_array_size) {
+        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_sessions; "
+                            "expected %u, got %u\n",
+                            exp_array_size, array_size);
+        rc = TPM_RC_BAD_PARAMETER;
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT32_Unmarshal(&bitmap, buffer, size);
+    }
+    for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
+        if (!(bitmap & ((UINT32)1 << i))) {
+            memset(&sessions[i], 0, sizeof(sessions[i]));
+            continue;
+        }
+        rc = SESSION_SLOT_Unmarshal(&sessions[i], buffer, size);
+        if (rc == TPM_RC_SUCCESS && !sessions[i].occupied) {
+            TPMLIB_LogTPM2Error("Volatile state: Session slot %zu is not occupied\n",
+                                i);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+    }
+
+    return rc;
+}
+#endif
+
+static UINT16
+Array_Compact_Marshal(BYTE *array, UINT16 array_size, BYTE **buffer, INT32 *size)
+{
+    UINT16 written;
+    UINT16 used = array_size;
+
+    while (used > 0 && array[used - 1] == 0)
+        used--;
+
+    written = UINT16_Marshal(&array_size, buffer, size);
+    written += UINT16_Marshal(&used, buffer, size);
+    written += Array_Marshal(array, used, buffer, size);
+
+    return written;
+}
+
+static TPM_RC
+Array_Compact_Unmarshal(BYTE *array, UINT16 exp_array_size, BYTE **buffer, INT32 *size,
+                        const char *name)
+{
+    TPM_RC rc = TPM_RC_SUCCESS;
+    UINT16 array_size = 0;
+    UINT16 used = 0;
+
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT16_Unmarshal(&array_size, buffer, size);
+    }
+    if (rc == TPM_RC_SUCCESS && array_size != exp_array_size) {
+        TPMLIB_LogTPM2Error("Volatile state: Bad array size for %s; "
+                            "expected %u, got %u\n",
+                            name, exp_array_size, array_size);
+        rc = TPM_RC_BAD_PARAMETER;
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = UINT16_Unmarshal(&used, buffer, size);
+    }
+    if (rc == TPM_RC_SUCCESS && used > array_size) {
+        TPMLIB_LogTPM2Error("Volatile state: Bad used size %u for %s\n",
+                            used, name);
+        rc = TPM_RC_BAD_PARAMETER;
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        rc = Array_Unmarshal(array, used, buffer, size);
+    }
+    if (rc == TPM_RC_SUCCESS) {
+        memset(&array[used], 0, array_size - used);
+    }
+
+    return rc;
+}
+
+#define VOLATILE_STATE_VERSION 5 /* 5: compact encoding since StateFormatLevel 9 */
 #define VOLATILE_STATE_MAGIC 0x45637889
 
 UINT16
@@ -2897,10 +3289,26 @@ VolatileState_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *Runtime
     };
     BOOL inFailureMode;
     UINT32 failFunction, failLine, failCode;
+    UINT16 blob_version;
+    UINT16 min_version;
+
+    switch (RuntimeProfile->stateFormatLevel) {
+    case 0:
+        pAssert(FALSE);
+        break;
+    case 1 ... 8:
+        blob_version = 4;
+        min_version = 1;
+        break;
+    default:
+        blob_version = 5; /* since stateFormatLevel 9 */
+        min_version = 5;
+        break;
+    }
 
     written = NV_HEADER_Marshal(buffer, size,
-                                VOLATILE_STATE_VERSION, VOLATILE_STATE_MAGIC,
-                                1);
+                                blob_version, VOLATILE_STATE_MAGIC,
+                                min_version);
 
     /* skip g_rcIndex: these are 'constants' */
     written += TPM_HANDLE_Marshal(&g_exclusiveAuditSession, buffer, size); /* line 423 */
@@ -3052,8 +3460,12 @@ VolatileState_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *Runtime
      * in NvManufacture -- since we don't call TPM2_Shutdown we serialize it here
      */
     array_size = sizeof(s_indexOrderlyRam);
-    written += UINT16_Marshal(&array_size, buffer, size);
-    written += Array_Marshal(s_indexOrderlyRam, array_size, buffer, size);
+    if (blob_version >= 5) {
+        written += Array_Compact_Marshal(s_indexOrderlyRam, array_size, buffer, size);
+    } else {
+        written += UINT16_Marshal(&array_size, buffer, size);
+        written += Array_Marshal(s_indexOrderlyRam, array_size, buffer, size);
+    }
 
     written += UINT64_Marshal(&s_maxCounter, buffer, size); /* line 992 */
     /* the following need not be written; NvIndexCacheInit initializes them partly
@@ -3080,10 +3492,15 @@ VolatileState_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *Runtime
      * persistent memory, so what is lost upon TPM2_Shutdown?
      */
     array_size = ARRAY_SIZE(s_objects);
-    written += UINT16_Marshal(&array_size, buffer, size);
+    if (blob_version >= 5) {
+        written += OBJECTS_Compact_Marshal(s_objects, array_size, buffer, size,
+                                           RuntimeProfile);
+    } else {
+        written += UINT16_Marshal(&array_size, buffer, size);
 
-    for (i = 0; i < array_size; i++) {
-        written += ANY_OBJECT_Marshal(&s_objects[i], buffer, size, RuntimeProfile);
+        for (i = 0; i < array_size; i++) {
+            written += ANY_OBJECT_Marshal(&s_objects[i], buffer, size, RuntimeProfile);
+        }
     }
 #else
 # error Unsupport #define value(s)
@@ -3101,10 +3518,14 @@ VolatileState_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *Runtime
 #if defined PCR_C || defined GLOBAL_C
     /* s_pcrs: Marshal *all* PCRs, even those for which stateSave bit is not set */
     array_size = ARRAY_SIZE(s_pcrs);
-    written += UINT16_Marshal(&array_size, buffer, size);
+    if (blob_version >= 5) {
+        written += PCRS_Compact_Marshal(s_pcrs, array_size, buffer, size);
+    } else {
+        written += UINT16_Marshal(&array_size, buffer, size);
 
-    for (i = 0; i < array_size; i++) {
-        written += PCR_Marshal(&s_pcrs[i], buffer, size);
+        for (i = 0; i < array_size; i++) {
+            written += PCR_Marshal(&s_pcrs[i], buffer, size);
+        }
     }
 #else
 # error Unsupport #define value(s)
@@ -3122,10 +3543,14 @@ VolatileState_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *Runtime
 #if defined SESSION_C || defined GLOBAL_C
     /* s_sessions: */
     array_size = ARRAY_SIZE(s_sessions);
-    written += UINT16_Marshal(&array_size, buffer, size);
+    if (blob_version >= 5) {
+        written += SESSION_SLOTS_Compact_Marshal(s_sessions, array_size, buffer, size);
+    } else {
+        written += UINT16_Marshal(&array_size, buffer, size);
 
-    for (i = 0; i < array_size; i++) {
-        written += SESSION_SLOT_Marshal(&s_sessions[i], buffer, size);
+        for (i = 0; i < array_size; i++) {
+            written += SESSION_SLOT_Marshal(&s_sessions[i], buffer, size);
+        }
     }
     /* s_oldestSavedSession: */
     written += UINT32_Marshal(&s_oldestSavedSession, buffer, size);
@@ -3526,18 +3951,26 @@ skip_accumulate_self_heal_timer_1:
         rc = UINT32_Unmarshal(&s_evictNvEnd, buffer, size); /* line 984 */
     }
 
-    if (rc == TPM_RC_SUCCESS) {
-        rc = UINT16_Unmarshal(&array_size, buffer, size);
-    }
-    if (rc == TPM_RC_SUCCESS &&
-        array_size != ARRAY_SIZE(s_indexOrderlyRam)) {
-        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_indexOrderlyRam; "
-                            "expected %zu, got %u\n",
-                            ARRAY_SIZE(s_indexOrderlyRam), array_size);
-        rc = TPM_RC_BAD_PARAMETER;
-    }
-    if (rc == TPM_RC_SUCCESS) {
-        rc = Array_Unmarshal(s_indexOrderlyRam, array_size, buffer, size);
+    if (hdr.version >= 5) {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = Array_Compact_Unmarshal(s_indexOrderlyRam,
+                                         ARRAY_SIZE(s_indexOrderlyRam),
+                                         buffer, size, "s_indexOrderlyRam");
+        }
+    } else {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = UINT16_Unmarshal(&array_size, buffer, size);
+        }
+        if (rc == TPM_RC_SUCCESS &&
+            array_size != ARRAY_SIZE(s_indexOrderlyRam)) {
+            TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_indexOrderlyRam; "
+                                "expected %zu, got %u\n",
+                                ARRAY_SIZE(s_indexOrderlyRam), array_size);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        if (rc == TPM_RC_SUCCESS) {
+            rc = Array_Unmarshal(s_indexOrderlyRam, array_size, buffer, size);
+        }
     }
     if (rc == TPM_RC_SUCCESS) {
         rc = UINT64_Unmarshal(&s_maxCounter, buffer, size); /* line 992 */
@@ -3563,18 +3996,25 @@ skip_nv:
                         "Volatile state", "s_objects");
     }
 #if defined OBJECT_C || defined GLOBAL_C
-    if (rc == TPM_RC_SUCCESS) {
-        rc = UINT16_Unmarshal(&array_size, buffer, size);
-    }
-    if (rc == TPM_RC_SUCCESS &&
-        array_size != ARRAY_SIZE(s_objects)) {
-        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_objects; "
-                            "expected %zu, got %u\n",
-                            ARRAY_SIZE(s_objects), array_size);
-        rc = TPM_RC_BAD_PARAMETER;
-    }
-    for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
-        rc = ANY_OBJECT_Unmarshal(&s_objects[i], buffer, size, true);
+    if (hdr.version >= 5) {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = OBJECTS_Compact_Unmarshal(s_objects, ARRAY_SIZE(s_objects),
+                                           buffer, size);
+        }
+    } else {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = UINT16_Unmarshal(&array_size, buffer, size);
+        }
+        if (rc == TPM_RC_SUCCESS &&
+            array_size != ARRAY_SIZE(s_objects)) {
+            TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_objects; "
+                                "expected %zu, got %u\n",
+                                ARRAY_SIZE(s_objects), array_size);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
+            rc = ANY_OBJECT_Unmarshal(&s_objects[i], buffer, size, true);
+        }
     }
 #else
 # error Unsupport #define value(s)
@@ -3592,18 +4032,25 @@ skip_object:
                         "Volatile state", "s_pcrs");
     }
 #if defined PCR_C || defined GLOBAL_C
-    if (rc == TPM_RC_SUCCESS) {
-        rc = UINT16_Unmarshal(&array_size, buffer, size);
-    }
-    if (rc == TPM_RC_SUCCESS &&
-        array_size != ARRAY_SIZE(s_pcrs)) {
-        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_pcrs; "
-                            "expected %zu, got %u\n",
-                            ARRAY_SIZE(s_pcrs), array_size);
-        rc = TPM_RC_BAD_PARAMETER;
-    }
-    for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
-        rc = PCR_Unmarshal(&s_pcrs[i], buffer, size, &shadow.pcrAllocated);
+    if (hdr.version >= 5) {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = PCRS_Compact_Unmarshal(s_pcrs, ARRAY_SIZE(s_pcrs), buffer, size,
+                                        &shadow.pcrAllocated);
+        }
+    } else {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = UINT16_Unmarshal(&array_size, buffer, size);
+        }
+        if (rc == TPM_RC_SUCCESS &&
+            array_size != ARRAY_SIZE(s_pcrs)) {
+            TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_pcrs; "
+                                "expected %zu, got %u\n",
+                                ARRAY_SIZE(s_pcrs), array_size);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
+            rc = PCR_Unmarshal(&s_pcrs[i], buffer, size, &shadow.pcrAllocated);
+        }
     }
 #else
 # error Unsupport #define value(s)
@@ -3621,19 +4068,26 @@ skip_pcr:
                         "Volatile state", "s_sessions");
     }
 #if defined SESSION_C || defined GLOBAL_C
-    if (rc == TPM_RC_SUCCESS) {
-        rc = UINT16_Unmarshal(&array_size, buffer, size);
-    }
-    if (rc == TPM_RC_SUCCESS &&
-        array_size != ARRAY_SIZE(s_sessions)) {
-        TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_sessions; "
-                            "expected %zu, got %u\n",
-                            ARRAY_SIZE(s_sessions), array_size);
-        rc = TPM_RC_BAD_PARAMETER;
-    }
     /* s_sessions: */
-    for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
-        rc = SESSION_SLOT_Unmarshal(&s_sessions[i], buffer, size);
+    if (hdr.version >= 5) {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = SESSION_SLOTS_Compact_Unmarshal(s_sessions, ARRAY_SIZE(s_sessions),
+                                                 buffer, size);
+        }
+    } else {
+        if (rc == TPM_RC_SUCCESS) {
+            rc = UINT16_Unmarshal(&array_size, buffer, size);
+        }
+        if (rc == TPM_RC_SUCCESS &&
+            array_size != ARRAY_SIZE(s_sessions)) {
+            TPMLIB_LogTPM2Error("Volatile state: Bad array size for s_sessions; "
+                                "expected %zu, got %u\n",
+                                ARRAY_SIZE(s_sessions), array_size);
+            rc = TPM_RC_BAD_PARAMETER;
+        }
+        for (i = 0; i < array_size && rc == TPM_RC_SUCCESS; i++) {
+            rc = SESSION_SLOT_Unmarshal(&s_sessions[i], buffer, size);
+        }
     }
     /* s_oldestSavedSession: */
     if (rc == TPM_RC_SUCCESS) {
@@ -4789,6 +5243,41 @@ USER_NVRAM_Display(const char *msg)
     fprintf(stderr, "-----------------------------\n");
 }
 
+/*
+ * Determine the number of bytes USER_NVRAM_Marshal() writes for the entry
+ * at entryRef. The terminating entry with entrysize 0 also accounts for
+ * the maxCount and the trailing block_skip.
+ */
+static UINT32
+USER_NVRAM_EntryMarshalSize(NV_REF entryRef, UINT32 entrysize,
+                            struct RuntimeProfile *RuntimeProfile)
+{
+    UINT32 needed = sizeof(UINT32);
+    UINT64 offset = sizeof(UINT32);
+    TPM_HANDLE handle;
+    NV_INDEX nvi;
+    OBJECT obj;
+
+    if (entrysize == 0)
+        return needed + sizeof(UINT64) + sizeof(BYTE) + sizeof(UINT16);
+
+    NvRead(&handle, entryRef + offset, sizeof(handle));
+    needed += TPM_HANDLE_Marshal(&handle, NULL, NULL);
+
+    switch (HandleGetType(handle)) {
+    case TPM_HT_NV_INDEX:
+        NvReadNvIndexInfo(entryRef + offset, &nvi);
+        needed += NV_INDEX_Marshal(&nvi, NULL, NULL);
+        needed += sizeof(UINT32) + entrysize - sizeof(UINT32) - sizeof(nvi);
+        break;
+    case TPM_HT_PERSISTENT:
+        NvReadObject(entryRef + offset, &obj);
+        needed += ANY_OBJECT_Marshal(&obj, NULL, NULL, RuntimeProfile);
+        break;
+    }
+    return needed;
+}
+
 #define USER_NVRAM_VERSION 2
 #define USER_NVRAM_MAGIC   0x094f22c3
 static UINT32
@@ -4796,6 +5285,7 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
 {
     UINT32 written;
     UINT32 entrysize;
+    UINT32 needed = 0, entry_start;
     UINT64 offset;
     NV_REF entryRef = NV_USER_DYNAMIC;
     NV_INDEX nvi;
@@ -4809,6 +5299,9 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
     if (FALSE)
         USER_NVRAM_Display("before marshalling");
 
+    NV_STREAM_RESERVE(NV_HEADER_Marshal(NULL, NULL,
+                                        USER_NVRAM_VERSION, USER_NVRAM_MAGIC,
+                                        1) + sizeof(UINT64));
     written = NV_HEADER_Marshal(buffer, size,
                                 USER_NVRAM_VERSION, USER_NVRAM_MAGIC,
                                 1);
@@ -4820,6 +5313,11 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
         NvRead(&entrysize, entryRef, sizeof(entrysize));
         offset = sizeof(UINT32);
 
+        if (nv_stream.writer && buffer)
+            needed = USER_NVRAM_EntryMarshalSize(entryRef, entrysize,
+                                                 RuntimeProfile);
+        NV_STREAM_RESERVE(needed);
+        entry_start = written;
         /* entrysize is in native format now */
         written += UINT32_Marshal(&entrysize, buffer, size);
         if (entrysize == 0)
@@ -4855,6 +5353,7 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
         default:
             TPMLIB_LogTPM2Error("USER_NVRAM: Corrupted handle: %08x\n", handle);
         }
+        NV_STREAM_CHECK("USER_NVRAM", needed, written - entry_start);
         /* advance to next entry */
         entryRef += entrysize;
     }
@@ -4862,6 +5361,7 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
     written += UINT64_Marshal(&maxCount, buffer, size);
 
     written += BLOCK_SKIP_WRITE_PUSH(TRUE, buffer, size);
+    NV_STREAM_CHECK("USER_NVRAM", needed, written - entry_start);
     /* future versions append below this line */
 
     BLOCK_SKIP_WRITE_POP(size);
@@ -4871,6 +5371,17 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
     return written;
 }
 
+/*
+ * Write into NVRAM unless a state blob is only being validated.
+ */
+static void
+NvWriteUnlessValidating(BOOL validateOnly, UINT32 nvOffset, UINT32 size,
+                        void *inBuffer)
+{
+    if (!validateOnly)
+        NvWrite(nvOffset, size, inBuffer);
+}
+
 /*
  * USER_NVRAM_Unmarshal:
  *
@@ -4881,7 +5392,7 @@ USER_NVRAM_Marshal(BYTE **buffer, INT32 *size, struct RuntimeProfile *RuntimePro
  * or if an unknown handle type was encountered.
  */
 static TPM_RC
-USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
+USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size, BOOL validateOnly)
 {
     TPM_RC rc = TPM_RC_SUCCESS;
     NV_HEADER hdr;
@@ -4921,7 +5432,8 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
             /* the entrysize also depends on the sizeof(nvi); we may have to
                update it if sizeof(nvi) changed between versions */
             entrysize_offset = o;
-            NvWrite(entryRef + o, sizeof(entrysize), &entrysize);
+            NvWriteUnlessValidating(validateOnly, entryRef + o,
+                                    sizeof(entrysize), &entrysize);
             offset = sizeof(UINT32);
             if (entrysize == 0)
                 break;
@@ -4942,7 +5454,8 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
                 if (rc == TPM_RC_SUCCESS) {
                     rc = NV_INDEX_Unmarshal(&nvi, buffer, size);
                     if (rc == TPM_RC_SUCCESS) {
-                        NvWrite(entryRef + o + offset, sizeof(nvi), &nvi);
+                        NvWriteUnlessValidating(validateOnly, entryRef + o + offset,
+                                                sizeof(nvi), &nvi);
                         offset += sizeof(nvi);
                     }
                 }
@@ -4967,7 +5480,8 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
                 if (rc == TPM_RC_SUCCESS && datasize > 0) {
                     BYTE buf[MAX_NV_INDEX_SIZE];
                     rc = Array_Unmarshal(buf, datasize, buffer, size);
-                    NvWrite(entryRef + o + offset, datasize, buf);
+                    NvWriteUnlessValidating(validateOnly, entryRef + o + offset,
+                                            datasize, buf);
                     offset += datasize;
 
                     /* update the entry size; account for expanding nvi */
@@ -4984,11 +5498,14 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
                     BYTE objBuffer[MAX_MARSHALLED_OBJECT_SIZE];
                     UINT32 marshalledObjectSize;
 
-                    NvWrite(entryRef + o + offset, sizeof(handle), &handle);
+                    NvWriteUnlessValidating(validateOnly, entryRef + o + offset,
+                                            sizeof(handle), &handle);
                     offset += sizeof(TPM_HANDLE);
 
                     memset(&obj, 0, sizeof(obj));
                     rc = ANY_OBJECT_Unmarshal(&obj, buffer, size, true);
+                    if (validateOnly && rc != TPM_RC_SUCCESS)
+                        break;
                     pAssert(rc == TPM_RC_SUCCESS);
                     // convert the OBJECT into a buffer to copy into NVRAM
                     marshalledObjectSize = NvObjectToBuffer(&obj, objBuffer, sizeof(objBuffer));
@@ -4997,7 +5514,8 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
                         o += offset + marshalledObjectSize;
                         goto exit_size;
                     }
-                    NvWrite(entryRef + o + offset, marshalledObjectSize, objBuffer);
+                    NvWriteUnlessValidating(validateOnly, entryRef + o + offset,
+                                            marshalledObjectSize, objBuffer);
                     offset += marshalledObjectSize;
 
                     entrysize = sizeof(UINT32) + sizeof(TPM_HANDLE) + marshalledObjectSize;
@@ -5011,7 +5529,8 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
             }
 
             if (rc == TPM_RC_SUCCESS) {
-                NvWrite(entryRef + entrysize_offset, sizeof(entrysize), &entrysize);
+                NvWriteUnlessValidating(validateOnly, entryRef + entrysize_offset,
+                                        sizeof(entrysize), &entrysize);
             }
         }
         if (rc == TPM_RC_SUCCESS) {
@@ -5025,7 +5544,8 @@ USER_NVRAM_Unmarshal(BYTE **buffer, INT32 *size)
     }
     if (rc == TPM_RC_SUCCESS) {
         rc = UINT64_Unmarshal(&maxCount, buffer, size);
-        NvWrite(entryRef + o + offset, sizeof(maxCount), &maxCount);
+        NvWriteUnlessValidating(validateOnly, entryRef + o + offset,
+                                sizeof(maxCount), &maxCount);
     }
 
     /* version 2 starts having indicator for next versions that we can skip;
@@ -5113,21 +5633,32 @@ PERSISTENT_ALL_Marshal(BYTE **buffer, INT32 *size)
     if (blob_version >= 4) {
         profileJSON = RuntimeProfileGetJSON(RuntimeProfile);
         assert(profileJSON);
+        NV_STREAM_RESERVE(String_Marshal(profileJSON, NULL, NULL));
         written += String_Marshal(profileJSON, buffer, size); // since v4
     }
+    NV_STREAM_RESERVE(PACompileConstants_Marshal(NULL, NULL));
     written += PACompileConstants_Marshal(buffer, size);
+    NV_STREAM_RESERVE(PERSISTENT_DATA_Marshal(&pd, NULL, NULL, RuntimeProfile));
     written += PERSISTENT_DATA_Marshal(&pd, buffer, size, RuntimeProfile);
+    NV_STREAM_RESERVE(ORDERLY_DATA_Marshal(&od, NULL, NULL));
     written += ORDERLY_DATA_Marshal(&od, buffer, size);
     writeSuState = (pd.orderlyState & TPM_SU_STATE_MASK) == TPM_SU_STATE;
     /* starting with v3 we only write STATE_RESET and STATE_CLEAR if needed */
     if (writeSuState) {
+        NV_STREAM_RESERVE(STATE_RESET_DATA_Marshal(&srd, NULL, NULL));
         written += STATE_RESET_DATA_Marshal(&srd, buffer, size);
+        NV_STREAM_RESERVE(STATE_CLEAR_DATA_Marshal(&scd, NULL, NULL));
         written += STATE_CLEAR_DATA_Marshal(&scd, buffer, size);
     }
+    NV_STREAM_RESERVE(INDEX_ORDERLY_RAM_Marshal(indexOrderlyRam,
+                                                sizeof(indexOrderlyRam),
+                                                NULL, NULL));
     written += INDEX_ORDERLY_RAM_Marshal(indexOrderlyRam, sizeof(indexOrderlyRam),
                                          buffer, size);
     written += USER_NVRAM_Marshal(buffer, size, RuntimeProfile);
 
+    /* block_skip and magic */
+    NV_STREAM_RESERVE(sizeof(BYTE) + sizeof(UINT16) + sizeof(UINT32));
     written += BLOCK_SKIP_WRITE_PUSH(TRUE, buffer, size);
     /* future versions append below this line */
 
@@ -5141,8 +5672,37 @@ PERSISTENT_ALL_Marshal(BYTE **buffer, INT32 *size)
     return written;
 }
 
+/*
+ * Marshal the PERSISTENT_ALL blob in chunks of at most bufsize bytes that
+ * are passed to the writer function. The given buffer is used for
+ * assembling the chunks.
+ */
 TPM_RC
-PERSISTENT_ALL_Unmarshal(BYTE **buffer, INT32 *size)
+PERSISTENT_ALL_MarshalStream(NV_STREAM_WRITER writer, void *opaque,
+                             BYTE *buffer, INT32 bufsize)
+{
+    BYTE *buf = buffer;
+    INT32 size = bufsize;
+    TPM_RC rc;
+
+    nv_stream.writer = writer;
+    nv_stream.opaque = opaque;
+    nv_stream.start = buffer;
+    nv_stream.bufsize = bufsize;
+    nv_stream.rc = TPM_RC_SUCCESS;
+
+    PERSISTENT_ALL_Marshal(&buf, &size);
+    if (nv_stream.rc == TPM_RC_SUCCESS && buf > buffer)
+        nv_stream.rc = writer(opaque, buffer, buf - buffer);
+
+    rc = nv_stream.rc;
+    memset(&nv_stream, 0, sizeof(nv_stream));
+
+    return rc;
+}
+
+static TPM_RC
+PERSISTENT_ALL_UnmarshalCommon(BYTE **buffer, INT32 *size, BOOL validateOnly)
 {
     TPM_RC rc = TPM_RC_SUCCESS;
     NV_HEADER hdr;
@@ -5206,7 +5766,7 @@ PERSISTENT_ALL_Unmarshal(BYTE **buffer, INT32 *size)
     }
     if (rc == TPM_RC_SUCCESS) {
         /* this will write it into NVRAM right away */
-        rc = USER_NVRAM_Unmarshal(buffer, size);
+        rc = USER_NVRAM_Unmarshal(buffer, size, validateOnly);
         /* if rc == TPM_RC_SUCCESS, we know that there is enough
            NVRAM to fit everything. */
     }
@@ -5226,7 +5786,7 @@ skip_future_versions:
                                "PERSISTENT_ALL_MAGIC after USER_NVRAM");
     }
 
-    if (rc == TPM_RC_SUCCESS) {
+    if (rc == TPM_RC_SUCCESS && !validateOnly) {
         NvWrite(NV_PERSISTENT_DATA, sizeof(pd), &pd);
         NvWrite(NV_ORDERLY_DATA, sizeof(od), &od);
         NvWrite(NV_STATE_RESET_DATA, sizeof(srd), &srd);
@@ -5241,6 +5801,40 @@ skip_future_versions:
     return rc;
 }
 
+TPM_RC
+PERSISTENT_ALL_Unmarshal(BYTE **buffer, INT32 *size)
+{
+    return PERSISTENT_ALL_UnmarshalCommon(buffer, size, FALSE);
+}
+
+/*
+ * Validate a PERSISTENT_ALL blob by unmarshalling all of its structures
+ * without writing them into NVRAM. The runtime profile the blob requires
+ * is set up in a scratch profile that replaces the active one for the
+ * time of the validation. The PCR allocation shadow and the context slot
+ * mask that the unmarshalling functions set are restored afterwards so
+ * that NVShadowRestore() does not pick up the blob's PCR allocation.
+ */
+TPM_RC
+PERSISTENT_ALL_Validate(BYTE **buffer, INT32 *size)
+{
+    struct RuntimeProfile activeProfile = g_RuntimeProfile;
+    struct shadow activeShadow = shadow;
+    CONTEXT_SLOT activeContextSlotMask = s_ContextSlotMask;
+    TPM_RC rc;
+
+    RuntimeProfileInit(&g_RuntimeProfile);
+
+    rc = PERSISTENT_ALL_UnmarshalCommon(buffer, size, TRUE);
+
+    RuntimeProfileFree(&g_RuntimeProfile);
+    g_RuntimeProfile = activeProfile;
+    shadow = activeShadow;
+    s_ContextSlotMask = activeContextSlotMask;
+
+    return rc;
+}
+
 void
 NVShadowRestore(void)
 {
@@ -23,7 +23,12 @@ UINT16 VolatileState_Marshal(BYTE **buffer, INT32 *size,
 TPM_RC VolatileState_Unmarshal(BYTE **buffer, INT32 *size);
 
 UINT32 PERSISTENT_ALL_Marshal(BYTE **buffer, INT32 *size);
+typedef TPM_RC (*NV_STREAM_WRITER)(void *opaque, const BYTE *data,
+                                   UINT32 length);
+TPM_RC PERSISTENT_ALL_MarshalStream(NV_STREAM_WRITER writer, void *opaque,
+                                    BYTE *buffer, INT32 bufsize);
 TPM_RC PERSISTENT_ALL_Unmarshal(BYTE **buffer, INT32 *size);
+TPM_RC PERSISTENT_ALL_Validate(BYTE **buffer, INT32 *size);
 
 void NVShadowRestore(void);
 
@@ -215,6 +215,8 @@ RuntimeAlgorithmInit(struct RuntimeAlgorithm *RuntimeAlgorithm)
     TPM_ALG_ID algId;
     size_t i;
 
+    RuntimeAlgorithm->lookupTablesValid = FALSE;
+
     MemorySet(RuntimeAlgorithm->algosMinimumKeySizes, 0 , sizeof(RuntimeAlgorithm->algosMinimumKeySizes));
 
     for (i = 0; i < ARRAY_SIZE(algsWithKeySizes); i++) {
@@ -329,6 +331,8 @@ RuntimeAlgorithmSetProfile(struct RuntimeAlgorithm  *RuntimeAlgorithm,
 	return TPM_RC_SUCCESS;
     }
 
+    RuntimeAlgorithm->lookupTablesValid = FALSE;
+
     MemorySet(RuntimeAlgorithm->enabledAlgorithms, 0, sizeof(RuntimeAlgorithm->enabledAlgorithms));
     MemorySet(RuntimeAlgorithm->enabledEccCurves, 0 , sizeof(RuntimeAlgorithm->enabledEccCurves));
     MemorySet(RuntimeAlgorithm->enabledEccShortcuts, 0, sizeof(RuntimeAlgorithm->enabledEccShortcuts));
@@ -578,6 +582,89 @@ static BOOL _RuntimeAlgorithmKeySizeCheckEnabled(
     return TRUE;
 }
 
+/* Build the lookup tables for the key size checks by evaluating the checks
+ * for all key sizes that are multiples of RUNTIME_ALGORITHM_KEYSIZE_UNIT,
+ * which covers all key sizes of the algorithms with key sizes other than ECC,
+ * and for all ECC curves with the key size of the curve.
+ */
+static void
+RuntimeAlgorithmBuildLookupTables(
+    struct RuntimeAlgorithm *RuntimeAlgorithm,
+    unsigned int             maxStateFormatLevel	// IN: maximum stateFormatLevel
+)
+{
+    TPM_ECC_CURVE curveId;
+    TPM_ALG_ID algId;
+    unsigned int n;
+
+    MemorySet(RuntimeAlgorithm->usableKeySizes, 0, sizeof(RuntimeAlgorithm->usableKeySizes));
+
+    for (algId = 0; algId < ARRAY_SIZE(s_AlgorithmProperties); algId++) {
+	if (!s_AlgorithmProperties[algId].name ||
+	    !s_AlgorithmProperties[algId].u.keySizes)
+	    continue;
+	for (n = 0; n < 64; n++) {
+	    if (_RuntimeAlgorithmKeySizeCheckEnabled(RuntimeAlgorithm, algId,
+						     (n + 1) * RUNTIME_ALGORITHM_KEYSIZE_UNIT,
+						     maxStateFormatLevel,
+						     TPM_ECC_NONE))
+		RuntimeAlgorithm->usableKeySizes[algId] |= (UINT64)1 << n;
+	}
+    }
+
+    MemorySet(RuntimeAlgorithm->usableEccCurves, 0, sizeof(RuntimeAlgorithm->usableEccCurves));
+
+    for (curveId = 0; curveId < ARRAY_SIZE(s_EccAlgorithmProperties); curveId++) {
+	if (!s_EccAlgorithmProperties[curveId].name)
+	    continue;
+	if (_RuntimeAlgorithmKeySizeCheckEnabled(RuntimeAlgorithm, TPM_ALG_ECC,
+						 s_EccAlgorithmProperties[curveId].keySize,
+						 maxStateFormatLevel,
+						 curveId))
+	    SET_BIT(curveId, RuntimeAlgorithm->usableEccCurves);
+    }
+
+    RuntimeAlgorithm->lookupStateFormatLevel = maxStateFormatLevel;
+    RuntimeAlgorithm->lookupTablesValid = TRUE;
+}
+
+/* Check whether the given key size is enabled using the lookup tables and
+ * fall back to _RuntimeAlgorithmKeySizeCheckEnabled for key sizes that are
+ * not covered by them.
+ */
+static BOOL
+RuntimeAlgorithmLookupKeySize(
+    struct RuntimeAlgorithm *RuntimeAlgorithm,
+    TPM_ALG_ID               algId,			// IN: the algorithm to check
+    UINT16                   keySizeInBits,		// IN: size of the key in bits
+    unsigned int             maxStateFormatLevel,	// IN: maximum stateFormatLevel
+    TPM_ECC_CURVE            curveId			// IN: curve Id for TPM_ALG_ECC
+)
+{
+    unsigned int n;
+
+    if (!RuntimeAlgorithm->lookupTablesValid ||
+	RuntimeAlgorithm->lookupStateFormatLevel != maxStateFormatLevel)
+	RuntimeAlgorithmBuildLookupTables(RuntimeAlgorithm, maxStateFormatLevel);
+
+    if (algId == TPM_ALG_ECC && curveId != TPM_ECC_NONE &&
+	curveId < ARRAY_SIZE(s_EccAlgorithmProperties) &&
+	keySizeInBits == s_EccAlgorithmProperties[curveId].keySize)
+	return TEST_BIT(curveId, RuntimeAlgorithm->usableEccCurves);
+
+    n = keySizeInBits / RUNTIME_ALGORITHM_KEYSIZE_UNIT;
+    if (algId < ARRAY_SIZE(s_AlgorithmProperties) &&
+	s_AlgorithmProperties[algId].u.keySizes &&
+	keySizeInBits % RUNTIME_ALGORITHM_KEYSIZE_UNIT == 0 &&
+	n >= 1 && n <= 64)
+	return (RuntimeAlgorithm->usableKeySizes[algId] >> (n - 1)) & 1;
+
+    return _RuntimeAlgorithmKeySizeCheckEnabled(RuntimeAlgorithm, algId,
+						keySizeInBits,
+						maxStateFormatLevel,
+						curveId);
+}
+
 LIB_EXPORT BOOL
 RuntimeAlgorithmKeySizeCheckEnabled(
     struct RuntimeAlgorithm *RuntimeAlgorithm,
@@ -586,7 +673,7 @@ RuntimeAlgorithmKeySizeCheckEnabled(
     unsigned int             maxStateFormatLevel	// IN: maximum stateFormatLevel
    )
 {
-    return _RuntimeAlgorithmKeySizeCheckEnabled(
+    return RuntimeAlgorithmLookupKeySize(
         RuntimeAlgorithm,
         algId,
         keySizeInBits,
@@ -604,7 +691,7 @@ RuntimeAlgorithmEccKeySizeCheckEnabled(
     unsigned int             maxStateFormatLevel	// IN: maximum stateFormatLevel
    )
 {
-    return _RuntimeAlgorithmKeySizeCheckEnabled(
+    return RuntimeAlgorithmLookupKeySize(
         RuntimeAlgorithm,
         algId,
         keySizeInBits,
@@ -17,6 +17,14 @@ struct RuntimeAlgorithm {
 #define RUNTIME_ALGORITHM_ECC_BN_BIT        1
     unsigned char enabledEccCurves[(NUM_ENTRIES_ECC_ALGO_PROPERTIES + 7) / 8];
     char *algorithmProfile;
+    /* lookup tables for the key size checks derived from the above for the
+     * lookupStateFormatLevel; they are built on first use after a change */
+    BOOL lookupTablesValid;
+    unsigned int lookupStateFormatLevel;
+    /* bit n set if key size (n + 1) * 64 is usable; algorithms with key sizes only */
+    UINT64 usableKeySizes[NUM_ENTRIES_ALGORITHM_PROPERTIES];
+#define RUNTIME_ALGORITHM_KEYSIZE_UNIT      64
+    unsigned char usableEccCurves[(NUM_ENTRIES_ECC_ALGO_PROPERTIES + 7) / 8];
 };
 
 void
@@ -398,14 +398,14 @@ RuntimeCommandsCheckEnabledByIdx(struct RuntimeCommands *RuntimeCommands,
 			         )
 {
     if (commandIndex >= ARRAY_SIZE(s_CommandProperties)) {
-        TPMLIB_LogPrintf("IsEnabled(0x%x): out-of-range command code\n",
-                         IdxToCc(commandIndex));
+        TPMLIB_LogDebug("IsEnabled(0x%x): out-of-range command code\n",
+                        IdxToCc(commandIndex));
         return FALSE;
     }
-    TPMLIB_LogPrintf("IsEnEnabled(0x%x = '%s'): %d\n",
-		     IdxToCc(commandIndex),
-		     s_CommandProperties[commandIndex].name,
-		     TEST_BIT(commandIndex, RuntimeCommands->enabledCommandsByIdx));
+    TPMLIB_LogDebug("IsEnEnabled(0x%x = '%s'): %d\n",
+		    IdxToCc(commandIndex),
+		    s_CommandProperties[commandIndex].name,
+		    TEST_BIT(commandIndex, RuntimeCommands->enabledCommandsByIdx));
     if (!TEST_BIT(commandIndex, RuntimeCommands->enabledCommandsByIdx))
 	return FALSE;
     return TRUE;
@@ -41,7 +41,7 @@ static const struct RuntimeProfileDesc {
      * This basically locks the name of the profile to the stateFormatLevel.
      */
     unsigned int stateFormatLevel;
-#define STATE_FORMAT_LEVEL_CURRENT 8
+#define STATE_FORMAT_LEVEL_CURRENT 9
 #define STATE_FORMAT_LEVEL_UNKNOWN 0 /* JSON didn't provide StateFormatLevel; this is only
 					allowed for the 'default' profile or when user
 					passed JSON via SetProfile() */
@@ -69,6 +69,8 @@ static const struct RuntimeProfileDesc {
  *      - pct
  *      - no-ecc-key-derivation
  *  8 : Enabled 4096-bit RSA support
+ *  9 : Volatile state uses a compact encoding for object slots, session slots,
+ *      PCRs and s_indexOrderlyRam
  */
     const char *description;
 #define DESCRIPTION_MAX_SIZE        250
@@ -670,6 +672,170 @@ RuntimeProfileFindByName(const char	*profileName,
     return NULL;
 }
 
+/*
+ * A cache of compiled profiles. The same profile is set every time the TPM 2
+ * state is loaded, so the compiled profile, i.e., the bitmaps of enabled
+ * algorithms, commands, and attributes, the minimum key sizes, and the
+ * StateFormatLevel, is kept in this cache keyed by the JSON profile and
+ * whether it was provided by the user. The cache survives TPMLIB_Terminate()
+ * so that subsequent initializations with the same profile can use it.
+ */
+#define RUNTIME_PROFILE_CACHE_SIZE  4
+
+static struct RuntimeProfileCacheEntry {
+    bool                  inUse;
+    bool                  jsonProfileIsFromUser;
+    UINT32                hash;          /* hash of jsonProfile */
+    char                  *jsonProfile;  /* may be NULL */
+    unsigned int          lastUsed;
+    struct RuntimeProfile RuntimeProfile;
+} s_RuntimeProfileCache[RUNTIME_PROFILE_CACHE_SIZE];
+static unsigned int s_RuntimeProfileCacheClock;
+
+static UINT32
+RuntimeProfileCacheHash(const char *jsonProfile)
+{
+    UINT32 hash = 2166136261u; /* FNV-1a */
+
+    if (jsonProfile) {
+	for (; *jsonProfile; jsonProfile++)
+	    hash = (hash ^ (unsigned char)*jsonProfile) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Copy the src RuntimeProfile to the dst RuntimeProfile. The dst
+ * RuntimeProfile is only modified if all strings could be duplicated.
+ */
+static TPM_RC
+RuntimeProfileCopy(struct RuntimeProfile       *dst,
+		   const struct RuntimeProfile *src)
+{
+    char *strings[6] = { NULL, };
+    const char *srcStrings[6] = {
+	src->RuntimeAlgorithm.algorithmProfile,
+	src->RuntimeCommands.commandsProfile,
+	src->RuntimeAttributes.attributesProfile,
+	src->profileName,
+	src->runtimeProfileJSON,
+	src->profileDescription,
+    };
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(srcStrings); i++) {
+	if (srcStrings[i] && !(strings[i] = strdup(srcStrings[i]))) {
+	    while (i > 0)
+		free(strings[--i]);
+	    return TPM_RC_MEMORY;
+	}
+    }
+
+    RuntimeProfileFree(dst);
+    *dst = *src;
+
+    dst->RuntimeAlgorithm.algorithmProfile = strings[0];
+    dst->RuntimeCommands.commandsProfile = strings[1];
+    dst->RuntimeAttributes.attributesProfile = strings[2];
+    dst->profileName = strings[3];
+    dst->runtimeProfileJSON = strings[4];
+    dst->profileDescription = strings[5];
+
+    return TPM_RC_SUCCESS;
+}
+
+static struct RuntimeProfileCacheEntry *
+RuntimeProfileCacheFind(const char *jsonProfile,
+			bool        jsonProfileIsFromUser,
+			UINT32      hash)
+{
+    struct RuntimeProfileCacheEntry *rpce;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(s_RuntimeProfileCache); i++) {
+	rpce = &s_RuntimeProfileCache[i];
+	if (!rpce->inUse ||
+	    rpce->hash != hash ||
+	    rpce->jsonProfileIsFromUser != jsonProfileIsFromUser)
+	    continue;
+	if (!rpce->jsonProfile || !jsonProfile) {
+	    if (rpce->jsonProfile != jsonProfile)
+		continue;
+	} else if (strcmp(rpce->jsonProfile, jsonProfile)) {
+	    continue;
+	}
+	rpce->lastUsed = ++s_RuntimeProfileCacheClock;
+	return rpce;
+    }
+    return NULL;
+}
+
+/*
+ * Add a compiled RuntimeProfile to the cache, replacing the least recently
+ * used entry if the cache is full. Failure to add it is not an error.
+ */
+static void
+RuntimeProfileCacheAdd(const char                  *jsonProfile,
+		       bool                        jsonProfileIsFromUser,
+		       UINT32                      hash,
+		       const struct RuntimeProfile *RuntimeProfile)
+{
+    struct RuntimeProfileCacheEntry *rpce = &s_RuntimeProfileCache[0];
+    char *jsonProfileCopy = NULL;
+    size_t i;
+
+    for (i = 1; i < ARRAY_SIZE(s_RuntimeProfileCache) && rpce->inUse; i++) {
+	if (!s_RuntimeProfileCache[i].inUse ||
+	    s_RuntimeProfileCache[i].lastUsed < rpce->lastUsed)
+	    rpce = &s_RuntimeProfileCache[i];
+    }
+
+    if (jsonProfile && !(jsonProfileCopy = strdup(jsonProfile)))
+	return;
+
+    if (!rpce->inUse)
+	RuntimeProfileInit(&rpce->RuntimeProfile);
+    if (RuntimeProfileCopy(&rpce->RuntimeProfile, RuntimeProfile) != TPM_RC_SUCCESS) {
+	free(jsonProfileCopy);
+	return;
+    }
+
+    free(rpce->jsonProfile);
+    rpce->jsonProfile = jsonProfileCopy;
+    rpce->jsonProfileIsFromUser = jsonProfileIsFromUser;
+    rpce->hash = hash;
+    rpce->lastUsed = ++s_RuntimeProfileCacheClock;
+    rpce->inUse = true;
+}
+
+/*
+ * Get the number of bytes allocated by the cache of compiled profiles.
+ */
+size_t
+RuntimeProfileCacheGetMemoryUsage(void)
+{
+    const struct RuntimeProfileCacheEntry *rpce;
+    size_t size = sizeof(s_RuntimeProfileCache);
+    size_t i;
+
+#define STRING_SIZE(STR) ((STR) ? strlen(STR) + 1 : 0)
+    for (i = 0; i < ARRAY_SIZE(s_RuntimeProfileCache); i++) {
+	rpce = &s_RuntimeProfileCache[i];
+	if (!rpce->inUse)
+	    continue;
+	size += STRING_SIZE(rpce->jsonProfile) +
+		STRING_SIZE(rpce->RuntimeProfile.RuntimeAlgorithm.algorithmProfile) +
+		STRING_SIZE(rpce->RuntimeProfile.RuntimeCommands.commandsProfile) +
+		STRING_SIZE(rpce->RuntimeProfile.RuntimeAttributes.attributesProfile) +
+		STRING_SIZE(rpce->RuntimeProfile.profileName) +
+		STRING_SIZE(rpce->RuntimeProfile.runtimeProfileJSON) +
+		STRING_SIZE(rpce->RuntimeProfile.profileDescription);
+    }
+#undef STRING_SIZE
+
+    return size;
+}
+
 /*
  * Set the given RuntimeProfile to the profile in JSON format. The profile may
  * be set by the user and in this case the jsonProfileIsFromUser is set to
@@ -700,8 +866,20 @@ RuntimeProfileSet(struct RuntimeProfile *RuntimeProfile,
     char *attributesProfile = NULL;
     char *commandsProfile = NULL;
     char *profileName = NULL;
+    struct RuntimeProfileCacheEntry *rpce;
+    UINT32 hash;
     TPM_RC retVal;
 
+    hash = RuntimeProfileCacheHash(jsonProfile);
+    rpce = RuntimeProfileCacheFind(jsonProfile, jsonProfileIsFromUser, hash);
+    if (rpce) {
+	retVal = RuntimeProfileCopy(RuntimeProfile, &rpce->RuntimeProfile);
+	if (retVal == TPM_RC_SUCCESS)
+	    TPMLIB_LogDebug("%s @ %u: cached runtimeProfile: %s\n", __func__, __LINE__,
+			    RuntimeProfile->runtimeProfileJSON);
+	return retVal;
+    }
+
     retVal = GetParametersFromJSON(jsonProfile, jsonProfileIsFromUser,
 				   &profileName, &stateFormatLevelJSON,
 				   &algorithmsProfile, &commandsProfile,
@@ -786,7 +964,7 @@ RuntimeProfileSet(struct RuntimeProfile *RuntimeProfile,
     if (retVal != TPM_RC_SUCCESS)
 	goto error;
 
-    TPMLIB_LogPrintf("%s @ %u: runtimeProfile: %s\n", __func__, __LINE__, runtimeProfileJSON);
+    TPMLIB_LogDebug("%s @ %u: runtimeProfile: %s\n", __func__, __LINE__, runtimeProfileJSON);
 
     free(RuntimeProfile->runtimeProfileJSON);
     RuntimeProfile->runtimeProfileJSON = runtimeProfileJSON;
@@ -814,6 +992,8 @@ RuntimeProfileSet(struct RuntimeProfile *RuntimeProfile,
     if (jsonProfileIsFromUser && !strcmp("null", profileName))
 	RuntimeProfile->wasNullProfile = true;
 
+    RuntimeProfileCacheAdd(jsonProfile, jsonProfileIsFromUser, hash, RuntimeProfile);
+
     return TPM_RC_SUCCESS;
 
 error:
@@ -963,8 +1143,9 @@ RuntimeProfileGetSeedCompatLevel(void)
     case 1: /* profile runs on v0.9 */
 	return SEED_COMPAT_LEVEL_RSA_PRIME_ADJUST_FIX;
 
-    case 2 ... 8: /* profile runs on v0.10 */ {
-	MUST_BE(STATE_FORMAT_LEVEL_CURRENT == 8); // force update when this changes
+    case 2 ... 7: /* profile runs on v0.10 */
+    case 8 ... 9: /* profile runs on v0.11 */ {
+	MUST_BE(STATE_FORMAT_LEVEL_CURRENT == 9); // force update when this changes
 	return SEED_COMPAT_LEVEL_LAST;
     }
 
@@ -55,6 +55,9 @@ RuntimeProfileGetByIndex(size_t  idx,
 
 SEED_COMPAT_LEVEL RuntimeProfileGetSeedCompatLevel(void);
 
+size_t
+RuntimeProfileCacheGetMemoryUsage(void);
+
 BOOL
 RuntimeProfileRequiresAttributeFlags(struct RuntimeProfile *RuntimeProfile,
                                      unsigned int           attributeFlags);
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+/*
+ * An in-memory snapshot of the state of a running TPM 2 that can be
+ * restored with memcpy() rather than by re-initializing the TPM from its
+ * marshalled state. The snapshot holds the variables from Global.h, the
+ * platform's clock, locality, cancel flag and ACTs from PlatformData.h and
+ * the NV memory image. Pointers in these variables only point into the same
+ * variables, so the copies remain valid as long as the TPM is running.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SESSION_PROCESS_C
+#define DA_C
+#define NV_C
+#define OBJECT_C
+#define PCR_C
+#define SESSION_C
+#define IO_BUFFER_C
+#include "Tpm.h"
+#include "Platform.h"
+#include "Snapshot.h"
+#include "PlatformInternal.h"
+#include "tpm_memusage.h"
+
+#define SNAPSHOT_VAR(VAR) { &(VAR), sizeof(VAR) }
+#define SNAPSHOT_ACT(N) SNAPSHOT_VAR(ACT_##N),
+
+static const struct {
+    void   *var;
+    size_t  size;
+} snapshotVars[] = {
+    SNAPSHOT_VAR(g_implementedAlgorithms),
+    SNAPSHOT_VAR(g_toTest),
+    SNAPSHOT_VAR(g_exclusiveAuditSession),
+    SNAPSHOT_VAR(g_time),
+#if CLOCK_STOPS
+    SNAPSHOT_VAR(g_timeEpoch),
+#endif
+    SNAPSHOT_VAR(g_phEnable),
+    SNAPSHOT_VAR(g_pcrReConfig),
+    SNAPSHOT_VAR(g_DRTMHandle),
+    SNAPSHOT_VAR(g_DrtmPreStartup),
+    SNAPSHOT_VAR(g_StartupLocality3),
+#if USE_DA_USED
+    SNAPSHOT_VAR(g_daUsed),
+#endif
+    SNAPSHOT_VAR(g_updateNV),
+    SNAPSHOT_VAR(g_powerWasLost),
+    SNAPSHOT_VAR(g_clearOrderly),
+    SNAPSHOT_VAR(g_prevOrderlyState),
+    SNAPSHOT_VAR(g_nvOk),
+    SNAPSHOT_VAR(g_NvStatus),
+#if VENDOR_PERMANENT_AUTH_ENABLED == YES
+    SNAPSHOT_VAR(g_platformUniqueAuth),
+#endif
+    SNAPSHOT_VAR(gp),
+    SNAPSHOT_VAR(go),		/* includes the state of the DRBG */
+    SNAPSHOT_VAR(gc),
+    SNAPSHOT_VAR(gr),
+    SNAPSHOT_VAR(s_ContextSlotMask),
+    SNAPSHOT_VAR(g_cryptoSelfTestState),
+    SNAPSHOT_VAR(g_initialized),
+    SNAPSHOT_VAR(s_sessionHandles),
+    SNAPSHOT_VAR(s_attributes),
+    SNAPSHOT_VAR(s_associatedHandles),
+    SNAPSHOT_VAR(s_nonceCaller),
+    SNAPSHOT_VAR(s_inputAuthValues),
+    SNAPSHOT_VAR(s_usedSessions),
+    SNAPSHOT_VAR(s_encryptSessionIndex),
+    SNAPSHOT_VAR(s_decryptSessionIndex),
+    SNAPSHOT_VAR(s_auditSessionIndex),
+#if CC_GetCommandAuditDigest
+    SNAPSHOT_VAR(s_cpHashForCommandAudit),
+#endif
+    SNAPSHOT_VAR(s_DAPendingOnNV),
+#if !ACCUMULATE_SELF_HEAL_TIMER
+    SNAPSHOT_VAR(s_selfHealTimer),
+    SNAPSHOT_VAR(s_lockoutTimer),
+#endif
+    SNAPSHOT_VAR(s_evictNvEnd),
+    SNAPSHOT_VAR(s_indexOrderlyRam),
+    SNAPSHOT_VAR(s_maxCounter),
+    SNAPSHOT_VAR(s_cachedNvIndex),
+    SNAPSHOT_VAR(s_cachedNvRef),
+    SNAPSHOT_VAR(s_cachedNvRamRef),
+    SNAPSHOT_VAR(s_objects),
+    SNAPSHOT_VAR(s_pcrs),
+    SNAPSHOT_VAR(s_sessions),
+    SNAPSHOT_VAR(s_oldestSavedSession),
+    SNAPSHOT_VAR(s_freeSessionSlots),
+    SNAPSHOT_VAR(s_actionIoBuffer),
+    SNAPSHOT_VAR(s_actionIoAllocation),
+    SNAPSHOT_VAR(s_ActUpdated),
+    SNAPSHOT_VAR(g_initCompleted),
+    /* PlatformData.h */
+    SNAPSHOT_VAR(s_isCanceled),
+#ifndef HARDWARE_CLOCK
+    SNAPSHOT_VAR(s_realTimePrevious),
+    SNAPSHOT_VAR(s_lastSystemTime),
+    SNAPSHOT_VAR(s_lastReportedTime),
+    SNAPSHOT_VAR(s_tpmTime),
+    SNAPSHOT_VAR(s_hostMonotonicAdjustTime),
+    SNAPSHOT_VAR(s_suspendedElapsedTime),
+#endif
+    SNAPSHOT_VAR(s_timerReset),
+    SNAPSHOT_VAR(s_timerStopped),
+    SNAPSHOT_VAR(s_initClock),
+    SNAPSHOT_VAR(s_adjustRate),
+    SNAPSHOT_VAR(s_locality),
+    SNAPSHOT_VAR(s_NV_unrecoverable),
+    SNAPSHOT_VAR(s_NV_recoverable),
+    SNAPSHOT_VAR(s_physicalPresence),
+    SNAPSHOT_VAR(s_powerLost),
+    FOR_EACH_ACT(SNAPSHOT_ACT)
+    SNAPSHOT_VAR(actTicksAllowed),
+};
+
+/* the NV memory image followed by the variables in snapshotVars */
+static BYTE *snapshot;
+
+static size_t SnapshotSize(void)
+{
+    size_t size = NV_MEMORY_SIZE;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(snapshotVars); i++)
+        size += snapshotVars[i].size;
+
+    return size;
+}
+
+/*
+ * Take a snapshot of the TPM's state. The TPM must not be in failure mode.
+ */
+TPM_RC SnapshotTake(void)
+{
+    BYTE *p;
+    size_t i;
+
+    if (_plat__InFailureMode())
+        return TPM_RC_FAILURE;
+
+    if (!snapshot) {
+        snapshot = malloc(SnapshotSize());
+        if (!snapshot)
+            return TPM_RC_MEMORY;
+        TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_SNAPSHOT,
+                              SnapshotSize(), SnapshotSize());
+    }
+
+    memcpy(snapshot, s_NV, NV_MEMORY_SIZE);
+    p = &snapshot[NV_MEMORY_SIZE];
+    for (i = 0; i < ARRAY_SIZE(snapshotVars); i++) {
+        memcpy(p, snapshotVars[i].var, snapshotVars[i].size);
+        p += snapshotVars[i].size;
+    }
+
+    return TPM_RC_SUCCESS;
+}
+
+/*
+ * Restore the TPM's state from the snapshot. This also leaves failure mode.
+ * The restored NV memory image is written to storage upon the TPM's next
+ * NV commit.
+ */
+TPM_RC SnapshotRestore(void)
+{
+    const BYTE *p;
+    size_t i;
+
+    if (!snapshot)
+        return TPM_RC_FAILURE;
+
+    /* have the whole NV memory image written upon the next commit */
+    _plat__NvMemoryWrite(0, NV_MEMORY_SIZE, snapshot);
+    p = &snapshot[NV_MEMORY_SIZE];
+    for (i = 0; i < ARRAY_SIZE(snapshotVars); i++) {
+        memcpy(snapshotVars[i].var, p, snapshotVars[i].size);
+        p += snapshotVars[i].size;
+    }
+
+    _plat_internal_resetFailureData();
+
+    return TPM_RC_SUCCESS;
+}
+
+void SnapshotFree(void)
+{
+    if (snapshot)
+        memset(snapshot, 0, SnapshotSize());
+    free(snapshot);
+    snapshot = NULL;
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_SNAPSHOT, 0, 0);
+}
@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <tpm_public/BaseTypes.h>
+
+TPM_RC SnapshotTake(void);
+TPM_RC SnapshotRestore(void);
+void SnapshotFree(void);
+
+#endif /* SNAPSHOT_H */
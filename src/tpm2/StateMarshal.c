@@ -14,6 +14,7 @@
 #include "tpm_nvfilename.h"
 #include "tpm_error.h"
 #include "tpm_memory.h"
+#include "tpm_probes.h"
 
 UINT16
 VolatileSave(BYTE **buffer, INT32 *size)
@@ -44,7 +45,11 @@ VolatileLoad(BOOL *restored)
         uint32_t tpm_number = 0;
         const char *name = TPM_VOLATILESTATE_NAME;
 
+        /* the application may have changed the stored state */
+        SetStoredStateDigest(TPMLIB_STATE_VOLATILE, NULL);
+        TPM_PROBE1(nvram_load_entry, name);
         ret = cbs->tpm_nvram_loaddata(&data, &length, tpm_number, name);
+        TPM_PROBE3(nvram_load_return, name, length, ret);
     }
 
     if (data && ret == TPM_SUCCESS) {
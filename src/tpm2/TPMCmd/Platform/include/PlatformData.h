@@ -80,7 +80,22 @@ EXTERN unsigned char s_locality;
 #error Do not define SIMULATION for libtpms!
 #endif  // SIMULATION
 
+// libtpms added begin
+// Choose if the NV file is mapped into memory. s_NV then points to a private
+// mapping of the file, which is read lazily by page faults, and a commit copies
+// the changed bytes into a shared mapping of the file.
+#if (!defined NV_FILE_MAPPED) || ((NV_FILE_MAPPED != NO) && (NV_FILE_MAPPED != YES))
+#  undef NV_FILE_MAPPED
+#  define NV_FILE_MAPPED NO  // Default: Either YES or NO
+#endif
+
+#if NV_FILE_MAPPED
+EXTERN unsigned char  s_NVRam[NV_MEMORY_SIZE];
+extern unsigned char* s_NV;  // s_NVRam or the mapped NV file; see NVMem.c
+#else
 EXTERN unsigned char s_NV[NV_MEMORY_SIZE];
+#endif
+// libtpms added end
 EXTERN int           s_NvIsAvailable;
 EXTERN int           s_NV_unrecoverable;
 EXTERN int           s_NV_recoverable;
@@ -22,15 +22,149 @@
 
 #if FILE_BACKED_NV
 #  include <stdio.h>
+#  if NV_FILE_MAPPED			// libtpms added begin
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+static int            s_NvFd     = -1;
+static unsigned char* s_NvShared = NULL;  // shared mapping of the NV file
+#  else					// libtpms added end
 static FILE* s_NvFile           = NULL;
+#  endif				// libtpms added
 static int   s_NeedsManufacture = FALSE;
+// libtpms added begin
+// The range of the NV image that changed since the last commit
+static unsigned int s_NvDirtyStart = NV_MEMORY_SIZE;
+static unsigned int s_NvDirtyEnd   = 0;
+// libtpms added end
 #endif
 
+#if NV_FILE_MAPPED			// libtpms added begin
+unsigned char* s_NV = s_NVRam;
+#endif					// libtpms added end
+
 //**Functions
 
 #if FILE_BACKED_NV
 const char* s_NvFilePath = "NVChip";
 
+// libtpms added begin
+//*** NvMarkDirty()
+// This function records that a range of the NV image changed so that only the
+// changed range needs to be written upon the next commit.
+static void NvMarkDirty(unsigned int startOffset, unsigned int size)
+{
+    if(startOffset < s_NvDirtyStart)
+        s_NvDirtyStart = startOffset;
+    if(startOffset + size > s_NvDirtyEnd)
+        s_NvDirtyEnd = startOffset + size;
+}
+
+//*** NvMarkClean()
+// This function records that the NV image matches the file.
+static void NvMarkClean(void)
+{
+    s_NvDirtyStart = NV_MEMORY_SIZE;
+    s_NvDirtyEnd   = 0;
+}
+// libtpms added end
+
+#  if NV_FILE_MAPPED			// libtpms added begin
+//*** NvFileIsOpen()
+static int NvFileIsOpen(void)
+{
+    return s_NvShared != NULL;
+}
+
+//*** NvFileUnmap()
+// This function unmaps and closes the NV file. The NV image is copied to RAM
+// first so that it remains available.
+static void NvFileUnmap(void)
+{
+    if(s_NV != s_NVRam)
+    {
+        memcpy(s_NVRam, s_NV, NV_MEMORY_SIZE);
+        munmap(s_NV, NV_MEMORY_SIZE);
+        s_NV = s_NVRam;
+    }
+    if(s_NvShared != NULL)
+        munmap(s_NvShared, NV_MEMORY_SIZE);
+    s_NvShared = NULL;
+    if(s_NvFd >= 0)
+        close(s_NvFd);
+    s_NvFd = -1;
+}
+
+//*** NvFileMap()
+// This function opens the NV file, creating it if necessary, and maps it
+// twice: s_NV points to a private mapping that the TPM reads and writes, and
+// a commit copies the changed bytes into the shared mapping. Since the file is
+// read by page faults, only the parts of it that the TPM touches are read.
+//  Return Type: int
+//  >= 0        success; 1 if the file did not have the right size
+//  -1          error
+static int NvFileMap(void)
+{
+    struct stat statbuf;
+    void*       priv;
+    int         needsInit;
+
+    s_NvFd = open(s_NvFilePath, O_RDWR | O_CREAT, 0666);
+    if(s_NvFd < 0)
+        return -1;
+    if(fstat(s_NvFd, &statbuf) < 0)
+        goto error;
+    needsInit = (statbuf.st_size != NV_MEMORY_SIZE);
+    if(needsInit && ftruncate(s_NvFd, NV_MEMORY_SIZE) < 0)
+        goto error;
+
+    s_NvShared = mmap(NULL, NV_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      s_NvFd, 0);
+    if(s_NvShared == MAP_FAILED)
+    {
+        s_NvShared = NULL;
+        goto error;
+    }
+    priv = mmap(NULL, NV_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                s_NvFd, 0);
+    if(priv == MAP_FAILED)
+        goto error;
+    s_NV = priv;
+    return needsInit;
+
+error:
+    TPMLIB_LogTPM2Error("Could not map NVChip file: %s\n", strerror(errno));
+    NvFileUnmap();
+    return -1;
+}
+
+//*** NvFileCommit()
+// Copy the changed bytes of the NV image into the file and write back the
+// pages they cover before returning, so that a commit is on disk once it
+// succeeded.
+//  Return Type: int
+//      TRUE(1)         success
+//      FALSE(0)        failure
+static int NvFileCommit(void)
+{
+    unsigned int start;
+    int          OK;
+    // If NV file is not available, return failure
+    if(s_NvShared == NULL)
+        return 1;
+    if(s_NvDirtyStart >= s_NvDirtyEnd)
+        return 1;
+    memcpy(&s_NvShared[s_NvDirtyStart], &s_NV[s_NvDirtyStart],
+           s_NvDirtyEnd - s_NvDirtyStart);
+    start = s_NvDirtyStart - s_NvDirtyStart % sysconf(_SC_PAGESIZE);
+    OK = (0 == msync(&s_NvShared[start], s_NvDirtyEnd - start, MS_SYNC));
+    assert(OK);
+    NvMarkClean();
+    return OK;
+}
+#  else					// libtpms added end
+
 //*** NvFileOpen()
 // This function opens the file used to hold the NV image.
 //  Return Type: int
@@ -50,8 +184,15 @@ static int NvFileOpen(const char* mode)
     return (s_NvFile == NULL) ? -1 : 0;
 }
 
+//*** NvFileIsOpen()
+static int NvFileIsOpen(void)		// libtpms added begin
+{
+    return s_NvFile != NULL;
+}					// libtpms added end
+
 //*** NvFileCommit()
-// Write all of the contents of the NV image to a file.
+// Write the contents of the NV image that changed since the last commit to a
+// file.
 //  Return Type: int
 //      TRUE(1)         success
 //      FALSE(0)        failure
@@ -61,11 +202,16 @@ static int NvFileCommit(void)
     // If NV file is not available, return failure
     if(s_NvFile == NULL)
         return 1;
+    if(s_NvDirtyStart >= s_NvDirtyEnd)	// libtpms added begin
+        return 1;			// libtpms added end
     // Write RAM data to NV
-    fseek(s_NvFile, 0, SEEK_SET);
-    OK = (NV_MEMORY_SIZE == fwrite(s_NV, 1, NV_MEMORY_SIZE, s_NvFile));
+    fseek(s_NvFile, s_NvDirtyStart, SEEK_SET);	// libtpms changed begin
+    OK = (s_NvDirtyEnd - s_NvDirtyStart
+          == fwrite(&s_NV[s_NvDirtyStart], 1, s_NvDirtyEnd - s_NvDirtyStart,
+                    s_NvFile));			// libtpms changed end
     OK = OK && (0 == fflush(s_NvFile));
     assert(OK);
+    NvMarkClean();			// libtpms added
     return OK;
 }
 
@@ -105,6 +251,7 @@ static long NvFileSize(int leaveAt)
     }
     return fileSize;
 }
+#  endif				// libtpms added
 #endif
 
 #if 0 /* libtpms added */
@@ -171,8 +318,25 @@ _plat__NVEnable_NVChipFile(
     s_NV_unrecoverable = FALSE;
     s_NV_recoverable   = FALSE;
 #if FILE_BACKED_NV
-    if(s_NvFile != NULL)
+    if(NvFileIsOpen())			// libtpms changed
         return NV_ENABLE_SUCCESS;
+#  if NV_FILE_MAPPED			// libtpms added begin
+    switch(NvFileMap())
+    {
+        case 0:
+            NvMarkClean();
+            break;
+        case 1:
+            // for any other size, initialize it
+            _plat__NvMemoryClear(0, NV_MEMORY_SIZE);
+            NvFileCommit();
+            s_NeedsManufacture = TRUE;
+            break;
+        default:
+            s_NV_unrecoverable = TRUE;
+            break;
+    }
+#  else					// libtpms added end
     // Initialize all the bytes in the ram copy of the NV
     _plat__NvMemoryClear(0, NV_MEMORY_SIZE);
 
@@ -193,6 +357,10 @@ _plat__NVEnable_NVChipFile(
 		TPMLIB_LogTPM2Error("Could not read NVChip file: %s\n",
 		                    strerror(errno));	// libtpms changes end
             }
+            else				// libtpms added begin
+            {
+                NvMarkClean();
+            }					// libtpms added end
         }
         else
         {
@@ -207,6 +375,7 @@ _plat__NVEnable_NVChipFile(
         s_NeedsManufacture = TRUE;
     }
     assert(NULL != s_NvFile);  // Just in case we are broken for some reason.
+#  endif				// libtpms added
 #endif
     // NV contents have been initialized and the error checks have been performed. For
     // simulation purposes, use the signaling interface to indicate if an error is
@@ -237,6 +406,13 @@ LIB_EXPORT void _plat__NVDisable(
 #endif /* TPM_LIBTPMS_CALLBACKS */
 
 #if FILE_BACKED_NV
+#  if NV_FILE_MAPPED			// libtpms added begin
+    // Setting the size to 0 has the TPM be remanufactured.
+    if(delete && s_NvFd >= 0 && ftruncate(s_NvFd, 0) < 0)
+        TPMLIB_LogTPM2Error("Could not truncate NVChip file: %s\n",
+                            strerror(errno));
+    NvFileUnmap();
+#  else					// libtpms added end
     if(NULL != s_NvFile)
     {
         fclose(s_NvFile);  // Close NV file
@@ -253,6 +429,7 @@ LIB_EXPORT void _plat__NVDisable(
         }
     }
     s_NvFile = NULL;  // Set file handle to NULL
+#  endif				// libtpms added
 #endif
     s_NvIsAvailable = FALSE;
     return;
@@ -277,7 +454,7 @@ LIB_EXPORT int _plat__GetNvReadyState(void)
         retVal = NV_WRITEFAILURE;
 #if FILE_BACKED_NV
     else
-        retVal = (s_NvFile == NULL);
+        retVal = !NvFileIsOpen();	// libtpms changed
 #endif
     return retVal;
 }
@@ -343,6 +520,9 @@ LIB_EXPORT int _plat__NvMemoryWrite(unsigned int startOffset,  // IN: write star
     if(startOffset + size <= NV_MEMORY_SIZE)
     {
         memcpy(&s_NV[startOffset], data, size);  // Copy the data to the NV image
+#if FILE_BACKED_NV				// libtpms added begin
+        NvMarkDirty(startOffset, size);
+#endif						// libtpms added end
         return TRUE;
     }
     return FALSE;
@@ -360,6 +540,9 @@ LIB_EXPORT int _plat__NvMemoryClear(unsigned int startOffset,  // IN: clear star
     {
         // In this implementation, assume that the erase value for NV is all 1s
         memset(&s_NV[startOffset], 0xff, size);
+#if FILE_BACKED_NV				// libtpms added begin
+        NvMarkDirty(startOffset, size);
+#endif						// libtpms added end
         return TRUE;
     }
     return FALSE;
@@ -384,6 +567,12 @@ LIB_EXPORT int _plat__NvMemoryMove(unsigned int sourceOffset,  // IN: source off
             memset(&s_NV[sourceOffset], 0, destOffset-sourceOffset);
         else
             memset(&s_NV[destOffset+size], 0, sourceOffset-destOffset);
+#endif						// libtpms added end
+#if FILE_BACKED_NV				// libtpms added begin
+        if (destOffset > sourceOffset)
+            NvMarkDirty(sourceOffset, destOffset + size - sourceOffset);
+        else
+            NvMarkDirty(destOffset, sourceOffset + size - destOffset);
 #endif						// libtpms added end
         return TRUE;
     }
@@ -391,8 +580,8 @@ LIB_EXPORT int _plat__NvMemoryMove(unsigned int sourceOffset,  // IN: source off
 }
 
 //***_plat__NvCommit()
-// This function writes the local copy of NV to NV for permanent store. It will write
-// NV_MEMORY_SIZE bytes to NV. If a file is use, the entire file is written.
+// This function writes the local copy of NV to NV for permanent store. If a file is
+// used, the bytes that changed since the last commit are written.	// libtpms changed
 //  Return Type: int
 //  0       NV write success
 //  non-0   NV write fail
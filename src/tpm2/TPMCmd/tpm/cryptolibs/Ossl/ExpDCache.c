@@ -4,6 +4,8 @@
 
 #include "Tpm.h"
 #include "ExpDCache_fp.h"
+#include "tpm_memusage.h"
+#include "tpm_probes.h"
 
 /* Implement a cache for the private exponent D so it doesn't need to be
  * recalculated every time from P, Q, E and N (modulus). The cache has a
@@ -30,6 +32,35 @@ struct ExpDCacheEntry {
 
 static struct ExpDCacheEntry ExpDCache[DCACHE_NUM_ENTRIES];
 
+/* number of used entries and the bytes held by their numbers */
+static size_t ExpDCacheNumEntries;
+static size_t ExpDCacheBNBytes;
+
+/* Account for the numbers of an entry that is added (sign = 1) or freed */
+static void ExpDCacheAccount(const struct ExpDCacheEntry *dce, int sign)
+{
+    size_t bytes;
+
+    /* only complete entries are in the cache */
+    if (!dce->P || !dce->N || !dce->E || !dce->Q || !dce->D)
+        return;
+
+    bytes = BN_num_bytes(dce->P) + BN_num_bytes(dce->N) +
+            BN_num_bytes(dce->E) + BN_num_bytes(dce->Q) +
+            BN_num_bytes(dce->D);
+    if (sign > 0) {
+        ExpDCacheNumEntries++;
+        ExpDCacheBNBytes += bytes;
+    } else {
+        ExpDCacheNumEntries--;
+        ExpDCacheBNBytes -= bytes;
+    }
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM2_EXPDCACHE,
+                          sizeof(ExpDCache) + ExpDCacheBNBytes,
+                          ExpDCacheNumEntries * sizeof(ExpDCache[0]) +
+                          ExpDCacheBNBytes);
+}
+
 /* Increment the age of all cache entries that have a current age <= maxage */
 static void ExpDCacheIncrementAge(unsigned maxage)
 {
@@ -44,6 +75,7 @@ static void ExpDCacheIncrementAge(unsigned maxage)
 /* Free the data associated with a ExpDCacheEntry and initialize it */
 static void ExpDCacheEntryFree(struct ExpDCacheEntry *dce)
 {
+    ExpDCacheAccount(dce, -1);
     BN_clear_free(dce->P);
     BN_free(dce->N);
     BN_free(dce->E);
@@ -103,8 +135,10 @@ void ExpDCacheAdd(const BIGNUM *P, const BIGNUM *N, const BIGNUM *E,
 
     if (!dce->P || !dce->N || !dce->E || !dce->Q || !dce->D)
         ExpDCacheEntryFree(dce);
-    else
+    else {
+        ExpDCacheAccount(dce, 1);
         ExpDCacheIncrementAge(~0);
+    }
 }
 
 BIGNUM *ExpDCacheFind(const BIGNUM *P, const BIGNUM *N, const BIGNUM *E, BIGNUM **Q)
@@ -117,6 +151,7 @@ BIGNUM *ExpDCacheFind(const BIGNUM *P, const BIGNUM *N, const BIGNUM *E, BIGNUM
         if (BN_cmp(ExpDCache[i].P, P) == 0 && BN_cmp(ExpDCache[i].N, N) == 0 &&
             BN_cmp(ExpDCache[i].E, E) == 0) {
             /* entry found */
+            TPM_PROBE2(expdcache_hit, i, BN_num_bits(N));
             myage = ExpDCache[i].age;
             /* mark this entry as most recently used */
             ExpDCache[i].age = 0;
@@ -140,5 +175,7 @@ BIGNUM *ExpDCacheFind(const BIGNUM *P, const BIGNUM *N, const BIGNUM *E, BIGNUM
         }
     }
 
+    TPM_PROBE1(expdcache_miss, BN_num_bits(N));
+
     return NULL;
 }
@@ -97,6 +97,20 @@ GetCachedEVPCipher(
     return evp_cipher;
 }
 
+/* Get the size of the cache and the bytes used by cached ciphers */
+void GetEVPCipherCacheMemoryUsage(size_t *size, size_t *in_use)
+{
+    const EVP_CIPHER **evp_cipher = &evp_cipher_cache[0][0][0];
+    size_t i;
+
+    *size = sizeof(evp_cipher_cache);
+    *in_use = 0;
+    for (i = 0; i < __NUM_ALGS * __NUM_MODES * __NUM_KEYSIZES; i++) {
+        if (evp_cipher[i])
+            *in_use += sizeof(evp_cipher[i]);
+    }
+}
+
 #undef __NUM_KEYSIZES
 #undef __NUM_MODES
 #undef __NUM_ALGS
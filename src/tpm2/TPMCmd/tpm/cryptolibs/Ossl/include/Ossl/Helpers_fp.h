@@ -28,6 +28,8 @@ TPM_RC DoEVPGetUpdatedIV(EVP_CIPHER_CTX    *ctx,    // IN: required context
                          size_t             iv_len  // IN: size of the buffer
                          );
 
+void GetEVPCipherCacheMemoryUsage(size_t *size, size_t *in_use);
+
 #endif
 
 #if USE_OPENSSL_FUNCTIONS_EC
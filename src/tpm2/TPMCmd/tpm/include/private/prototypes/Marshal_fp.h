@@ -60,6 +60,14 @@ extern "C" {
     Array_Marshal(BYTE *sourceBuffer, UINT16 sourceSize, BYTE **buffer, INT32 *size);
     UINT16
     TPM2B_Marshal(TPM2B *source, UINT32 maxSize, BYTE **buffer, INT32 *size); // libtpms changed
+    UINT16										// libtpms added begin
+    UINT16_Array_Marshal(UINT16 *source, BYTE **buffer, INT32 *size, INT32 count);
+    UINT16
+    UINT32_Array_Marshal(UINT32 *source, BYTE **buffer, INT32 *size, INT32 count);
+    UINT16
+    TPM2B_DIGEST_Array_Marshal(TPM2B_DIGEST *source, BYTE **buffer, INT32 *size, INT32 count);
+    UINT16
+    TPMS_PCR_SELECTION_Array_Marshal(TPMS_PCR_SELECTION *source, BYTE **buffer, INT32 *size, INT32 count); // libtpms added end
     UINT16
     TPM_KEY_BITS_Marshal(TPM_KEY_BITS *source, BYTE **buffer, INT32 *size);
     UINT16
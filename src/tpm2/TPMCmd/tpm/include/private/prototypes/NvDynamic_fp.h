@@ -375,4 +375,9 @@ void NvSetMaxCount(UINT64 value);
 UINT64
 NvGetMaxCount(void);
 
+//*** NvGetUsedBytes()				// libtpms added begin
+// This function returns the number of octets of NV memory used by the
+// reserved data and the list of NV Indices and evict objects.
+UINT32 NvGetUsedBytes(void);			// libtpms added end
+
 #endif  // _NV_DYNAMIC_FP_H_
@@ -11,6 +11,7 @@
 #include "Marshal.h"
 
 #include "tpm_library_intern.h"		// libtpms added
+#include "tpm_probes.h"			// libtpms added
 
 //****************************************************************************/
 //**     Hash/HMAC Functions
@@ -1065,6 +1066,29 @@ void CryptComputeSymmetricUnique(
     return;
 }
 
+// libtpms added begin
+// Get the key size in bits, or the curve ID of an ECC key, for the
+// keygen_entry probe.
+static UINT32 CryptGetKeySizeForProbe(TPMT_PUBLIC* publicArea)
+{
+    switch(publicArea->type)
+    {
+#if ALG_RSA
+        case TPM_ALG_RSA:
+            return publicArea->parameters.rsaDetail.keyBits;
+#endif
+#if ALG_ECC
+        case TPM_ALG_ECC:
+            return publicArea->parameters.eccDetail.curveID;
+#endif
+        case TPM_ALG_SYMCIPHER:
+            return publicArea->parameters.symDetail.sym.keyBits.sym;
+        default:
+            return 0;
+    }
+}
+// libtpms added end
+
 //*** CryptCreateObject()
 // This function creates an object.
 // For an asymmetric key, it will create a key pair and, for a parent key, a seed
@@ -1123,6 +1147,9 @@ CryptCreateObject(OBJECT*                object,  // IN: new object structure po
     if(IS_ATTRIBUTE(publicArea->objectAttributes, TPMA_OBJECT, sensitiveDataOrigin))
         sensitiveCreate->data.t.size = 0;
 
+    TPM_PROBE2(keygen_entry, publicArea->type,			// libtpms added begin
+               CryptGetKeySizeForProbe(publicArea));		// libtpms added end
+
     // Generate the key and unique fields for the asymmetric keys and just the
     // sensitive value for symmetric object
     switch(publicArea->type)
@@ -1154,6 +1181,7 @@ CryptCreateObject(OBJECT*                object,  // IN: new object structure po
             FAIL(FATAL_ERROR_INTERNAL);
             break;
     }
+    TPM_PROBE2(keygen_return, publicArea->type, result);		// libtpms added
     if(result != TPM_RC_SUCCESS)
         return result;
     // Create the sensitive seed value
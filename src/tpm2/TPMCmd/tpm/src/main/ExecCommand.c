@@ -17,6 +17,7 @@
 
 #define TPM_HAVE_TPM2_DECLARATIONS
 #include "tpm_library_intern.h"  // libtpms added
+#include "tpm_probes.h"          // libtpms added
 
 //** ExecuteCommand()
 //
@@ -121,6 +122,8 @@ LIB_EXPORT void ExecuteCommand(
     if(g_DRTMHandle != TPM_RH_UNASSIGNED)
         ObjectTerminateEvent();
 
+    TPM_PROBE1(exec_entry, requestSize);	// libtpms added
+
     // Get command buffer size and command buffer.
     command.tag = 0;				// libtpms added: Coverity
     command.parameterBuffer = request;
@@ -196,6 +199,10 @@ LIB_EXPORT void ExecuteCommand(
     NvIndexCacheInit();
     // Parse Handle buffer.
     result = ParseHandleBuffer(&command);
+    TPM_PROBE5(exec_handles, command.code, command.handleNum,	// libtpms added begin
+               command.handleNum > 0 ? command.handles[0] : 0,
+               command.handleNum > 1 ? command.handles[1] : 0,
+               result);							// libtpms added end
     if(result != TPM_RC_SUCCESS)
         goto Cleanup;
     // All handles in the handle area are required to reference TPM-resident
@@ -230,6 +237,8 @@ LIB_EXPORT void ExecuteCommand(
         // successful return, command.parameterBuffer should be pointing at the
         // first byte of the parameters.
         result = ParseSessionBuffer(&command);
+        TPM_PROBE4(exec_sessions, command.code, command.sessionNum,	// libtpms added begin
+                   command.authSize, result);				// libtpms added end
         if(result != TPM_RC_SUCCESS)
             goto Cleanup;
     }
@@ -258,12 +267,15 @@ LIB_EXPORT void ExecuteCommand(
     // CommandDispatcher returns a response handle buffer and a response parameter
     // buffer if it succeeds. It will also set the parameterSize field in the
     // buffer if the tag is TPM_RC_SESSIONS.
+    TPM_PROBE1(exec_dispatch_entry, command.code);		// libtpms added
     result = CommandDispatcher(&command);
+    TPM_PROBE2(exec_dispatch_return, command.code, result);	// libtpms added
     if(result != TPM_RC_SUCCESS)
         goto Cleanup;
 
     // Build the session area at the end of the parameter area.
     result = BuildResponseSession(&command);
+    TPM_PROBE2(exec_response_session, command.code, result);	// libtpms added
     if(result != TPM_RC_SUCCESS)
     {
         goto Cleanup;
@@ -326,4 +338,6 @@ Cleanup:
         // something in the command triggered failure mode - handle command as a failure instead
         TpmFailureMode(requestSize, request, responseSize, response);
     }
+
+    TPM_PROBE3(exec_return, command.code, result, *responseSize);	// libtpms added
 }
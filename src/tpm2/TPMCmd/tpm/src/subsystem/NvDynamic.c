@@ -153,6 +153,14 @@ static UINT32 NvGetFreeBytes(void)
     return s_evictNvEnd - NvGetEnd();
 }
 
+//*** NvGetUsedBytes()						// libtpms added begin
+// This function returns the number of octets of NV memory used by the
+// reserved data and the list of NV Indices and evict objects.
+UINT32 NvGetUsedBytes(void)
+{
+    return NvGetEnd();
+}								// libtpms added end
+
 //*** NvTestSpace()
 // This function will test if there is enough space to add a new entity.
 //  Return Type: BOOL
@@ -47,6 +47,7 @@
 //** Includes, Defines
 #define NV_C
 #include "Tpm.h"
+#include "tpm_probes.h"		// libtpms added
 
 //************************************************
 //** Functions
@@ -97,7 +98,12 @@ void NvCheckState(void)
 // This is a wrapper for the platform function to commit pending NV writes.
 BOOL NvCommit(void)
 {
-    return (_plat__NvCommit() == 0);
+    BOOL success;						// libtpms changed begin
+
+    TPM_PROBE1(nv_commit_entry, g_updateNV);
+    success = (_plat__NvCommit() == 0);
+    TPM_PROBE1(nv_commit_return, success);
+    return success;						// libtpms changed end
 }
 
 //*** NvPowerOn()
@@ -26,6 +26,30 @@ typedef UINT16 ATTRIBUTE_TYPE;
 
 //** Command Attribute Functions
 
+#if !COMPRESSED_LISTS							// libtpms added begin
+// With uncompressed lists the index of a library command in s_ccAttr and
+// s_commandAttributes is the offset of its command code from TPM_CC_FIRST. This
+// is also the index of the command's bit in the runtime profile's bitmap of
+// enabled commands, so looking up a command is a range check and a bit test.
+MUST_BE(LIBRARY_COMMAND_ARRAY_SIZE == NUM_ENTRIES_COMMAND_PROPERTIES);
+MUST_BE(LIBRARY_COMMAND_ARRAY_SIZE
+        <= 8 * sizeof(((struct RuntimeCommands*)0)->enabledCommandsByIdx));
+
+//*** IsCommandIndexEnabled()
+// This function checks whether the library command at 'commandIndex' is
+// enabled by the active runtime profile.
+//  Return Type: BOOL
+//      TRUE(1)         command is enabled
+//      FALSE(0)        command is out of range, not implemented or disabled
+static inline BOOL IsCommandIndexEnabled(COMMAND_INDEX commandIndex)
+{
+    const BYTE* enabled = g_RuntimeProfile.RuntimeCommands.enabledCommandsByIdx;
+
+    return commandIndex < LIBRARY_COMMAND_ARRAY_SIZE
+           && (enabled[commandIndex >> 3] & (1 << (commandIndex & 7))) != 0;
+}
+#endif									// libtpms added end
+
 //*** NextImplementedIndex()							// libtpms added begin
 // This function is used when the lists are not compressed. In a compressed list,
 // only the implemented commands are present. So, a search might find a value
@@ -41,9 +65,7 @@ static COMMAND_INDEX NextImplementedIndex(COMMAND_INDEX commandIndex)
 {
     for(; commandIndex < COMMAND_COUNT; commandIndex++)
     {
-       if(RuntimeCommandsCheckEnabled(&g_RuntimeProfile.RuntimeCommands,	// libtpms added begin
-                                      GET_ATTRIBUTE(s_ccAttr[commandIndex],
-                                                    TPMA_CC, commandIndex)))	// libtpms added end
+        if(IsCommandIndexEnabled(commandIndex))
             return commandIndex;
     }
     return UNIMPLEMENTED_COMMAND_INDEX;
@@ -232,17 +254,16 @@ CommandCodeToCommandIndex(TPM_CC commandCode  // IN: the command code to look up
 #if !COMPRESSED_LISTS							// libtpms added begin
     if(!vendor)
     {
-        commandIndex = searchIndex - (COMMAND_INDEX)GET_ATTRIBUTE(s_ccAttr[0], TPMA_CC, commandIndex);
-        // Check for out of range or unimplemented.
-        // Note, since a COMMAND_INDEX is unsigned, if searchIndex is smaller than
+        UINT32 offset = commandCode - TPM_CC_FIRST;
+        // Check for out of range, unimplemented or runtime-disabled.
+        // Note, since the offset is unsigned, if commandCode is smaller than
         // the lowest value of command, it will become a 'negative' number making
         // it look like a large unsigned number, this will cause it to fail
         // the unsigned check below.
-        if(commandIndex >= LIBRARY_COMMAND_ARRAY_SIZE
-           || !RuntimeCommandsCheckEnabled(&g_RuntimeProfile.RuntimeCommands,
-                                           commandCode))
+        if(offset >= LIBRARY_COMMAND_ARRAY_SIZE
+           || !IsCommandIndexEnabled((COMMAND_INDEX)offset))
             return UNIMPLEMENTED_COMMAND_INDEX;
-        return commandIndex;
+        return (COMMAND_INDEX)offset;
     }
 #endif									// libtpms added end
     // Need this code for any vendor code lookup or for compressed lists
@@ -274,9 +295,13 @@ GetNextCommandIndex(COMMAND_INDEX commandIndex  // IN: the starting index
 {
     while(++commandIndex < COMMAND_COUNT)
     {
-        if(!RuntimeCommandsCheckEnabled(&g_RuntimeProfile.RuntimeCommands,	// libtpms added begin
+#if !COMPRESSED_LISTS							// libtpms added begin
+        if(!IsCommandIndexEnabled(commandIndex))
+#else
+        if(!RuntimeCommandsCheckEnabled(&g_RuntimeProfile.RuntimeCommands,
                                         GET_ATTRIBUTE(s_ccAttr[commandIndex],
                                                       TPMA_CC, commandIndex)))
+#endif
             continue;								// libtpms added end
         return commandIndex;
     }
@@ -480,10 +505,14 @@ CommandCapGetCCList(TPM_CC commandCode,  // IN: start command code
         commandIndex != UNIMPLEMENTED_COMMAND_INDEX;
         commandIndex = GetNextCommandIndex(commandIndex))
     {
-        if (!RuntimeCommandsCheckEnabled(&g_RuntimeProfile.RuntimeCommands,		// libtpms added begin
+#if COMPRESSED_LISTS								// libtpms added begin
+        // GetClosestCommandIndex() and GetNextCommandIndex() only return
+        // runtime-enabled commands when lists are not compressed
+        if (!RuntimeCommandsCheckEnabled(&g_RuntimeProfile.RuntimeCommands,
                                          GET_ATTRIBUTE(s_ccAttr[commandIndex],
                                                        TPMA_CC, commandIndex)))
-             continue;									// libtpms added end
+             continue;
+#endif										// libtpms added end
         if(commandList->count < count)
         {
             // If the list is not full, add the attributes for this command.
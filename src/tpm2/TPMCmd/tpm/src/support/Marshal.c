@@ -160,10 +160,140 @@ TPM2B_Marshal(TPM2B *source, UINT32 maxSize, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
     assert(source->size <= maxSize); // libtpms added
+#if 0	// libtpms changed begin
     written += UINT16_Marshal(&(source->size), buffer, size);
     written += Array_Marshal(source->buffer, source->size, buffer, size);
+#else
+    written = sizeof(UINT16) + source->size;
+    if (buffer != NULL) {
+	if ((size == NULL) || (*size >= written)) {
+	    UINT16_TO_BYTE_ARRAY(source->size, *buffer);
+	    memcpy(*buffer + sizeof(UINT16), source->buffer, source->size);
+	    *buffer += written;
+
+	    if (size != NULL) {
+		*size -= written;
+	    }
+	}
+	else {
+	    pAssert(FALSE);
+	}
+    }
+#endif	// libtpms changed end
+    return written;
+}
+
+/* libtpms added begin */
+/* The following functions marshal arrays of the given type with a single
+   check of the available space for the whole array. */
+
+UINT16
+UINT16_Array_Marshal(UINT16 *source, BYTE **buffer, INT32 *size, INT32 count)
+{
+    UINT16 written = (UINT16)(count * sizeof(UINT16));
+    INT32 i;
+
+    if (buffer != NULL) {
+	if ((size == NULL) || (*size >= written)) {
+	    for (i = 0; i < count; i++) {
+		UINT16_TO_BYTE_ARRAY(source[i], &(*buffer)[i * sizeof(UINT16)]);
+	    }
+	    *buffer += written;
+
+	    if (size != NULL) {
+		*size -= written;
+	    }
+	}
+	else {
+	    pAssert(FALSE);
+	}
+    }
+    return written;
+}
+
+UINT16
+UINT32_Array_Marshal(UINT32 *source, BYTE **buffer, INT32 *size, INT32 count)
+{
+    UINT16 written = (UINT16)(count * sizeof(UINT32));
+    INT32 i;
+
+    if (buffer != NULL) {
+	if ((size == NULL) || (*size >= written)) {
+	    for (i = 0; i < count; i++) {
+		UINT32_TO_BYTE_ARRAY(source[i], &(*buffer)[i * sizeof(UINT32)]);
+	    }
+	    *buffer += written;
+
+	    if (size != NULL) {
+		*size -= written;
+	    }
+	}
+	else {
+	    pAssert(FALSE);
+	}
+    }
+    return written;
+}
+
+UINT16
+TPM2B_DIGEST_Array_Marshal(TPM2B_DIGEST *source, BYTE **buffer, INT32 *size, INT32 count)
+{
+    UINT16 written = 0;
+    INT32 i;
+
+    for (i = 0; i < count; i++) {
+	assert(source[i].t.size <= sizeof(source[i].t.buffer));
+	written += sizeof(UINT16) + source[i].t.size;
+    }
+    if (buffer != NULL) {
+	if ((size == NULL) || (*size >= written)) {
+	    for (i = 0; i < count; i++) {
+		UINT16_TO_BYTE_ARRAY(source[i].t.size, *buffer);
+		memcpy(*buffer + sizeof(UINT16), source[i].t.buffer, source[i].t.size);
+		*buffer += sizeof(UINT16) + source[i].t.size;
+	    }
+
+	    if (size != NULL) {
+		*size -= written;
+	    }
+	}
+	else {
+	    pAssert(FALSE);
+	}
+    }
+    return written;
+}
+
+UINT16
+TPMS_PCR_SELECTION_Array_Marshal(TPMS_PCR_SELECTION *source, BYTE **buffer, INT32 *size, INT32 count)
+{
+    UINT16 written = 0;
+    INT32 i;
+
+    for (i = 0; i < count; i++) {
+	written += sizeof(UINT16) + sizeof(UINT8) + source[i].sizeofSelect;
+    }
+    if (buffer != NULL) {
+	if ((size == NULL) || (*size >= written)) {
+	    for (i = 0; i < count; i++) {
+		UINT16_TO_BYTE_ARRAY(source[i].hash, *buffer);
+		(*buffer)[sizeof(UINT16)] = source[i].sizeofSelect;
+		memcpy(*buffer + sizeof(UINT16) + sizeof(UINT8),
+		       source[i].pcrSelect, source[i].sizeofSelect);
+		*buffer += sizeof(UINT16) + sizeof(UINT8) + source[i].sizeofSelect;
+	    }
+
+	    if (size != NULL) {
+		*size -= written;
+	    }
+	}
+	else {
+	    pAssert(FALSE);
+	}
+    }
     return written;
 }
+/* libtpms added end */
 
 /* Table 2:5 - Definition of Types for Documentation Clarity (TypedefTable()) */
 
@@ -724,12 +854,17 @@ UINT16
 TPML_CC_Marshal(TPML_CC *source, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
-    UINT32 i;
 
     written += UINT32_Marshal(&source->count, buffer, size);
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; i < source->count ; i++) {
 	written += TPM_CC_Marshal(&source->commandCodes[i], buffer, size);
     }
+#else
+    written += UINT32_Array_Marshal(&source->commandCodes[0], buffer, size,
+                                    (INT32)source->count);
+#endif	// libtpms changed end
     return written;
 }
 
@@ -754,12 +889,17 @@ UINT16
 TPML_ALG_Marshal(TPML_ALG *source, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
-    UINT32 i;
 
     written += UINT32_Marshal(&source->count, buffer, size);
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; i < source->count ; i++) {
 	written += TPM_ALG_ID_Marshal(&source->algorithms[i], buffer, size);
     }
+#else
+    written += UINT16_Array_Marshal(&source->algorithms[0], buffer, size,
+                                    (INT32)source->count);
+#endif	// libtpms changed end
     return written;
 }
 
@@ -769,12 +909,17 @@ UINT16
 TPML_HANDLE_Marshal(TPML_HANDLE *source, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
-    UINT32 i;
 
     written += UINT32_Marshal(&source->count, buffer, size);
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; i < source->count ; i++) {
 	written += TPM_HANDLE_Marshal(&source->handle[i], buffer, size);
     }
+#else
+    written += UINT32_Array_Marshal(&source->handle[0], buffer, size,
+                                    (INT32)source->count);
+#endif	// libtpms changed end
     return written;
 }
 
@@ -784,12 +929,17 @@ UINT16
 TPML_DIGEST_Marshal(TPML_DIGEST *source, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
-    UINT32 i;
 
     written += UINT32_Marshal(&source->count, buffer, size);
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; i < source->count ; i++) {
 	written += TPM2B_DIGEST_Marshal(&source->digests[i], buffer, size);
     }
+#else
+    written += TPM2B_DIGEST_Array_Marshal(&source->digests[0], buffer, size,
+                                          (INT32)source->count);
+#endif	// libtpms changed end
     return written;
 }
 
@@ -814,12 +964,17 @@ UINT16
 TPML_PCR_SELECTION_Marshal(TPML_PCR_SELECTION *source, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
-    UINT32 i;
 
     written += UINT32_Marshal(&source->count, buffer, size);
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; i < source->count ; i++) {
 	written += TPMS_PCR_SELECTION_Marshal(&source->pcrSelections[i], buffer, size);
     }
+#else
+    written += TPMS_PCR_SELECTION_Array_Marshal(&source->pcrSelections[0], buffer, size,
+                                                (INT32)source->count);
+#endif	// libtpms changed end
     return written;
 }
 
@@ -876,12 +1031,16 @@ TPML_ECC_CURVE_Marshal(TPML_ECC_CURVE *source, BYTE **buffer, INT32 *size)
 {
     UINT16 written = 0;
 
-    UINT32 i;
-
     written += UINT32_Marshal(&source->count, buffer, size);
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; i < source->count ; i++) {
 	written += TPM_ECC_CURVE_Marshal(&source->eccCurves[i], buffer, size);
     }
+#else
+    written += UINT16_Array_Marshal(&source->eccCurves[0], buffer, size,
+                                    (INT32)source->count);
+#endif	// libtpms changed end
     return written;
 }
 
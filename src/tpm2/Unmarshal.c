@@ -97,6 +97,45 @@ Array_Unmarshal(BYTE *targetBuffer, UINT16 targetSize, BYTE **buffer, INT32 *siz
     return rc;
 }
 
+/* libtpms added begin */
+/* The following functions unmarshal arrays of the given type with a single
+   check of the available input for the whole array. */
+
+TPM_RC
+UINT16_Array_Unmarshal(UINT16 *target, BYTE **buffer, INT32 *size, INT32 count)
+{
+    UINT32 length = (UINT32)count * sizeof(UINT16);
+    INT32 i;
+
+    if ((UINT32)*size < length) {
+	return TPM_RC_INSUFFICIENT;
+    }
+    for (i = 0; i < count; i++) {
+	target[i] = BYTE_ARRAY_TO_UINT16(&(*buffer)[i * sizeof(UINT16)]);
+    }
+    *buffer += length;
+    *size -= length;
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+UINT32_Array_Unmarshal(UINT32 *target, BYTE **buffer, INT32 *size, INT32 count)
+{
+    UINT32 length = (UINT32)count * sizeof(UINT32);
+    INT32 i;
+
+    if ((UINT32)*size < length) {
+	return TPM_RC_INSUFFICIENT;
+    }
+    for (i = 0; i < count; i++) {
+	target[i] = BYTE_ARRAY_TO_UINT32(&(*buffer)[i * sizeof(UINT32)]);
+    }
+    *buffer += length;
+    *size -= length;
+    return TPM_RC_SUCCESS;
+}
+/* libtpms added end */
+
 TPM_RC
 TPM2B_Unmarshal(TPM2B *target, UINT16 targetSize, BYTE **buffer, INT32 *size)
 {
@@ -2136,7 +2175,6 @@ TPML_CC_Unmarshal(TPML_CC *target, BYTE **buffer, INT32 *size)
 {
     TPM_RC rc = TPM_RC_SUCCESS;
 
-    UINT32 i;
     if (rc == TPM_RC_SUCCESS) {
 	rc = UINT32_Unmarshal(&target->count, buffer, size);
     }
@@ -2146,9 +2184,17 @@ TPML_CC_Unmarshal(TPML_CC *target, BYTE **buffer, INT32 *size)
 	    target->count = 0; // libtpms added
 	}
     }
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; (rc == TPM_RC_SUCCESS) && (i < target->count) ; i++) {
 	rc = TPM_CC_Unmarshal(&target->commandCodes[i], buffer, size);
     }
+#else
+    if (rc == TPM_RC_SUCCESS) {
+	rc = UINT32_Array_Unmarshal(&target->commandCodes[0], buffer, size,
+	                            (INT32)target->count);
+    }
+#endif	// libtpms changed end
     return rc;
 }
 
@@ -2201,7 +2247,6 @@ TPML_ALG_Unmarshal(TPML_ALG *target, BYTE **buffer, INT32 *size)
 {
     TPM_RC rc = TPM_RC_SUCCESS;
 
-    UINT32 i;
     if (rc == TPM_RC_SUCCESS) {
 	rc = UINT32_Unmarshal(&target->count, buffer, size);
     }
@@ -2211,9 +2256,17 @@ TPML_ALG_Unmarshal(TPML_ALG *target, BYTE **buffer, INT32 *size)
 	    target->count = 0; // libtpms added
 	}
     }
+#if 0	// libtpms changed begin
+    UINT32 i;
     for (i = 0 ; (rc == TPM_RC_SUCCESS) && (i < target->count) ; i++) {
 	rc = TPM_ALG_ID_Unmarshal(&target->algorithms[i], buffer, size);
     }
+#else
+    if (rc == TPM_RC_SUCCESS) {
+	rc = UINT16_Array_Unmarshal(&target->algorithms[0], buffer, size,
+	                            (INT32)target->count);
+    }
+#endif	// libtpms changed end
     return rc;
 }
 
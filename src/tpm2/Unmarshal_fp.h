@@ -62,6 +62,10 @@ extern "C" {
     UINT64_Unmarshal(UINT64 *target, BYTE **buffer, INT32 *size);
     LIB_EXPORT TPM_RC
     Array_Unmarshal(BYTE *targetBuffer, UINT16 targetSize, BYTE **buffer, INT32 *size);
+    LIB_EXPORT TPM_RC /* libtpms added begin */
+    UINT16_Array_Unmarshal(UINT16 *target, BYTE **buffer, INT32 *size, INT32 count);
+    LIB_EXPORT TPM_RC
+    UINT32_Array_Unmarshal(UINT32 *target, BYTE **buffer, INT32 *size, INT32 count); /* libtpms added end */
     LIB_EXPORT TPM_RC
     TPM2B_Unmarshal(TPM2B *target, UINT16 targetSize, BYTE **buffer, INT32 *size);
     LIB_EXPORT TPM_RC
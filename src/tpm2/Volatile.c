@@ -91,11 +91,13 @@ VolatileState_Save(BYTE **buffer, INT32 *size)
     BYTE hash[SHA1_DIGEST_SIZE];
     TPM_ALG_ID hashAlg = TPM_ALG_SHA1;
 
-    start = *buffer;
+    /* buffer == NULL: only computing the size of the state */
+    start = buffer ? *buffer : NULL;
     written = VolatileState_Marshal(buffer, size, &g_RuntimeProfile);
 
     /* append the checksum */
-    CryptHashBlock(hashAlg, written, start, sizeof(hash), hash);
+    if (start)
+        CryptHashBlock(hashAlg, written, start, sizeof(hash), hash);
     written += Array_Marshal(hash, sizeof(hash), buffer, size);
 
     return written;
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+/*
+ * Record the commands sent to the TPM along with their localities and
+ * response codes so that a workload can be replayed offline by
+ * tests/tpm_replay. See tpm_capture.h for the format of the file.
+ */
+
+#include <config.h>
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tpm_capture.h"
+#include "tpm_library_intern.h"
+
+#if LIBTPMS_CAPTURE
+
+static FILE *capture_file;
+
+static unsigned char *capture_put_u16(unsigned char *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+    return p + 2;
+}
+
+static unsigned char *capture_put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+static void capture_write(const unsigned char *data, size_t datalen)
+{
+    if (fwrite(data, 1, datalen, capture_file) != datalen) {
+        TPMLIB_LogError("Could not write to the capture file: %s\n",
+                        strerror(errno));
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+}
+
+/*
+ * Open the capture file for appending. Since the capture holds secrets, a new
+ * file is only accessible by the owner and an existing file is only used if
+ * it is a regular file owned by the effective user that no one else can
+ * access.
+ */
+static FILE *capture_open(const char *filename)
+{
+    struct stat statbuf;
+    FILE *file;
+    int fd;
+
+    fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | O_NOFOLLOW,
+              S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        TPMLIB_LogError("Could not open capture file %s: %s\n",
+                        filename, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &statbuf) < 0) {
+        TPMLIB_LogError("Could not stat capture file %s: %s\n",
+                        filename, strerror(errno));
+        goto err_close;
+    }
+    if (!S_ISREG(statbuf.st_mode) || statbuf.st_uid != geteuid() ||
+        (statbuf.st_mode & (S_IRWXG | S_IRWXO))) {
+        TPMLIB_LogError("Refusing to use capture file %s: it must be a regular "
+                        "file owned by the user and only accessible by the user\n",
+                        filename);
+        goto err_close;
+    }
+
+    /* let ftell() return the size of the file to detect a new file */
+    if (lseek(fd, 0, SEEK_END) < 0) {
+        TPMLIB_LogError("Could not seek in capture file %s: %s\n",
+                        filename, strerror(errno));
+        goto err_close;
+    }
+
+    file = fdopen(fd, "ab");
+    if (!file) {
+        TPMLIB_LogError("Could not open capture file %s: %s\n",
+                        filename, strerror(errno));
+        goto err_close;
+    }
+    return file;
+
+err_close:
+    close(fd);
+    return NULL;
+}
+
+/*
+ * Open the capture file named by the TPM_CAPTURE_FILE environment variable,
+ * if set, and record the (re-)initialization of the TPM.
+ */
+void TPM_Capture_Init(TPMLIB_TPMVersion tpmversion)
+{
+    unsigned char buffer[TPM_CAPTURE_HEADER_SIZE], *p;
+    const char *filename;
+
+    if (!capture_file) {
+        filename = getenv("TPM_CAPTURE_FILE");
+        if (!filename || !filename[0])
+            return;
+
+        capture_file = capture_open(filename);
+        if (!capture_file)
+            return;
+        if (ftell(capture_file) == 0) {
+            p = capture_put_u32(buffer, TPM_CAPTURE_MAGIC);
+            capture_put_u16(p, TPM_CAPTURE_VERSION);
+            capture_write(buffer, TPM_CAPTURE_HEADER_SIZE);
+            if (!capture_file)
+                return;
+        }
+    }
+
+    buffer[0] = TPM_CAPTURE_RECORD_INIT;
+    capture_put_u16(&buffer[1], tpmversion);
+    capture_write(buffer, TPM_CAPTURE_INIT_SIZE);
+    if (capture_file)
+        fflush(capture_file);
+}
+
+/*
+ * Record a command and the response code the TPM returned for it.
+ */
+void TPM_Capture_Command(uint8_t locality,
+                         const unsigned char *command, uint32_t command_size,
+                         const unsigned char *response, uint32_t resp_size)
+{
+    unsigned char buffer[TPM_CAPTURE_COMMAND_HDR_SIZE], *p;
+    uint32_t rc = 0;
+
+    if (!capture_file)
+        return;
+
+    /* tag (2 bytes), size (4 bytes), response code (4 bytes) */
+    if (resp_size >= 10)
+        rc = ((uint32_t)response[6] << 24) | ((uint32_t)response[7] << 16) |
+             ((uint32_t)response[8] << 8) | response[9];
+
+    buffer[0] = TPM_CAPTURE_RECORD_COMMAND;
+    buffer[1] = locality;
+    p = capture_put_u32(&buffer[2], rc);
+    capture_put_u32(p, command_size);
+
+    capture_write(buffer, TPM_CAPTURE_COMMAND_HDR_SIZE);
+    if (capture_file)
+        capture_write(command, command_size);
+    /* have every command on disk in case the process does not terminate */
+    if (capture_file)
+        fflush(capture_file);
+}
+
+void TPM_Capture_Terminate(void)
+{
+    if (capture_file) {
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+}
+
+#endif /* LIBTPMS_CAPTURE */
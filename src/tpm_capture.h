@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+#ifndef TPM_CAPTURE_H
+#define TPM_CAPTURE_H
+
+#include <stdint.h>
+
+#include "tpm_library.h"
+
+/*
+ * Capture of the commands sent to the TPM for replaying them offline.
+ *
+ * If libtpms was configured with --enable-capture and the environment
+ * variable TPM_CAPTURE_FILE names a file when TPMLIB_MainInit() is called,
+ * the commands and their response codes are appended to that file. All numbers are written in big endian format.
+ *
+ * The file starts with a header:
+ *   uint32_t magic    TPM_CAPTURE_MAGIC
+ *   uint16_t version  TPM_CAPTURE_VERSION
+ *
+ * It is followed by records that start with a uint8_t type:
+ *   TPM_CAPTURE_RECORD_INIT: the TPM was (re-)initialized
+ *     uint16_t tpm_version   TPMLIB_TPMVersion of the initialized TPM
+ *   TPM_CAPTURE_RECORD_COMMAND: a command was processed
+ *     uint8_t  locality      locality the command was sent from
+ *     uint32_t rc            response code returned by the TPM
+ *     uint32_t command_size  size of the command
+ *     uint8_t  command[command_size]
+ */
+#define TPM_CAPTURE_MAGIC             0x4c544350 /* 'LTCP' */
+#define TPM_CAPTURE_VERSION           1
+
+#define TPM_CAPTURE_RECORD_INIT       1
+#define TPM_CAPTURE_RECORD_COMMAND    2
+
+#define TPM_CAPTURE_HEADER_SIZE       (4 + 2)
+#define TPM_CAPTURE_INIT_SIZE         (1 + 2)
+#define TPM_CAPTURE_COMMAND_HDR_SIZE  (1 + 1 + 4 + 4)
+
+#if LIBTPMS_CAPTURE
+
+void TPM_Capture_Init(TPMLIB_TPMVersion tpmversion);
+void TPM_Capture_Command(uint8_t locality,
+                         const unsigned char *command, uint32_t command_size,
+                         const unsigned char *response, uint32_t resp_size);
+void TPM_Capture_Terminate(void);
+
+#else
+
+static inline void TPM_Capture_Init(TPMLIB_TPMVersion tpmversion)
+{
+    (void)tpmversion;
+}
+
+static inline void TPM_Capture_Command(uint8_t locality,
+                                       const unsigned char *command,
+                                       uint32_t command_size,
+                                       const unsigned char *response,
+                                       uint32_t resp_size)
+{
+    (void)locality;
+    (void)command;
+    (void)command_size;
+    (void)response;
+    (void)resp_size;
+}
+
+static inline void TPM_Capture_Terminate(void)
+{
+}
+
+#endif /* LIBTPMS_CAPTURE */
+
+#endif /* TPM_CAPTURE_H */
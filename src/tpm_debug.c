@@ -57,6 +57,9 @@ int tpm_swallow_printf_args(const char *format, ...)
 void TPM_PrintFourLimit(const char *string,
                         const unsigned char *buff, size_t buflen)
 {
+    if (!TPMLIB_LogWouldPrint(string))
+        return;
+
     if (buff != NULL) {
         switch (buflen) {
         case 0:
@@ -112,6 +115,9 @@ void TPM_PrintAll(const char *string, const unsigned char* buff, uint32_t length
     uint32_t i;
     int indent;
 
+    if (!TPMLIB_LogWouldPrint(string))
+        return;
+
     if (buff != NULL) {
         indent = TPMLIB_LogPrintf("%s length %u\n", string, length);
         if (indent < 0)
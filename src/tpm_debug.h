@@ -69,6 +69,6 @@ extern int swallow_rc;
 #ifdef printf
 # undef  printf
 #endif
-#define printf(...) TPMLIB_LogPrintf(__VA_ARGS__);
+#define printf(...) TPMLIB_LogDebug(__VA_ARGS__);
 
 #endif
@@ -51,6 +51,7 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <inttypes.h>
 
 #ifdef USE_FREEBL_CRYPTO_LIBRARY
 # include <plbase64.h>
@@ -61,11 +62,15 @@
 # include <openssl/evp.h>
 #endif
 
+#include "tpm_capture.h"
 #include "tpm_debug.h"
 #include "tpm_error.h"
 #include "tpm_library.h"
 #include "tpm_library_intern.h"
+#include "tpm_memusage.h"
+#include "tpm_nvfile.h"
 #include "tpm_nvfilename.h"
+#include "tpm_probes.h"
 #include "tpm_tis.h"
 
 static const struct tags_and_indices {
@@ -97,8 +102,60 @@ static int debug_fd = -1;
 static unsigned debug_level = 0;
 static char *debug_prefix = NULL;
 
+unsigned int tpmlib_log_level = 0;
+
+/*
+ * Ring buffer that the debug output is written to instead of debug_fd
+ * if one was set with TPMLIB_SetDebugRingBuffer(). The thread running
+ * the TPM is the only producer and the thread calling
+ * TPMLIB_ReadDebugRingBuffer() the only consumer. They only synchronize
+ * through the free-running head and tail indices. Lines that do not fit
+ * into the ring buffer are dropped rather than waiting for the consumer.
+ */
+#define DEBUG_RING_MIN_SIZE    4096
+#define DEBUG_RING_MAX_SIZE    (64 * 1024 * 1024)
+
+static struct {
+    char *buffer;
+    size_t size;     /* power of 2 */
+    size_t head;     /* only written by the producer */
+    size_t tail;     /* only written by the consumer */
+    size_t dropped;  /* number of dropped lines */
+} debug_ring;
+
 static struct sized_buffer cached_blobs[TPMLIB_STATE_SAVE_STATE + 1];
 
+/* digests of the state blobs last stored for each state type */
+static struct stored_digest {
+    bool valid;
+    unsigned char digest[STORED_STATE_DIGEST_SIZE];
+} stored_digests[TPMLIB_STATE_SAVE_STATE + 1];
+
+/* the blob of the last state delta produced or applied for each state type */
+static struct delta_base {
+    unsigned char *buffer;
+    uint32_t buflen;
+    uint64_t generation;
+} delta_bases[TPMLIB_STATE_SAVE_STATE + 1];
+static uint64_t state_generation;
+
+/* the delta bases at the time of the last TPMLIB_TakeSnapshot() */
+static struct delta_base snapshot_delta_bases[TPMLIB_STATE_SAVE_STATE + 1];
+
+static void ClearAllDeltaBases(void);
+static void FreeSnapshotDeltaBases(void);
+static void UpdateStateCacheUsage(void);
+
+/* a template's state blobs; they are never modified once created */
+struct TPMLIB_StateTemplate {
+    int tpmvers_choice;
+    struct sized_buffer blobs[TPMLIB_STATE_SAVE_STATE + 1];
+};
+
+/* whether an instance created from a template needs to be reseeded */
+static TPM_BOOL template_pending = FALSE;
+static unsigned int template_flags;
+
 static int tpmvers_choice = 0; /* default is TPM1.2 */
 static TPM_BOOL tpmvers_locked = FALSE;
 
@@ -116,16 +173,22 @@ TPM_RESULT TPMLIB_ChooseTPMVersion(TPMLIB_TPMVersion ver)
     switch (ver) {
 #if WITH_TPM1
     case TPMLIB_TPM_VERSION_1_2:
-        if (tpmvers_choice != 0)
+        if (tpmvers_choice != 0) {
             ClearAllCachedState();
+            ClearAllDeltaBases();
+            template_pending = FALSE;
+        }
 
         tpmvers_choice = 0; // entry 0 in tpm_iface
         return TPM_SUCCESS;
 #endif
 #if WITH_TPM2
     case TPMLIB_TPM_VERSION_2:
-        if (tpmvers_choice != 1)
+        if (tpmvers_choice != 1) {
             ClearAllCachedState();
+            ClearAllDeltaBases();
+            template_pending = FALSE;
+        }
 
         tpmvers_choice = 1; // entry 1 in tpm_iface
         return TPM_SUCCESS;
@@ -137,22 +200,57 @@ TPM_RESULT TPMLIB_ChooseTPMVersion(TPMLIB_TPMVersion ver)
 
 TPM_RESULT TPMLIB_MainInit(void)
 {
+    TPM_RESULT ret;
+
     if (!tpm_iface[tpmvers_choice]) {
         return TPM_FAIL;
     }
 
     tpmvers_locked = TRUE;
 
-    return tpm_iface[tpmvers_choice]->MainInit();
+    /* the storage may have been changed while the TPM was not running */
+    ClearAllStoredStateDigests();
+
+    ret = tpm_iface[tpmvers_choice]->MainInit();
+    /* a failed start consumes the template so a later one cannot reseed */
+    if (template_pending) {
+        template_pending = FALSE;
+        if (ret == TPM_SUCCESS)
+            ret = tpm_iface[tpmvers_choice]->ReseedInstance(template_flags);
+    }
+    if (ret == TPM_SUCCESS)
+        TPM_Capture_Init(tpmvers_choice == 0 ? TPMLIB_TPM_VERSION_1_2
+                                             : TPMLIB_TPM_VERSION_2);
+
+    return ret;
 }
 
 void TPMLIB_Terminate(void)
 {
     tpm_iface[tpmvers_choice]->Terminate();
+    FreeSnapshotDeltaBases();
+    TPM_NVRAM_Terminate();
+    TPM_Capture_Terminate();
 
     tpmvers_locked = FALSE;
 }
 
+
+/*
+ * Get the big endian uint32_t at the given offset in a command or response
+ * for a probe; the ordinal or response code are found at offset 6.
+ */
+static uint32_t TPMLIB_ProbeGetUint32(const unsigned char *buffer,
+                                      uint32_t buffer_size, uint32_t offset)
+{
+    if (!buffer || buffer_size < offset + 4)
+        return 0;
+    return ((uint32_t)buffer[offset] << 24) |
+           ((uint32_t)buffer[offset + 1] << 16) |
+           ((uint32_t)buffer[offset + 2] << 8) |
+           (uint32_t)buffer[offset + 3];
+}
+
 /*
  * Send a command to the TPM. The command buffer must hold a well formatted
  * TPM command and the command_size indicate the size of the command.
@@ -166,9 +264,22 @@ TPM_RESULT TPMLIB_Process(unsigned char **respbuffer, uint32_t *resp_size,
                           uint32_t *respbufsize,
 		          unsigned char *command, uint32_t command_size)
 {
-    return tpm_iface[tpmvers_choice]->Process(respbuffer,
+    TPM_RESULT ret;
+
+    TPM_PROBE2(process_entry,
+               TPMLIB_ProbeGetUint32(command, command_size, 6),
+               command_size);
+
+    ret = tpm_iface[tpmvers_choice]->Process(respbuffer,
                                  resp_size, respbufsize,
                                  command, command_size);
+
+    TPM_PROBE3(process_return,
+               TPMLIB_ProbeGetUint32(command, command_size, 6),
+               TPMLIB_ProbeGetUint32(*respbuffer, *resp_size, 6),
+               *resp_size);
+
+    return ret;
 }
 
 /*
@@ -219,15 +330,468 @@ char *TPMLIB_GetInfo(enum TPMLIB_InfoFlags flags)
 TPM_RESULT TPMLIB_SetState(enum TPMLIB_StateType st,
                            const unsigned char *buffer, uint32_t buflen)
 {
+    /* the application handles the stored state itself */
+    ClearAllStoredStateDigests();
+
     return tpm_iface[tpmvers_choice]->SetState(st, buffer, buflen);
 }
 
 TPM_RESULT TPMLIB_GetState(enum TPMLIB_StateType st,
                            unsigned char **buffer, uint32_t *buflen)
 {
+    ClearAllStoredStateDigests();
+
     return tpm_iface[tpmvers_choice]->GetState(st, buffer, buflen);
 }
 
+/* the property holding the maximum size of the state blob of the given type */
+static enum TPMLIB_TPMProperty StateTypeToMaxProperty(enum TPMLIB_StateType st)
+{
+    switch (st) {
+    case TPMLIB_STATE_PERMANENT:
+        return TPMPROP_TPM_MAX_NV_SPACE;
+    case TPMLIB_STATE_VOLATILE:
+        return TPMPROP_TPM_MAX_VOLATILESTATE_SPACE;
+    case TPMLIB_STATE_SAVE_STATE:
+        break;
+    }
+    return TPMPROP_TPM_MAX_SAVESTATE_SPACE;
+}
+
+/*
+ * Read a state blob in chunks from the reader function until it returns
+ * 0 bytes and set it. The chunks are copied into a single buffer sized for
+ * the largest blob of the given type, which the TPM then keeps.
+ */
+TPM_RESULT TPMLIB_SetStateStream(enum TPMLIB_StateType st,
+                                 TPMLIB_StateReader reader, void *opaque)
+{
+    TPM_RESULT ret;
+    unsigned char *buffer;
+    uint32_t bufsize, buflen = 0, nread;
+    int maxsize;
+
+    ret = TPMLIB_GetTPMProperty(StateTypeToMaxProperty(st), &maxsize);
+    if (ret != TPM_SUCCESS)
+        return ret;
+
+    /* one more byte than the largest blob detects a too large blob */
+    bufsize = (uint32_t)maxsize + 1;
+    buffer = malloc(bufsize);
+    if (!buffer) {
+        TPMLIB_LogError("Could not allocate %u bytes.\n", bufsize);
+        return TPM_SIZE;
+    }
+
+    while (TRUE) {
+        nread = 0;
+        ret = reader(opaque, &buffer[buflen], bufsize - buflen, &nread);
+        if (ret != TPM_SUCCESS || nread == 0)
+            break;
+        if (nread > bufsize - buflen) {
+            ret = TPM_BAD_PARAMETER;
+            break;
+        }
+        buflen += nread;
+        if (buflen == bufsize) {
+            TPMLIB_LogError("State blob exceeds the maximum of %d bytes.\n",
+                            maxsize);
+            ret = TPM_SIZE;
+            break;
+        }
+    }
+
+    if (ret != TPM_SUCCESS) {
+        free(buffer);
+        return ret;
+    }
+
+    if (buflen == 0) {
+        free(buffer);
+        return TPMLIB_SetState(st, NULL, 0);
+    }
+
+    /* the application handles the stored state itself */
+    ClearAllStoredStateDigests();
+
+    return tpm_iface[tpmvers_choice]->SetStateBuffer(st, buffer, buflen);
+}
+
+TPM_RESULT TPMLIB_GetStateStream(enum TPMLIB_StateType st,
+                                 TPMLIB_StateWriter writer, void *opaque)
+{
+    ClearAllStoredStateDigests();
+
+    return tpm_iface[tpmvers_choice]->GetStateStream(st, writer, opaque);
+}
+
+/*
+ * State deltas consist of a header followed by records that each replace
+ * a range of the previous state blob:
+ *
+ *   magic (4) | state type (4) | base generation (8) | generation (8) |
+ *   blob length (4) | number of records (4)
+ *   record: offset (4) | length (4) | data (length)
+ *
+ * All numbers are big endian. A base generation of 0 indicates that the
+ * records hold the complete blob.
+ */
+#define STATE_DELTA_MAGIC       0x54445354 /* 'TDST' */
+#define STATE_DELTA_HDR_SIZE    32
+#define STATE_DELTA_REC_SIZE    8
+#define STATE_DELTA_BLOCK_SIZE  256
+
+static unsigned char *delta_put(unsigned char *ptr, uint64_t val,
+                                unsigned int len)
+{
+    while (len--)
+        *ptr++ = (unsigned char)(val >> (8 * len));
+    return ptr;
+}
+
+static uint64_t delta_get(const unsigned char *ptr, unsigned int len)
+{
+    uint64_t val = 0;
+
+    while (len--)
+        val = (val << 8) | *ptr++;
+    return val;
+}
+
+static void ClearDeltaBase(enum TPMLIB_StateType st)
+{
+    free(delta_bases[st].buffer);
+    delta_bases[st].buffer = NULL;
+    delta_bases[st].buflen = 0;
+    delta_bases[st].generation = 0;
+    UpdateStateCacheUsage();
+}
+
+static void ClearAllDeltaBases(void)
+{
+    ClearDeltaBase(TPMLIB_STATE_VOLATILE);
+    ClearDeltaBase(TPMLIB_STATE_PERMANENT);
+    ClearDeltaBase(TPMLIB_STATE_SAVE_STATE);
+}
+
+/*
+ * Write the records for the blocks of blob that differ from the same
+ * blocks in base into out and return the number of bytes they need.
+ * Adjacent dirty blocks are combined into one record. If out is NULL
+ * only the size is computed.
+ */
+static uint32_t StateDeltaRecords(const unsigned char *base, uint32_t baselen,
+                                  const unsigned char *blob, uint32_t bloblen,
+                                  unsigned char *out, uint32_t *numrecords)
+{
+    uint32_t offset, len, start = 0, written = 0;
+    bool in_run = false, dirty;
+
+    *numrecords = 0;
+
+    for (offset = 0; offset <= bloblen; offset += len) {
+        len = bloblen - offset;
+        if (len > STATE_DELTA_BLOCK_SIZE)
+            len = STATE_DELTA_BLOCK_SIZE;
+
+        dirty = len > 0 &&
+                (offset + len > baselen ||
+                 memcmp(&base[offset], &blob[offset], len) != 0);
+        if (dirty && !in_run) {
+            start = offset;
+            in_run = true;
+        } else if (!dirty && in_run) {
+            if (out) {
+                out = delta_put(out, start, 4);
+                out = delta_put(out, offset - start, 4);
+                memcpy(out, &blob[start], offset - start);
+                out += offset - start;
+            }
+            written += STATE_DELTA_REC_SIZE + offset - start;
+            (*numrecords)++;
+            in_run = false;
+        }
+        if (len == 0)
+            break;
+    }
+
+    return written;
+}
+
+/*
+ * Get the difference between the state blob of the given type and the
+ * blob of the delta of the same type that was produced with generation
+ * since_generation. If since_generation is 0 or does not match the
+ * last produced delta, the delta holds the complete blob. The generation
+ * of the returned delta is returned in generation; it only changes when
+ * the state has changed.
+ */
+TPM_RESULT TPMLIB_GetStateDelta(enum TPMLIB_StateType st,
+                                uint64_t since_generation,
+                                unsigned char **delta, uint32_t *deltalen,
+                                uint64_t *generation)
+{
+    TPM_RESULT ret;
+    struct delta_base *base;
+    unsigned char *blob = NULL, *ptr;
+    uint32_t bloblen = 0, baselen = 0, numrecords, reclen;
+    const unsigned char *basebuf = NULL;
+    uint64_t base_generation = 0, new_generation;
+    bool changed = true;
+
+    *delta = NULL;
+    *deltalen = 0;
+
+    if (!TPMLIB_StateTypeToName(st))
+        return TPM_BAD_PARAMETER;
+    base = &delta_bases[st];
+
+    ret = TPMLIB_GetState(st, &blob, &bloblen);
+    if (ret != TPM_SUCCESS)
+        return ret;
+
+    if (since_generation != 0 && since_generation == base->generation) {
+        base_generation = base->generation;
+        basebuf = base->buffer;
+        baselen = base->buflen;
+        changed = (bloblen != baselen ||
+                   (bloblen > 0 && memcmp(blob, basebuf, bloblen) != 0));
+    }
+    new_generation = changed ? ++state_generation : base_generation;
+
+    reclen = StateDeltaRecords(basebuf, baselen, blob, bloblen,
+                               NULL, &numrecords);
+    *delta = malloc(STATE_DELTA_HDR_SIZE + reclen);
+    if (!*delta) {
+        TPMLIB_LogError("Could not allocate %u bytes.\n",
+                        STATE_DELTA_HDR_SIZE + reclen);
+        free(blob);
+        return TPM_SIZE;
+    }
+
+    ptr = delta_put(*delta, STATE_DELTA_MAGIC, 4);
+    ptr = delta_put(ptr, st, 4);
+    ptr = delta_put(ptr, base_generation, 8);
+    ptr = delta_put(ptr, new_generation, 8);
+    ptr = delta_put(ptr, bloblen, 4);
+    ptr = delta_put(ptr, numrecords, 4);
+    StateDeltaRecords(basebuf, baselen, blob, bloblen, ptr, &numrecords);
+
+    *deltalen = STATE_DELTA_HDR_SIZE + reclen;
+    *generation = new_generation;
+
+    if (changed) {
+        free(base->buffer);
+        base->buffer = blob;
+        base->buflen = bloblen;
+        base->generation = new_generation;
+        UpdateStateCacheUsage();
+    } else {
+        free(blob);
+    }
+
+    return TPM_SUCCESS;
+}
+
+/*
+ * Apply a delta produced by TPMLIB_GetStateDelta() to the blob of the
+ * previously applied delta of the same type and set the resulting state
+ * blob. A delta with base generation 0 holds the complete blob.
+ */
+TPM_RESULT TPMLIB_ApplyStateDelta(enum TPMLIB_StateType st,
+                                  const unsigned char *delta,
+                                  uint32_t deltalen)
+{
+    TPM_RESULT ret;
+    struct delta_base *base;
+    const unsigned char *ptr = delta, *end = delta + deltalen;
+    uint64_t base_generation, new_generation, maxlen;
+    uint32_t bloblen, numrecords, offset, len, i;
+    unsigned char *blob;
+    int maxsize;
+
+    if (!TPMLIB_StateTypeToName(st) || deltalen < STATE_DELTA_HDR_SIZE ||
+        delta_get(ptr, 4) != STATE_DELTA_MAGIC ||
+        delta_get(ptr + 4, 4) != st)
+        return TPM_BAD_PARAMETER;
+    base = &delta_bases[st];
+
+    base_generation = delta_get(ptr + 8, 8);
+    new_generation = delta_get(ptr + 16, 8);
+    bloblen = delta_get(ptr + 24, 4);
+    numrecords = delta_get(ptr + 28, 4);
+    ptr += STATE_DELTA_HDR_SIZE;
+
+    if (base_generation != 0 && base_generation != base->generation) {
+        TPMLIB_LogError("State delta is for generation %"PRIu64" "
+                        "but generation %"PRIu64" was applied last.\n",
+                        base_generation, base->generation);
+        return TPM_BAD_PARAMETER;
+    }
+    if (base_generation != 0 && base_generation == new_generation)
+        return TPM_SUCCESS;
+
+    /*
+     * Bytes beyond the base are always carried by the records, so a valid
+     * blob cannot be larger than the base plus the data of the records.
+     * Check this and the TPM's maximum state size before allocating.
+     */
+    if ((uint64_t)numrecords * STATE_DELTA_REC_SIZE >
+        deltalen - STATE_DELTA_HDR_SIZE)
+        return TPM_BAD_PARAMETER;
+    maxlen = deltalen - STATE_DELTA_HDR_SIZE -
+             (uint64_t)numrecords * STATE_DELTA_REC_SIZE;
+    if (base_generation != 0)
+        maxlen += base->buflen;
+    if (TPMLIB_GetTPMProperty(StateTypeToMaxProperty(st), &maxsize) ==
+            TPM_SUCCESS && maxsize >= 0 && (uint64_t)maxsize < maxlen)
+        maxlen = maxsize;
+    if (bloblen > maxlen) {
+        TPMLIB_LogError("State delta with blob size %u exceeds the maximum "
+                        "of %"PRIu64" bytes.\n", bloblen, maxlen);
+        return TPM_BAD_PARAMETER;
+    }
+
+    blob = calloc(1, bloblen ? bloblen : 1);
+    if (!blob) {
+        TPMLIB_LogError("Could not allocate %u bytes.\n", bloblen);
+        return TPM_SIZE;
+    }
+    if (base_generation != 0 && base->buflen > 0)
+        memcpy(blob, base->buffer,
+               base->buflen < bloblen ? base->buflen : bloblen);
+
+    for (i = 0; i < numrecords; i++) {
+        if (end - ptr < STATE_DELTA_REC_SIZE)
+            goto err_bad_parameter;
+        offset = delta_get(ptr, 4);
+        len = delta_get(ptr + 4, 4);
+        ptr += STATE_DELTA_REC_SIZE;
+        if (offset > bloblen || len > bloblen - offset ||
+            (uint32_t)(end - ptr) < len)
+            goto err_bad_parameter;
+        memcpy(&blob[offset], ptr, len);
+        ptr += len;
+    }
+    /* a truncated or concatenated delta must not be applied */
+    if (ptr != end)
+        goto err_bad_parameter;
+
+    ret = TPMLIB_SetState(st, bloblen ? blob : NULL, bloblen);
+    if (ret == TPM_SUCCESS) {
+        free(base->buffer);
+        base->buffer = blob;
+        base->buflen = bloblen;
+        base->generation = new_generation;
+        UpdateStateCacheUsage();
+    } else {
+        free(blob);
+    }
+
+    return ret;
+
+err_bad_parameter:
+    free(blob);
+
+    return TPM_BAD_PARAMETER;
+}
+
+/*
+ * Create a template holding the permanent and volatile state of the TPM.
+ * The state is taken from the running TPM or, if the TPM is not running,
+ * from the state that it would use upon TPMLIB_MainInit().
+ */
+TPM_RESULT TPMLIB_CreateStateTemplate(struct TPMLIB_StateTemplate **tmpl)
+{
+    struct TPMLIB_StateTemplate *t;
+    struct sized_buffer *blob;
+    TPM_RESULT ret = TPM_SUCCESS;
+    enum TPMLIB_StateType st;
+
+    t = calloc(1, sizeof(*t));
+    if (!t) {
+        TPMLIB_LogError("Could not allocate %zu bytes.\n", sizeof(*t));
+        return TPM_SIZE;
+    }
+    t->tpmvers_choice = tpmvers_choice;
+
+    for (st = TPMLIB_STATE_PERMANENT;
+         st <= TPMLIB_STATE_VOLATILE && ret == TPM_SUCCESS; st <<= 1) {
+        blob = &t->blobs[st];
+        ret = TPMLIB_GetState(st, &blob->buffer, &blob->buflen);
+        if (ret == TPM_RETRY && st == TPMLIB_STATE_VOLATILE)
+            ret = TPM_SUCCESS;
+        if (ret != TPM_SUCCESS || !blob->buffer) {
+            blob->buffer = NULL;
+            blob->buflen = 0;
+        }
+    }
+    if (ret == TPM_SUCCESS && !t->blobs[TPMLIB_STATE_PERMANENT].buffer)
+        ret = TPM_FAIL;
+
+    if (ret == TPM_SUCCESS)
+        *tmpl = t;
+    else
+        TPMLIB_FreeStateTemplate(t);
+
+    return ret;
+}
+
+/*
+ * Have the TPM use a copy of the state in the template upon the next
+ * TPMLIB_MainInit(). The state blobs were produced by the TPM, so they are
+ * copied without being tested again. TPMLIB_MainInit() reseeds the random
+ * number generator of the new instance and renews the primary seeds
+ * selected in flags.
+ */
+TPM_RESULT TPMLIB_InstantiateStateTemplate(
+                                    const struct TPMLIB_StateTemplate *tmpl,
+                                    unsigned int flags)
+{
+    enum TPMLIB_StateType st;
+    unsigned char *buffer[TPMLIB_STATE_SAVE_STATE + 1] = { NULL, };
+    const struct sized_buffer *blob;
+
+    if (tpmvers_locked)
+        return TPM_INVALID_POSTINIT;
+    if (!tmpl || tmpl->tpmvers_choice != tpmvers_choice ||
+        (flags & ~(TPMLIB_TEMPLATE_NEW_EPS | TPMLIB_TEMPLATE_NEW_SPS |
+                   TPMLIB_TEMPLATE_NEW_PPS)))
+        return TPM_BAD_PARAMETER;
+
+    for (st = TPMLIB_STATE_PERMANENT; st <= TPMLIB_STATE_VOLATILE; st <<= 1) {
+        blob = &tmpl->blobs[st];
+        if (!blob->buffer)
+            continue;
+        buffer[st] = malloc(blob->buflen);
+        if (!buffer[st]) {
+            TPMLIB_LogError("Could not allocate %u bytes.\n", blob->buflen);
+            free(buffer[TPMLIB_STATE_PERMANENT]);
+            return TPM_SIZE;
+        }
+        memcpy(buffer[st], blob->buffer, blob->buflen);
+    }
+
+    /* an absent blob must not be read from elsewhere */
+    for (st = TPMLIB_STATE_PERMANENT; st <= TPMLIB_STATE_SAVE_STATE; st <<= 1)
+        SetCachedState(st, buffer[st], tmpl->blobs[st].buflen);
+
+    template_pending = TRUE;
+    template_flags = flags;
+
+    return TPM_SUCCESS;
+}
+
+void TPMLIB_FreeStateTemplate(struct TPMLIB_StateTemplate *tmpl)
+{
+    if (!tmpl)
+        return;
+
+    free(tmpl->blobs[TPMLIB_STATE_PERMANENT].buffer);
+    free(tmpl->blobs[TPMLIB_STATE_VOLATILE].buffer);
+    free(tmpl);
+}
+
 TPM_RESULT TPM_IO_Hash_Start(void)
 {
     return tpm_iface[tpmvers_choice]->HashStart();
@@ -262,12 +826,103 @@ uint32_t TPMLIB_SetBufferSize(uint32_t wanted_size,
                                                     max_size);
 }
 
+uint32_t TPMLIB_SetKeyHandles(uint32_t wanted,
+                              uint32_t *min,
+                              uint32_t *max)
+{
+    return tpm_iface[tpmvers_choice]->SetKeyHandles(wanted, min, max);
+}
+
 TPM_RESULT TPMLIB_ValidateState(enum TPMLIB_StateType st,
                                 unsigned int flags)
 {
     return tpm_iface[tpmvers_choice]->ValidateState(st, flags);
 }
 
+TPM_RESULT TPMLIB_ValidateStateBlob(enum TPMLIB_StateType st,
+                                    const unsigned char *buffer,
+                                    uint32_t buflen, unsigned int flags)
+{
+    return tpm_iface[tpmvers_choice]->ValidateStateBlob(st, buffer, buflen,
+                                                        flags);
+}
+
+/*
+ * Copy the delta bases from src to dst. A base that cannot be copied is
+ * cleared, so that the next delta of its type holds the complete blob.
+ */
+static void CopyDeltaBases(struct delta_base *dst,
+                           const struct delta_base *src)
+{
+    int st;
+
+    for (st = 0; st <= TPMLIB_STATE_SAVE_STATE; st++) {
+        free(dst[st].buffer);
+        dst[st].buffer = NULL;
+        dst[st].buflen = 0;
+        dst[st].generation = 0;
+        if (!src[st].buffer)
+            continue;
+        dst[st].buffer = malloc(src[st].buflen);
+        if (!dst[st].buffer)
+            continue;
+        memcpy(dst[st].buffer, src[st].buffer, src[st].buflen);
+        dst[st].buflen = src[st].buflen;
+        dst[st].generation = src[st].generation;
+    }
+    UpdateStateCacheUsage();
+}
+
+static void FreeSnapshotDeltaBases(void)
+{
+    static const struct delta_base none[TPMLIB_STATE_SAVE_STATE + 1];
+
+    CopyDeltaBases(snapshot_delta_bases, none);
+}
+
+/*
+ * Take an in-memory snapshot of the running TPM's state that
+ * TPMLIB_ResetToSnapshot() can restore far more quickly than the TPM can be
+ * re-initialized from its state blobs. Besides the TPM's state, the snapshot
+ * holds the bases of the state deltas. The snapshot is freed by
+ * TPMLIB_Terminate().
+ */
+TPM_RESULT TPMLIB_TakeSnapshot(void)
+{
+    TPM_RESULT ret;
+
+    if (!tpmvers_locked)
+        return TPM_INVALID_POSTINIT;
+
+    ret = tpm_iface[tpmvers_choice]->TakeSnapshot();
+    if (ret == TPM_SUCCESS)
+        CopyDeltaBases(snapshot_delta_bases, delta_bases);
+
+    return ret;
+}
+
+/*
+ * Reset the TPM to the snapshot. The generation of the state deltas keeps
+ * counting up, so that a generation never names two different blobs. The
+ * storage still holds the state stored after the snapshot was taken, so the
+ * digests of the stored state are cleared rather than reset.
+ */
+TPM_RESULT TPMLIB_ResetToSnapshot(void)
+{
+    TPM_RESULT ret;
+
+    if (!tpmvers_locked)
+        return TPM_INVALID_POSTINIT;
+
+    ret = tpm_iface[tpmvers_choice]->ResetToSnapshot();
+    if (ret == TPM_SUCCESS) {
+        CopyDeltaBases(delta_bases, snapshot_delta_bases);
+        ClearAllStoredStateDigests();
+    }
+
+    return ret;
+}
+
 TPM_RESULT TPMLIB_SetProfile(const char *profile)
 {
     return tpm_iface[tpmvers_choice]->SetProfile(profile);
@@ -299,6 +954,9 @@ TPM_RESULT TPMLIB_RegisterCallbacks(struct libtpms_callbacks *callbacks)
     memset(&libtpms_cbs, 0x0, sizeof(libtpms_cbs));
     memcpy(&libtpms_cbs, callbacks, max_size);
 
+    /* the new callbacks may store the state elsewhere */
+    ClearAllStoredStateDigests();
+
     return TPM_SUCCESS;
 }
 
@@ -468,14 +1126,122 @@ TPM_RESULT TPMLIB_DecodeBlob(const char *buffer, enum TPMLIB_BlobType type,
     return res;
 }
 
+static void TPMLIB_UpdateLogLevel(void)
+{
+    if ((debug_fd || debug_ring.buffer) && debug_level)
+        tpmlib_log_level = debug_level;
+    else
+        tpmlib_log_level = 0;
+}
+
 void TPMLIB_SetDebugFD(int fd)
 {
     debug_fd = fd;
+    TPMLIB_UpdateLogLevel();
 }
 
 void TPMLIB_SetDebugLevel(unsigned level)
 {
     debug_level = level;
+    TPMLIB_UpdateLogLevel();
+}
+
+TPM_RESULT TPMLIB_SetDebugRingBuffer(size_t size)
+{
+    size_t ringsize = DEBUG_RING_MIN_SIZE;
+    char *buffer = NULL;
+
+    if (size > DEBUG_RING_MAX_SIZE)
+        return TPM_BAD_PARAMETER;
+
+    if (size > 0) {
+        while (ringsize < size)
+            ringsize <<= 1;
+
+        buffer = malloc(ringsize);
+        if (!buffer) {
+            TPMLIB_LogError("Could not allocate %zu bytes.\n", ringsize);
+            return TPM_SIZE;
+        }
+    }
+
+    free(debug_ring.buffer);
+    debug_ring.buffer = buffer;
+    debug_ring.size = buffer ? ringsize : 0;
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_DEBUG_RING,
+                          debug_ring.size, debug_ring.size);
+    debug_ring.head = 0;
+    debug_ring.tail = 0;
+    debug_ring.dropped = 0;
+
+    TPMLIB_UpdateLogLevel();
+
+    return TPM_SUCCESS;
+}
+
+/* copy data into the ring buffer starting at the free-running index pos */
+static void TPMLIB_DebugRingCopyIn(size_t pos, const char *data, size_t len)
+{
+    size_t offset = pos & (debug_ring.size - 1);
+    size_t n = debug_ring.size - offset;
+
+    if (n > len)
+        n = len;
+    memcpy(&debug_ring.buffer[offset], data, n);
+    memcpy(debug_ring.buffer, &data[n], len - n);
+}
+
+/* append a line with an optional prefix to the ring buffer or drop it */
+static void TPMLIB_DebugRingPut(const char *prefix, const char *line)
+{
+    size_t prefixlen = prefix ? strlen(prefix) : 0;
+    size_t linelen = strlen(line);
+    size_t head = debug_ring.head;
+    size_t tail = __atomic_load_n(&debug_ring.tail, __ATOMIC_ACQUIRE);
+
+    if (prefixlen + linelen > debug_ring.size - (head - tail)) {
+        __atomic_fetch_add(&debug_ring.dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (prefixlen)
+        TPMLIB_DebugRingCopyIn(head, prefix, prefixlen);
+    TPMLIB_DebugRingCopyIn(head + prefixlen, line, linelen);
+
+    /* publish the line to the consumer */
+    __atomic_store_n(&debug_ring.head, head + prefixlen + linelen,
+                     __ATOMIC_RELEASE);
+}
+
+size_t TPMLIB_ReadDebugRingBuffer(char *buffer, size_t bufsize,
+                                  size_t *dropped)
+{
+    size_t head, tail, offset, n = 0, m;
+
+    if (debug_ring.buffer) {
+        head = __atomic_load_n(&debug_ring.head, __ATOMIC_ACQUIRE);
+        tail = debug_ring.tail;
+
+        n = head - tail;
+        if (n > bufsize)
+            n = bufsize;
+
+        offset = tail & (debug_ring.size - 1);
+        m = debug_ring.size - offset;
+        if (m > n)
+            m = n;
+        memcpy(buffer, &debug_ring.buffer[offset], m);
+        memcpy(&buffer[m], debug_ring.buffer, n - m);
+
+        /* hand the space back to the producer */
+        __atomic_store_n(&debug_ring.tail, tail + n, __ATOMIC_RELEASE);
+    }
+
+    if (dropped)
+        *dropped = __atomic_exchange_n(&debug_ring.dropped, 0,
+                                       __ATOMIC_RELAXED);
+
+    return n;
 }
 
 TPM_RESULT TPMLIB_SetDebugPrefix(const char *prefix)
@@ -495,12 +1261,12 @@ TPM_RESULT TPMLIB_SetDebugPrefix(const char *prefix)
 
 int TPMLIB_LogPrintf(const char *format, ...)
 {
-    unsigned level = debug_level, i;
+    unsigned level = tpmlib_log_level, i;
     va_list args;
     char buffer[256];
     int n;
 
-    if (!debug_fd || !debug_level)
+    if (!level)
         return -1;
 
     va_start(args, format);
@@ -523,6 +1289,11 @@ int TPMLIB_LogPrintf(const char *format, ...)
         i++;
     }
 
+    if (debug_ring.buffer) {
+        TPMLIB_DebugRingPut(debug_prefix, buffer);
+        return i;
+    }
+
     if (debug_prefix)
         dprintf(debug_fd, "%s", debug_prefix);
     dprintf(debug_fd, "%s", buffer);
@@ -545,7 +1316,7 @@ void TPMLIB_LogPrintfA(unsigned int indent, const char *format, ...)
     int fd;
 
     if (indent != (unsigned int)~0) {
-        if (!debug_fd || !debug_level)
+        if (!tpmlib_log_level)
            return;
         fd = debug_fd;
     } else {
@@ -553,14 +1324,25 @@ void TPMLIB_LogPrintfA(unsigned int indent, const char *format, ...)
         fd = (debug_fd >= 0) ? debug_fd : STDERR_FILENO;
     }
 
-    if (indent) {
-        if (indent > sizeof(spaces) - 1)
-            indent = sizeof(spaces) - 1;
-        memset(spaces, ' ', indent);
-        spaces[indent] = 0;
-        dprintf(fd, "%s", spaces);
+    if (indent > sizeof(spaces) - 1)
+        indent = sizeof(spaces) - 1;
+    memset(spaces, ' ', indent);
+    spaces[indent] = 0;
+
+    if (debug_ring.buffer) {
+        char buffer[256];
+
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+
+        TPMLIB_DebugRingPut(spaces, buffer);
+        return;
     }
 
+    if (indent)
+        dprintf(fd, "%s", spaces);
+
     va_start(args, format);
     vdprintf(fd, format, args);
     va_end(args);
@@ -580,6 +1362,9 @@ void TPMLIB_LogArray(unsigned int indent, const unsigned char *data,
     char line[80];
     size_t i, o = 0;
 
+    if (indent != (unsigned int)~0 && !tpmlib_log_level)
+        return;
+
     for (i = 0; i < datalen; i++) {
         snprintf(&line[o], sizeof(line) - o, "%02x ", data[i]);
         o += 3;
@@ -605,11 +1390,29 @@ int TPMLIB_asprintf(char **strp, const char *fmt, ...)
     return ret;
 }
 
+/* account for the memory held by the cached state blobs and delta bases */
+static void UpdateStateCacheUsage(void)
+{
+    size_t size = 0;
+    int st;
+
+    for (st = 0; st <= TPMLIB_STATE_SAVE_STATE; st++) {
+        if (cached_blobs[st].buffer)
+            size += cached_blobs[st].buflen;
+        if (delta_bases[st].buffer)
+            size += delta_bases[st].buflen;
+        if (snapshot_delta_bases[st].buffer)
+            size += snapshot_delta_bases[st].buflen;
+    }
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_STATE_CACHE, size, size);
+}
+
 void ClearCachedState(enum TPMLIB_StateType st)
 {
     free(cached_blobs[st].buffer);
     cached_blobs[st].buffer = NULL;
     cached_blobs[st].buflen = 0;
+    UpdateStateCacheUsage();
 }
 
 void ClearAllCachedState(void)
@@ -629,6 +1432,7 @@ void SetCachedState(enum TPMLIB_StateType st,
     free(cached_blobs[st].buffer);
     cached_blobs[st].buffer = buffer;
     cached_blobs[st].buflen = buffer ? buflen : BUFLEN_EMPTY_BUFFER;
+    UpdateStateCacheUsage();
 }
 
 void GetCachedState(enum TPMLIB_StateType st,
@@ -641,6 +1445,7 @@ void GetCachedState(enum TPMLIB_StateType st,
     *is_empty_buffer = (*buflen == BUFLEN_EMPTY_BUFFER);
     cached_blobs[st].buffer = NULL;
     cached_blobs[st].buflen = 0;
+    UpdateStateCacheUsage();
 }
 
 bool HasCachedState(enum TPMLIB_StateType st)
@@ -675,6 +1480,55 @@ TPM_RESULT CopyCachedState(enum TPMLIB_StateType st,
     return ret;
 }
 
+/*
+ * Compute the digest of a state blob that is about to be stored. Returns
+ * false if no digest could be computed.
+ */
+bool ComputeStoredStateDigest(const unsigned char *buffer, uint32_t buflen,
+                              unsigned char *digest)
+{
+#ifdef USE_OPENSSL_CRYPTO_LIBRARY
+    return EVP_Digest(buffer, buflen, digest, NULL, EVP_sha256(), NULL) == 1;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Check whether the digest matches the one of the state blob of the same
+ * type that was stored last, in which case storing it again can be skipped.
+ * This assumes that libtpms is the only writer of the stored state. The
+ * digests are therefore cleared whenever the state is loaded through the
+ * callbacks or accessed through TPMLIB_SetState() or TPMLIB_GetState().
+ */
+bool StoredStateDigestMatches(enum TPMLIB_StateType st,
+                              const unsigned char *digest)
+{
+    return stored_digests[st].valid &&
+           !memcmp(stored_digests[st].digest, digest,
+                   sizeof(stored_digests[st].digest));
+}
+
+/*
+ * Remember the digest of the state blob that was stored; a NULL digest
+ * indicates that the stored state is unknown.
+ */
+void SetStoredStateDigest(enum TPMLIB_StateType st,
+                          const unsigned char *digest)
+{
+    stored_digests[st].valid = (digest != NULL);
+    if (digest)
+        memcpy(stored_digests[st].digest, digest,
+               sizeof(stored_digests[st].digest));
+}
+
+void ClearAllStoredStateDigests(void)
+{
+    SetStoredStateDigest(TPMLIB_STATE_VOLATILE, NULL);
+    SetStoredStateDigest(TPMLIB_STATE_PERMANENT, NULL);
+    SetStoredStateDigest(TPMLIB_STATE_SAVE_STATE, NULL);
+}
+
 const char *TPMLIB_StateTypeToName(enum TPMLIB_StateType st)
 {
     switch (st) {
@@ -700,3 +1554,24 @@ enum TPMLIB_StateType TPMLIB_NameToStateType(const char *name)
         return TPMLIB_STATE_SAVE_STATE;
     return 0;
 }
+
+/*
+ * Pass a state blob to the writer function in chunks of at most
+ * TPMLIB_STATE_CHUNK_SIZE bytes.
+ */
+TPM_RESULT TPMLIB_WriteStateChunks(const unsigned char *buffer,
+                                   uint32_t buflen,
+                                   TPMLIB_StateWriter writer, void *opaque)
+{
+    TPM_RESULT ret = TPM_SUCCESS;
+    uint32_t offset, len;
+
+    for (offset = 0; offset < buflen && ret == TPM_SUCCESS; offset += len) {
+        len = buflen - offset;
+        if (len > TPMLIB_STATE_CHUNK_SIZE)
+            len = TPMLIB_STATE_CHUNK_SIZE;
+        ret = writer(opaque, &buffer[offset], len);
+    }
+
+    return ret;
+}
@@ -79,6 +79,13 @@
  */
 #define TPM_KEY_HANDLES                  20            /* SS, VA,  BAL */
 
+/*
+ * The number of key slots can be raised at runtime using
+ * TPMLIB_SetKeyHandles() up to the following maximum. The default
+ * number of key slots is TPM_KEY_HANDLES.
+ */
+#define TPM_KEY_HANDLES_MAX              48            /* SS, VA,  BAL */
+
 /*
  * Every 2048 bit key on which the owner evict key flag is set
  * accounts for an increase of 559 bytes of the permanentall
@@ -141,20 +148,33 @@
                                       TPM_OWNER_EVICT_KEY_HANDLES * 559 + \
                                       TPM_MAX_NV_DEFINED_SIZE)
 
-#define TPM_MAX_SAVESTATE_SPACE      (972 + /* base size */         \
-                                      TPM_KEY_HANDLES * 559 +       \
+/*
+ * The savestate and volatile state space depend on the number of key
+ * slots of a TPM instance; the _KEYS variants take that number and the
+ * plain macros give the space for the largest number of key slots.
+ */
+#define TPM_MAX_SAVESTATE_SPACE_KEYS(KEY_HANDLES)                   \
+                                     (972 + /* base size */         \
+                                      (KEY_HANDLES) * 559 +         \
                                       TPM_MIN_TRANS_SESSIONS * 78 + \
                                       TPM_MIN_DAA_SESSIONS * 844 +  \
                                       TPM_MIN_AUTH_SESSIONS * 119 + \
                                       TPM_SPACE_SAFETY_MARGIN)
 
-#define TPM_MAX_VOLATILESTATE_SPACE  (1203  + /* base size */       \
-                                      TPM_KEY_HANDLES * 559 +       \
+#define TPM_MAX_VOLATILESTATE_SPACE_KEYS(KEY_HANDLES)               \
+                                     (1203  + /* base size */       \
+                                      (KEY_HANDLES) * 559 +         \
                                       TPM_MIN_TRANS_SESSIONS * 78 + \
                                       TPM_MIN_DAA_SESSIONS * 844 +  \
                                       TPM_MIN_AUTH_SESSIONS * 119 + \
                                       TPM_SPACE_SAFETY_MARGIN)
 
+#define TPM_MAX_SAVESTATE_SPACE      \
+        TPM_MAX_SAVESTATE_SPACE_KEYS(TPM_KEY_HANDLES_MAX)
+
+#define TPM_MAX_VOLATILESTATE_SPACE  \
+        TPM_MAX_VOLATILESTATE_SPACE_KEYS(TPM_KEY_HANDLES_MAX)
+
 /*
  * The timeouts in microseconds.
  *
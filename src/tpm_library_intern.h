@@ -82,10 +82,23 @@ struct tpm_interface {
                                 unsigned int flags);
     TPM_RESULT (*SetState)(enum TPMLIB_StateType st,
                            const unsigned char *buffer, uint32_t buflen);
+    /* like SetState but takes ownership of the buffer */
+    TPM_RESULT (*SetStateBuffer)(enum TPMLIB_StateType st,
+                                 unsigned char *buffer, uint32_t buflen);
     TPM_RESULT (*GetState)(enum TPMLIB_StateType st,
                            unsigned char **buffer, uint32_t *buflen);
     TPM_RESULT (*SetProfile)(const char *profile);
     TPM_BOOL (*WasManufactured)(void);
+    uint32_t (*SetKeyHandles)(uint32_t wanted, uint32_t *min,
+                              uint32_t *max);
+    TPM_RESULT (*GetStateStream)(enum TPMLIB_StateType st,
+                                 TPMLIB_StateWriter writer, void *opaque);
+    TPM_RESULT (*ValidateStateBlob)(enum TPMLIB_StateType st,
+                                    const unsigned char *buffer,
+                                    uint32_t buflen, unsigned int flags);
+    TPM_RESULT (*ReseedInstance)(unsigned int flags);
+    TPM_RESULT (*TakeSnapshot)(void);
+    TPM_RESULT (*ResetToSnapshot)(void);
 };
 
 extern const struct tpm_interface DisabledInterface;
@@ -100,6 +113,7 @@ TPM_RESULT TPM12_IO_Hash_End(void);
 TPM_RESULT TPM12_IO_TpmEstablished_Get(TPM_BOOL *tpmEstablished);
 
 uint32_t TPM12_GetBufferSize(void);
+uint32_t TPM12_GetKeyHandles(void);
 
 TPM_RESULT TPM12_IO_TpmEstablished_Reset(void);
 
@@ -117,6 +131,39 @@ void TPMLIB_LogArray(unsigned int indent, const unsigned char *data,
 #define TPMLIB_LogTPM2Error(format, ...) \
      TPMLIB_LogPrintfA(~0, "libtpms/tpm2: "format, __VA_ARGS__)
 
+/* the debug level in effect; 0 if no debug output is produced */
+extern unsigned int tpmlib_log_level;
+
+/*
+ * TPMLIB_LogWouldPrint: Check whether TPMLIB_LogPrintf() could print a
+ * line with the given format without formatting it. A line is not printed
+ * if it is indented by at least as many spaces as the debug level.
+ */
+static inline bool TPMLIB_LogWouldPrint(const char *format)
+{
+    unsigned int level = tpmlib_log_level, i;
+
+    if (level == 0)
+        return false;
+
+    for (i = 0; format[i] == ' '; i++) {
+        if (i + 1 == level)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * TPMLIB_LogDebug: TPMLIB_LogPrintf() that neither evaluates its
+ * arguments nor formats them if the line would not be printed.
+ */
+#define TPMLIB_LOG_FORMAT(format, ...) format
+#define TPMLIB_LogDebug(...) \
+     do { \
+         if (TPMLIB_LogWouldPrint(TPMLIB_LOG_FORMAT(__VA_ARGS__, ""))) \
+             TPMLIB_LogPrintf(__VA_ARGS__); \
+     } while (0)
+
 int TPMLIB_asprintf(char **strp, const char *fmt, ...);
 
 /* prototypes for TPM2 */
@@ -145,9 +192,31 @@ TPM_RESULT CopyCachedState(enum TPMLIB_StateType st,
                            unsigned char **buffer, uint32_t *buflen,
                            bool *is_empty_buffer);
 
+/* size of the digests of stored state blobs (SHA-256) */
+#define STORED_STATE_DIGEST_SIZE 32
+
+bool ComputeStoredStateDigest(const unsigned char *buffer, uint32_t buflen,
+                              unsigned char *digest);
+bool StoredStateDigestMatches(enum TPMLIB_StateType st,
+                              const unsigned char *digest);
+void SetStoredStateDigest(enum TPMLIB_StateType st,
+                          const unsigned char *digest);
+void ClearAllStoredStateDigests(void);
+
+/* size of the chunks state blobs are streamed in */
+#define TPMLIB_STATE_CHUNK_SIZE (16 * 1024)
+
+TPM_RESULT TPMLIB_WriteStateChunks(const unsigned char *buffer,
+                                   uint32_t buflen,
+                                   TPMLIB_StateWriter writer, void *opaque);
+
 const char *TPMLIB_StateTypeToName(enum TPMLIB_StateType st);
 enum TPMLIB_StateType TPMLIB_NameToStateType(const char *name);
 
+/* in-memory snapshots for the fuzzer; not exported from the shared library */
+TPM_RESULT TPMLIB_TakeSnapshot(void);
+TPM_RESULT TPMLIB_ResetToSnapshot(void);
+
 uint32_t TPM2_GetBufferSize(void);
 TPM_RESULT TPM2_PersistentAllStore(unsigned char **buf, uint32_t *buflen);
 
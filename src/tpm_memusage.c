@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tpm_library_intern.h"
+#include "tpm_memusage.h"
+
+#define MEMUSAGE_TPM12   (1 << 0)
+#define MEMUSAGE_TPM2    (1 << 1)
+#define MEMUSAGE_SUBSET  (1 << 2) /* not added to the total */
+
+static const struct {
+    const char *name;
+    unsigned int flags;
+} memusage_types[TPMLIB_MEMUSAGE_NUM] = {
+    [TPMLIB_MEMUSAGE_STATE_CACHE] = {
+        .name = "StateCache",
+        .flags = MEMUSAGE_TPM12 | MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_DEBUG_RING] = {
+        .name = "DebugRingBuffer",
+        .flags = MEMUSAGE_TPM12 | MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_NV] = {
+        .name = "NV",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_OBJECTS] = {
+        .name = "Objects",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_HASH_SEQUENCES] = {
+        .name = "HashSequences",
+        .flags = MEMUSAGE_TPM2 | MEMUSAGE_SUBSET,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_SESSIONS] = {
+        .name = "Sessions",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_EXPDCACHE] = {
+        .name = "ExpDCache",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_CIPHER_CACHE] = {
+        .name = "CipherCache",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_RUNTIME_PROFILE] = {
+        .name = "RuntimeProfile",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM2_SNAPSHOT] = {
+        .name = "Snapshot",
+        .flags = MEMUSAGE_TPM2,
+    },
+    [TPMLIB_MEMUSAGE_TPM12_KEY_HANDLES] = {
+        .name = "KeyHandles",
+        .flags = MEMUSAGE_TPM12,
+    },
+    [TPMLIB_MEMUSAGE_TPM12_NV_INDICES] = {
+        .name = "NVIndices",
+        .flags = MEMUSAGE_TPM12,
+    },
+};
+
+static struct {
+    size_t size;
+    size_t in_use;
+    size_t peak;
+} memusage[TPMLIB_MEMUSAGE_NUM];
+
+void TPMLIB_MemoryUsageSet(enum TPMLIB_MemoryUsageType type,
+                           size_t size, size_t in_use)
+{
+    memusage[type].size = size;
+    memusage[type].in_use = in_use;
+    if (in_use > memusage[type].peak)
+        memusage[type].peak = in_use;
+}
+
+/*
+ * TPMLIB_MemoryUsagePrint: Print the memory usage of the subsystems
+ *                          of the given TPM version as JSON
+ *
+ * @tpmversion: the version of the TPM
+ *
+ * Returns the "MemoryUsage" JSON object or NULL on error.
+ */
+char *TPMLIB_MemoryUsagePrint(TPMLIB_TPMVersion tpmversion)
+{
+    unsigned int mask = (tpmversion == TPMLIB_TPM_VERSION_2)
+                        ? MEMUSAGE_TPM2 : MEMUSAGE_TPM12;
+    size_t total_size = 0, total_in_use = 0;
+    char *buffer = NULL, *tmp;
+    bool printed = false;
+    size_t i;
+
+    if (!(buffer = strdup("\"MemoryUsage\":{")))
+        return NULL;
+
+    for (i = 0; i < TPMLIB_MEMUSAGE_NUM; i++) {
+        if (!(memusage_types[i].flags & mask))
+            continue;
+
+        tmp = buffer;
+        buffer = NULL;
+        if (TPMLIB_asprintf(&buffer,
+                            "%s%s\"%s\":{\"size\":%zu,\"inUse\":%zu,\"peak\":%zu}",
+                            tmp, printed ? "," : "",
+                            memusage_types[i].name, memusage[i].size,
+                            memusage[i].in_use, memusage[i].peak) < 0) {
+            free(tmp);
+            return NULL;
+        }
+        free(tmp);
+        printed = true;
+
+        if (!(memusage_types[i].flags & MEMUSAGE_SUBSET)) {
+            total_size += memusage[i].size;
+            total_in_use += memusage[i].in_use;
+        }
+    }
+
+    tmp = buffer;
+    buffer = NULL;
+    if (TPMLIB_asprintf(&buffer, "%s,\"Total\":{\"size\":%zu,\"inUse\":%zu}}",
+                        tmp, total_size, total_in_use) < 0)
+        buffer = NULL;
+    free(tmp);
+
+    return buffer;
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+#ifndef TPM_MEMUSAGE_H
+#define TPM_MEMUSAGE_H
+
+#include <stddef.h>
+
+#include "tpm_library.h"
+
+/*
+ * Accounting of the memory held by the subsystems of libtpms.
+ *
+ * The subsystems report the number of bytes they hold ('size'), which
+ * includes statically sized tables, and the number of those bytes used by
+ * live entries ('inUse') whenever these change or are sampled. The peak of
+ * 'inUse' is kept and reported by TPMLIB_GetInfo(TPMLIB_INFO_MEMORY_USAGE).
+ * Sizes of OpenSSL objects are approximated by the size of their numbers.
+ */
+enum TPMLIB_MemoryUsageType {
+    TPMLIB_MEMUSAGE_STATE_CACHE,
+    TPMLIB_MEMUSAGE_DEBUG_RING,
+    TPMLIB_MEMUSAGE_TPM2_NV,
+    TPMLIB_MEMUSAGE_TPM2_OBJECTS,
+    TPMLIB_MEMUSAGE_TPM2_HASH_SEQUENCES,  /* part of TPM2_OBJECTS */
+    TPMLIB_MEMUSAGE_TPM2_SESSIONS,
+    TPMLIB_MEMUSAGE_TPM2_EXPDCACHE,
+    TPMLIB_MEMUSAGE_TPM2_CIPHER_CACHE,
+    TPMLIB_MEMUSAGE_TPM2_RUNTIME_PROFILE,
+    TPMLIB_MEMUSAGE_TPM2_SNAPSHOT,
+    TPMLIB_MEMUSAGE_TPM12_KEY_HANDLES,
+    TPMLIB_MEMUSAGE_TPM12_NV_INDICES,
+
+    TPMLIB_MEMUSAGE_NUM
+};
+
+void TPMLIB_MemoryUsageSet(enum TPMLIB_MemoryUsageType type,
+                           size_t size, size_t in_use);
+char *TPMLIB_MemoryUsagePrint(TPMLIB_TPMVersion tpmversion);
+
+#endif /* TPM_MEMUSAGE_H */
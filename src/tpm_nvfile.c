@@ -54,6 +54,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "tpm_debug.h"
 #include "tpm_error.h"
@@ -64,6 +68,7 @@
 #ifdef TPM_LIBTPMS_CALLBACKS
 #include "tpm_library_intern.h"
 #include "tpm_library.h"
+#include "tpm_probes.h"
 #endif
 
 
@@ -73,6 +78,27 @@ static TPM_RESULT TPM_NVRAM_GetFilenameForName(char *filename,
                                                size_t filename_len,
 					       uint32_t tpm_number,
                                                const char *name);
+static TPM_RESULT TPM_NVRAM_WriteData(const unsigned char *data,
+                                      uint32_t length,
+                                      uint32_t tpm_number,
+                                      const char *name);
+
+static void       TPM_NVRAM_JournalClose(void);
+static TPM_RESULT TPM_NVRAM_JournalOpen(void);
+static TPM_RESULT TPM_NVRAM_JournalCheckpoint(void);
+static TPM_RESULT TPM_NVRAM_JournalRecover(void);
+static TPM_RESULT TPM_NVRAM_JournalLoad(unsigned char **data,
+                                        uint32_t *length,
+                                        TPM_BOOL *found,
+                                        uint32_t tpm_number,
+                                        const char *name);
+static TPM_RESULT TPM_NVRAM_JournalStore(const unsigned char *data,
+                                         uint32_t length,
+                                         uint32_t tpm_number,
+                                         const char *name);
+static TPM_RESULT TPM_NVRAM_JournalDelete(uint32_t tpm_number,
+                                          const char *name,
+                                          TPM_BOOL mustExist);
 
 
 /* A file name in NVRAM is composed of 3 parts:
@@ -91,6 +117,45 @@ static TPM_RESULT TPM_NVRAM_GetFilenameForName(char *filename,
 
 char state_directory[FILENAME_MAX];
 
+/* The journal backend is enabled by setting the TPM_NV_JOURNAL environment variable to the number
+   of records that are appended between calls to fsync().
+
+   Stored state is appended as a checksummed record to the journal file in the state directory
+   rather than rewriting the file for the name.  When loading, the latest record for a name takes
+   precedence over its file.  The journal is replayed when it is first used and a torn record at
+   its end is discarded.  Once the journal grows beyond TPM_JOURNAL_MAX_SIZE, it is checkpointed:
+   the latest state for each name is atomically written to its file and the journal is truncated.
+
+   A journal left behind by a previous run is checkpointed by TPM_NVRAM_Init() even if
+   TPM_NV_JOURNAL is not set anymore, so that its state is never rolled back.  TPM_NVRAM_Terminate()
+   checkpoints and closes the journal.
+*/
+
+#define TPM_JOURNAL_NAME        "journal"
+#define TPM_JOURNAL_MAGIC       0x544a4e4c      /* 'TJNL' */
+#define TPM_JOURNAL_HDR_SIZE    24
+#define TPM_JOURNAL_MAX_SIZE    (1024 * 1024)
+#define TPM_JOURNAL_ENTRIES     16
+
+/* record types */
+#define TPM_JOURNAL_STORE       0
+#define TPM_JOURNAL_DELETE      1
+
+static unsigned int journal_batch;              /* records per fsync, 0 if disabled */
+static int          journal_fd = -1;
+static off_t        journal_size;
+static unsigned int journal_unsynced;           /* records appended since the last fsync */
+
+/* the latest record for each name in the journal */
+static struct journal_entry {
+    TPM_BOOL    used;
+    uint32_t    tpm_number;
+    char        name[TPM_FILENAME_MAX];
+    TPM_BOOL    deleted;
+    off_t       offset;                         /* of the data in the journal */
+    uint32_t    length;
+} journal_index[TPM_JOURNAL_ENTRIES];
+
 /* TPM_NVRAM_Init() is called once at startup.  It does any NVRAM required initialization.
 
    This function sets some static variables that are used by all TPM's.
@@ -100,6 +165,7 @@ TPM_RESULT TPM_NVRAM_Init(void)
 {
     TPM_RESULT  rc = 0;
     char        *tpm_state_path = NULL;
+    char        *journal = NULL;
     size_t      length;
 
 #ifdef TPM_LIBTPMS_CALLBACKS
@@ -136,12 +202,41 @@ TPM_RESULT TPM_NVRAM_Init(void)
         }
     }
     if (rc == 0) {
+        TPM_NVRAM_JournalClose();
         strcpy(state_directory, tpm_state_path);
         printf("TPM_NVRAM_Init: Rooted state path %s\n", state_directory);
     }
+    if (rc == 0) {
+        rc = TPM_NVRAM_JournalRecover();
+    }
+    if (rc == 0) {
+        journal = getenv("TPM_NV_JOURNAL");
+        journal_batch = 0;
+        if (journal != NULL) {
+            journal_batch = strtoul(journal, NULL, 10);
+            printf("TPM_NVRAM_Init: Journal fsync batch %u\n", journal_batch);
+        }
+    }
     return rc;
 }
 
+/* TPM_NVRAM_Terminate() is called once at shutdown.  It checkpoints the journal, if it is used, and
+   closes it.
+*/
+
+void TPM_NVRAM_Terminate(void)
+{
+    if (journal_fd < 0) {
+        return;
+    }
+    printf(" TPM_NVRAM_Terminate:\n");
+    if (journal_size > 0) {
+        /* on failure the journal still holds the state and is replayed at the next start */
+        TPM_NVRAM_JournalCheckpoint();
+    }
+    TPM_NVRAM_JournalClose();
+}
+
 /* Load 'data' of 'length' from the 'name'.
 
    'data' must be freed after use.
@@ -167,6 +262,7 @@ TPM_RESULT TPM_NVRAM_LoadData(unsigned char **data,     /* freed by caller */
 #ifdef TPM_LIBTPMS_CALLBACKS
     struct libtpms_callbacks *cbs;
     bool is_empty_buffer;
+    enum TPMLIB_StateType st = (tpm_number == 0) ? TPMLIB_NameToStateType(name) : 0;
 
     /* try to get state blob set with TPMLIB_SetState() */
     GetCachedState(TPMLIB_NameToStateType(name), data, length, &is_empty_buffer);
@@ -180,14 +276,28 @@ TPM_RESULT TPM_NVRAM_LoadData(unsigned char **data,     /* freed by caller */
     /* call user-provided function if available, otherwise execute
        default behavior */
     if (cbs->tpm_nvram_loaddata) {
+        /* the application may have changed the stored state */
+        if (st != 0) {
+            SetStoredStateDigest(st, NULL);
+        }
+        TPM_PROBE1(nvram_load_entry, name);
         rc = cbs->tpm_nvram_loaddata(data, length, tpm_number, name);
+        TPM_PROBE3(nvram_load_return, name, *length, rc);
         return rc;
     }
 #endif
 
-    printf(" TPM_NVRAM_LoadData: From file %s\n", name);
     *data = NULL;
     *length = 0;
+    if (journal_batch > 0) {
+        TPM_BOOL found;
+
+        rc = TPM_NVRAM_JournalLoad(data, length, &found, tpm_number, name);
+        if ((rc != 0) || found) {
+            return rc;
+        }
+    }
+    printf(" TPM_NVRAM_LoadData: From file %s\n", name);
     /* open the file */
     if (rc == 0) {
         /* map name to the rooted filename */
@@ -277,6 +387,8 @@ TPM_RESULT TPM_NVRAM_LoadData(unsigned char **data,     /* freed by caller */
 
 /* TPM_NVRAM_StoreData stores 'data' of 'length' to the rooted 'filename'
 
+   Storing is skipped if the data are the same as those last stored for the name.
+
    Returns
         0 on success
         TPM_FAIL for other fatal errors
@@ -286,6 +398,34 @@ TPM_RESULT TPM_NVRAM_StoreData(const unsigned char *data,
                                uint32_t length,
 			       uint32_t tpm_number,
                                const char *name)
+{
+    TPM_RESULT  rc = 0;
+#ifdef TPM_LIBTPMS_CALLBACKS
+    enum TPMLIB_StateType st = (tpm_number == 0) ? TPMLIB_NameToStateType(name) : 0;
+    unsigned char digest[STORED_STATE_DIGEST_SIZE];
+    bool        have_digest;
+
+    have_digest = (st != 0) && ComputeStoredStateDigest(data, length, digest);
+    if (have_digest && StoredStateDigestMatches(st, digest)) {
+        printf(" TPM_NVRAM_StoreData: Name %s is unchanged\n", name);
+        return 0;
+    }
+#endif
+    rc = TPM_NVRAM_WriteData(data, length, tpm_number, name);
+#ifdef TPM_LIBTPMS_CALLBACKS
+    if (st != 0) {
+        SetStoredStateDigest(st, (rc == 0 && have_digest) ? digest : NULL);
+    }
+#endif
+    return rc;
+}
+
+/* TPM_NVRAM_WriteData writes 'data' of 'length' to the rooted 'filename' */
+
+static TPM_RESULT TPM_NVRAM_WriteData(const unsigned char *data,
+                                      uint32_t length,
+                                      uint32_t tpm_number,
+                                      const char *name)
 {
     TPM_RESULT  rc = 0;
     uint32_t      lrc;
@@ -299,11 +439,16 @@ TPM_RESULT TPM_NVRAM_StoreData(const unsigned char *data,
     /* call user-provided function if available, otherwise execute
        default behavior */
     if (cbs->tpm_nvram_storedata) {
+        TPM_PROBE2(nvram_store_entry, name, length);
         rc = cbs->tpm_nvram_storedata(data, length, tpm_number, name);
+        TPM_PROBE2(nvram_store_return, name, rc);
         return rc;
     }
 #endif
 
+    if (journal_batch > 0) {
+        return TPM_NVRAM_JournalStore(data, length, tpm_number, name);
+    }
     printf(" TPM_NVRAM_StoreData: To name %s\n", name);
     if (rc == 0) {
         /* map name to the rooted filename */
@@ -395,6 +540,12 @@ TPM_RESULT TPM_NVRAM_DeleteName(uint32_t tpm_number,
 
 #ifdef TPM_LIBTPMS_CALLBACKS
     struct libtpms_callbacks *cbs = TPMLIB_GetCallbacks();
+    enum TPMLIB_StateType st = (tpm_number == 0) ? TPMLIB_NameToStateType(name) : 0;
+
+    /* the stored state will be unknown */
+    if (st != 0) {
+        SetStoredStateDigest(st, NULL);
+    }
 
     /* call user-provided function if available, otherwise execute
        default behavior */
@@ -404,6 +555,9 @@ TPM_RESULT TPM_NVRAM_DeleteName(uint32_t tpm_number,
     }
 #endif
     
+    if (journal_batch > 0) {
+        return TPM_NVRAM_JournalDelete(tpm_number, name, mustExist);
+    }
     printf(" TPM_NVRAM_DeleteName: Name %s\n", name);
     /* map name to the rooted filename */
     if (rc == 0) {
@@ -423,3 +577,553 @@ TPM_RESULT TPM_NVRAM_DeleteName(uint32_t tpm_number,
     return rc;
 }
 
+
+/*
+  Journal backend
+*/
+
+static void TPM_NVRAM_JournalPut32(unsigned char *buffer, uint32_t value)
+{
+    buffer[0] = (unsigned char)(value >> 24);
+    buffer[1] = (unsigned char)(value >> 16);
+    buffer[2] = (unsigned char)(value >> 8);
+    buffer[3] = (unsigned char)value;
+}
+
+static uint32_t TPM_NVRAM_JournalGet32(const unsigned char *buffer)
+{
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) |
+           ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+/* TPM_NVRAM_JournalCrc32() continues the CRC-32 'crc' over 'length' bytes of 'data' */
+
+static uint32_t TPM_NVRAM_JournalCrc32(uint32_t crc,
+                                       const unsigned char *data,
+                                       size_t length)
+{
+    unsigned int i;
+
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* TPM_NVRAM_JournalRecordCrc() returns the checksum of a record.  The checksum field of the
+   header is taken as 0. */
+
+static uint32_t TPM_NVRAM_JournalRecordCrc(const unsigned char *hdr,
+                                           const unsigned char *payload,
+                                           uint32_t payload_len)
+{
+    static const unsigned char zero[4];
+    uint32_t crc;
+
+    crc = TPM_NVRAM_JournalCrc32(0, hdr, TPM_JOURNAL_HDR_SIZE - 4);
+    crc = TPM_NVRAM_JournalCrc32(crc, zero, sizeof(zero));
+    return TPM_NVRAM_JournalCrc32(crc, payload, payload_len);
+}
+
+/* TPM_NVRAM_JournalFind() returns the index entry for the name, allocating one if 'create' is
+   TRUE.  Returns NULL if there is none. */
+
+static struct journal_entry *TPM_NVRAM_JournalFind(uint32_t tpm_number,
+                                                   const char *name,
+                                                   TPM_BOOL create)
+{
+    struct journal_entry *free_entry = NULL;
+    size_t i;
+
+    for (i = 0; i < TPM_JOURNAL_ENTRIES; i++) {
+        if (!journal_index[i].used) {
+            if (free_entry == NULL) {
+                free_entry = &journal_index[i];
+            }
+        }
+        else if ((journal_index[i].tpm_number == tpm_number) &&
+                 (strcmp(journal_index[i].name, name) == 0)) {
+            return &journal_index[i];
+        }
+    }
+    if (!create || (free_entry == NULL)) {
+        return NULL;
+    }
+    free_entry->used = TRUE;
+    free_entry->tpm_number = tpm_number;
+    strcpy(free_entry->name, name);
+    return free_entry;
+}
+
+/* TPM_NVRAM_JournalClose() syncs and closes the journal and forgets its index */
+
+static void TPM_NVRAM_JournalClose(void)
+{
+    if (journal_fd >= 0) {
+        if ((journal_unsynced > 0) && (fsync(journal_fd) != 0)) {
+            printf("TPM_NVRAM_JournalClose: Error syncing journal, %s\n", strerror(errno));
+        }
+        close(journal_fd);
+    }
+    journal_fd = -1;
+    journal_size = 0;
+    journal_unsynced = 0;
+    memset(journal_index, 0, sizeof(journal_index));
+}
+
+/* TPM_NVRAM_JournalOpen() opens the journal if it is not open yet and replays it into the index.
+   The journal is truncated after the last intact record.
+
+   Returns
+        0 on success
+        TPM_FAIL on failure
+*/
+
+static TPM_RESULT TPM_NVRAM_JournalOpen(void)
+{
+    TPM_RESULT  rc = 0;
+    char        filename[FILENAME_MAX];
+    unsigned char hdr[TPM_JOURNAL_HDR_SIZE];
+    unsigned char *payload = NULL;
+    unsigned char *tmp;
+    uint32_t    payload_size = 0;
+    uint32_t    type, tpm_number, namelen, datalen;
+    struct journal_entry *entry;
+    off_t       offset = 0;
+    ssize_t     n;
+
+    if (journal_fd >= 0) {
+        return 0;
+    }
+    if (rc == 0) {
+        rc = TPM_NVRAM_GetFilenameForName(filename, sizeof(filename), 0, TPM_JOURNAL_NAME);
+    }
+    if (rc == 0) {
+        printf(" TPM_NVRAM_JournalOpen: Opening journal %s\n", filename);
+        journal_fd = open(filename, O_RDWR | O_CREAT, 0640);
+        if (journal_fd < 0) {
+            printf("TPM_NVRAM_JournalOpen: Error (fatal) opening %s, %s\n",
+                   filename, strerror(errno));
+            rc = TPM_FAIL;
+        }
+    }
+    /* replay the records */
+    while (rc == 0) {
+        n = pread(journal_fd, hdr, sizeof(hdr), offset);
+        if (n != sizeof(hdr)) {
+            break;
+        }
+        type = TPM_NVRAM_JournalGet32(&hdr[4]);
+        tpm_number = TPM_NVRAM_JournalGet32(&hdr[8]);
+        namelen = TPM_NVRAM_JournalGet32(&hdr[12]);
+        datalen = TPM_NVRAM_JournalGet32(&hdr[16]);
+        if ((TPM_NVRAM_JournalGet32(&hdr[0]) != TPM_JOURNAL_MAGIC) ||
+            (type > TPM_JOURNAL_DELETE) ||
+            (namelen == 0) || (namelen >= TPM_FILENAME_MAX) ||
+            (datalen > TPM_JOURNAL_MAX_SIZE * 64)) {
+            break;
+        }
+        /* one more byte to terminate the name */
+        if (namelen + datalen + 1 > payload_size) {
+            tmp = realloc(payload, namelen + datalen + 1);
+            if (tmp == NULL) {
+                printf("TPM_NVRAM_JournalOpen: Error (fatal) allocating %u bytes\n",
+                       namelen + datalen + 1);
+                rc = TPM_FAIL;
+                break;
+            }
+            payload = tmp;
+            payload_size = namelen + datalen + 1;
+        }
+        n = pread(journal_fd, payload, namelen + datalen, offset + sizeof(hdr));
+        if ((n != (ssize_t)(namelen + datalen)) ||
+            (TPM_NVRAM_JournalRecordCrc(hdr, payload, namelen + datalen) !=
+             TPM_NVRAM_JournalGet32(&hdr[20])) ||
+            (memchr(payload, 0, namelen) != NULL)) {
+            break;
+        }
+        payload[namelen] = 0;   /* the data are not needed */
+        entry = TPM_NVRAM_JournalFind(tpm_number, (char *)payload, TRUE);
+        if (entry == NULL) {
+            printf("TPM_NVRAM_JournalOpen: Error (fatal) too many names in journal\n");
+            rc = TPM_FAIL;
+            break;
+        }
+        entry->deleted = (type == TPM_JOURNAL_DELETE);
+        entry->offset = offset + sizeof(hdr) + namelen;
+        entry->length = datalen;
+        offset += sizeof(hdr) + namelen + datalen;
+    }
+    free(payload);
+    /* discard a torn record at the end */
+    if (rc == 0) {
+        journal_size = offset;
+        if ((lseek(journal_fd, 0, SEEK_END) != offset) &&
+            (ftruncate(journal_fd, offset) != 0)) {
+            printf("TPM_NVRAM_JournalOpen: Error (fatal) truncating journal, %s\n",
+                   strerror(errno));
+            rc = TPM_FAIL;
+        }
+    }
+    if (rc != 0) {
+        TPM_NVRAM_JournalClose();
+    }
+    return rc;
+}
+
+/* TPM_NVRAM_JournalWriteFile() atomically replaces the file with 'data' of 'length' by writing
+   a temporary file, syncing it and renaming it */
+
+static TPM_RESULT TPM_NVRAM_JournalWriteFile(const char *filename,
+                                             const unsigned char *data,
+                                             uint32_t length)
+{
+    TPM_RESULT  rc = 0;
+    char        tmpname[FILENAME_MAX + 4];
+    uint32_t    written = 0;
+    ssize_t     n;
+    int         fd = -1;
+
+    if (rc == 0) {
+        snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+        fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+        if (fd < 0) {
+            printf("TPM_NVRAM_JournalWriteFile: Error (fatal) opening %s, %s\n",
+                   tmpname, strerror(errno));
+            rc = TPM_FAIL;
+        }
+    }
+    while ((rc == 0) && (written < length)) {
+        n = write(fd, data + written, length - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("TPM_NVRAM_JournalWriteFile: Error (fatal) writing %s, %s\n",
+                   tmpname, strerror(errno));
+            rc = TPM_FAIL;
+        }
+        else {
+            written += n;
+        }
+    }
+    if ((rc == 0) && (fsync(fd) != 0)) {
+        printf("TPM_NVRAM_JournalWriteFile: Error (fatal) syncing %s, %s\n",
+               tmpname, strerror(errno));
+        rc = TPM_FAIL;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if ((rc == 0) && (rename(tmpname, filename) != 0)) {
+        printf("TPM_NVRAM_JournalWriteFile: Error (fatal) renaming %s, %s\n",
+               tmpname, strerror(errno));
+        rc = TPM_FAIL;
+    }
+    return rc;
+}
+
+/* TPM_NVRAM_JournalCheckpoint() writes the latest state of all names in the journal to their
+   files and empties the journal.  Until the journal is truncated, it still holds all state, so a
+   failure in between loses nothing.
+*/
+
+static TPM_RESULT TPM_NVRAM_JournalCheckpoint(void)
+{
+    TPM_RESULT  rc = 0;
+    char        filename[FILENAME_MAX];
+    unsigned char *data;
+    uint32_t    length;
+    TPM_BOOL    found;
+    size_t      i;
+    int         dirfd;
+
+    printf(" TPM_NVRAM_JournalCheckpoint: Checkpointing %lu bytes\n",
+           (unsigned long)journal_size);
+    for (i = 0; (rc == 0) && (i < TPM_JOURNAL_ENTRIES); i++) {
+        if (!journal_index[i].used) {
+            continue;
+        }
+        rc = TPM_NVRAM_GetFilenameForName(filename, sizeof(filename),
+                                          journal_index[i].tpm_number,
+                                          journal_index[i].name);
+        if ((rc == 0) && journal_index[i].deleted) {
+            if ((remove(filename) != 0) && (errno != ENOENT)) {
+                printf("TPM_NVRAM_JournalCheckpoint: Error (fatal) removing %s, %s\n",
+                       filename, strerror(errno));
+                rc = TPM_FAIL;
+            }
+        }
+        else if (rc == 0) {
+            rc = TPM_NVRAM_JournalLoad(&data, &length, &found,
+                                       journal_index[i].tpm_number,
+                                       journal_index[i].name);
+            if (rc == 0) {
+                rc = TPM_NVRAM_JournalWriteFile(filename, data, length);
+                free(data);
+            }
+        }
+    }
+    /* make the renames durable before the journal is emptied */
+    if (rc == 0) {
+        dirfd = open(state_directory, O_RDONLY);
+        if (dirfd >= 0) {
+            if (fsync(dirfd) != 0) {
+                printf("TPM_NVRAM_JournalCheckpoint: Error (fatal) syncing %s, %s\n",
+                       state_directory, strerror(errno));
+                rc = TPM_FAIL;
+            }
+            close(dirfd);
+        }
+    }
+    if (rc == 0) {
+        if ((ftruncate(journal_fd, 0) != 0) || (fsync(journal_fd) != 0)) {
+            printf("TPM_NVRAM_JournalCheckpoint: Error (fatal) truncating journal, %s\n",
+                   strerror(errno));
+            rc = TPM_FAIL;
+        }
+    }
+    if (rc == 0) {
+        journal_size = 0;
+        journal_unsynced = 0;
+        memset(journal_index, 0, sizeof(journal_index));
+    }
+    return rc;
+}
+
+/* TPM_NVRAM_JournalRecover() checkpoints a non-empty journal that was left behind by a previous
+   run and closes it again.
+
+   Returns
+        0 on success
+        TPM_FAIL on failure
+*/
+
+static TPM_RESULT TPM_NVRAM_JournalRecover(void)
+{
+    TPM_RESULT  rc = 0;
+    char        filename[FILENAME_MAX];
+    struct stat st;
+
+    if (rc == 0) {
+        rc = TPM_NVRAM_GetFilenameForName(filename, sizeof(filename), 0, TPM_JOURNAL_NAME);
+    }
+    if (rc == 0) {
+        if (stat(filename, &st) != 0) {
+            if (errno == ENOENT) {
+                return 0;
+            }
+            printf("TPM_NVRAM_JournalRecover: Error (fatal) accessing %s, %s\n",
+                   filename, strerror(errno));
+            rc = TPM_FAIL;
+        }
+        else if (st.st_size == 0) {
+            return 0;
+        }
+    }
+    if (rc == 0) {
+        printf(" TPM_NVRAM_JournalRecover: Replaying journal %s\n", filename);
+        rc = TPM_NVRAM_JournalOpen();
+    }
+    if (rc == 0) {
+        rc = TPM_NVRAM_JournalCheckpoint();
+    }
+    TPM_NVRAM_JournalClose();
+    return rc;
+}
+
+/* TPM_NVRAM_JournalAppend() appends a record for the name to the journal and syncs the journal
+   once 'journal_batch' records have been appended.  The journal is checkpointed when it has grown
+   beyond TPM_JOURNAL_MAX_SIZE.
+*/
+
+static TPM_RESULT TPM_NVRAM_JournalAppend(uint32_t type,
+                                          const unsigned char *data,
+                                          uint32_t length,
+                                          uint32_t tpm_number,
+                                          const char *name)
+{
+    TPM_RESULT  rc = 0;
+    unsigned char *record = NULL;
+    uint32_t    namelen = strlen(name);
+    size_t      record_len = TPM_JOURNAL_HDR_SIZE + namelen + length;
+    struct journal_entry *entry = NULL;
+    size_t      written = 0;
+    ssize_t     n;
+
+    if (rc == 0) {
+        rc = TPM_NVRAM_JournalOpen();
+    }
+    if ((rc == 0) && ((namelen == 0) || (namelen >= TPM_FILENAME_MAX))) {
+        printf("TPM_NVRAM_JournalAppend: Error (fatal), bad name %s\n", name);
+        rc = TPM_FAIL;
+    }
+    if (rc == 0) {
+        entry = TPM_NVRAM_JournalFind(tpm_number, name, TRUE);
+        if (entry == NULL) {
+            printf("TPM_NVRAM_JournalAppend: Error (fatal) too many names in journal\n");
+            rc = TPM_FAIL;
+        }
+    }
+    if (rc == 0) {
+        rc = TPM_Malloc(&record, record_len);
+    }
+    if (rc == 0) {
+        TPM_NVRAM_JournalPut32(&record[0], TPM_JOURNAL_MAGIC);
+        TPM_NVRAM_JournalPut32(&record[4], type);
+        TPM_NVRAM_JournalPut32(&record[8], tpm_number);
+        TPM_NVRAM_JournalPut32(&record[12], namelen);
+        TPM_NVRAM_JournalPut32(&record[16], length);
+        memcpy(&record[TPM_JOURNAL_HDR_SIZE], name, namelen);
+        if (length > 0) {
+            memcpy(&record[TPM_JOURNAL_HDR_SIZE + namelen], data, length);
+        }
+        TPM_NVRAM_JournalPut32(&record[20],
+                               TPM_NVRAM_JournalRecordCrc(record,
+                                                          &record[TPM_JOURNAL_HDR_SIZE],
+                                                          namelen + length));
+    }
+    while ((rc == 0) && (written < record_len)) {
+        n = pwrite(journal_fd, record + written, record_len - written,
+                   journal_size + written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("TPM_NVRAM_JournalAppend: Error (fatal) writing journal, %s\n",
+                   strerror(errno));
+            /* drop the partial record */
+            if (ftruncate(journal_fd, journal_size) != 0) {
+                printf("TPM_NVRAM_JournalAppend: Error truncating journal, %s\n",
+                       strerror(errno));
+            }
+            rc = TPM_FAIL;
+        }
+        else {
+            written += n;
+        }
+    }
+    free(record);
+    if (rc == 0) {
+        entry->deleted = (type == TPM_JOURNAL_DELETE);
+        entry->offset = journal_size + TPM_JOURNAL_HDR_SIZE + namelen;
+        entry->length = length;
+        journal_size += record_len;
+        journal_unsynced++;
+        if (journal_unsynced >= journal_batch) {
+            if (fsync(journal_fd) != 0) {
+                printf("TPM_NVRAM_JournalAppend: Error (fatal) syncing journal, %s\n",
+                       strerror(errno));
+                rc = TPM_FAIL;
+            }
+            journal_unsynced = 0;
+        }
+    }
+    if ((rc == 0) && (journal_size > TPM_JOURNAL_MAX_SIZE)) {
+        rc = TPM_NVRAM_JournalCheckpoint();
+    }
+    return rc;
+}
+
+/* TPM_NVRAM_JournalLoad() loads the latest state for the name from the journal.  'found' is
+   FALSE if the journal does not hold a record for the name.
+
+   Returns
+        0 on success
+        TPM_RETRY if the name was deleted
+        TPM_FAIL on failure
+*/
+
+static TPM_RESULT TPM_NVRAM_JournalLoad(unsigned char **data,
+                                        uint32_t *length,
+                                        TPM_BOOL *found,
+                                        uint32_t tpm_number,
+                                        const char *name)
+{
+    TPM_RESULT  rc = 0;
+    struct journal_entry *entry = NULL;
+
+    *data = NULL;
+    *length = 0;
+    *found = FALSE;
+    if (rc == 0) {
+        rc = TPM_NVRAM_JournalOpen();
+    }
+    if (rc == 0) {
+        entry = TPM_NVRAM_JournalFind(tpm_number, name, FALSE);
+        if (entry == NULL) {
+            return 0;
+        }
+        *found = TRUE;
+        printf(" TPM_NVRAM_JournalLoad: From journal %s\n", name);
+        if (entry->deleted) {
+            rc = TPM_RETRY;
+        }
+    }
+    if ((rc == 0) && (entry->length > 0)) {
+        rc = TPM_Malloc(data, entry->length);
+    }
+    if ((rc == 0) && (entry->length > 0)) {
+        if (pread(journal_fd, *data, entry->length, entry->offset) !=
+            (ssize_t)entry->length) {
+            printf("TPM_NVRAM_JournalLoad: Error (fatal) reading journal\n");
+            rc = TPM_FAIL;
+        }
+    }
+    if (rc == 0) {
+        *length = entry->length;
+    }
+    else {
+        free(*data);
+        *data = NULL;
+    }
+    return rc;
+}
+
+static TPM_RESULT TPM_NVRAM_JournalStore(const unsigned char *data,
+                                         uint32_t length,
+                                         uint32_t tpm_number,
+                                         const char *name)
+{
+    printf(" TPM_NVRAM_JournalStore: Appending %u bytes for %s\n", length, name);
+    return TPM_NVRAM_JournalAppend(TPM_JOURNAL_STORE, data, length, tpm_number, name);
+}
+
+static TPM_RESULT TPM_NVRAM_JournalDelete(uint32_t tpm_number,
+                                          const char *name,
+                                          TPM_BOOL mustExist)
+{
+    TPM_RESULT  rc = 0;
+    char        filename[FILENAME_MAX];
+    struct journal_entry *entry;
+    TPM_BOOL    exists = FALSE;
+
+    printf(" TPM_NVRAM_JournalDelete: Name %s\n", name);
+    if (rc == 0) {
+        rc = TPM_NVRAM_JournalOpen();
+    }
+    if (rc == 0) {
+        entry = TPM_NVRAM_JournalFind(tpm_number, name, FALSE);
+        if (entry != NULL) {
+            exists = !entry->deleted;
+        }
+        else {
+            rc = TPM_NVRAM_GetFilenameForName(filename, sizeof(filename), tpm_number, name);
+            if (rc == 0) {
+                exists = (access(filename, F_OK) == 0);
+            }
+        }
+    }
+    if ((rc == 0) && !exists && mustExist) {
+        printf("TPM_NVRAM_JournalDelete: Error, (fatal) %s does not exist\n", name);
+        rc = TPM_FAIL;
+    }
+    if ((rc == 0) && exists) {
+        rc = TPM_NVRAM_JournalAppend(TPM_JOURNAL_DELETE, NULL, 0, tpm_number, name);
+    }
+    return rc;
+}
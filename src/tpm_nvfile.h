@@ -51,6 +51,7 @@
 #define TPM_FILENAME_MAX 20
 
 TPM_RESULT TPM_NVRAM_Init(void);
+void       TPM_NVRAM_Terminate(void);
 
 /*
   Basic abstraction for read and write
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+/*
+ * The semaphores of the USDT probes. A tracer increments the semaphore of a
+ * probe while it is attached to it.
+ */
+
+#include <config.h>
+
+#include "tpm_probes.h"
+
+#if defined(LIBTPMS_USDT) && LIBTPMS_USDT
+
+# define TPM_PROBE_DEFINE_SEMAPHORE(name) \
+    unsigned short TPM_PROBE_SEMAPHORE(name) \
+        __attribute__((section(".probes")));
+TPM_PROBE_LIST(TPM_PROBE_DEFINE_SEMAPHORE)
+
+#endif /* LIBTPMS_USDT */
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// (c) Copyright IBM Corporation, 2026
+
+#ifndef TPM_PROBES_H
+#define TPM_PROBES_H
+
+/*
+ * Static tracepoints (USDT probes) in the 'libtpms' provider.
+ *
+ * The probes are only compiled in if configure found sys/sdt.h and
+ * defined LIBTPMS_USDT. Each probe has a semaphore that a tracer increments
+ * while it is attached. A probe that is not being traced costs a test of
+ * its semaphore and a branch; its arguments are only evaluated while it is
+ * traced. The probes can be listed and attached to with tools such as
+ * bpftrace or perf, e.g. 'bpftrace -l usdt:/usr/lib64/libtpms.so'.
+ *
+ * Probes and their arguments:
+ *   process_entry(command_code, command_size)
+ *   process_return(command_code, response_code, resp_size)
+ *   exec_entry(command_size)
+ *   exec_handles(command_code, num_handles, handle0, handle1, rc)
+ *   exec_sessions(command_code, num_sessions, auth_size, rc)
+ *   exec_dispatch_entry(command_code)
+ *   exec_dispatch_return(command_code, rc)
+ *   exec_response_session(command_code, rc)
+ *   exec_return(command_code, rc, response_size)
+ *   nv_commit_entry(update_type)
+ *   nv_commit_return(success)
+ *   nv_commit_skipped(size)           permanent state unchanged; not stored
+ *   nvram_load_entry(name)
+ *   nvram_load_return(name, length, rc)
+ *   nvram_store_entry(name, length)
+ *   nvram_store_return(name, rc)
+ *   keygen_entry(type, key_bits)      key_bits is the curve ID for ECC keys
+ *   keygen_return(type, rc)
+ *   expdcache_hit(index, modulus_bits)
+ *   expdcache_miss(modulus_bits)
+ *
+ * All arguments are integers except for 'name', which is a string.
+ */
+#define TPM_PROBE_LIST(op) \
+    op(process_entry) \
+    op(process_return) \
+    op(exec_entry) \
+    op(exec_handles) \
+    op(exec_sessions) \
+    op(exec_dispatch_entry) \
+    op(exec_dispatch_return) \
+    op(exec_response_session) \
+    op(exec_return) \
+    op(nv_commit_entry) \
+    op(nv_commit_return) \
+    op(nv_commit_skipped) \
+    op(nvram_load_entry) \
+    op(nvram_load_return) \
+    op(nvram_store_entry) \
+    op(nvram_store_return) \
+    op(keygen_entry) \
+    op(keygen_return) \
+    op(expdcache_hit) \
+    op(expdcache_miss)
+
+#if defined(LIBTPMS_USDT) && LIBTPMS_USDT
+
+/* the probes reference their semaphores, which are defined in tpm_probes.c */
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+# define TPM_PROBE_SEMAPHORE(name) libtpms_##name##_semaphore
+
+# define TPM_PROBE_DECLARE_SEMAPHORE(name) \
+    extern unsigned short TPM_PROBE_SEMAPHORE(name) \
+        __attribute__((unused, section(".probes")));
+TPM_PROBE_LIST(TPM_PROBE_DECLARE_SEMAPHORE)
+
+/* whether a tracer is attached to the probe */
+# define TPM_PROBE_ENABLED(name) \
+    __builtin_expect(TPM_PROBE_SEMAPHORE(name) != 0, 0)
+
+# define TPM_PROBE1(name, a) \
+    do { if (TPM_PROBE_ENABLED(name)) \
+        DTRACE_PROBE1(libtpms, name, a); } while (0)
+# define TPM_PROBE2(name, a, b) \
+    do { if (TPM_PROBE_ENABLED(name)) \
+        DTRACE_PROBE2(libtpms, name, a, b); } while (0)
+# define TPM_PROBE3(name, a, b, c) \
+    do { if (TPM_PROBE_ENABLED(name)) \
+        DTRACE_PROBE3(libtpms, name, a, b, c); } while (0)
+# define TPM_PROBE4(name, a, b, c, d) \
+    do { if (TPM_PROBE_ENABLED(name)) \
+        DTRACE_PROBE4(libtpms, name, a, b, c, d); } while (0)
+# define TPM_PROBE5(name, a, b, c, d, e) \
+    do { if (TPM_PROBE_ENABLED(name)) \
+        DTRACE_PROBE5(libtpms, name, a, b, c, d, e); } while (0)
+
+#else
+
+# define TPM_PROBE_ENABLED(name) 0
+
+/* arguments are not evaluated but still checked by the compiler */
+# define TPM_PROBE1(name, a) \
+    do { if (0) { (void)(a); } } while (0)
+# define TPM_PROBE2(name, a, b) \
+    do { if (0) { (void)(a); (void)(b); } } while (0)
+# define TPM_PROBE3(name, a, b, c) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); } } while (0)
+# define TPM_PROBE4(name, a, b, c, d) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); (void)(d); } } while (0)
+# define TPM_PROBE5(name, a, b, c, d, e) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); (void)(d); (void)(e); } } while (0)
+
+#endif /* LIBTPMS_USDT */
+
+#endif /* TPM_PROBES_H */
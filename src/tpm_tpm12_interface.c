@@ -45,14 +45,17 @@
 #include <string.h>
 #include <stdbool.h>
 
+#include "tpm_capture.h"
 #include "tpm_debug.h"
 #include "tpm_error.h"
 #include "tpm12/tpm_init.h"
 #include "tpm_library_intern.h"
+#include "tpm_memusage.h"
 #include "tpm12/tpm_process.h"
 #include "tpm12/tpm_startup.h"
 #include "tpm12/tpm_global.h"
 #include "tpm12/tpm_permanent.h"
+#include "tpm12/tpm_store.h"
 #include "tpm_nvfile.h"
 
 static TPM_RESULT TPM12_MainInit(void)
@@ -65,15 +68,73 @@ static void TPM12_Terminate(void)
     TPM_Global_Delete(tpm_instances[0]);
     free(tpm_instances[0]);
     tpm_instances[0] = NULL;
+    TPM_Sbuffer_PoolDelete();
+}
+
+/*
+ * Update the memory usage of the key slots and NV indices. Keys are
+ * accounted with their public and encrypted parts and the decrypted
+ * private key.
+ */
+static void TPM12_UpdateMemoryUsage(void)
+{
+    const TPM_KEY_HANDLE_ENTRIES *khes;
+    const TPM_NV_INDEX_ENTRIES *nvies;
+    const TPM_KEY *key;
+    size_t size, in_use, keysize;
+    uint32_t i;
+
+    if (!tpm_instances[0])
+        return;
+
+    khes = &tpm_instances[0]->tpm_key_handle_entries;
+    size = khes->keyHandleCount * sizeof(khes->tpm_key_handle_entry[0]) +
+           khes->indexSize * sizeof(khes->index[0]);
+    in_use = khes->indexSize * sizeof(khes->index[0]);
+    for (i = 0; i < khes->keyHandleCount; i++) {
+        key = khes->tpm_key_handle_entry[i].key;
+        if (!key)
+            continue;
+        keysize = sizeof(*key) +
+                  key->pcrInfo.size + key->pubKey.size + key->encData.size;
+        if (key->tpm_store_asymkey)
+            keysize += sizeof(*key->tpm_store_asymkey);
+        size += keysize;
+        in_use += sizeof(khes->tpm_key_handle_entry[0]) + keysize;
+    }
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM12_KEY_HANDLES, size, in_use);
+
+    nvies = &tpm_instances[0]->tpm_nv_index_entries;
+    size = nvies->nvIndexCount * sizeof(nvies->tpm_nvindex_entry[0]);
+    in_use = 0;
+    for (i = 0; i < nvies->nvIndexCount; i++) {
+        /* deleted entries are marked with TPM_NV_INDEX_LOCK */
+        if (nvies->tpm_nvindex_entry[i].pubInfo.nvIndex == TPM_NV_INDEX_LOCK)
+            continue;
+        in_use += sizeof(nvies->tpm_nvindex_entry[0]) +
+                  nvies->tpm_nvindex_entry[i].pubInfo.dataSize;
+        size += nvies->tpm_nvindex_entry[i].pubInfo.dataSize;
+    }
+    TPMLIB_MemoryUsageSet(TPMLIB_MEMUSAGE_TPM12_NV_INDICES, size, in_use);
 }
 
 static TPM_RESULT TPM12_Process(unsigned char **respbuffer, uint32_t *resp_size,
                                 uint32_t *respbufsize,
                                 unsigned char *command, uint32_t command_size)
 {
+    TPM_RESULT ret;
+
     *resp_size = 0;
-    return TPM_ProcessA(respbuffer, resp_size, respbufsize,
-                        command, command_size);
+    ret = TPM_ProcessA(respbuffer, resp_size, respbufsize,
+                       command, command_size);
+    if (ret == TPM_SUCCESS) {
+        /* TPM_Process() got the locality of the command */
+        TPM_Capture_Command(tpm_instances[0]->tpm_stany_flags.localityModifier,
+                            command, command_size,
+                            *respbuffer, *resp_size);
+        TPM12_UpdateMemoryUsage();
+    }
+    return ret;
 }
 
 static TPM_RESULT TPM12_VolatileAllStore(unsigned char **buffer,
@@ -108,6 +169,17 @@ static TPM_RESULT TPM12_CancelCommand(void)
 }
 
 
+/*
+ * The number of key slots of the running TPM instance or, if there is
+ * none, the number the next TPM_MainInit will allocate.
+ */
+static uint32_t TPM12_InstanceKeyHandles(void)
+{
+    if (tpm_instances[0])
+        return tpm_instances[0]->tpm_key_handle_entries.keyHandleCount;
+    return TPM12_GetKeyHandles();
+}
+
 static TPM_RESULT TPM12_GetTPMProperty(enum TPMLIB_TPMProperty prop,
                                 int *result)
 {
@@ -117,7 +189,7 @@ static TPM_RESULT TPM12_GetTPMProperty(enum TPMLIB_TPMProperty prop,
         break;
 
     case  TPMPROP_TPM_KEY_HANDLES:
-        *result = TPM_KEY_HANDLES;
+        *result = TPM12_GetKeyHandles();
         break;
 
     case  TPMPROP_TPM_OWNER_EVICT_KEY_HANDLES:
@@ -163,11 +235,11 @@ static TPM_RESULT TPM12_GetTPMProperty(enum TPMLIB_TPMProperty prop,
         break;
 
     case  TPMPROP_TPM_MAX_SAVESTATE_SPACE:
-        *result = TPM_MAX_SAVESTATE_SPACE;
+        *result = TPM_MAX_SAVESTATE_SPACE_KEYS(TPM12_InstanceKeyHandles());
         break;
 
     case  TPMPROP_TPM_MAX_VOLATILESTATE_SPACE:
-        *result = TPM_MAX_VOLATILESTATE_SPACE;
+        *result = TPM_MAX_VOLATILESTATE_SPACE_KEYS(TPM12_InstanceKeyHandles());
         break;
 
     default:
@@ -199,6 +271,7 @@ static char *TPM12_GetInfo(enum TPMLIB_InfoFlags flags)
         "\"model\":\"swtpm\""
     "}";
     char *fmt = NULL, *buffer;
+    char *memoryUsage = NULL;
     bool printed = false;
 
     if (!(buffer = strdup("{%s%s%s}")))
@@ -222,6 +295,22 @@ static char *TPM12_GetInfo(enum TPMLIB_InfoFlags flags)
         printed = true;
     }
 
+    if ((flags & TPMLIB_INFO_MEMORY_USAGE)) {
+        fmt = buffer;
+        buffer = NULL;
+        TPM12_UpdateMemoryUsage();
+        memoryUsage = TPMLIB_MemoryUsagePrint(TPMLIB_TPM_VERSION_1_2);
+        if (!memoryUsage)
+            goto error;
+        if (asprintf(&buffer, fmt,  printed ? "," : "",
+                     memoryUsage, "%s%s%s") < 0)
+            goto error;
+        free(fmt);
+        free(memoryUsage);
+        memoryUsage = NULL;
+        printed = true;
+    }
+
     /* nothing else to add */
     fmt = buffer;
     buffer = NULL;
@@ -232,6 +321,7 @@ static char *TPM12_GetInfo(enum TPMLIB_InfoFlags flags)
     return buffer;
 
 error:
+    free(memoryUsage);
     free(fmt);
     free(buffer);
 
@@ -267,6 +357,40 @@ uint32_t TPM12_GetBufferSize(void)
     return TPM12_SetBufferSize(0, NULL, NULL);
 }
 
+static uint32_t tpm12_keyhandles = TPM_KEY_HANDLES;
+
+/*
+ * Set the number of key slots to allocate at the next TPM_MainInit. The
+ * minimum is the compile-time number of key slots so that all existing
+ * state blobs can still be loaded.
+ */
+static uint32_t TPM12_SetKeyHandles(uint32_t wanted,
+                                    uint32_t *min,
+                                    uint32_t *max)
+{
+    if (min)
+        *min = TPM_KEY_HANDLES;
+    if (max)
+        *max = TPM_KEY_HANDLES_MAX;
+
+    if (wanted == 0)
+        return tpm12_keyhandles;
+
+    if (wanted > TPM_KEY_HANDLES_MAX)
+        wanted = TPM_KEY_HANDLES_MAX;
+    else if (wanted < TPM_KEY_HANDLES)
+        wanted = TPM_KEY_HANDLES;
+
+    tpm12_keyhandles = wanted;
+
+    return tpm12_keyhandles;
+}
+
+uint32_t TPM12_GetKeyHandles(void)
+{
+    return TPM12_SetKeyHandles(0, NULL, NULL);
+}
+
 static TPM_RESULT TPM12_ValidateState(enum TPMLIB_StateType st,
                                       unsigned int flags LIBTPMS_ATTR_UNUSED)
 {
@@ -424,43 +548,63 @@ static TPM_RESULT TPM12_GetState(enum TPMLIB_StateType st,
 }
 
 /*
- * Set the state the TPM 1.2 will use upon next TPM_MainInit(). The TPM 1.2
- * must not have been started, yet, or it must have been terminated for this
- * function to set the state.
- *
- * @st: The TPMLIB_StateType describing the type of blob in the buffer
- * @buffer: pointer to the buffer containing the state blob; NULL pointer clears
- *          previous state
- * @buflen: length of the buffer
+ * Get the state blob of the given type and pass it to the writer function
+ * in chunks. The blob of a running TPM is passed directly from the store
+ * buffer it was serialized into.
  */
-static TPM_RESULT TPM12_SetState(enum TPMLIB_StateType st,
-                                 const unsigned char *buffer, uint32_t buflen)
+static TPM_RESULT TPM12_GetStateStream(enum TPMLIB_StateType st,
+                                       TPMLIB_StateWriter writer,
+                                       void *opaque)
 {
-    TPM_RESULT ret = TPM_SUCCESS;
-    unsigned char *stream = NULL, *orig_stream = NULL;
-    uint32_t stream_size = buflen;
-    tpm_state_t *tpm_state = NULL;
+    TPM_RESULT ret = TPM_FAIL;
+    TPM_STORE_BUFFER tsb;
+    const unsigned char *buffer;
+    unsigned char *blob;
+    uint32_t buflen;
 
-    if (buffer == NULL) {
-        SetCachedState(st, NULL, 0);
-        return TPM_SUCCESS;
+    if (tpm_instances[0] == NULL) {
+        ret = TPM12_GetState(st, &blob, &buflen);
+        if (ret == TPM_SUCCESS) {
+            ret = TPMLIB_WriteStateChunks(blob, buflen, writer, opaque);
+            free(blob);
+        }
+        return ret;
     }
 
-    if (tpm_instances[0])
-        return TPM_INVALID_POSTINIT;
+    TPM_Sbuffer_Init(&tsb);
 
-    if (ret == TPM_SUCCESS) {
-        stream = malloc(buflen);
-        if (!stream) {
-            TPMLIB_LogError("Could not allocate %u bytes.\n", buflen);
-            ret = TPM_SIZE;
-        }
+    switch (st) {
+    case TPMLIB_STATE_PERMANENT:
+        ret = _TPM_PermanentAll_Store(&tsb, tpm_instances[0]);
+        break;
+    case TPMLIB_STATE_VOLATILE:
+        ret = TPM_VolatileAll_Store(&tsb, tpm_instances[0]);
+        break;
+    case TPMLIB_STATE_SAVE_STATE:
+        ret = TPM_SaveState_Store(&tsb, tpm_instances[0]);
+        break;
     }
 
     if (ret == TPM_SUCCESS) {
-        orig_stream = stream;
-        memcpy(stream, buffer, buflen);
+        TPM_Sbuffer_Get(&tsb, &buffer, &buflen);
+        ret = TPMLIB_WriteStateChunks(buffer, buflen, writer, opaque);
+    }
+    TPM_Sbuffer_Delete(&tsb);
 
+    return ret;
+}
+
+/*
+ * Test whether a state blob can be loaded by loading it into a scratch
+ * TPM state.
+ */
+static TPM_RESULT TPM12_TestState(enum TPMLIB_StateType st,
+                                  unsigned char *stream, uint32_t stream_size)
+{
+    TPM_RESULT ret = TPM_SUCCESS;
+    tpm_state_t *tpm_state = NULL;
+
+    if (ret == TPM_SUCCESS) {
         tpm_state = malloc(sizeof(tpm_state_t));
         if (!tpm_state) {
             TPMLIB_LogError("Could not allocated %zu bytes.\n",
@@ -473,7 +617,6 @@ static TPM_RESULT TPM12_SetState(enum TPMLIB_StateType st,
         ret = TPM_Global_Init(tpm_state);
     }
 
-    /* test whether we can accept the blob */
     if (ret == TPM_SUCCESS) {
         tpm_state->tpm_number = 0;
 
@@ -492,24 +635,131 @@ static TPM_RESULT TPM12_SetState(enum TPMLIB_StateType st,
             if (ret == TPM_SUCCESS)
                  ret = TPM_SaveState_Load(tpm_state, &stream, &stream_size);
             break;
+        default:
+            ret = TPM_BAD_PARAMETER;
         }
-        if (ret)
-            ClearAllCachedState();
     }
 
+    TPM_Global_Delete(tpm_state);
+    free(tpm_state);
+
+    return ret;
+}
+
+/*
+ * Test the state blob in the buffer and cache it for the next
+ * TPM_MainInit(). The buffer is owned by the cache afterwards or freed
+ * if the blob cannot be used.
+ */
+static TPM_RESULT TPM12_SetStateBuffer(enum TPMLIB_StateType st,
+                                       unsigned char *buffer, uint32_t buflen)
+{
+    TPM_RESULT ret;
+
+    if (tpm_instances[0]) {
+        free(buffer);
+        return TPM_INVALID_POSTINIT;
+    }
+
+    /* test whether we can accept the blob */
+    ret = TPM12_TestState(st, buffer, buflen);
+    if (ret)
+        ClearAllCachedState();
+
     /* cache the blob for the TPM_MainInit() to pick it up */
     if (ret == TPM_SUCCESS) {
-        SetCachedState(st, orig_stream, buflen);
+        SetCachedState(st, buffer, buflen);
     } else {
-        free(orig_stream);
+        free(buffer);
     }
 
-    TPM_Global_Delete(tpm_state);
-    free(tpm_state);
+    return ret;
+}
+
+/*
+ * Set the state the TPM 1.2 will use upon next TPM_MainInit(). The TPM 1.2
+ * must not have been started, yet, or it must have been terminated for this
+ * function to set the state.
+ *
+ * @st: The TPMLIB_StateType describing the type of blob in the buffer
+ * @buffer: pointer to the buffer containing the state blob; NULL pointer clears
+ *          previous state
+ * @buflen: length of the buffer
+ */
+static TPM_RESULT TPM12_SetState(enum TPMLIB_StateType st,
+                                 const unsigned char *buffer, uint32_t buflen)
+{
+    unsigned char *stream;
+
+    if (buffer == NULL) {
+        SetCachedState(st, NULL, 0);
+        return TPM_SUCCESS;
+    }
+
+    if (tpm_instances[0])
+        return TPM_INVALID_POSTINIT;
+
+    stream = malloc(buflen);
+    if (!stream) {
+        TPMLIB_LogError("Could not allocate %u bytes.\n", buflen);
+        return TPM_SIZE;
+    }
+    memcpy(stream, buffer, buflen);
+
+    return TPM12_SetStateBuffer(st, stream, buflen);
+}
+
+static TPM_RESULT TPM12_ValidateStateBlob(enum TPMLIB_StateType st,
+                                          const unsigned char *buffer,
+                                          uint32_t buflen,
+                                          unsigned int flags)
+{
+    TPM_RESULT ret;
+    unsigned char *stream;
+
+    if (tpm_instances[0])
+        return TPM_INVALID_POSTINIT;
+
+    /* no flags are defined */
+    if (flags)
+        return TPM_BAD_PARAMETER;
+
+    stream = malloc(buflen ? buflen : 1);
+    if (!stream) {
+        TPMLIB_LogError("Could not allocate %u bytes.\n", buflen);
+        return TPM_SIZE;
+    }
+    memcpy(stream, buffer, buflen);
+
+    ret = TPM12_TestState(st, stream, buflen);
+
+    free(stream);
 
     return ret;
 }
 
+/*
+ * The TPM 1.2 draws its random numbers from the crypto library and has
+ * no hierarchy seeds that could be renewed.
+ */
+static TPM_RESULT TPM12_ReseedInstance(unsigned int flags)
+{
+    if (flags)
+        return TPM_BAD_MODE;
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT TPM12_TakeSnapshot(void)
+{
+    return TPM_FAIL;
+}
+
+static TPM_RESULT TPM12_ResetToSnapshot(void)
+{
+    return TPM_FAIL;
+}
+
 static TPM_RESULT TPM12_SetProfile(const char *profile)
 {
     return TPM_FAIL;
@@ -536,7 +786,14 @@ const struct tpm_interface TPM12Interface = {
     .SetBufferSize = TPM12_SetBufferSize,
     .ValidateState = TPM12_ValidateState,
     .SetState = TPM12_SetState,
+    .SetStateBuffer = TPM12_SetStateBuffer,
     .GetState = TPM12_GetState,
     .SetProfile = TPM12_SetProfile,
     .WasManufactured = TPM12_WasManufactured,
+    .SetKeyHandles = TPM12_SetKeyHandles,
+    .GetStateStream = TPM12_GetStateStream,
+    .ValidateStateBlob = TPM12_ValidateStateBlob,
+    .ReseedInstance = TPM12_ReseedInstance,
+    .TakeSnapshot = TPM12_TakeSnapshot,
+    .ResetToSnapshot = TPM12_ResetToSnapshot,
 };
@@ -50,6 +50,8 @@
 #include <Simulator_fp.h>
 #include "PlatformData.h"
 #include "PlatformInternal.h"
+#include "MemoryUsage.h"
+#include "Snapshot.h"
 #include "StateMarshal.h"
 #include "Volatile.h"
 #include "ExpDCache_fp.h"
@@ -57,7 +59,10 @@
 #define TPM_HAVE_TPM2_DECLARATIONS
 #include "tpm_nvfile.h" // TPM_NVRAM_Loaddata()
 #include "tpm_error.h"
+#include "tpm_capture.h"
 #include "tpm_library_intern.h"
+#include "tpm_memusage.h"
+#include "tpm_probes.h"
 #include "tpm_nvfilename.h"
 
 static BOOL      reportedFailureCommand;
@@ -79,7 +84,9 @@ static TPM_BOOL _TPM2_CheckNVRAMFileExists(bool *has_nvram_loaddata_callback)
 
     *has_nvram_loaddata_callback = cbs->tpm_nvram_loaddata != NULL;
     if (cbs->tpm_nvram_loaddata) {
+        TPM_PROBE1(nvram_load_entry, name);
         ret = cbs->tpm_nvram_loaddata(&data, &length, tpm_number, name);
+        TPM_PROBE3(nvram_load_return, name, length, ret);
         free(data);
         /* a file exists once NOT TPM_RETRY is returned */
         if (ret != TPM_RETRY)
@@ -168,6 +175,7 @@ static void TPM2_Terminate(void)
 
     _rpc__Signal_PowerOff();
     ExpDCacheFree();
+    SnapshotFree();
 
     free(g_profile);
     g_profile = NULL;
@@ -232,6 +240,11 @@ static TPM_RESULT TPM2_Process(unsigned char **respbuffer, uint32_t *resp_size,
      */
     *resp_size = MIN(resp.BufferSize, TPM2_GetBufferSize());
 
+    TPM_Capture_Command(locality, command, command_size,
+                        *respbuffer, *resp_size);
+
+    MemoryUsageUpdateSlots();
+
     if (_plat__InFailureMode() && !reportedFailureCommand) {
         reportedFailureCommand = TRUE;
         TPMLIB_LogTPM2Error("%s: Entered failure mode through command:\n",
@@ -247,35 +260,33 @@ TPM_RESULT TPM2_PersistentAllStore(unsigned char **buf,
 {
     BYTE *buffer;
     INT32 size;
-    unsigned char *nbuffer;
     TPM_RESULT ret = TPM_SUCCESS;
-    UINT32 written = 0;
-
-    *buflen = NV_MEMORY_SIZE + 32 * 1024;
-    *buf = NULL;
-
-    /* the marshal functions do not indicate insufficient
-       buffer; to make sure we didn't run out of buffer,
-       we check that enough room for the biggest type of
-       chunk (64k) is available and try again. */
-    do {
-        *buflen += 66 * 1024;
-
-        nbuffer = realloc(*buf, *buflen);
-        if (nbuffer == NULL) {
-            free(*buf);
-            *buf = NULL;
-            ret = TPM_SIZE;
-            written = 0;
-            break;
-        }
+    UINT32 written, expected;
 
-        *buf = buffer = nbuffer;
-        size = *buflen;
-        written = PERSISTENT_ALL_Marshal(&buffer, &size);
-    } while (size < 66 * 1024);
+    /* marshalling without a buffer only computes the size of the blob,
+       so the buffer can be allocated with the exact size and the blob
+       written in a single pass */
+    expected = PERSISTENT_ALL_Marshal(NULL, NULL);
 
-    *buflen = written;
+    *buflen = 0;
+    *buf = malloc(expected);
+    if (*buf == NULL) {
+        TPMLIB_LogTPM2Error("Could not allocate %u bytes.\n", expected);
+        return TPM_SIZE;
+    }
+
+    buffer = *buf;
+    size = expected;
+    written = PERSISTENT_ALL_Marshal(&buffer, &size);
+    if (written != expected) {
+        TPMLIB_LogTPM2Error("Marshalled %u bytes rather than %u bytes.\n",
+                            written, expected);
+        free(*buf);
+        *buf = NULL;
+        ret = TPM_FAIL;
+    } else {
+        *buflen = written;
+    }
 
     return ret;
 }
@@ -284,22 +295,26 @@ static TPM_RESULT TPM2_VolatileAllStore(unsigned char **buffer,
                                         uint32_t *buflen)
 {
     TPM_RESULT rc = 0;
-    INT32 size = NV_MEMORY_SIZE;
-    UINT16 written;
+    INT32 size;
+    UINT16 written, expected;
     unsigned char *statebuffer = NULL;
 
+    /* sizing pass; see TPM2_PersistentAllStore */
+    expected = VolatileSave(NULL, NULL);
+
     *buffer = NULL;
-    statebuffer = malloc(size);
+    statebuffer = malloc(expected);
     if (!statebuffer) {
-        TPMLIB_LogTPM2Error("Could not allocate %u bytes.\n", size);
+        TPMLIB_LogTPM2Error("Could not allocate %u bytes.\n", expected);
         return TPM_SIZE;
     }
 
     /* statebuffer will change */
     *buffer = statebuffer;
+    size = expected;
 
     written = VolatileSave(&statebuffer, &size);
-    if (written >= size) {
+    if (written != expected) {
         free(*buffer);
         *buffer = NULL;
         rc = TPM_FAIL;
@@ -333,6 +348,22 @@ static TPM_RESULT TPM2_GetTPMProperty(enum TPMLIB_TPMProperty prop,
         *result = TPM2_BUFFER_MAX;
         break;
 
+    case  TPMPROP_TPM_MAX_NV_SPACE:
+        /* the permanent blob holds the marshalled NV memory; the headers
+           of its structures and entries are less than its size */
+        *result = 2 * NV_MEMORY_SIZE;
+        break;
+
+    case  TPMPROP_TPM_MAX_SAVESTATE_SPACE:
+        /* the TPM 2 has no savestate blob */
+        *result = 0;
+        break;
+
+    case  TPMPROP_TPM_MAX_VOLATILESTATE_SPACE:
+        /* VolatileSave() returns the size of the blob as UINT16 */
+        *result = UINT16_MAX;
+        break;
+
     /* not supported for TPM 2 */
     case  TPMPROP_TPM_OWNER_EVICT_KEY_HANDLES:
     case  TPMPROP_TPM_MIN_AUTH_SESSIONS:
@@ -343,9 +374,6 @@ static TPM_RESULT TPM2_GetTPMProperty(enum TPMLIB_TPMProperty prop,
     case  TPMPROP_TPM_NUM_FAMILY_TABLE_ENTRY_MIN:
     case  TPMPROP_TPM_NUM_DELEGATE_TABLE_ENTRY_MIN:
     case  TPMPROP_TPM_SPACE_SAFETY_MARGIN:
-    case  TPMPROP_TPM_MAX_NV_SPACE:
-    case  TPMPROP_TPM_MAX_SAVESTATE_SPACE:
-    case  TPMPROP_TPM_MAX_VOLATILESTATE_SPACE:
 
     default:
         return TPM_FAIL;
@@ -409,6 +437,7 @@ static char *TPM2_GetInfo(enum TPMLIB_InfoFlags flags)
     "\"AvailableProfiles\":["
         "%s%s%s"
     "]";
+    char *memoryUsage = NULL;
     char *fmt = NULL, *buffer;
     bool printed = false;
     char *tpmspec = NULL;
@@ -601,6 +630,20 @@ static char *TPM2_GetInfo(enum TPMLIB_InfoFlags flags)
         printed = true;
     }
 
+    if ((flags & TPMLIB_INFO_MEMORY_USAGE)) {
+        fmt = buffer;
+        buffer = NULL;
+        MemoryUsageUpdate();
+        memoryUsage = TPMLIB_MemoryUsagePrint(TPMLIB_TPM_VERSION_2);
+        if (!memoryUsage)
+            goto error;
+        if (TPMLIB_asprintf(&buffer, fmt, printed ? "," : "",
+                            memoryUsage, "%s%s%s") < 0)
+            goto error;
+        free(fmt);
+        printed = true;
+    }
+
     /* nothing else to add */
     fmt = buffer;
     buffer = NULL;
@@ -609,6 +652,7 @@ static char *TPM2_GetInfo(enum TPMLIB_InfoFlags flags)
 
 exit:
     free(fmt);
+    free(memoryUsage);
     free(tpmspec);
     free(tpmattrs);
     free(tpmfeatures);
@@ -672,6 +716,19 @@ uint32_t TPM2_GetBufferSize(void)
     return TPM2_SetBufferSize(0, NULL, NULL);
 }
 
+static uint32_t TPM2_SetKeyHandles(uint32_t wanted LIBTPMS_ATTR_UNUSED,
+                                   uint32_t *min,
+                                   uint32_t *max)
+{
+    /* the number of TPM 2 object slots is fixed at compile time */
+    if (min)
+        *min = 0;
+    if (max)
+        *max = 0;
+
+    return 0;
+}
+
 /*
  * Validate the state blobs to check whether they can be
  * successfully used by a TPM_INIT.
@@ -707,8 +764,10 @@ static TPM_RESULT TPM2_ValidateState(enum TPMLIB_StateType st,
 
 #ifdef TPM_LIBTPMS_CALLBACKS
         if (cbs->tpm_nvram_loaddata) {
+            TPM_PROBE1(nvram_load_entry, TPM_PERMANENT_ALL_NAME);
             ret = cbs->tpm_nvram_loaddata(&data, &length, 0,
                                           TPM_PERMANENT_ALL_NAME);
+            TPM_PROBE3(nvram_load_return, TPM_PERMANENT_ALL_NAME, length, ret);
             if (ret != TPM_SUCCESS)
                 return ret;
         }
@@ -784,6 +843,122 @@ static TPM_RESULT TPM2_GetState(enum TPMLIB_StateType st,
     return ret;
 }
 
+struct state_stream {
+    TPMLIB_StateWriter writer;
+    void *opaque;
+    TPM_RESULT ret;
+};
+
+static TPM_RC TPM2_StateStreamWrite(void *opaque, const BYTE *data,
+                                    UINT32 length)
+{
+    struct state_stream *ss = opaque;
+
+    ss->ret = ss->writer(ss->opaque, data, length);
+
+    return ss->ret == TPM_SUCCESS ? TPM_RC_SUCCESS : TPM_RC_FAILURE;
+}
+
+/*
+ * Get the state blob of the given type and pass it to the writer function
+ * in chunks. The permanent state of a running TPM is marshalled directly
+ * into a chunk-sized buffer so that its size does not determine the
+ * memory needed for it.
+ */
+static TPM_RESULT TPM2_GetStateStream(enum TPMLIB_StateType st,
+                                      TPMLIB_StateWriter writer,
+                                      void *opaque)
+{
+    TPM_RESULT ret;
+    struct state_stream ss = {
+        .writer = writer,
+        .opaque = opaque,
+        .ret = TPM_SUCCESS,
+    };
+    unsigned char *buffer;
+    uint32_t buflen;
+    TPM_RC rc;
+
+    if (_rpc__Signal_IsPowerOn() && st == TPMLIB_STATE_PERMANENT) {
+        buffer = malloc(TPMLIB_STATE_CHUNK_SIZE);
+        if (!buffer) {
+            TPMLIB_LogTPM2Error("Could not allocate %u bytes.\n",
+                                TPMLIB_STATE_CHUNK_SIZE);
+            return TPM_SIZE;
+        }
+        rc = PERSISTENT_ALL_MarshalStream(TPM2_StateStreamWrite, &ss,
+                                          buffer, TPMLIB_STATE_CHUNK_SIZE);
+        free(buffer);
+
+        if (ss.ret != TPM_SUCCESS)
+            return ss.ret;
+        return rc == TPM_RC_SUCCESS ? TPM_SUCCESS : TPM_FAIL;
+    }
+
+    ret = TPM2_GetState(st, &buffer, &buflen);
+    if (ret == TPM_SUCCESS) {
+        ret = TPMLIB_WriteStateChunks(buffer, buflen, writer, opaque);
+        free(buffer);
+    }
+
+    return ret;
+}
+
+/*
+ * Test the state blob in the buffer and cache it for the next
+ * TPM_MainInit(). The buffer is owned by the cache afterwards or freed
+ * if the blob cannot be used.
+ */
+static TPM_RESULT TPM2_SetStateBuffer(enum TPMLIB_StateType st,
+                                      unsigned char *buffer, uint32_t buflen)
+{
+    TPM_RESULT ret = TPM_SUCCESS;
+    TPM_RC rc = TPM_RC_SUCCESS;
+    BYTE *stream = buffer;
+    INT32 stream_size = buflen;
+    unsigned char *permanent = NULL, *ptr;
+    INT32 permanent_len;
+
+    if (_rpc__Signal_IsPowerOn()) {
+        free(buffer);
+        return TPM_INVALID_POSTINIT;
+    }
+
+    /* test whether we can accept the blob */
+    switch (st) {
+    case TPMLIB_STATE_PERMANENT:
+        rc = PERSISTENT_ALL_Unmarshal(&stream, &stream_size);
+        break;
+    case TPMLIB_STATE_VOLATILE:
+        /* load permanent state first */
+        rc = TPM2_GetState(TPMLIB_STATE_PERMANENT,
+                           &permanent, (uint32_t *)&permanent_len);
+        if (rc == TPM_RC_SUCCESS) {
+            ptr = permanent;
+            rc = PERSISTENT_ALL_Unmarshal(&ptr, &permanent_len);
+            if (rc == TPM_RC_SUCCESS)
+                rc = VolatileState_Load(&stream, &stream_size);
+        }
+        break;
+    case TPMLIB_STATE_SAVE_STATE:
+        rc = TPM_BAD_TYPE;
+        break;
+    }
+    ret = rc;
+    if (ret != TPM_SUCCESS)
+        ClearAllCachedState();
+
+    /* cache the blob for the TPM_MainInit() to pick it up */
+    if (ret == TPM_SUCCESS) {
+        SetCachedState(st, buffer, buflen);
+    } else {
+        free(buffer);
+    }
+    free(permanent);
+
+    return ret;
+}
+
 /*
  * Set the state the TPM 2 will use upon next TPM_MainInit(). The TPM 2
  * must not have been started, yet, or it must have been terminated for this
@@ -797,12 +972,7 @@ static TPM_RESULT TPM2_GetState(enum TPMLIB_StateType st,
 static TPM_RESULT TPM2_SetState(enum TPMLIB_StateType st,
                                 const unsigned char *buffer, uint32_t buflen)
 {
-    TPM_RESULT ret = TPM_SUCCESS;
-    TPM_RC rc = TPM_RC_SUCCESS;
-    BYTE *stream = NULL, *orig_stream = NULL;
-    INT32 stream_size = buflen;
-    unsigned char *permanent = NULL, *ptr;
-    INT32 permanent_len;
+    unsigned char *stream;
 
     if (buffer == NULL) {
         SetCachedState(st, NULL, 0);
@@ -812,53 +982,161 @@ static TPM_RESULT TPM2_SetState(enum TPMLIB_StateType st,
     if (_rpc__Signal_IsPowerOn())
         return TPM_INVALID_POSTINIT;
 
-    if (ret == TPM_SUCCESS) {
-        stream = malloc(buflen);
-        if (!stream)
-            ret = TPM_SIZE;
+    stream = malloc(buflen);
+    if (!stream)
+        return TPM_SIZE;
+    memcpy(stream, buffer, buflen);
+
+    return TPM2_SetStateBuffer(st, stream, buflen);
+}
+
+static TPM_RESULT TPM2_ValidateStateBlob(enum TPMLIB_StateType st,
+                                         const unsigned char *buffer,
+                                         uint32_t buflen,
+                                         unsigned int flags)
+{
+    /* the blob is only read */
+    BYTE *stream = (BYTE *)buffer;
+    INT32 stream_size = buflen;
+    TPM_RC rc;
+
+    if (_rpc__Signal_IsPowerOn())
+        return TPM_INVALID_POSTINIT;
+
+    /* no flags are defined */
+    if (flags)
+        return TPM_BAD_PARAMETER;
+
+    switch (st) {
+    case TPMLIB_STATE_PERMANENT:
+        rc = PERSISTENT_ALL_Validate(&stream, &stream_size);
+        break;
+    case TPMLIB_STATE_VOLATILE:
+        /* the volatile state is unmarshalled directly into the TPM's
+           globals and cannot be checked without loading it */
+    case TPMLIB_STATE_SAVE_STATE:
+        rc = TPM_BAD_TYPE;
+        break;
+    default:
+        rc = TPM_BAD_PARAMETER;
     }
 
-    if (ret == TPM_SUCCESS) {
-        orig_stream = stream;
-        memcpy(stream, buffer, buflen);
+    return rc;
+}
+
+/*
+ * Reseed the DRBG of a TPM 2 whose state was instantiated from a template
+ * so that it does not produce the same random numbers as the other
+ * instances created from the template. The null hierarchy and the loaded
+ * sessions and objects of the template must not be shared either, so the
+ * instance goes through a TPM Reset: a running instance gets a new null
+ * proof and seed and its sessions and objects are flushed, as
+ * TPM2_Startup(CLEAR) would do, while an instance that is yet to be started
+ * cannot resume the state saved in the template. The primary seeds selected
+ * in flags are renewed along with the proof value of their hierarchy; the
+ * objects of such a hierarchy are flushed since they were derived from
+ * the old seed.
+ */
+static TPM_RESULT TPM2_ReseedInstance(unsigned int flags)
+{
+    if (!_rpc__Signal_IsPowerOn() || _plat__InFailureMode())
+        return TPM_FAIL;
+
+    if (!CryptRandStartup())
+        return TPM_FAIL;
+
+    if (g_NvStatus != TPM_RC_SUCCESS)
+        return TPM_FAIL;
+
+    if (TPMIsStarted()) {
+        gr.nullProof.t.size = sizeof(gr.nullProof.t.buffer);
+        CryptRandomGenerate(gr.nullProof.t.size, gr.nullProof.t.buffer);
+        gr.nullSeed.t.size = sizeof(gr.nullSeed.t.buffer);
+        CryptRandomGenerate(gr.nullSeed.t.size, gr.nullSeed.t.buffer);
+        gr.nullSeedCompatLevel = RuntimeProfileGetSeedCompatLevel();
+
+        gr.objectContextID = 0;
+        gr.clearCount = 0;
+        gr.restartCount = 0;
+        /* contexts saved by the template carry the old resetCount */
+        gp.resetCount++;
+        NV_SYNC_PERSISTENT(resetCount);
+        gp.totalResetCount++;
+        NV_SYNC_PERSISTENT(totalResetCount);
+
+        if (!SessionStartup(SU_RESET) || !ObjectStartup())
+            return TPM_FAIL;
+    } else if ((gp.orderlyState & TPM_SU_STATE_MASK) == TPM_SU_STATE) {
+        /* TPM2_Startup(CLEAR) would restore gr after a TPM2_Shutdown(STATE);
+           an orderly shutdown with CLEAR has it do a TPM Reset instead */
+        gp.orderlyState &= ~TPM_SU_STATE_MASK;
+        NV_SYNC_PERSISTENT(orderlyState);
     }
 
-    /* test whether we can accept the blob */
-    if (ret == TPM_SUCCESS) {
-        switch (st) {
-        case TPMLIB_STATE_PERMANENT:
-            rc = PERSISTENT_ALL_Unmarshal(&stream, &stream_size);
-            break;
-        case TPMLIB_STATE_VOLATILE:
-            /* load permanent state first */
-            rc = TPM2_GetState(TPMLIB_STATE_PERMANENT,
-                               &permanent, (uint32_t *)&permanent_len);
-            if (rc == TPM_RC_SUCCESS) {
-                ptr = permanent;
-                rc = PERSISTENT_ALL_Unmarshal(&ptr, &permanent_len);
-                if (rc == TPM_RC_SUCCESS)
-                    rc = VolatileState_Load(&stream, &stream_size);
-            }
-            break;
-        case TPMLIB_STATE_SAVE_STATE:
-            if (buffer != NULL)
-                rc = TPM_BAD_TYPE;
-            break;
-        }
-        ret = rc;
-        if (ret != TPM_SUCCESS)
-            ClearAllCachedState();
+    if (flags & TPMLIB_TEMPLATE_NEW_EPS) {
+        CryptRandomGenerate(sizeof(gp.EPSeed.t.buffer), gp.EPSeed.t.buffer);
+        gp.EPSeedCompatLevel = RuntimeProfileGetSeedCompatLevel();
+        CryptRandomGenerate(sizeof(gp.ehProof.t.buffer), gp.ehProof.t.buffer);
+        ObjectFlushHierarchy(TPM_RH_ENDORSEMENT);
+        NvFlushHierarchy(TPM_RH_ENDORSEMENT);
+        NV_SYNC_PERSISTENT(EPSeed);
+        NV_SYNC_PERSISTENT(EPSeedCompatLevel);
+        NV_SYNC_PERSISTENT(ehProof);
+    }
+    if (flags & TPMLIB_TEMPLATE_NEW_SPS) {
+        CryptRandomGenerate(sizeof(gp.SPSeed.t.buffer), gp.SPSeed.t.buffer);
+        gp.SPSeedCompatLevel = RuntimeProfileGetSeedCompatLevel();
+        CryptRandomGenerate(sizeof(gp.shProof.t.buffer), gp.shProof.t.buffer);
+        ObjectFlushHierarchy(TPM_RH_OWNER);
+        NvFlushHierarchy(TPM_RH_OWNER);
+        NV_SYNC_PERSISTENT(SPSeed);
+        NV_SYNC_PERSISTENT(SPSeedCompatLevel);
+        NV_SYNC_PERSISTENT(shProof);
     }
+    if (flags & TPMLIB_TEMPLATE_NEW_PPS) {
+        CryptRandomGenerate(sizeof(gp.PPSeed.t.buffer), gp.PPSeed.t.buffer);
+        gp.PPSeedCompatLevel = RuntimeProfileGetSeedCompatLevel();
+        CryptRandomGenerate(sizeof(gp.phProof.t.buffer), gp.phProof.t.buffer);
+        ObjectFlushHierarchy(TPM_RH_PLATFORM);
+        NvFlushHierarchy(TPM_RH_PLATFORM);
+        NV_SYNC_PERSISTENT(PPSeed);
+        NV_SYNC_PERSISTENT(PPSeedCompatLevel);
+        NV_SYNC_PERSISTENT(phProof);
+    }
+    NvCommit();
 
-    /* cache the blob for the TPM_MainInit() to pick it up */
-    if (ret == TPM_SUCCESS) {
-        SetCachedState(st, orig_stream, buflen);
-    } else {
-        free(orig_stream);
+    if (_plat__InFailureMode())
+        return TPM_FAIL;
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT TPM2_TakeSnapshot(void)
+{
+    if (!_rpc__Signal_IsPowerOn())
+        return TPM_FAIL;
+
+    switch (SnapshotTake()) {
+    case TPM_RC_SUCCESS:
+        return TPM_SUCCESS;
+    case TPM_RC_MEMORY:
+        return TPM_SIZE;
+    default:
+        return TPM_FAIL;
     }
-    free(permanent);
+}
 
-    return ret;
+static TPM_RESULT TPM2_ResetToSnapshot(void)
+{
+    if (!_rpc__Signal_IsPowerOn())
+        return TPM_FAIL;
+
+    if (SnapshotRestore() != TPM_RC_SUCCESS)
+        return TPM_FAIL;
+
+    reportedFailureCommand = FALSE;
+
+    return TPM_SUCCESS;
 }
 
 static TPM_RESULT TPM2_SetProfile(const char *profile)
@@ -907,7 +1185,14 @@ const struct tpm_interface TPM2Interface = {
     .SetBufferSize = TPM2_SetBufferSize,
     .ValidateState = TPM2_ValidateState,
     .SetState = TPM2_SetState,
+    .SetStateBuffer = TPM2_SetStateBuffer,
     .GetState = TPM2_GetState,
     .SetProfile = TPM2_SetProfile,
     .WasManufactured = TPM2_WasManufactured,
+    .SetKeyHandles = TPM2_SetKeyHandles,
+    .GetStateStream = TPM2_GetStateStream,
+    .ValidateStateBlob = TPM2_ValidateStateBlob,
+    .ReseedInstance = TPM2_ReseedInstance,
+    .TakeSnapshot = TPM2_TakeSnapshot,
+    .ResetToSnapshot = TPM2_ResetToSnapshot,
 };
@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tpm_error.h"
+#include "tpm_library.h"
+#include "tpm_library_intern.h"
+
+/*
+ * Write more debug output to the ring buffer than it can hold and check that
+ * the lines that do not fit are dropped and counted.
+ */
+
+/* 64 bytes per line so that 64 lines fill the smallest ring buffer */
+#define LINE_FORMAT "line %058u\n"
+#define LINE_LEN    64
+#define RING_SIZE   4096
+
+static int check_read(const char *when, size_t exp_lines, size_t exp_dropped)
+{
+    static char buffer[2 * RING_SIZE];
+    char line[LINE_LEN + 1];
+    size_t n, dropped, i;
+
+    n = TPMLIB_ReadDebugRingBuffer(buffer, sizeof(buffer), &dropped);
+    if (n != exp_lines * LINE_LEN || dropped != exp_dropped) {
+        fprintf(stderr, "Read %zu bytes with %zu dropped lines %s, expected "
+                "%zu bytes with %zu dropped lines.\n", n, dropped, when,
+                exp_lines * LINE_LEN, exp_dropped);
+        return 1;
+    }
+    for (i = 0; i < exp_lines; i++) {
+        snprintf(line, sizeof(line), LINE_FORMAT, (unsigned)i);
+        if (memcmp(&buffer[i * LINE_LEN], line, LINE_LEN)) {
+            fprintf(stderr, "Line %zu is different %s.\n", i, when);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    char buffer[LINE_LEN];
+    size_t dropped;
+    unsigned i;
+    int ret = 1;
+
+    TPMLIB_SetDebugLevel(1);
+
+    if (TPMLIB_SetDebugRingBuffer(64 * 1024 * 1024 + 1) != TPM_BAD_PARAMETER) {
+        fprintf(stderr, "TPMLIB_SetDebugRingBuffer() accepted a too large "
+                "size.\n");
+        goto exit;
+    }
+    /* the size is rounded up to the minimum */
+    if (TPMLIB_SetDebugRingBuffer(100) != TPM_SUCCESS) {
+        fprintf(stderr, "TPMLIB_SetDebugRingBuffer() failed.\n");
+        goto exit;
+    }
+
+    for (i = 0; i < RING_SIZE / LINE_LEN + 6; i++)
+        TPMLIB_LogPrintf(LINE_FORMAT, i);
+
+    if (check_read("after overflowing the ring buffer",
+                   RING_SIZE / LINE_LEN, 6) ||
+        check_read("after draining the ring buffer", 0, 0))
+        goto exit;
+
+    /* lines wrapping around the end of the ring buffer stay intact */
+    TPMLIB_LogPrintf("%031u\n", 0);
+    if (TPMLIB_ReadDebugRingBuffer(buffer, sizeof(buffer), &dropped)
+            != LINE_LEN / 2 || dropped) {
+        fprintf(stderr, "Reading a short line from the ring buffer "
+                "failed.\n");
+        goto exit;
+    }
+    for (i = 0; i < RING_SIZE / LINE_LEN; i++)
+        TPMLIB_LogPrintf(LINE_FORMAT, i);
+    if (check_read("after wrapping around", RING_SIZE / LINE_LEN, 0))
+        goto exit;
+
+    /* without a ring buffer nothing can be read */
+    TPMLIB_SetDebugRingBuffer(0);
+    if (TPMLIB_ReadDebugRingBuffer(buffer, sizeof(buffer), &dropped) ||
+        dropped) {
+        fprintf(stderr, "Read from a freed ring buffer.\n");
+        goto exit;
+    }
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    TPMLIB_SetDebugRingBuffer(0);
+
+    return ret;
+}
@@ -10,6 +10,15 @@
 #include <libtpms/tpm_memory.h>
 #include <libtpms/tpm_nvfilename.h>
 
+#define EXIT_TEST_SKIP 77
+
+#ifdef FUZZ_PERSISTENT_MODE
+/* internal functions only accessible with '-static' */
+extern "C" {
+TPM_RESULT TPMLIB_TakeSnapshot(void);
+TPM_RESULT TPMLIB_ResetToSnapshot(void);
+}
+#endif
 
 static void die(const char *msg)
 {
@@ -73,6 +82,72 @@ static TPM_RESULT mytpm_nvram_storedata(const unsigned char *data,
     return TPM_SUCCESS;
 }
 
+static const struct libtpms_callbacks fuzz_callbacks = {
+    .sizeOfStruct               = sizeof(struct libtpms_callbacks),
+    .tpm_nvram_init             = NULL,
+    .tpm_nvram_loaddata         = mytpm_nvram_loaddata,
+    .tpm_nvram_storedata        = mytpm_nvram_storedata,
+    .tpm_nvram_deletename       = NULL,
+    .tpm_io_init                = mytpm_io_init,
+    .tpm_io_getlocality         = mytpm_io_getlocality,
+    .tpm_io_getphysicalpresence = mytpm_io_getphysicalpresence,
+};
+
+#ifdef FUZZ_PERSISTENT_MODE
+/*
+ * In persistent mode the TPM is only manufactured and started once. Each
+ * input is run against the TPM after resetting it to a snapshot of its
+ * state after TPM2_Startup. The suspend and resume of the TPM's state are
+ * not tested in this mode.
+ */
+static int fuzz_persistent(const uint8_t* data, size_t size)
+{
+    static unsigned char *rbuffer;
+    static uint32_t rtotal;
+    static bool initialized;
+    uint32_t rlength;
+    TPM_RESULT res;
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x01, 0x44, 0x00, 0x00
+    };
+    struct libtpms_callbacks cbs = fuzz_callbacks;
+
+    if (!initialized) {
+        res = TPMLIB_RegisterCallbacks(&cbs);
+        if (res != TPM_SUCCESS)
+            die("Could not register callbacks\n");
+
+        res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+        if (res != TPM_SUCCESS)
+            die("Could not choose the TPM version\n");
+
+        res = TPMLIB_MainInit();
+        if (res != TPM_SUCCESS)
+            die("Error: TPMLIB_MainInit() failed\n");
+
+        res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, startup, sizeof(startup));
+        if (res != TPM_SUCCESS)
+            die("Error: TPMLIB_Process(Startup) failed\n");
+
+        res = TPMLIB_TakeSnapshot();
+        if (res != TPM_SUCCESS)
+            die("Error: TPMLIB_TakeSnapshot() failed\n");
+
+        initialized = true;
+    } else {
+        res = TPMLIB_ResetToSnapshot();
+        if (res != TPM_SUCCESS)
+            die("Error: TPMLIB_ResetToSnapshot() failed\n");
+    }
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, (unsigned char*)data, size);
+    if (res != TPM_SUCCESS)
+        die("Error: TPMLIB_Process(fuzz-command) failed\n");
+
+    return 0;
+}
+#endif
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
 {
     unsigned char *rbuffer = NULL;
@@ -86,16 +161,15 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
     unsigned char startup[] = {
         0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x01, 0x44, 0x00, 0x00
     };
-    struct libtpms_callbacks cbs = {
-        .sizeOfStruct               = sizeof(struct libtpms_callbacks),
-        .tpm_nvram_init             = NULL,
-        .tpm_nvram_loaddata         = mytpm_nvram_loaddata,
-        .tpm_nvram_storedata        = mytpm_nvram_storedata,
-        .tpm_nvram_deletename       = NULL,
-        .tpm_io_init                = mytpm_io_init,
-        .tpm_io_getlocality         = mytpm_io_getlocality,
-        .tpm_io_getphysicalpresence = mytpm_io_getphysicalpresence,
-    };
+    struct libtpms_callbacks cbs = fuzz_callbacks;
+
+    if (getenv("FUZZ_PERSISTENT"))
+#ifdef FUZZ_PERSISTENT_MODE
+        return fuzz_persistent(data, size);
+#else
+        return EXIT_TEST_SKIP;
+#endif
+
     res = TPMLIB_RegisterCallbacks(&cbs);
     if (res != TPM_SUCCESS)
         die("Could not register callbacks\n");
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// (c) Copyright IBM Corporation, 2026
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "tpm_error.h"
+#include "tpm_nvfile.h"
+#include "tpm_nvfilename.h"
+
+static char dir[] = "/tmp/nvram_journal.XXXXXX";
+
+static off_t filesize(const char *name)
+{
+    char filename[FILENAME_MAX];
+    struct stat st;
+
+    snprintf(filename, sizeof(filename), "%s/00.%s", dir, name);
+    if (stat(filename, &st) != 0)
+        return -1;
+    return st.st_size;
+}
+
+static int store(const char *data, const char *journal)
+{
+    if (journal)
+        setenv("TPM_NV_JOURNAL", journal, 1);
+    else
+        unsetenv("TPM_NV_JOURNAL");
+
+    if (TPM_NVRAM_Init() != TPM_SUCCESS) {
+        fprintf(stderr, "TPM_NVRAM_Init() failed\n");
+        return 1;
+    }
+    if (TPM_NVRAM_StoreData((const unsigned char *)data, strlen(data), 0,
+                            TPM_PERMANENT_ALL_NAME) != TPM_SUCCESS) {
+        fprintf(stderr, "TPM_NVRAM_StoreData() failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* restart without the journal and check that the latest state is read back */
+static int check(const char *exp)
+{
+    unsigned char *data = NULL;
+    uint32_t length;
+    int ret = 1;
+
+    unsetenv("TPM_NV_JOURNAL");
+
+    if (TPM_NVRAM_Init() != TPM_SUCCESS) {
+        fprintf(stderr, "TPM_NVRAM_Init() failed\n");
+        return 1;
+    }
+    if (TPM_NVRAM_LoadData(&data, &length, 0,
+                           TPM_PERMANENT_ALL_NAME) != TPM_SUCCESS) {
+        fprintf(stderr, "TPM_NVRAM_LoadData() failed\n");
+        return 1;
+    }
+    if (length != strlen(exp) || memcmp(data, exp, length)) {
+        fprintf(stderr, "Read back '%.*s' rather than '%s'\n",
+                (int)length, data, exp);
+        goto exit;
+    }
+    if (filesize(TPM_PERMANENT_ALL_NAME) != (off_t)strlen(exp)) {
+        fprintf(stderr, "State file was not written\n");
+        goto exit;
+    }
+    if (filesize("journal") != 0) {
+        fprintf(stderr, "Journal was not emptied\n");
+        goto exit;
+    }
+    ret = 0;
+
+exit:
+    free(data);
+    return ret;
+}
+
+int main(void)
+{
+    char filename[FILENAME_MAX];
+    int status;
+    int ret = 1;
+    pid_t pid;
+
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "mkdtemp() failed\n");
+        return 1;
+    }
+    setenv("TPM_PATH", dir, 1);
+
+    /* the journaled state of a TPM that exited without terminating must
+       not be lost when it is restarted without the journal */
+    if (store("version 1", NULL))
+        goto exit;
+
+    pid = fork();
+    if (pid == 0) {
+        if (store("version 2", "1") || store("version 3", "1"))
+            _exit(1);
+        _exit(0);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Storing into the journal failed\n");
+        goto exit;
+    }
+    if (filesize("journal") <= 0) {
+        fprintf(stderr, "Journal was not written\n");
+        goto exit;
+    }
+    if (check("version 3"))
+        goto exit;
+
+    /* terminating checkpoints the journal */
+    if (store("version 4", "1"))
+        goto exit;
+    TPM_NVRAM_Terminate();
+    if (filesize("journal") != 0) {
+        fprintf(stderr, "Journal was not checkpointed at terminate\n");
+        goto exit;
+    }
+    if (check("version 4"))
+        goto exit;
+
+    fprintf(stdout, "OK\n");
+
+    ret = 0;
+
+exit:
+    snprintf(filename, sizeof(filename), "%s/00.%s", dir, TPM_PERMANENT_ALL_NAME);
+    unlink(filename);
+    snprintf(filename, sizeof(filename), "%s/00.journal", dir);
+    unlink(filename);
+    rmdir(dir);
+
+    return ret;
+}
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+/*
+ * Change the number of key slots of a TPM 1.2 and check that requests
+ * outside the supported range are clamped and that the TPM advertises
+ * the number of key slots it was started with.
+ */
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm12_command(const char *name,
+                         unsigned char *cmd, size_t cmdlen,
+                         const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_keyhandles(const char *what, uint32_t wanted, uint32_t exp)
+{
+    uint32_t res, min, max;
+    int prop;
+
+    res = TPMLIB_SetKeyHandles(wanted, &min, &max);
+    if (res != exp) {
+        fprintf(stderr, "TPMLIB_SetKeyHandles(%u) %s returned %u, "
+                "expected %u.\n", wanted, what, res, exp);
+        return 1;
+    }
+    if (TPMLIB_GetTPMProperty(TPMPROP_TPM_KEY_HANDLES, &prop) ||
+        (uint32_t)prop != exp) {
+        fprintf(stderr, "TPMPROP_TPM_KEY_HANDLES is not %u %s.\n", exp, what);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned char startup[] = {
+        0x00, 0xc1, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x00, 0x99, 0x00, 0x01
+    };
+    const unsigned char startup_resp[] = {
+        0x00, 0xc4, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00,
+        0x00, 0x00
+    };
+    /* TPM_CAP_PROPERTY, TPM_CAP_PROP_MAX_KEYS */
+    unsigned char getcapability[] = {
+        0x00, 0xc1, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00,
+        0x00, 0x65, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00,
+        0x00, 0x04, 0x00, 0x00, 0x01, 0x10
+    };
+    unsigned char getcapability_resp[] = {
+        0x00, 0xc4, 0x00, 0x00, 0x00, 0x12, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00,
+        0x00, 0x00
+    };
+    uint32_t min, max, keyhandles;
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_1_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    /* the minimum number of key slots is the default */
+    keyhandles = TPMLIB_SetKeyHandles(0, &min, &max);
+    if (keyhandles != min || min == 0 || max < min) {
+        fprintf(stderr, "TPMLIB_SetKeyHandles(0) returned %u with minimum %u "
+                "and maximum %u.\n", keyhandles, min, max);
+        goto exit;
+    }
+
+    if (check_keyhandles("below the minimum", 1, min) ||
+        check_keyhandles("above the maximum", max + 1, max) ||
+        check_keyhandles("at the minimum", min, min) ||
+        check_keyhandles("at the maximum", max, max) ||
+        check_keyhandles("when querying", 0, max))
+        goto exit;
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    getcapability_resp[14] = max >> 24;
+    getcapability_resp[15] = max >> 16;
+    getcapability_resp[16] = max >> 8;
+    getcapability_resp[17] = max;
+
+    if (tpm12_command("TPM_Startup", startup, sizeof(startup),
+                      startup_resp, sizeof(startup_resp)) ||
+        tpm12_command("TPM_GetCapability",
+                      getcapability, sizeof(getcapability),
+                      getcapability_resp, sizeof(getcapability_resp)))
+        goto exit;
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    TPMLIB_Terminate();
+    TPM_Free(rbuffer);
+
+    return ret;
+}
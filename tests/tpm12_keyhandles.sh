@@ -0,0 +1,13 @@
+#!/usr/bin/env bash
+
+# For the license, see the LICENSE file in the root directory.
+
+DIR=${PWD}
+
+TPM_PATH=$(mktemp -d)
+export TPM_PATH
+
+trap "rm -rf ${TPM_PATH}" EXIT
+
+"${DIR}/tpm12_keyhandles"
+exit $?
@@ -0,0 +1,973 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Throughput benchmark for TPM 2 commands sent through TPMLIB_Process().
+ *
+ * Each benchmark runs a representative command mix against a freshly
+ * manufactured TPM whose state is kept in memory and reports ops/sec as well
+ * as the p50 and p99 latencies of the timed commands as JSON on stdout.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+#include <libtpms/tpm_nvfilename.h>
+
+#define TPM_ST_NO_SESSIONS        0x8001
+#define TPM_ST_SESSIONS           0x8002
+
+#define TPM_CC_NV_DefineSpace     0x0000012a
+#define TPM_CC_CreatePrimary      0x00000131
+#define TPM_CC_NV_Write           0x00000137
+#define TPM_CC_Create             0x00000153
+#define TPM_CC_Load               0x00000157
+#define TPM_CC_Quote              0x00000158
+#define TPM_CC_Unseal             0x0000015e
+#define TPM_CC_ContextLoad        0x00000161
+#define TPM_CC_ContextSave        0x00000162
+#define TPM_CC_FlushContext       0x00000165
+#define TPM_CC_NV_Read            0x0000014e
+#define TPM_CC_NV_ReadPublic      0x00000169
+#define TPM_CC_StartAuthSession   0x00000176
+#define TPM_CC_PCR_Extend         0x00000182
+#define TPM_CC_Startup            0x00000144
+
+#define TPM_RH_OWNER              0x40000001
+#define TPM_RH_NULL               0x40000007
+#define TPM_RS_PW                 0x40000009
+#define TPM_RH_ENDORSEMENT        0x4000000b
+
+#define TPM_ALG_RSA               0x0001
+#define TPM_ALG_AES               0x0006
+#define TPM_ALG_KEYEDHASH         0x0008
+#define TPM_ALG_SHA256            0x000b
+#define TPM_ALG_NULL              0x0010
+#define TPM_ALG_RSASSA            0x0014
+#define TPM_ALG_ECDSA             0x0018
+#define TPM_ALG_ECC               0x0023
+#define TPM_ALG_CFB               0x0043
+#define TPM_ECC_NIST_P256         0x0003
+
+#define TPM_SE_HMAC               0x00
+
+#define TPMA_SESSION_CONTINUESESSION 0x01
+#define TPMA_SESSION_ENCRYPT         0x40
+
+#define NV_INDEX                  0x01000000
+#define NV_DATA_SIZE              64
+
+#define SHA256_DIGEST_SIZE        32
+
+struct buffer {
+    unsigned char data[4096];
+    size_t len;
+};
+
+struct tpm2b {
+    uint16_t size;
+    unsigned char buffer[256];
+};
+
+struct session {
+    uint32_t handle;            /* TPM_RS_PW for a password session */
+    unsigned char attributes;
+    struct tpm2b nonceTPM;
+};
+
+struct benchmark {
+    const char *name;
+    unsigned int iterations;
+    int (*setup)(void);
+    int (*run)(void);           /* one timed operation */
+    void (*cleanup)(void);      /* untimed, after each operation */
+    void (*teardown)(void);
+};
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static unsigned char *nvram_blobs[3];
+static uint32_t nvram_lengths[3];
+static const char *nvram_names[] = {
+    TPM_PERMANENT_ALL_NAME,
+    TPM_VOLATILESTATE_NAME,
+    TPM_SAVESTATE_NAME,
+};
+
+/* handles and names of objects used by the benchmarks */
+static uint32_t srk_handle;
+static uint32_t ak_handle;
+static uint32_t sealed_handle;
+static struct tpm2b sealed_name;
+static struct tpm2b nv_name;
+static struct session hmac_session;
+
+/*
+ * Keep the TPM's state in memory so that the benchmarks do not measure
+ * the file system.
+ */
+static int nvram_index(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(nvram_names) / sizeof(nvram_names[0]); i++)
+        if (!strcmp(name, nvram_names[i]))
+            return i;
+    return -1;
+}
+
+static TPM_RESULT nvram_init(void)
+{
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_loaddata(unsigned char **data, uint32_t *length,
+                                 uint32_t tpm_number, const char *name)
+{
+    int i = nvram_index(name);
+
+    (void)tpm_number;
+    if (i < 0 || !nvram_blobs[i])
+        return TPM_RETRY;
+    if (TPM_Malloc(data, nvram_lengths[i]) != TPM_SUCCESS)
+        return TPM_FAIL;
+    memcpy(*data, nvram_blobs[i], nvram_lengths[i]);
+    *length = nvram_lengths[i];
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_storedata(const unsigned char *data, uint32_t length,
+                                  uint32_t tpm_number, const char *name)
+{
+    int i = nvram_index(name);
+    unsigned char *copy;
+
+    (void)tpm_number;
+    if (i < 0)
+        return TPM_FAIL;
+    copy = malloc(length ? length : 1);
+    if (!copy)
+        return TPM_FAIL;
+    memcpy(copy, data, length);
+    free(nvram_blobs[i]);
+    nvram_blobs[i] = copy;
+    nvram_lengths[i] = length;
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_deletename(uint32_t tpm_number, const char *name,
+                                   TPM_BOOL mustExist)
+{
+    int i = nvram_index(name);
+
+    (void)tpm_number;
+    if (i < 0 || !nvram_blobs[i])
+        return mustExist ? TPM_FAIL : TPM_SUCCESS;
+    free(nvram_blobs[i]);
+    nvram_blobs[i] = NULL;
+    nvram_lengths[i] = 0;
+
+    return TPM_SUCCESS;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1E6 + ts.tv_nsec / 1E3;
+}
+
+static void put_u8(struct buffer *b, uint8_t v)
+{
+    b->data[b->len++] = v;
+}
+
+static void put_u16(struct buffer *b, uint16_t v)
+{
+    put_u8(b, v >> 8);
+    put_u8(b, v);
+}
+
+static void put_u32(struct buffer *b, uint32_t v)
+{
+    put_u16(b, v >> 16);
+    put_u16(b, v);
+}
+
+static void put_bytes(struct buffer *b, const void *data, size_t len)
+{
+    memcpy(&b->data[b->len], data, len);
+    b->len += len;
+}
+
+static void put_tpm2b(struct buffer *b, const void *data, uint16_t len)
+{
+    put_u16(b, len);
+    put_bytes(b, data, len);
+}
+
+static uint16_t get_u16(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+    return ((uint32_t)get_u16(p) << 16) | get_u16(&p[2]);
+}
+
+/* Read a TPM2B from a response; returns the number of bytes consumed */
+static size_t get_tpm2b(struct tpm2b *t, const unsigned char *p, size_t avail)
+{
+    uint16_t size;
+
+    if (avail < 2)
+        return 0;
+    size = get_u16(p);
+    if (size > avail - 2 || size > sizeof(t->buffer))
+        return 0;
+    t->size = size;
+    memcpy(t->buffer, &p[2], size);
+
+    return 2 + size;
+}
+
+/*
+ * Send a command with the given handles and parameters. If a session is
+ * given, the command carries an authorization for the first handle. For an
+ * HMAC session the names of the handles are needed to calculate the cpHash.
+ * The HMAC key is empty since the sessions are neither bound nor salted and
+ * all entities have an empty authValue.
+ */
+static uint32_t tpm2_command(uint32_t cc,
+                             const uint32_t *handles, const struct tpm2b *names,
+                             unsigned int num_handles,
+                             struct session *session,
+                             const struct buffer *params,
+                             unsigned int num_rsp_handles)
+{
+    static const unsigned char nonceCaller[16] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    static const unsigned char hmac_key[1];
+    unsigned char cpHash[SHA256_DIGEST_SIZE];
+    unsigned char hmac[SHA256_DIGEST_SIZE];
+    unsigned int hmac_len = sizeof(hmac);
+    struct buffer cmd = { .len = 0 };
+    struct buffer data = { .len = 0 };
+    struct tpm2b nonce;
+    unsigned int i;
+    uint32_t rc, psize;
+    size_t off;
+
+    put_u16(&cmd, session ? TPM_ST_SESSIONS : TPM_ST_NO_SESSIONS);
+    put_u32(&cmd, 0);
+    put_u32(&cmd, cc);
+    for (i = 0; i < num_handles; i++)
+        put_u32(&cmd, handles[i]);
+
+    if (session && session->handle == TPM_RS_PW) {
+        put_u32(&cmd, 9);
+        put_u32(&cmd, TPM_RS_PW);
+        put_u16(&cmd, 0);
+        put_u8(&cmd, session->attributes);
+        put_u16(&cmd, 0);
+    } else if (session) {
+        /* cpHash := SHA256(commandCode || names || parameters) */
+        put_u32(&data, cc);
+        for (i = 0; i < num_handles; i++)
+            put_bytes(&data, names[i].buffer, names[i].size);
+        if (params)
+            put_bytes(&data, params->data, params->len);
+        EVP_Digest(data.data, data.len, cpHash, NULL, EVP_sha256(), NULL);
+
+        /* HMAC(cpHash || nonceNewer || nonceOlder || sessionAttributes) */
+        data.len = 0;
+        put_bytes(&data, cpHash, sizeof(cpHash));
+        put_bytes(&data, nonceCaller, sizeof(nonceCaller));
+        put_bytes(&data, session->nonceTPM.buffer, session->nonceTPM.size);
+        put_u8(&data, session->attributes);
+        HMAC(EVP_sha256(), hmac_key, 0, data.data, data.len, hmac, &hmac_len);
+
+        put_u32(&cmd, 4 + 2 + sizeof(nonceCaller) + 1 + 2 + hmac_len);
+        put_u32(&cmd, session->handle);
+        put_tpm2b(&cmd, nonceCaller, sizeof(nonceCaller));
+        put_u8(&cmd, session->attributes);
+        put_tpm2b(&cmd, hmac, hmac_len);
+    }
+    if (params)
+        put_bytes(&cmd, params->data, params->len);
+
+    cmd.data[2] = cmd.len >> 24;
+    cmd.data[3] = cmd.len >> 16;
+    cmd.data[4] = cmd.len >> 8;
+    cmd.data[5] = cmd.len;
+
+    if (TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd.data, cmd.len) ||
+        rlength < 10)
+        return TPM_FAIL;
+
+    rc = get_u32(&rbuffer[6]);
+    if (rc != 0 || !session || session->handle == TPM_RS_PW)
+        return rc;
+
+    /* pick up nonceTPM from the response session */
+    off = 10 + 4 * num_rsp_handles;
+    if (rlength < off + 4)
+        return TPM_FAIL;
+    psize = get_u32(&rbuffer[off]);
+    off += 4 + psize;
+    if (off > rlength)
+        return TPM_FAIL;
+    if (get_tpm2b(&nonce, &rbuffer[off], rlength - off) == 0)
+        return TPM_FAIL;
+    session->nonceTPM = nonce;
+
+    return rc;
+}
+
+static uint32_t flush_context(uint32_t handle)
+{
+    struct buffer params = { .len = 0 };
+
+    put_u32(&params, handle);
+    return tpm2_command(TPM_CC_FlushContext, NULL, NULL, 0, NULL, &params, 0);
+}
+
+/* TPM2B_SENSITIVE_CREATE with empty userAuth and the given data */
+static void put_sensitive_create(struct buffer *b,
+                                 const void *data, uint16_t datalen)
+{
+    put_u16(b, 4 + datalen);
+    put_u16(b, 0);
+    put_tpm2b(b, data, datalen);
+}
+
+static void put_rsa_public(struct buffer *b, uint32_t attributes,
+                           bool sign, uint16_t keyBits)
+{
+    struct buffer pub = { .len = 0 };
+
+    put_u16(&pub, TPM_ALG_RSA);
+    put_u16(&pub, TPM_ALG_SHA256);
+    put_u32(&pub, attributes);
+    put_u16(&pub, 0);                    /* authPolicy */
+    if (sign) {
+        put_u16(&pub, TPM_ALG_NULL);
+        put_u16(&pub, TPM_ALG_RSASSA);
+        put_u16(&pub, TPM_ALG_SHA256);
+    } else {
+        put_u16(&pub, TPM_ALG_AES);
+        put_u16(&pub, 128);
+        put_u16(&pub, TPM_ALG_CFB);
+        put_u16(&pub, TPM_ALG_NULL);
+    }
+    put_u16(&pub, keyBits);
+    put_u32(&pub, 0);                    /* exponent */
+    put_u16(&pub, 0);                    /* unique */
+
+    put_tpm2b(b, pub.data, pub.len);
+}
+
+static void put_ecc_public(struct buffer *b, uint32_t attributes, bool sign)
+{
+    struct buffer pub = { .len = 0 };
+
+    put_u16(&pub, TPM_ALG_ECC);
+    put_u16(&pub, TPM_ALG_SHA256);
+    put_u32(&pub, attributes);
+    put_u16(&pub, 0);                    /* authPolicy */
+    if (sign) {
+        put_u16(&pub, TPM_ALG_NULL);
+        put_u16(&pub, TPM_ALG_ECDSA);
+        put_u16(&pub, TPM_ALG_SHA256);
+    } else {
+        put_u16(&pub, TPM_ALG_AES);
+        put_u16(&pub, 128);
+        put_u16(&pub, TPM_ALG_CFB);
+        put_u16(&pub, TPM_ALG_NULL);
+    }
+    put_u16(&pub, TPM_ECC_NIST_P256);
+    put_u16(&pub, TPM_ALG_NULL);         /* kdf */
+    put_u16(&pub, 0);                    /* unique.x */
+    put_u16(&pub, 0);                    /* unique.y */
+
+    put_tpm2b(b, pub.data, pub.len);
+}
+
+/* fixedTPM, fixedParent, sensitiveDataOrigin, userWithAuth, noDA, restricted */
+#define ATTRS_KEY      0x00010472
+#define ATTRS_STORAGE  (ATTRS_KEY | 0x00020000)   /* decrypt */
+#define ATTRS_SIGNING  (ATTRS_KEY | 0x00040000)   /* sign */
+
+enum key_type {
+    KEY_RSA2048,
+    KEY_RSA3072,
+    KEY_ECC_P256,
+};
+
+static uint32_t create_primary(uint32_t hierarchy, enum key_type type,
+                               bool sign, uint32_t *handle)
+{
+    struct session pw = { .handle = TPM_RS_PW };
+    struct buffer params = { .len = 0 };
+    uint32_t attributes = sign ? ATTRS_SIGNING : ATTRS_STORAGE;
+    uint32_t rc;
+
+    put_sensitive_create(&params, NULL, 0);
+    switch (type) {
+    case KEY_RSA2048:
+        put_rsa_public(&params, attributes, sign, 2048);
+        break;
+    case KEY_RSA3072:
+        put_rsa_public(&params, attributes, sign, 3072);
+        break;
+    case KEY_ECC_P256:
+        put_ecc_public(&params, attributes, sign);
+        break;
+    }
+    put_u16(&params, 0);                 /* outsideInfo */
+    put_u32(&params, 0);                 /* creationPCR */
+
+    rc = tpm2_command(TPM_CC_CreatePrimary, &hierarchy, NULL, 1, &pw,
+                      &params, 1);
+    if (rc == 0)
+        *handle = get_u32(&rbuffer[10]);
+
+    return rc;
+}
+
+static uint32_t start_hmac_session(struct session *session, bool encrypt)
+{
+    struct buffer params = { .len = 0 };
+    const uint32_t handles[] = { TPM_RH_NULL, TPM_RH_NULL };
+    unsigned char nonceCaller[16] = { 0, };
+    uint32_t rc;
+
+    put_tpm2b(&params, nonceCaller, sizeof(nonceCaller));
+    put_u16(&params, 0);                 /* encryptedSalt */
+    put_u8(&params, TPM_SE_HMAC);
+    if (encrypt) {
+        put_u16(&params, TPM_ALG_AES);
+        put_u16(&params, 128);
+        put_u16(&params, TPM_ALG_CFB);
+    } else {
+        put_u16(&params, TPM_ALG_NULL);
+    }
+    put_u16(&params, TPM_ALG_SHA256);
+
+    rc = tpm2_command(TPM_CC_StartAuthSession, handles, NULL, 2, NULL,
+                      &params, 1);
+    if (rc)
+        return rc;
+
+    session->handle = get_u32(&rbuffer[10]);
+    session->attributes = TPMA_SESSION_CONTINUESESSION;
+    if (encrypt)
+        session->attributes |= TPMA_SESSION_ENCRYPT;
+    if (get_tpm2b(&session->nonceTPM, &rbuffer[14], rlength - 14) == 0)
+        return TPM_FAIL;
+
+    return 0;
+}
+
+/* PCR_Extend of a resettable PCR */
+static int pcr_extend_run(void)
+{
+    static const unsigned char digest[SHA256_DIGEST_SIZE] = { 0x11, };
+    struct session pw = { .handle = TPM_RS_PW };
+    struct buffer params = { .len = 0 };
+    uint32_t pcr = 16;
+
+    put_u32(&params, 1);
+    put_u16(&params, TPM_ALG_SHA256);
+    put_bytes(&params, digest, sizeof(digest));
+
+    return tpm2_command(TPM_CC_PCR_Extend, &pcr, NULL, 1, &pw, &params, 0);
+}
+
+/* NV_Read authorized with an HMAC session */
+static int nv_read_setup(void)
+{
+    struct session pw = { .handle = TPM_RS_PW };
+    struct buffer params = { .len = 0 };
+    struct buffer nvpublic = { .len = 0 };
+    const uint32_t handles[] = { NV_INDEX, NV_INDEX };
+    unsigned char data[NV_DATA_SIZE];
+    uint32_t owner = TPM_RH_OWNER;
+    uint32_t rc;
+    size_t n;
+
+    put_u32(&nvpublic, NV_INDEX);
+    put_u16(&nvpublic, TPM_ALG_SHA256);
+    put_u32(&nvpublic, 0x02040004);      /* noDA, authRead, authWrite */
+    put_u16(&nvpublic, 0);               /* authPolicy */
+    put_u16(&nvpublic, NV_DATA_SIZE);
+
+    put_u16(&params, 0);                 /* auth */
+    put_tpm2b(&params, nvpublic.data, nvpublic.len);
+    rc = tpm2_command(TPM_CC_NV_DefineSpace, &owner, NULL, 1, &pw, &params, 0);
+    if (rc)
+        return rc;
+
+    memset(data, 0x5a, sizeof(data));
+    params.len = 0;
+    put_tpm2b(&params, data, sizeof(data));
+    put_u16(&params, 0);                 /* offset */
+    rc = tpm2_command(TPM_CC_NV_Write, handles, NULL, 2, &pw, &params, 0);
+    if (rc)
+        return rc;
+
+    /* the name of the index changed when it was written */
+    rc = tpm2_command(TPM_CC_NV_ReadPublic, handles, NULL, 1, NULL, NULL, 0);
+    if (rc)
+        return rc;
+    n = get_tpm2b(&nv_name, &rbuffer[10], rlength - 10);     /* nvPublic */
+    if (n == 0 ||
+        get_tpm2b(&nv_name, &rbuffer[10 + n], rlength - 10 - n) == 0)
+        return TPM_FAIL;
+
+    return start_hmac_session(&hmac_session, false);
+}
+
+static int nv_read_run(void)
+{
+    const uint32_t handles[] = { NV_INDEX, NV_INDEX };
+    const struct tpm2b names[] = { nv_name, nv_name };
+    struct buffer params = { .len = 0 };
+
+    put_u16(&params, NV_DATA_SIZE);
+    put_u16(&params, 0);                 /* offset */
+
+    return tpm2_command(TPM_CC_NV_Read, handles, names, 2, &hmac_session,
+                        &params, 0);
+}
+
+static void hmac_session_teardown(void)
+{
+    flush_context(hmac_session.handle);
+}
+
+/* Quote of the first 8 SHA256 PCRs */
+static int quote_rsa_setup(void)
+{
+    return create_primary(TPM_RH_ENDORSEMENT, KEY_RSA2048, true, &ak_handle);
+}
+
+static int quote_ecc_setup(void)
+{
+    return create_primary(TPM_RH_ENDORSEMENT, KEY_ECC_P256, true, &ak_handle);
+}
+
+static int quote_run(void)
+{
+    struct session pw = { .handle = TPM_RS_PW };
+    struct buffer params = { .len = 0 };
+    static const unsigned char qualifyingData[16];
+
+    put_tpm2b(&params, qualifyingData, sizeof(qualifyingData));
+    put_u16(&params, TPM_ALG_NULL);      /* inScheme */
+    put_u32(&params, 1);
+    put_u16(&params, TPM_ALG_SHA256);
+    put_u8(&params, 3);
+    put_u8(&params, 0xff);
+    put_u8(&params, 0x00);
+    put_u8(&params, 0x00);
+
+    return tpm2_command(TPM_CC_Quote, &ak_handle, NULL, 1, &pw, &params, 0);
+}
+
+static void ak_teardown(void)
+{
+    flush_context(ak_handle);
+}
+
+/* CreatePrimary of storage keys; flushing the key is not timed */
+static int create_primary_run(enum key_type type)
+{
+    return create_primary(TPM_RH_OWNER, type, false, &srk_handle);
+}
+
+static int create_primary_rsa2048_run(void)
+{
+    return create_primary_run(KEY_RSA2048);
+}
+
+static int create_primary_rsa3072_run(void)
+{
+    return create_primary_run(KEY_RSA3072);
+}
+
+static int create_primary_ecc_run(void)
+{
+    return create_primary_run(KEY_ECC_P256);
+}
+
+/* ContextSave, ContextLoad and FlushContext of a loaded key */
+static int context_setup(void)
+{
+    return create_primary(TPM_RH_OWNER, KEY_ECC_P256, false, &srk_handle);
+}
+
+static int context_run(void)
+{
+    struct buffer params = { .len = 0 };
+    uint32_t rc;
+
+    rc = tpm2_command(TPM_CC_ContextSave, &srk_handle, NULL, 1, NULL, NULL, 0);
+    if (rc)
+        return rc;
+
+    put_bytes(&params, &rbuffer[10], rlength - 10);
+    rc = tpm2_command(TPM_CC_ContextLoad, NULL, NULL, 0, NULL, &params, 1);
+    if (rc)
+        return rc;
+
+    return flush_context(get_u32(&rbuffer[10]));
+}
+
+static void srk_flush(void)
+{
+    flush_context(srk_handle);
+}
+
+/* Unseal with response parameter encryption */
+static int unseal_setup(void)
+{
+    struct session pw = { .handle = TPM_RS_PW };
+    struct buffer params = { .len = 0 };
+    struct buffer pub = { .len = 0 };
+    unsigned char secret[32];
+    struct tpm2b outPrivate, outPublic;
+    uint32_t rc, psize;
+    size_t n, m;
+
+    rc = create_primary(TPM_RH_OWNER, KEY_ECC_P256, false, &srk_handle);
+    if (rc)
+        return rc;
+
+    memset(secret, 0xa5, sizeof(secret));
+    put_sensitive_create(&params, secret, sizeof(secret));
+    put_u16(&pub, TPM_ALG_KEYEDHASH);
+    put_u16(&pub, TPM_ALG_SHA256);
+    put_u32(&pub, 0x00000452);           /* fixedTPM, fixedParent, userWithAuth, noDA */
+    put_u16(&pub, 0);                    /* authPolicy */
+    put_u16(&pub, TPM_ALG_NULL);         /* scheme */
+    put_u16(&pub, 0);                    /* unique */
+    put_tpm2b(&params, pub.data, pub.len);
+    put_u16(&params, 0);                 /* outsideInfo */
+    put_u32(&params, 0);                 /* creationPCR */
+
+    rc = tpm2_command(TPM_CC_Create, &srk_handle, NULL, 1, &pw, &params, 0);
+    if (rc)
+        return rc;
+    psize = get_u32(&rbuffer[10]);
+    n = get_tpm2b(&outPrivate, &rbuffer[14], psize);
+    m = n ? get_tpm2b(&outPublic, &rbuffer[14 + n], psize - n) : 0;
+    if (m == 0)
+        return TPM_FAIL;
+
+    params.len = 0;
+    put_tpm2b(&params, outPrivate.buffer, outPrivate.size);
+    put_tpm2b(&params, outPublic.buffer, outPublic.size);
+    rc = tpm2_command(TPM_CC_Load, &srk_handle, NULL, 1, &pw, &params, 1);
+    if (rc)
+        return rc;
+    sealed_handle = get_u32(&rbuffer[10]);
+    if (get_tpm2b(&sealed_name, &rbuffer[18], rlength - 18) == 0)
+        return TPM_FAIL;
+
+    return start_hmac_session(&hmac_session, true);
+}
+
+static int unseal_run(void)
+{
+    return tpm2_command(TPM_CC_Unseal, &sealed_handle, &sealed_name, 1,
+                        &hmac_session, NULL, 0);
+}
+
+static void unseal_teardown(void)
+{
+    flush_context(hmac_session.handle);
+    flush_context(sealed_handle);
+    flush_context(srk_handle);
+}
+
+static const struct benchmark benchmarks[] = {
+    {
+        .name = "PCR_Extend",
+        .iterations = 5000,
+        .run = pcr_extend_run,
+    }, {
+        .name = "NV_Read-HMAC",
+        .iterations = 5000,
+        .setup = nv_read_setup,
+        .run = nv_read_run,
+        .teardown = hmac_session_teardown,
+    }, {
+        .name = "Quote-RSA2048",
+        .iterations = 200,
+        .setup = quote_rsa_setup,
+        .run = quote_run,
+        .teardown = ak_teardown,
+    }, {
+        .name = "Quote-ECC-P256",
+        .iterations = 1000,
+        .setup = quote_ecc_setup,
+        .run = quote_run,
+        .teardown = ak_teardown,
+    }, {
+        .name = "CreatePrimary-RSA2048",
+        .iterations = 20,
+        .run = create_primary_rsa2048_run,
+        .cleanup = srk_flush,
+    }, {
+        .name = "CreatePrimary-RSA3072",
+        .iterations = 5,
+        .run = create_primary_rsa3072_run,
+        .cleanup = srk_flush,
+    }, {
+        .name = "CreatePrimary-ECC-P256",
+        .iterations = 500,
+        .run = create_primary_ecc_run,
+        .cleanup = srk_flush,
+    }, {
+        .name = "ContextSave-ContextLoad",
+        .iterations = 2000,
+        .setup = context_setup,
+        .run = context_run,
+        .teardown = srk_flush,
+    }, {
+        .name = "Unseal-ParamEncrypt",
+        .iterations = 2000,
+        .setup = unseal_setup,
+        .run = unseal_run,
+        .teardown = unseal_teardown,
+    },
+};
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/* nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, unsigned int n, unsigned int p)
+{
+    unsigned int rank = (n * p + 99) / 100;
+
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static int run_benchmark(const struct benchmark *b, double scale, bool first)
+{
+    unsigned int iterations = b->iterations * scale;
+    unsigned int i;
+    double *latencies;
+    double start, t, total = 0;
+    int rc = 0;
+
+    if (iterations == 0)
+        iterations = 1;
+    latencies = calloc(iterations, sizeof(*latencies));
+    if (!latencies)
+        return 1;
+
+    if (b->setup && (rc = b->setup()) != 0) {
+        fprintf(stderr, "%s: setup failed: 0x%x\n", b->name, rc);
+        goto exit;
+    }
+
+    for (i = 0; i < iterations; i++) {
+        start = now_us();
+        rc = b->run();
+        t = now_us() - start;
+        if (rc) {
+            fprintf(stderr, "%s: command failed: 0x%x\n", b->name, rc);
+            goto exit;
+        }
+        latencies[i] = t;
+        total += t;
+        if (b->cleanup)
+            b->cleanup();
+    }
+    if (b->teardown)
+        b->teardown();
+
+    qsort(latencies, iterations, sizeof(*latencies), compare_double);
+
+    printf("%s    {\n"
+           "      \"name\": \"%s\",\n"
+           "      \"iterations\": %u,\n"
+           "      \"ops_per_sec\": %.1f,\n"
+           "      \"p50_us\": %.1f,\n"
+           "      \"p99_us\": %.1f\n"
+           "    }",
+           first ? "" : ",\n",
+           b->name, iterations, iterations / total * 1E6,
+           percentile(latencies, iterations, 50),
+           percentile(latencies, iterations, 99));
+
+exit:
+    free(latencies);
+
+    return rc ? 1 : 0;
+}
+
+static void usage(const char *prg)
+{
+    printf("Usage: %s [options]\n"
+           "\n"
+           "Run TPM 2 command benchmarks and print the results as JSON.\n"
+           "\n"
+           "-b, --benchmark <name>  run only the given benchmark; may be repeated\n"
+           "-p, --profile <json>    profile to create the TPM with\n"
+           "-s, --scale <factor>    scale the number of iterations by factor\n"
+           "-l, --list              list the benchmarks\n"
+           "-h, --help              display this help screen\n",
+           prg);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"benchmark", required_argument, NULL, 'b'},
+        {"profile", required_argument, NULL, 'p'},
+        {"scale", required_argument, NULL, 's'},
+        {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct libtpms_callbacks callbacks = {
+        .sizeOfStruct = sizeof(struct libtpms_callbacks),
+        .tpm_nvram_init = nvram_init,
+        .tpm_nvram_loaddata = nvram_loaddata,
+        .tpm_nvram_storedata = nvram_storedata,
+        .tpm_nvram_deletename = nvram_deletename,
+    };
+    bool selected[sizeof(benchmarks) / sizeof(benchmarks[0])];
+    size_t num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    struct buffer params = { .len = 0 };
+    const char *profile = NULL;
+    bool filter = false, first = true;
+    uint32_t version;
+    double scale = 1;
+    TPM_RESULT res;
+    int ret = 1;
+    size_t i;
+    int opt;
+
+    memset(selected, 0, sizeof(selected));
+
+    while ((opt = getopt_long(argc, argv, "b:p:s:lh", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'b':
+            for (i = 0; i < num_benchmarks; i++) {
+                if (!strcmp(optarg, benchmarks[i].name))
+                    break;
+            }
+            if (i == num_benchmarks) {
+                fprintf(stderr, "Unknown benchmark '%s'; use --list to "
+                        "list the benchmarks.\n", optarg);
+                return 1;
+            }
+            selected[i] = true;
+            filter = true;
+            break;
+        case 'p':
+            profile = optarg;
+            break;
+        case 's':
+            scale = strtod(optarg, NULL);
+            if (scale <= 0) {
+                fprintf(stderr, "Scale factor must be positive.\n");
+                return 1;
+            }
+            break;
+        case 'l':
+            for (i = 0; i < num_benchmarks; i++)
+                printf("%s\n", benchmarks[i].name);
+            return 0;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    res = TPMLIB_RegisterCallbacks(&callbacks);
+    if (res) {
+        fprintf(stderr, "TPMLIB_RegisterCallbacks() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (profile) {
+        res = TPMLIB_SetProfile(profile);
+        if (res) {
+            fprintf(stderr, "TPMLIB_SetProfile() failed: 0x%02x\n", res);
+            goto exit;
+        }
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    put_u16(&params, 0);                 /* TPM_SU_CLEAR */
+    res = tpm2_command(TPM_CC_Startup, NULL, NULL, 0, NULL, &params, 0);
+    if (res) {
+        fprintf(stderr, "TPM2_Startup() failed: 0x%02x\n", res);
+        goto exit_terminate;
+    }
+
+    version = TPMLIB_GetVersion();
+    printf("{\n"
+           "  \"libtpms\": \"%u.%u.%u\",\n"
+           "  \"benchmarks\": [\n",
+           version >> 16, (version >> 8) & 0xff, version & 0xff);
+
+    for (i = 0; i < num_benchmarks; i++) {
+        if (filter && !selected[i])
+            continue;
+        if (run_benchmark(&benchmarks[i], scale, first))
+            goto exit_terminate;
+        first = false;
+    }
+
+    printf("\n  ]\n}\n");
+    ret = 0;
+
+exit_terminate:
+    TPMLIB_Terminate();
+
+exit:
+    TPM_Free(rbuffer);
+    for (i = 0; i < sizeof(nvram_blobs) / sizeof(nvram_blobs[0]); i++)
+        free(nvram_blobs[i]);
+
+    return ret;
+}
@@ -0,0 +1,612 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Microbenchmarks for the crypto primitives of the TPM 2 code.
+ *
+ * The primitives are called directly and therefore this program must be
+ * linked statically. Random numbers needed by the primitives are taken from
+ * a DRBG that is instantiated from a fixed seed before each benchmark, so the
+ * cost of sieving and prime search is the same on every machine. The results
+ * are printed as JSON in the same format as tpm2_bench's.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "Tpm.h"
+#include "CryptPrime_fp.h"
+#include "CryptPrimeSieve_fp.h"
+#include "TpmMath_Util_fp.h"
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+
+struct timing {
+    double *latencies;
+    unsigned int iterations;
+    unsigned int count;
+    double start;
+};
+
+struct benchmark {
+    const char *name;
+    unsigned int iterations;
+    int (*run)(struct timing *t);
+};
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1E6 + ts.tv_nsec / 1E3;
+}
+
+static void timing_begin(struct timing *t)
+{
+    t->start = now_us();
+}
+
+static void timing_end(struct timing *t)
+{
+    t->latencies[t->count++] = now_us() - t->start;
+}
+
+static bool timing_done(const struct timing *t)
+{
+    return t->count == t->iterations;
+}
+
+/* A DRBG instantiated from a fixed seed */
+static void rand_init(RAND_STATE *rand)
+{
+    TPM2B_DIGEST seed = {
+        .t.size = SHA256_DIGEST_SIZE,
+    };
+    TPM2B_DIGEST purpose = {
+        .t.size = 10,
+        .t.buffer = "benchmark",
+    };
+
+    memset(seed.t.buffer, 0x42, seed.t.size);
+    DRBG_InstantiateSeeded(&rand->drbg, &seed.b, &purpose.b, NULL, NULL,
+                           SEED_COMPAT_LEVEL_LAST);
+}
+
+static int hash_run(struct timing *t, UINT32 size)
+{
+    BYTE data[1024], digest[SHA256_DIGEST_SIZE];
+
+    memset(data, 0x11, sizeof(data));
+    while (!timing_done(t)) {
+        timing_begin(t);
+        CryptHashBlock(TPM_ALG_SHA256, size, data, sizeof(digest), digest);
+        timing_end(t);
+    }
+    return 0;
+}
+
+static int hash_64_run(struct timing *t)
+{
+    return hash_run(t, 64);
+}
+
+static int hash_1024_run(struct timing *t)
+{
+    return hash_run(t, 1024);
+}
+
+static int hmac_run(struct timing *t)
+{
+    BYTE key[SHA256_DIGEST_SIZE], data[64], digest[SHA256_DIGEST_SIZE];
+    HMAC_STATE hmac;
+
+    memset(key, 0x22, sizeof(key));
+    memset(data, 0x33, sizeof(data));
+    while (!timing_done(t)) {
+        timing_begin(t);
+        CryptHmacStart(&hmac, TPM_ALG_SHA256, sizeof(key), key);
+        CryptDigestUpdate(&hmac.hashState, sizeof(data), data);
+        CryptHmacEnd(&hmac, sizeof(digest), digest);
+        timing_end(t);
+    }
+    return 0;
+}
+
+/* KDFa as used for deriving session keys */
+static int kdfa_run(struct timing *t)
+{
+    TPM2B_DIGEST key = { .t.size = SHA256_DIGEST_SIZE };
+    TPM2B_NONCE nonceNewer = { .t.size = SHA256_DIGEST_SIZE };
+    TPM2B_NONCE nonceOlder = { .t.size = SHA256_DIGEST_SIZE };
+    BYTE keyStream[SHA256_DIGEST_SIZE];
+
+    memset(key.t.buffer, 0x44, key.t.size);
+    memset(nonceNewer.t.buffer, 0x55, nonceNewer.t.size);
+    memset(nonceOlder.t.buffer, 0x66, nonceOlder.t.size);
+    while (!timing_done(t)) {
+        timing_begin(t);
+        CryptKDFa(TPM_ALG_SHA256, &key.b, SESSION_KEY, &nonceNewer.b,
+                  &nonceOlder.b, sizeof(keyStream) * 8, keyStream, NULL, 0);
+        timing_end(t);
+    }
+    return 0;
+}
+
+/* KDFe as used for ECDH-based secret sharing */
+static int kdfe_run(struct timing *t)
+{
+    TPM2B_ECC_PARAMETER Z = { .t.size = 32 };
+    TPM2B_ECC_PARAMETER partyU = { .t.size = 32 };
+    TPM2B_ECC_PARAMETER partyV = { .t.size = 32 };
+    BYTE keyStream[SHA256_DIGEST_SIZE];
+
+    memset(Z.t.buffer, 0x77, Z.t.size);
+    memset(partyU.t.buffer, 0x88, partyU.t.size);
+    memset(partyV.t.buffer, 0x99, partyV.t.size);
+    while (!timing_done(t)) {
+        timing_begin(t);
+        CryptKDFe(TPM_ALG_SHA256, &Z.b, SECRET_KEY, &partyU.b, &partyV.b,
+                  sizeof(keyStream) * 8, keyStream);
+        timing_end(t);
+    }
+    return 0;
+}
+
+static int symmetric_run(struct timing *t, TPM_ALG_ID mode)
+{
+    BYTE key[16], dIn[1024], dOut[1024];
+    TPM2B_IV iv = { .t.size = 16 };
+    TPM_RC rc;
+
+    memset(key, 0xaa, sizeof(key));
+    memset(dIn, 0xbb, sizeof(dIn));
+    while (!timing_done(t)) {
+        timing_begin(t);
+        rc = CryptSymmetricEncrypt(dOut, TPM_ALG_AES, sizeof(key) * 8, key,
+                                   &iv, mode, sizeof(dIn), dIn);
+        timing_end(t);
+        if (rc)
+            return rc;
+    }
+    return 0;
+}
+
+static int aes_cfb_run(struct timing *t)
+{
+    return symmetric_run(t, TPM_ALG_CFB);
+}
+
+static int aes_ctr_run(struct timing *t)
+{
+    return symmetric_run(t, TPM_ALG_CTR);
+}
+
+static int aes_ecb_run(struct timing *t)
+{
+    return symmetric_run(t, TPM_ALG_ECB);
+}
+
+static int drbg_run(struct timing *t)
+{
+    RAND_STATE rand;
+    BYTE random[32];
+
+    rand_init(&rand);
+    while (!timing_done(t)) {
+        timing_begin(t);
+        DRBG_Generate(&rand, random, sizeof(random));
+        timing_end(t);
+    }
+    return 0;
+}
+
+static TPM_RC rsa_key_generate(OBJECT *key, RAND_STATE *rand)
+{
+    memset(key, 0, sizeof(*key));
+    key->publicArea.type = TPM_ALG_RSA;
+    key->publicArea.nameAlg = TPM_ALG_SHA256;
+    SET_ATTRIBUTE(key->publicArea.objectAttributes, TPMA_OBJECT, sign);
+    SET_ATTRIBUTE(key->publicArea.objectAttributes, TPMA_OBJECT, decrypt);
+    key->publicArea.parameters.rsaDetail.symmetric.algorithm = TPM_ALG_NULL;
+    key->publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    key->publicArea.parameters.rsaDetail.keyBits = 2048;
+    key->sensitive.sensitiveType = TPM_ALG_RSA;
+
+    return CryptRsaGenerateKey(&key->publicArea, &key->sensitive, key, rand);
+}
+
+/* Key generation from a seed as done for primary keys */
+static int rsa_generate_run(struct timing *t)
+{
+    RAND_STATE rand;
+    OBJECT key;
+    TPM_RC rc;
+
+    rand_init(&rand);
+    while (!timing_done(t)) {
+        timing_begin(t);
+        rc = rsa_key_generate(&key, &rand);
+        timing_end(t);
+        if (rc)
+            return rc;
+    }
+    return 0;
+}
+
+static int rsa_sign_run(struct timing *t)
+{
+    TPM2B_DIGEST digest = { .t.size = SHA256_DIGEST_SIZE };
+    TPMT_SIGNATURE signature;
+    RAND_STATE rand;
+    OBJECT key;
+    TPM_RC rc;
+
+    rand_init(&rand);
+    rc = rsa_key_generate(&key, &rand);
+    if (rc)
+        return rc;
+
+    memset(digest.t.buffer, 0xcc, digest.t.size);
+    while (!timing_done(t)) {
+        signature.sigAlg = TPM_ALG_RSASSA;
+        signature.signature.rsassa.hash = TPM_ALG_SHA256;
+        timing_begin(t);
+        rc = CryptRsaSign(&signature, &key, &digest, NULL);
+        timing_end(t);
+        if (rc)
+            return rc;
+    }
+    return 0;
+}
+
+static int rsa_decrypt_run(struct timing *t)
+{
+    TPMT_RSA_DECRYPT scheme = {
+        .scheme = TPM_ALG_OAEP,
+        .details.oaep.hashAlg = TPM_ALG_SHA256,
+    };
+    TPM2B_DIGEST secret = { .t.size = SHA256_DIGEST_SIZE };
+    TPM2B_DATA label = { .t.size = 0 };
+    TPM2B_PUBLIC_KEY_RSA cipher;
+    TPM2B_PUBLIC_KEY_RSA plain;
+    RAND_STATE rand;
+    OBJECT key;
+    TPM_RC rc;
+
+    rand_init(&rand);
+    rc = rsa_key_generate(&key, &rand);
+    if (rc)
+        return rc;
+
+    memset(secret.t.buffer, 0xdd, secret.t.size);
+    cipher.t.size = sizeof(cipher.t.buffer);
+    rc = CryptRsaEncrypt(&cipher, &secret.b, &key, &scheme, &label.b, &rand);
+    if (rc)
+        return rc;
+
+    while (!timing_done(t)) {
+        plain.t.size = sizeof(plain.t.buffer);
+        timing_begin(t);
+        rc = CryptRsaDecrypt(&plain.b, &cipher.b, &key, &scheme, &label.b);
+        timing_end(t);
+        if (rc)
+            return rc;
+    }
+    return 0;
+}
+
+/* [d]G on NIST P-256 */
+static int ecc_point_mult_run(struct timing *t)
+{
+    TPM2B_ECC_PARAMETER d = { .t.size = 32 };
+    TPM_RC rc = TPM_RC_SUCCESS;
+
+    memset(d.t.buffer, 0x5a, d.t.size);
+    {
+        CRYPT_CURVE_INITIALIZED(E, TPM_ECC_NIST_P256);
+        CRYPT_ECC_INITIALIZED(bnD, &d);
+        CRYPT_POINT_VAR(R);
+
+        while (!timing_done(t) && rc == TPM_RC_SUCCESS) {
+            timing_begin(t);
+            rc = TpmEcc_PointMult(R, NULL, bnD, NULL, NULL, E);
+            timing_end(t);
+        }
+        CRYPT_CURVE_FREE(E);
+    }
+    return rc;
+}
+
+/* Miller-Rabin test of a 1024 bit prime, which is the worst case */
+static int miller_rabin_run(struct timing *t)
+{
+    RAND_STATE rand;
+    CRYPT_PRIME_VAR(prime);
+
+    rand_init(&rand);
+    if (TpmRsa_GeneratePrimeForRSA(prime, 1024, RSA_DEFAULT_PUBLIC_EXPONENT,
+                                   &rand) != TPM_RC_SUCCESS)
+        return TPM_RC_FAILURE;
+
+    while (!timing_done(t)) {
+        timing_begin(t);
+        if (!MillerRabin(prime, &rand)) {
+            timing_end(t);
+            return TPM_RC_FAILURE;
+        }
+        timing_end(t);
+    }
+    return 0;
+}
+
+/* Sieve of the field above a 1024 bit prime candidate */
+static int prime_sieve_run(struct timing *t)
+{
+    TPM2B_PUBLIC_KEY_RSA random = { .t.size = 1024 / 8 };
+    BYTE field[2048];
+    RAND_STATE rand;
+    CRYPT_PRIME_VAR(start);
+    CRYPT_PRIME_VAR(candidate);
+
+    rand_init(&rand);
+    DRBG_Generate(&rand, random.t.buffer, random.t.size);
+    random.t.buffer[0] |= 0xc0;
+    random.t.buffer[random.t.size - 1] |= 0x01;
+    TpmMath_IntFrom2B(start, &random.b);
+    RsaAdjustPrimeLimit(4096, &rand);
+
+    while (!timing_done(t)) {
+        ExtMath_Copy(candidate, start);
+        timing_begin(t);
+        PrimeSieve(candidate, sizeof(field), field);
+        timing_end(t);
+    }
+    return 0;
+}
+
+/* Sieve and Miller-Rabin tests until a 1024 bit prime is found */
+static int prime_search_run(struct timing *t)
+{
+    RAND_STATE rand;
+    CRYPT_PRIME_VAR(prime);
+
+    rand_init(&rand);
+    while (!timing_done(t)) {
+        timing_begin(t);
+        if (TpmRsa_GeneratePrimeForRSA(prime, 1024, RSA_DEFAULT_PUBLIC_EXPONENT,
+                                       &rand) != TPM_RC_SUCCESS) {
+            timing_end(t);
+            return TPM_RC_FAILURE;
+        }
+        timing_end(t);
+    }
+    return 0;
+}
+
+static const struct benchmark benchmarks[] = {
+    { "CryptHashBlock-SHA256-64", 200000, hash_64_run },
+    { "CryptHashBlock-SHA256-1024", 50000, hash_1024_run },
+    { "CryptHmac-SHA256-64", 100000, hmac_run },
+    { "CryptKDFa-SHA256-256", 100000, kdfa_run },
+    { "CryptKDFe-SHA256-256", 100000, kdfe_run },
+    { "CryptSymmetricEncrypt-AES128-CFB-1024", 50000, aes_cfb_run },
+    { "CryptSymmetricEncrypt-AES128-CTR-1024", 50000, aes_ctr_run },
+    { "CryptSymmetricEncrypt-AES128-ECB-1024", 50000, aes_ecb_run },
+    { "DRBG_Generate-32", 100000, drbg_run },
+    { "CryptRsaGenerateKey-2048", 10, rsa_generate_run },
+    { "CryptRsaSign-RSASSA-2048", 200, rsa_sign_run },
+    { "CryptRsaDecrypt-OAEP-2048", 200, rsa_decrypt_run },
+    { "TpmEcc_PointMult-P256", 2000, ecc_point_mult_run },
+    { "MillerRabin-1024", 200, miller_rabin_run },
+    { "PrimeSieve-1024", 500, prime_sieve_run },
+    { "TpmRsa_GeneratePrimeForRSA-1024", 50, prime_search_run },
+};
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/* nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, unsigned int n, unsigned int p)
+{
+    unsigned int rank = (n * p + 99) / 100;
+
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static int run_benchmark(const struct benchmark *b, double scale, bool first)
+{
+    struct timing t = {
+        .iterations = b->iterations * scale,
+    };
+    double total = 0;
+    unsigned int i;
+    int rc;
+
+    if (t.iterations == 0)
+        t.iterations = 1;
+    t.latencies = calloc(t.iterations, sizeof(*t.latencies));
+    if (!t.latencies)
+        return 1;
+
+    rc = b->run(&t);
+    if (rc || _plat__InFailureMode()) {
+        fprintf(stderr, "%s failed: 0x%x\n", b->name, rc);
+        free(t.latencies);
+        return 1;
+    }
+
+    for (i = 0; i < t.iterations; i++)
+        total += t.latencies[i];
+    qsort(t.latencies, t.iterations, sizeof(*t.latencies), compare_double);
+
+    printf("%s    {\n"
+           "      \"name\": \"%s\",\n"
+           "      \"iterations\": %u,\n"
+           "      \"ops_per_sec\": %.1f,\n"
+           "      \"p50_us\": %.3f,\n"
+           "      \"p99_us\": %.3f\n"
+           "    }",
+           first ? "" : ",\n",
+           b->name, t.iterations, t.iterations / total * 1E6,
+           percentile(t.latencies, t.iterations, 50),
+           percentile(t.latencies, t.iterations, 99));
+
+    free(t.latencies);
+
+    return 0;
+}
+
+/* The state of the TPM is not needed after the benchmark */
+static TPM_RESULT nvram_init(void)
+{
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_loaddata(unsigned char **data, uint32_t *length,
+                                 uint32_t tpm_number, const char *name)
+{
+    return TPM_RETRY;
+}
+
+static TPM_RESULT nvram_storedata(const unsigned char *data, uint32_t length,
+                                  uint32_t tpm_number, const char *name)
+{
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_deletename(uint32_t tpm_number, const char *name,
+                                   TPM_BOOL mustExist)
+{
+    return TPM_SUCCESS;
+}
+
+static void usage(const char *prg)
+{
+    printf("Usage: %s [options]\n"
+           "\n"
+           "Run benchmarks of TPM 2 crypto primitives and print the results as JSON.\n"
+           "\n"
+           "-b, --benchmark <name>  run only the given benchmark; may be repeated\n"
+           "-s, --scale <factor>    scale the number of iterations by factor\n"
+           "-l, --list              list the benchmarks\n"
+           "-h, --help              display this help screen\n",
+           prg);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"benchmark", required_argument, NULL, 'b'},
+        {"scale", required_argument, NULL, 's'},
+        {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct libtpms_callbacks callbacks = {
+        .sizeOfStruct = sizeof(struct libtpms_callbacks),
+        .tpm_nvram_init = nvram_init,
+        .tpm_nvram_loaddata = nvram_loaddata,
+        .tpm_nvram_storedata = nvram_storedata,
+        .tpm_nvram_deletename = nvram_deletename,
+    };
+    const size_t num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    bool selected[sizeof(benchmarks) / sizeof(benchmarks[0])];
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    unsigned char *rbuffer = NULL;
+    uint32_t rlength, rtotal = 0;
+    bool filter = false, first = true;
+    uint32_t version;
+    double scale = 1;
+    TPM_RESULT res;
+    int ret = 1;
+    size_t i;
+    int opt;
+
+    memset(selected, 0, sizeof(selected));
+
+    while ((opt = getopt_long(argc, argv, "b:s:lh", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'b':
+            for (i = 0; i < num_benchmarks; i++) {
+                if (!strcmp(optarg, benchmarks[i].name))
+                    break;
+            }
+            if (i == num_benchmarks) {
+                fprintf(stderr, "Unknown benchmark '%s'; use --list to "
+                        "list the benchmarks.\n", optarg);
+                return 1;
+            }
+            selected[i] = true;
+            filter = true;
+            break;
+        case 's':
+            scale = strtod(optarg, NULL);
+            if (scale <= 0) {
+                fprintf(stderr, "Scale factor must be positive.\n");
+                return 1;
+            }
+            break;
+        case 'l':
+            for (i = 0; i < num_benchmarks; i++)
+                printf("%s\n", benchmarks[i].name);
+            return 0;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* bring up the TPM so that the crypto subsystem is initialized */
+    res = TPMLIB_RegisterCallbacks(&callbacks);
+    if (res == TPM_SUCCESS)
+        res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res == TPM_SUCCESS)
+        res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "Could not initialize the TPM: 0x%02x\n", res);
+        return 1;
+    }
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, startup, sizeof(startup));
+    if (res || rlength != 10 || rbuffer[9] != 0) {
+        fprintf(stderr, "TPM2_Startup() failed\n");
+        goto exit;
+    }
+
+    version = TPMLIB_GetVersion();
+    printf("{\n"
+           "  \"libtpms\": \"%u.%u.%u\",\n"
+           "  \"benchmarks\": [\n",
+           version >> 16, (version >> 8) & 0xff, version & 0xff);
+
+    for (i = 0; i < num_benchmarks; i++) {
+        if (filter && !selected[i])
+            continue;
+        if (run_benchmark(&benchmarks[i], scale, first))
+            goto exit;
+        first = false;
+    }
+
+    printf("\n  ]\n}\n");
+    ret = 0;
+
+exit:
+    TPMLIB_Terminate();
+    free(rbuffer);
+
+    return ret;
+}
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+/*
+ * Check the memory usage that TPMLIB_GetInfo() reports for the debug ring
+ * buffer and for a loaded object.
+ */
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm2_command(const char *name,
+                        unsigned char *cmd, size_t cmdlen,
+                        const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+/* get the size and the bytes in use of a subsystem from the JSON object */
+static int get_usage(const char *info, const char *name,
+                     size_t *size, size_t *in_use)
+{
+    char key[64];
+    const char *p;
+
+    snprintf(key, sizeof(key), "\"%s\":{", name);
+    p = strstr(info, key);
+    if (!p ||
+        sscanf(p + strlen(key), "\"size\":%zu,\"inUse\":%zu", size,
+               in_use) != 2) {
+        fprintf(stderr, "Memory usage of %s is missing in %s\n", name, info);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    const unsigned char startup_resp[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00,
+        0x00, 0x00
+    };
+    unsigned char createprimary[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x43, 0x00, 0x00,
+        0x01, 0x31, 0x40, 0x00, 0x00, 0x01, 0x00, 0x00,
+        0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x0b, 0x00,
+        0x03, 0x04, 0x72, 0x00, 0x00, 0x00, 0x06, 0x00,
+        0x80, 0x00, 0x43, 0x00, 0x10, 0x08, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00
+    };
+    size_t ring_size, ring_in_use, objects_size, objects_in_use;
+    size_t total_size, total_in_use;
+    char *info = NULL;
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_SetDebugRingBuffer(8192);
+    if (res) {
+        fprintf(stderr, "TPMLIB_SetDebugRingBuffer() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command("TPM2_Startup", startup, sizeof(startup),
+                     startup_resp, sizeof(startup_resp)) ||
+        tpm2_command("TPM2_CreatePrimary",
+                     createprimary, sizeof(createprimary), NULL, 0))
+        goto exit;
+
+    info = TPMLIB_GetInfo(TPMLIB_INFO_MEMORY_USAGE);
+    if (!info || strncmp(info, "{\"MemoryUsage\":{", 16)) {
+        fprintf(stderr, "TPMLIB_GetInfo() returned %s\n", info);
+        goto exit;
+    }
+
+    if (get_usage(info, "DebugRingBuffer", &ring_size, &ring_in_use) ||
+        get_usage(info, "Objects", &objects_size, &objects_in_use) ||
+        get_usage(info, "Total", &total_size, &total_in_use))
+        goto exit;
+
+    if (ring_size != 8192 || ring_in_use != 8192) {
+        fprintf(stderr, "Unexpected memory usage of the debug ring buffer: "
+                "%s\n", info);
+        goto exit;
+    }
+    /* the primary key is still loaded */
+    if (objects_in_use == 0 || objects_in_use > objects_size) {
+        fprintf(stderr, "Unexpected memory usage of the objects: %s\n", info);
+        goto exit;
+    }
+    if (total_size < ring_size + objects_size ||
+        total_in_use < ring_in_use + objects_in_use ||
+        total_in_use > total_size) {
+        fprintf(stderr, "Unexpected total memory usage: %s\n", info);
+        goto exit;
+    }
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    free(info);
+    TPMLIB_Terminate();
+    TPMLIB_SetDebugRingBuffer(0);
+    TPM_Free(rbuffer);
+
+    return ret;
+}
@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "Tpm.h"
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+/*
+ * Without callbacks the TPM 2 keeps its NV memory in the NVChip file. Check
+ * that the file holds the NV memory of the TPM after the commands that
+ * change it.
+ */
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm2_command(const char *name,
+                        unsigned char *cmd, size_t cmdlen,
+                        const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int tpm2_start(void)
+{
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    const unsigned char startup_resp[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00,
+        0x00, 0x00
+    };
+    TPM_RESULT res;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        return 1;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        return 1;
+    }
+
+    return tpm2_command("TPM2_Startup", startup, sizeof(startup),
+                        startup_resp, sizeof(startup_resp));
+}
+
+/* compare the NVChip file in the current directory with the NV memory */
+static int nvchip_check(const char *when)
+{
+    static unsigned char nv[NV_MEMORY_SIZE], file[NV_MEMORY_SIZE];
+    FILE *f;
+    size_t n;
+
+    if (!_plat__NvMemoryRead(0, NV_MEMORY_SIZE, nv)) {
+        fprintf(stderr, "Could not read the NV memory %s.\n", when);
+        return 1;
+    }
+
+    f = fopen("NVChip", "rb");
+    if (!f) {
+        fprintf(stderr, "Could not open the NVChip file %s.\n", when);
+        return 1;
+    }
+    n = fread(file, 1, sizeof(file), f);
+    fclose(f);
+
+    if (n != sizeof(file) || memcmp(nv, file, sizeof(file))) {
+        fprintf(stderr, "The NVChip file does not hold the NV memory %s.\n",
+                when);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned char createprimary[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x43, 0x00, 0x00,
+        0x01, 0x31, 0x40, 0x00, 0x00, 0x01, 0x00, 0x00,
+        0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x0b, 0x00,
+        0x03, 0x04, 0x72, 0x00, 0x00, 0x00, 0x06, 0x00,
+        0x80, 0x00, 0x43, 0x00, 0x10, 0x08, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00
+    };
+    /* make the primary key 0x80000000 persistent as 0x81000000 */
+    unsigned char evictcontrol_persist[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x23, 0x00, 0x00,
+        0x01, 0x20, 0x40, 0x00, 0x00, 0x01, 0x80, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x40, 0x00,
+        0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81,
+        0x00, 0x00, 0x00
+    };
+    /* evict the persistent key 0x81000000 */
+    unsigned char evictcontrol_evict[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x23, 0x00, 0x00,
+        0x01, 0x20, 0x40, 0x00, 0x00, 0x01, 0x81, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x40, 0x00,
+        0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81,
+        0x00, 0x00, 0x00
+    };
+    const unsigned char evictcontrol_resp[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x00
+    };
+    int ret = 1;
+
+    if (tpm2_start() ||
+        nvchip_check("after manufacturing"))
+        goto exit;
+
+    if (tpm2_command("TPM2_CreatePrimary",
+                     createprimary, sizeof(createprimary), NULL, 0) ||
+        tpm2_command("TPM2_EvictControl",
+                     evictcontrol_persist, sizeof(evictcontrol_persist),
+                     evictcontrol_resp, sizeof(evictcontrol_resp)) ||
+        nvchip_check("after persisting a key"))
+        goto exit;
+
+    if (tpm2_command("TPM2_EvictControl",
+                     evictcontrol_evict, sizeof(evictcontrol_evict),
+                     evictcontrol_resp, sizeof(evictcontrol_resp)) ||
+        nvchip_check("after evicting a key"))
+        goto exit;
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    TPMLIB_Terminate();
+    TPM_Free(rbuffer);
+
+    return ret;
+}
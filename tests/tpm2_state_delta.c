@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm2_command(const char *name,
+                        unsigned char *cmd, size_t cmdlen,
+                        const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    unsigned char createprimary[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x43, 0x00, 0x00,
+        0x01, 0x31, 0x40, 0x00, 0x00, 0x01, 0x00, 0x00,
+        0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x0b, 0x00,
+        0x03, 0x04, 0x72, 0x00, 0x00, 0x00, 0x06, 0x00,
+        0x80, 0x00, 0x43, 0x00, 0x10, 0x08, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00
+    };
+    /* make the primary key 0x80000000 persistent as 0x81000000 */
+    unsigned char evictcontrol[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x23, 0x00, 0x00,
+        0x01, 0x20, 0x40, 0x00, 0x00, 0x01, 0x80, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x40, 0x00,
+        0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81,
+        0x00, 0x00, 0x00
+    };
+    const unsigned char evictcontrol_resp[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x00
+    };
+    unsigned char getcapability[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00,
+        0x01, 0x7a, 0x00, 0x00, 0x00, 0x01, 0x81, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x40
+    };
+    const unsigned char getcapability_resp[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x01, 0x81, 0x00, 0x00, 0x00
+    };
+    unsigned char *full = NULL, *delta = NULL, *unchanged = NULL;
+    unsigned char *extended = NULL;
+    uint32_t fulllen, deltalen, unchangedlen;
+    uint64_t gen_full, gen_delta, gen_unchanged;
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command("TPM2_Startup", startup, sizeof(startup), NULL, 0))
+        goto exit;
+
+    /* without a base the delta holds the whole blob */
+    res = TPMLIB_GetStateDelta(TPMLIB_STATE_PERMANENT, 0,
+                               &full, &fulllen, &gen_full);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetStateDelta(0) failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command("TPM2_CreatePrimary",
+                     createprimary, sizeof(createprimary), NULL, 0) ||
+        tpm2_command("TPM2_EvictControl",
+                     evictcontrol, sizeof(evictcontrol),
+                     evictcontrol_resp, sizeof(evictcontrol_resp)))
+        goto exit;
+
+    res = TPMLIB_GetStateDelta(TPMLIB_STATE_PERMANENT, gen_full,
+                               &delta, &deltalen, &gen_delta);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetStateDelta() failed: 0x%02x\n", res);
+        goto exit;
+    }
+    if (gen_delta == gen_full) {
+        fprintf(stderr, "Generation of changed state did not change.\n");
+        goto exit;
+    }
+
+    /* an unchanged state keeps its generation */
+    res = TPMLIB_GetStateDelta(TPMLIB_STATE_PERMANENT, gen_delta,
+                               &unchanged, &unchangedlen, &gen_unchanged);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetStateDelta() failed: 0x%02x\n", res);
+        goto exit;
+    }
+    if (gen_unchanged != gen_delta) {
+        fprintf(stderr, "Generation of unchanged state changed.\n");
+        goto exit;
+    }
+
+    TPMLIB_Terminate();
+
+    /* the last delta that was produced has generation gen_delta, so a delta
+       based on gen_full must be rejected */
+    res = TPMLIB_ApplyStateDelta(TPMLIB_STATE_PERMANENT, delta, deltalen);
+    if (res != TPM_BAD_PARAMETER) {
+        fprintf(stderr, "TPMLIB_ApplyStateDelta() with a generation mismatch "
+                "returned 0x%02x.\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_ApplyStateDelta(TPMLIB_STATE_PERMANENT, full, fulllen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ApplyStateDelta(full) failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    /* trailing bytes must be rejected */
+    extended = malloc(deltalen + 1);
+    if (!extended)
+        goto exit;
+    memcpy(extended, delta, deltalen);
+    extended[deltalen] = 0;
+    res = TPMLIB_ApplyStateDelta(TPMLIB_STATE_PERMANENT, extended,
+                                 deltalen + 1);
+    if (res != TPM_BAD_PARAMETER) {
+        fprintf(stderr, "TPMLIB_ApplyStateDelta() with trailing bytes "
+                "returned 0x%02x.\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_ApplyStateDelta(TPMLIB_STATE_PERMANENT, delta, deltalen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ApplyStateDelta() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    /* the TPM must start with the persistent key of the applied state */
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() after ApplyStateDelta failed: "
+                "0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command("TPM2_Startup", startup, sizeof(startup), NULL, 0) ||
+        tpm2_command("TPM2_GetCapability",
+                     getcapability, sizeof(getcapability),
+                     getcapability_resp, sizeof(getcapability_resp)))
+        goto exit;
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    free(full);
+    free(delta);
+    free(unchanged);
+    free(extended);
+    TPMLIB_Terminate();
+    TPM_Free(rbuffer);
+
+    return ret;
+}
@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+/*
+ * Start two TPMs from the same template. They must produce different random
+ * numbers and primary keys in the null hierarchy and must not have the
+ * object that was loaded in the TPM the template was created from.
+ */
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm2_command(const char *name,
+                        unsigned char *cmd, size_t cmdlen,
+                        const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int tpm2_command_ok(const char *name,
+                           unsigned char *cmd, size_t cmdlen)
+{
+    if (tpm2_command(name, cmd, cmdlen, NULL, 0))
+        return 1;
+    if (rlength < 10 || rbuffer[6] || rbuffer[7] || rbuffer[8] || rbuffer[9]) {
+        fprintf(stderr, "%s failed: 0x%02x%02x%02x%02x\n", name,
+                rbuffer[6], rbuffer[7], rbuffer[8], rbuffer[9]);
+        return 1;
+    }
+    return 0;
+}
+
+/* primary key 0x80000000 in the null hierarchy */
+static unsigned char createprimary[] = {
+    0x80, 0x02, 0x00, 0x00, 0x00, 0x43, 0x00, 0x00,
+    0x01, 0x31, 0x40, 0x00, 0x00, 0x07, 0x00, 0x00,
+    0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x0b, 0x00,
+    0x03, 0x04, 0x72, 0x00, 0x00, 0x00, 0x06, 0x00,
+    0x80, 0x00, 0x43, 0x00, 0x10, 0x08, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00
+};
+
+/* start a TPM from the template and have it produce random bytes and a
+   primary key in the null hierarchy */
+static int tpm2_instance(const struct TPMLIB_StateTemplate *tmpl,
+                         unsigned char *random, size_t randomlen,
+                         unsigned char **primary, uint32_t *primarylen)
+{
+    unsigned char getrandom[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x7b, 0x00, 0x10
+    };
+    unsigned char readpublic[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00,
+        0x01, 0x73, 0x80, 0x00, 0x00, 0x00
+    };
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_InstantiateStateTemplate(tmpl, 0);
+    if (res) {
+        fprintf(stderr, "TPMLIB_InstantiateStateTemplate() failed: 0x%02x\n",
+                res);
+        return 1;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        return 1;
+    }
+
+    /* the object loaded in the template must have been flushed */
+    if (tpm2_command("TPM2_ReadPublic", readpublic, sizeof(readpublic),
+                     NULL, 0))
+        goto exit;
+    if (rlength >= 10 && !rbuffer[6] && !rbuffer[7] && !rbuffer[8] &&
+        !rbuffer[9]) {
+        fprintf(stderr, "The object loaded in the template is still loaded.\n");
+        goto exit;
+    }
+
+    if (tpm2_command_ok("TPM2_GetRandom", getrandom, sizeof(getrandom)))
+        goto exit;
+    if (rlength != 12 + randomlen) {
+        fprintf(stderr, "TPM2_GetRandom returned %u bytes.\n", rlength);
+        goto exit;
+    }
+    memcpy(random, &rbuffer[12], randomlen);
+
+    if (tpm2_command_ok("TPM2_CreatePrimary",
+                        createprimary, sizeof(createprimary)))
+        goto exit;
+    *primarylen = rlength;
+    *primary = malloc(rlength);
+    if (!*primary)
+        goto exit;
+    memcpy(*primary, rbuffer, rlength);
+
+    ret = 0;
+
+exit:
+    TPMLIB_Terminate();
+
+    return ret;
+}
+
+int main(void)
+{
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    struct TPMLIB_StateTemplate *tmpl = NULL;
+    unsigned char random1[16], random2[16];
+    unsigned char *primary1 = NULL, *primary2 = NULL;
+    uint32_t primary1len, primary2len;
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command_ok("TPM2_Startup", startup, sizeof(startup)) ||
+        tpm2_command_ok("TPM2_CreatePrimary",
+                        createprimary, sizeof(createprimary)))
+        goto exit;
+
+    res = TPMLIB_CreateStateTemplate(&tmpl);
+    if (res) {
+        fprintf(stderr, "TPMLIB_CreateStateTemplate() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    TPMLIB_Terminate();
+
+    if (tpm2_instance(tmpl, random1, sizeof(random1),
+                      &primary1, &primary1len) ||
+        tpm2_instance(tmpl, random2, sizeof(random2),
+                      &primary2, &primary2len))
+        goto exit;
+
+    if (!memcmp(random1, random2, sizeof(random1))) {
+        fprintf(stderr, "TPMs started from the template produced the same "
+                "random numbers.\n");
+        goto exit;
+    }
+    if (primary1len == primary2len && !memcmp(primary1, primary2, primary1len)) {
+        fprintf(stderr, "TPMs started from the template share the null "
+                "hierarchy.\n");
+        goto exit;
+    }
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    free(primary1);
+    free(primary2);
+    TPMLIB_FreeStateTemplate(tmpl);
+    TPMLIB_Terminate();
+    TPM_Free(rbuffer);
+
+    return ret;
+}
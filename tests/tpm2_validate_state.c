@@ -0,0 +1,234 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "Tpm.h"
+#include "NVMarshal.h"
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+/*
+ * Validate the permanent state blob of a TPM 2 with a different PCR
+ * allocation and then resume another state. The validation must not leave
+ * the PCR allocation or the context slot mask of the validated blob behind.
+ */
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm2_command(const char *name,
+                        unsigned char *cmd, size_t cmdlen,
+                        const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int tpm2_command_ok(const char *name,
+                           unsigned char *cmd, size_t cmdlen)
+{
+    if (tpm2_command(name, cmd, cmdlen, NULL, 0))
+        return 1;
+    if (rlength < 10 || rbuffer[6] || rbuffer[7] || rbuffer[8] || rbuffer[9]) {
+        fprintf(stderr, "%s failed: 0x%02x%02x%02x%02x\n", name,
+                rbuffer[6], rbuffer[7], rbuffer[8], rbuffer[9]);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    /* only allocate PCRs 0-7 of the SHA1 bank */
+    unsigned char pcr_allocate[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x25, 0x00, 0x00,
+        0x01, 0x2b, 0x40, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x04, 0x03, 0xff, 0x00, 0x00
+    };
+    unsigned char shutdown_state[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x45, 0x00, 0x01
+    };
+    unsigned char getcapability_pcrs[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00,
+        0x01, 0x7a, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x01
+    };
+    unsigned char *permanent = NULL, *volatilestate = NULL, *other = NULL;
+    unsigned char *pcrs = NULL;
+    uint32_t permanentlen, volatilelen, otherlen, pcrslen;
+    TPML_PCR_SELECTION pcrAllocated;
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command_ok("TPM2_Startup", startup, sizeof(startup)) ||
+        tpm2_command_ok("TPM2_GetCapability",
+                        getcapability_pcrs, sizeof(getcapability_pcrs)))
+        goto exit;
+
+    pcrslen = rlength;
+    pcrs = malloc(pcrslen);
+    if (!pcrs)
+        goto exit;
+    memcpy(pcrs, rbuffer, pcrslen);
+    pcrAllocated = gp.pcrAllocated;
+
+    /* the state that is resumed */
+    res = TPMLIB_GetState(TPMLIB_STATE_PERMANENT, &permanent, &permanentlen);
+    if (!res)
+        res = TPMLIB_GetState(TPMLIB_STATE_VOLATILE,
+                              &volatilestate, &volatilelen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    /* the state that is validated has a different PCR allocation, which
+       becomes active upon the next TPM2_Startup(CLEAR), and holds the
+       STATE_RESET_DATA due to the TPM2_Shutdown(SU_STATE) */
+    if (tpm2_command_ok("TPM2_PCR_Allocate",
+                        pcr_allocate, sizeof(pcr_allocate)))
+        goto exit;
+
+    res = TPMLIB_GetState(TPMLIB_STATE_PERMANENT, &other, &otherlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    TPMLIB_Terminate();
+
+    res = TPMLIB_SetState(TPMLIB_STATE_PERMANENT, other, otherlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_SetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+    free(other);
+    other = NULL;
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command_ok("TPM2_Startup", startup, sizeof(startup)) ||
+        tpm2_command_ok("TPM2_Shutdown", shutdown_state,
+                        sizeof(shutdown_state)))
+        goto exit;
+
+    res = TPMLIB_GetState(TPMLIB_STATE_PERMANENT, &other, &otherlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    TPMLIB_Terminate();
+
+    s_ContextSlotMask = 0x00ff;
+
+    res = TPMLIB_ValidateStateBlob(TPMLIB_STATE_PERMANENT, other, otherlen, 0);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ValidateStateBlob() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (s_ContextSlotMask != 0x00ff) {
+        fprintf(stderr, "TPMLIB_ValidateStateBlob() changed the context slot "
+                "mask.\n");
+        goto exit;
+    }
+    gp.pcrAllocated = pcrAllocated;
+    NVShadowRestore();
+    if (memcmp(&gp.pcrAllocated, &pcrAllocated, sizeof(pcrAllocated))) {
+        fprintf(stderr, "TPMLIB_ValidateStateBlob() left the PCR allocation "
+                "of the blob behind.\n");
+        goto exit;
+    }
+
+    /* unsupported flags and the volatile state are rejected */
+    res = TPMLIB_ValidateStateBlob(TPMLIB_STATE_PERMANENT, other, otherlen, 1);
+    if (res != TPM_BAD_PARAMETER) {
+        fprintf(stderr, "TPMLIB_ValidateStateBlob() with flags returned "
+                "0x%02x.\n", res);
+        goto exit;
+    }
+    res = TPMLIB_ValidateStateBlob(TPMLIB_STATE_VOLATILE,
+                                   volatilestate, volatilelen, 0);
+    if (res != TPM_BAD_TYPE) {
+        fprintf(stderr, "TPMLIB_ValidateStateBlob() of the volatile state "
+                "returned 0x%02x.\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_SetState(TPMLIB_STATE_PERMANENT, permanent, permanentlen);
+    if (!res)
+        res = TPMLIB_SetState(TPMLIB_STATE_VOLATILE,
+                              volatilestate, volatilelen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_SetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    /* the resumed TPM has the PCR allocation of its own state */
+    if (tpm2_command("TPM2_GetCapability",
+                     getcapability_pcrs, sizeof(getcapability_pcrs),
+                     pcrs, pcrslen))
+        goto exit;
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    free(permanent);
+    free(volatilestate);
+    free(other);
+    free(pcrs);
+    TPMLIB_Terminate();
+    TPM_Free(rbuffer);
+
+    return ret;
+}
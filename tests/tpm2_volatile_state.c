@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+
+/*
+ * Save and resume the volatile state of a TPM 2 using the default-v2 profile,
+ * which writes the compact volatile state of StateFormatLevel 9, while an
+ * object and a session are loaded and a PCR has been extended.
+ */
+
+static unsigned char *rbuffer;
+static uint32_t rlength;
+static uint32_t rtotal;
+
+static int tpm2_command(const char *name,
+                        unsigned char *cmd, size_t cmdlen,
+                        const unsigned char *exp_resp, size_t exp_resplen)
+{
+    TPM_RESULT res;
+
+    res = TPMLIB_Process(&rbuffer, &rlength, &rtotal, cmd, cmdlen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_Process(%s) failed: 0x%02x\n", name, res);
+        return 1;
+    }
+    if (!exp_resp)
+        return 0;
+    if (rlength != exp_resplen || memcmp(rbuffer, exp_resp, rlength)) {
+        fprintf(stderr, "Expected %s response is different than received "
+                "one.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int tpm2_command_ok(const char *name,
+                           unsigned char *cmd, size_t cmdlen)
+{
+    if (tpm2_command(name, cmd, cmdlen, NULL, 0))
+        return 1;
+    if (rlength < 10 || rbuffer[6] || rbuffer[7] || rbuffer[8] || rbuffer[9]) {
+        fprintf(stderr, "%s failed: 0x%02x%02x%02x%02x\n", name,
+                rbuffer[6], rbuffer[7], rbuffer[8], rbuffer[9]);
+        return 1;
+    }
+    return 0;
+}
+
+/* run a command that must succeed and keep a copy of its response */
+static int tpm2_command_save(const char *name,
+                             unsigned char *cmd, size_t cmdlen,
+                             unsigned char **resp, uint32_t *resplen)
+{
+    if (tpm2_command_ok(name, cmd, cmdlen))
+        return 1;
+    *resp = malloc(rlength);
+    if (!*resp)
+        return 1;
+    memcpy(*resp, rbuffer, rlength);
+    *resplen = rlength;
+    return 0;
+}
+
+int main(void)
+{
+    unsigned char startup[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+        0x01, 0x44, 0x00, 0x00
+    };
+    unsigned char createprimary[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x43, 0x00, 0x00,
+        0x01, 0x31, 0x40, 0x00, 0x00, 0x01, 0x00, 0x00,
+        0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x0b, 0x00,
+        0x03, 0x04, 0x72, 0x00, 0x00, 0x00, 0x06, 0x00,
+        0x80, 0x00, 0x43, 0x00, 0x10, 0x08, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00
+    };
+    /* unbound and unsalted HMAC session with SHA256 */
+    unsigned char startauthsession[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x2b, 0x00, 0x00,
+        0x01, 0x76, 0x40, 0x00, 0x00, 0x07, 0x40, 0x00,
+        0x00, 0x07, 0x00, 0x10, 0x01, 0x02, 0x03, 0x04,
+        0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c,
+        0x0d, 0x0e, 0x0f, 0x10, 0x00, 0x00, 0x00, 0x00,
+        0x10, 0x00, 0x0b
+    };
+    /* extend the SHA256 bank of PCR 10 */
+    unsigned char pcr_extend[] = {
+        0x80, 0x02, 0x00, 0x00, 0x00, 0x41, 0x00, 0x00,
+        0x01, 0x82, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00,
+        0x00, 0x09, 0x40, 0x00, 0x00, 0x09, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x0b, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+        0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+        0x20
+    };
+    /* read PCRs 8-15 of the SHA256 bank */
+    unsigned char pcr_read[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00,
+        0x01, 0x7e, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0b,
+        0x03, 0x00, 0xff, 0x00
+    };
+    unsigned char readpublic[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00,
+        0x01, 0x73, 0x80, 0x00, 0x00, 0x00
+    };
+    /* list the loaded sessions */
+    unsigned char getcapability_sessions[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00,
+        0x01, 0x7a, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x40
+    };
+    unsigned char *permanent = NULL, *volatilestate = NULL;
+    unsigned char *pcrs = NULL, *public = NULL, *sessions = NULL;
+    uint32_t permanentlen, volatilelen, pcrslen, publiclen, sessionslen;
+    TPM_RESULT res;
+    int ret = 1;
+
+    res = TPMLIB_ChooseTPMVersion(TPMLIB_TPM_VERSION_2);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_SetProfile("{\"Name\":\"default-v2\"}");
+    if (res) {
+        fprintf(stderr, "TPMLIB_SetProfile() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    if (tpm2_command_ok("TPM2_Startup", startup, sizeof(startup)) ||
+        tpm2_command_ok("TPM2_CreatePrimary",
+                        createprimary, sizeof(createprimary)) ||
+        tpm2_command_ok("TPM2_StartAuthSession",
+                        startauthsession, sizeof(startauthsession)) ||
+        tpm2_command_ok("TPM2_PCR_Extend", pcr_extend, sizeof(pcr_extend)))
+        goto exit;
+
+    if (tpm2_command_save("TPM2_PCR_Read", pcr_read, sizeof(pcr_read),
+                          &pcrs, &pcrslen) ||
+        tpm2_command_save("TPM2_ReadPublic", readpublic, sizeof(readpublic),
+                          &public, &publiclen) ||
+        tpm2_command_save("TPM2_GetCapability",
+                          getcapability_sessions,
+                          sizeof(getcapability_sessions),
+                          &sessions, &sessionslen))
+        goto exit;
+
+    res = TPMLIB_GetState(TPMLIB_STATE_PERMANENT, &permanent, &permanentlen);
+    if (!res)
+        res = TPMLIB_GetState(TPMLIB_STATE_VOLATILE,
+                              &volatilestate, &volatilelen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_GetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    TPMLIB_Terminate();
+
+    res = TPMLIB_SetState(TPMLIB_STATE_PERMANENT, permanent, permanentlen);
+    if (!res)
+        res = TPMLIB_SetState(TPMLIB_STATE_VOLATILE,
+                              volatilestate, volatilelen);
+    if (res) {
+        fprintf(stderr, "TPMLIB_SetState() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    res = TPMLIB_MainInit();
+    if (res) {
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    /* the resumed TPM has the PCRs, object and session it had before */
+    if (tpm2_command("TPM2_PCR_Read", pcr_read, sizeof(pcr_read),
+                     pcrs, pcrslen) ||
+        tpm2_command("TPM2_ReadPublic", readpublic, sizeof(readpublic),
+                     public, publiclen) ||
+        tpm2_command("TPM2_GetCapability",
+                     getcapability_sessions, sizeof(getcapability_sessions),
+                     sessions, sessionslen))
+        goto exit;
+
+    ret = 0;
+
+    fprintf(stdout, "OK\n");
+
+exit:
+    free(permanent);
+    free(volatilestate);
+    free(pcrs);
+    free(public);
+    free(sessions);
+    TPMLIB_Terminate();
+    TPM_Free(rbuffer);
+
+    return ret;
+}
@@ -0,0 +1,533 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Replay a capture of TPM commands recorded by libtpms when the environment
+ * variable TPM_CAPTURE_FILE was set (see src/tpm_capture.h for the format).
+ *
+ * The commands are sent through TPMLIB_Process() from the locality they were
+ * recorded from to either a freshly manufactured TPM or a TPM whose state is
+ * loaded from a directory. The state is kept in memory and the files in the
+ * directory are never modified. Each command is timed and its response code
+ * compared to the recorded one. The latencies per command code are printed
+ * as JSON on stdout.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <libtpms/tpm_library.h>
+#include <libtpms/tpm_error.h>
+#include <libtpms/tpm_memory.h>
+#include <libtpms/tpm_nvfilename.h>
+
+#include "tpm_capture.h"
+
+struct record {
+    uint8_t type;
+    uint16_t tpm_version;       /* TPM_CAPTURE_RECORD_INIT */
+    uint8_t locality;           /* TPM_CAPTURE_RECORD_COMMAND */
+    uint32_t rc;
+    uint32_t command_size;
+    const unsigned char *command;
+};
+
+struct ordinal_stats {
+    uint32_t ordinal;
+    unsigned int count;
+    unsigned int size;
+    double *latencies;
+    double total;
+};
+
+static unsigned char *nvram_blobs[3];
+static uint32_t nvram_lengths[3];
+static const char *nvram_names[] = {
+    TPM_PERMANENT_ALL_NAME,
+    TPM_VOLATILESTATE_NAME,
+    TPM_SAVESTATE_NAME,
+};
+
+static TPM_MODIFIER_INDICATOR current_locality;
+
+static struct ordinal_stats *stats;
+static size_t num_stats;
+
+/*
+ * Keep the TPM's state in memory so that neither the file system is
+ * measured nor the snapshot the replay started from is modified.
+ */
+static int nvram_index(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(nvram_names) / sizeof(nvram_names[0]); i++)
+        if (!strcmp(name, nvram_names[i]))
+            return i;
+    return -1;
+}
+
+static TPM_RESULT nvram_init(void)
+{
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_loaddata(unsigned char **data, uint32_t *length,
+                                 uint32_t tpm_number, const char *name)
+{
+    int i = nvram_index(name);
+
+    (void)tpm_number;
+    if (i < 0 || !nvram_blobs[i])
+        return TPM_RETRY;
+    if (TPM_Malloc(data, nvram_lengths[i]) != TPM_SUCCESS)
+        return TPM_FAIL;
+    memcpy(*data, nvram_blobs[i], nvram_lengths[i]);
+    *length = nvram_lengths[i];
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_storedata(const unsigned char *data, uint32_t length,
+                                  uint32_t tpm_number, const char *name)
+{
+    int i = nvram_index(name);
+    unsigned char *copy;
+
+    (void)tpm_number;
+    if (i < 0)
+        return TPM_FAIL;
+    copy = malloc(length ? length : 1);
+    if (!copy)
+        return TPM_FAIL;
+    memcpy(copy, data, length);
+    free(nvram_blobs[i]);
+    nvram_blobs[i] = copy;
+    nvram_lengths[i] = length;
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT nvram_deletename(uint32_t tpm_number, const char *name,
+                                   TPM_BOOL mustExist)
+{
+    int i = nvram_index(name);
+
+    (void)tpm_number;
+    if (i < 0 || !nvram_blobs[i])
+        return mustExist ? TPM_FAIL : TPM_SUCCESS;
+    free(nvram_blobs[i]);
+    nvram_blobs[i] = NULL;
+    nvram_lengths[i] = 0;
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT io_init(void)
+{
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT io_getlocality(TPM_MODIFIER_INDICATOR *locality,
+                                 uint32_t tpm_number)
+{
+    (void)tpm_number;
+    *locality = current_locality;
+
+    return TPM_SUCCESS;
+}
+
+static TPM_RESULT io_getphysicalpresence(TPM_BOOL *physicalPresence,
+                                         uint32_t tpm_number)
+{
+    (void)tpm_number;
+    *physicalPresence = FALSE;
+
+    return TPM_SUCCESS;
+}
+
+static unsigned char *read_file(const char *filename, size_t *length,
+                                bool must_exist)
+{
+    unsigned char *data = NULL;
+    long size;
+    FILE *f;
+
+    f = fopen(filename, "rb");
+    if (!f) {
+        if (must_exist)
+            fprintf(stderr, "Could not open %s.\n", filename);
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0 ||
+        fseek(f, 0, SEEK_SET) < 0)
+        goto err;
+    data = malloc(size ? size : 1);
+    if (!data || fread(data, 1, size, f) != (size_t)size)
+        goto err;
+    fclose(f);
+    *length = size;
+
+    return data;
+
+err:
+    fprintf(stderr, "Could not read %s.\n", filename);
+    free(data);
+    fclose(f);
+
+    return NULL;
+}
+
+/*
+ * Load the state files that the default implementation of the nvram
+ * functions writes into a TPM_PATH directory.
+ */
+static int load_state(const char *dir)
+{
+    char filename[FILENAME_MAX];
+    bool found = false;
+    size_t i, length;
+
+    for (i = 0; i < sizeof(nvram_names) / sizeof(nvram_names[0]); i++) {
+        snprintf(filename, sizeof(filename), "%s/00.%s", dir, nvram_names[i]);
+        nvram_blobs[i] = read_file(filename, &length, false);
+        if (nvram_blobs[i]) {
+            nvram_lengths[i] = length;
+            found = true;
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "No TPM state found in %s.\n", dir);
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint16_t get_u16(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*
+ * Parse the record at the given offset. Returns the size of the record or
+ * 0 if the capture ends with a truncated or unknown record.
+ */
+static size_t parse_record(const unsigned char *data, size_t length,
+                           size_t offset, struct record *r)
+{
+    const unsigned char *p = &data[offset];
+    size_t avail = length - offset;
+
+    if (avail < 1)
+        return 0;
+    r->type = p[0];
+
+    switch (r->type) {
+    case TPM_CAPTURE_RECORD_INIT:
+        if (avail < TPM_CAPTURE_INIT_SIZE)
+            return 0;
+        r->tpm_version = get_u16(&p[1]);
+        return TPM_CAPTURE_INIT_SIZE;
+    case TPM_CAPTURE_RECORD_COMMAND:
+        if (avail < TPM_CAPTURE_COMMAND_HDR_SIZE)
+            return 0;
+        r->locality = p[1];
+        r->rc = get_u32(&p[2]);
+        r->command_size = get_u32(&p[6]);
+        if (avail - TPM_CAPTURE_COMMAND_HDR_SIZE < r->command_size)
+            return 0;
+        r->command = &p[TPM_CAPTURE_COMMAND_HDR_SIZE];
+        return TPM_CAPTURE_COMMAND_HDR_SIZE + r->command_size;
+    }
+
+    return 0;
+}
+
+static int add_latency(uint32_t ordinal, double t)
+{
+    struct ordinal_stats *s, *tmp;
+    double *latencies;
+    size_t i;
+
+    for (i = 0; i < num_stats; i++)
+        if (stats[i].ordinal == ordinal)
+            break;
+    if (i == num_stats) {
+        tmp = realloc(stats, (num_stats + 1) * sizeof(*stats));
+        if (!tmp)
+            return 1;
+        stats = tmp;
+        memset(&stats[num_stats], 0, sizeof(*stats));
+        stats[num_stats++].ordinal = ordinal;
+    }
+    s = &stats[i];
+    if (s->count == s->size) {
+        latencies = realloc(s->latencies,
+                            (s->size ? 2 * s->size : 16) * sizeof(*latencies));
+        if (!latencies)
+            return 1;
+        s->latencies = latencies;
+        s->size = s->size ? 2 * s->size : 16;
+    }
+    s->latencies[s->count++] = t;
+    s->total += t;
+
+    return 0;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1E6 + ts.tv_nsec / 1E3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+static int compare_ordinal(const void *a, const void *b)
+{
+    const struct ordinal_stats *sa = a, *sb = b;
+
+    return (sa->ordinal > sb->ordinal) - (sa->ordinal < sb->ordinal);
+}
+
+/* nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, unsigned int n, unsigned int p)
+{
+    unsigned int rank = (n * p + 99) / 100;
+
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static TPM_RESULT start_tpm(uint16_t tpm_version, bool running)
+{
+    TPM_RESULT res;
+
+    if (running)
+        TPMLIB_Terminate();
+
+    res = TPMLIB_ChooseTPMVersion(tpm_version);
+    if (res) {
+        fprintf(stderr, "TPMLIB_ChooseTPMVersion() failed: 0x%02x\n", res);
+        return res;
+    }
+    res = TPMLIB_MainInit();
+    if (res)
+        fprintf(stderr, "TPMLIB_MainInit() failed: 0x%02x\n", res);
+
+    return res;
+}
+
+static void print_results(const char *capture, unsigned int commands,
+                          unsigned int mismatches, double total)
+{
+    uint32_t version = TPMLIB_GetVersion();
+    struct ordinal_stats *s;
+    size_t i;
+
+    qsort(stats, num_stats, sizeof(*stats), compare_ordinal);
+
+    printf("{\n"
+           "  \"libtpms\": \"%u.%u.%u\",\n"
+           "  \"capture\": \"%s\",\n"
+           "  \"commands\": %u,\n"
+           "  \"mismatches\": %u,\n"
+           "  \"total_us\": %.1f,\n"
+           "  \"ordinals\": [\n",
+           version >> 16, (version >> 8) & 0xff, version & 0xff,
+           capture, commands, mismatches, total);
+
+    for (i = 0; i < num_stats; i++) {
+        s = &stats[i];
+        qsort(s->latencies, s->count, sizeof(*s->latencies), compare_double);
+        printf("    {\n"
+               "      \"ordinal\": \"0x%08x\",\n"
+               "      \"count\": %u,\n"
+               "      \"total_us\": %.1f,\n"
+               "      \"p50_us\": %.1f,\n"
+               "      \"p99_us\": %.1f\n"
+               "    }%s\n",
+               s->ordinal, s->count, s->total,
+               percentile(s->latencies, s->count, 50),
+               percentile(s->latencies, s->count, 99),
+               i + 1 < num_stats ? "," : "");
+    }
+
+    printf("  ]\n}\n");
+}
+
+static void usage(const char *prg)
+{
+    printf("Usage: %s [options] <capture file>\n"
+           "\n"
+           "Replay the TPM commands of a capture file recorded with\n"
+           "TPM_CAPTURE_FILE and print their latencies as JSON.\n"
+           "\n"
+           "-s, --state <dir>  start from the TPM state files in dir rather\n"
+           "                   than from a freshly manufactured TPM; the\n"
+           "                   files are not modified\n"
+           "-v, --verbose      print the latency and response code of each\n"
+           "                   command to stderr\n"
+           "-h, --help         display this help screen\n",
+           prg);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"state", required_argument, NULL, 's'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct libtpms_callbacks callbacks = {
+        .sizeOfStruct = sizeof(struct libtpms_callbacks),
+        .tpm_nvram_init = nvram_init,
+        .tpm_nvram_loaddata = nvram_loaddata,
+        .tpm_nvram_storedata = nvram_storedata,
+        .tpm_nvram_deletename = nvram_deletename,
+        .tpm_io_init = io_init,
+        .tpm_io_getlocality = io_getlocality,
+        .tpm_io_getphysicalpresence = io_getphysicalpresence,
+    };
+    unsigned int commands = 0, mismatches = 0;
+    unsigned char *rbuffer = NULL;
+    uint32_t rlength, rtotal = 0;
+    const char *state_dir = NULL;
+    unsigned char *capture;
+    bool verbose = false, running = false;
+    size_t length, offset, n;
+    struct record r;
+    double start, t, total = 0;
+    uint32_t rc;
+    TPM_RESULT res;
+    int ret = 1;
+    int opt;
+    size_t i;
+
+    while ((opt = getopt_long(argc, argv, "s:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            state_dir = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* do not capture the replay */
+    unsetenv("TPM_CAPTURE_FILE");
+
+    capture = read_file(argv[optind], &length, true);
+    if (!capture)
+        return 1;
+    if (length < TPM_CAPTURE_HEADER_SIZE ||
+        get_u32(capture) != TPM_CAPTURE_MAGIC ||
+        get_u16(&capture[4]) != TPM_CAPTURE_VERSION) {
+        fprintf(stderr, "%s is not a supported capture file.\n", argv[optind]);
+        goto exit;
+    }
+
+    if (state_dir && load_state(state_dir))
+        goto exit;
+
+    res = TPMLIB_RegisterCallbacks(&callbacks);
+    if (res) {
+        fprintf(stderr, "TPMLIB_RegisterCallbacks() failed: 0x%02x\n", res);
+        goto exit;
+    }
+
+    for (offset = TPM_CAPTURE_HEADER_SIZE; offset < length; offset += n) {
+        n = parse_record(capture, length, offset, &r);
+        if (n == 0) {
+            fprintf(stderr, "Ignoring truncated or unknown record at offset "
+                    "%zu.\n", offset);
+            break;
+        }
+
+        switch (r.type) {
+        case TPM_CAPTURE_RECORD_INIT:
+            if (start_tpm(r.tpm_version, running))
+                goto exit;
+            running = true;
+            break;
+        case TPM_CAPTURE_RECORD_COMMAND:
+            if (!running) {
+                fprintf(stderr, "Command at offset %zu precedes the TPM's "
+                        "initialization.\n", offset);
+                goto exit;
+            }
+            current_locality = r.locality;
+
+            start = now_us();
+            res = TPMLIB_Process(&rbuffer, &rlength, &rtotal,
+                                 (unsigned char *)r.command, r.command_size);
+            t = now_us() - start;
+            if (res) {
+                fprintf(stderr, "TPMLIB_Process() failed: 0x%02x\n", res);
+                goto exit_terminate;
+            }
+            rc = rlength >= 10 ? get_u32(&rbuffer[6]) : 0;
+
+            commands++;
+            total += t;
+            if (rc != r.rc)
+                mismatches++;
+            if (r.command_size >= 10 && add_latency(get_u32(&r.command[6]), t))
+                goto exit_terminate;
+            if (verbose)
+                fprintf(stderr, "%u: ordinal 0x%08x locality %u: %.1f us, "
+                        "rc 0x%x%s (expected 0x%x)\n",
+                        commands,
+                        r.command_size >= 10 ? get_u32(&r.command[6]) : 0,
+                        r.locality, t, rc, rc == r.rc ? "" : " MISMATCH",
+                        r.rc);
+            break;
+        }
+    }
+
+    print_results(argv[optind], commands, mismatches, total);
+    ret = 0;
+
+exit_terminate:
+    if (running)
+        TPMLIB_Terminate();
+
+exit:
+    for (i = 0; i < num_stats; i++)
+        free(stats[i].latencies);
+    free(stats);
+    for (i = 0; i < sizeof(nvram_blobs) / sizeof(nvram_blobs[0]); i++)
+        free(nvram_blobs[i]);
+    free(rbuffer);
+    free(capture);
+
+    return ret;
+}